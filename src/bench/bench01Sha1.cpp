@@ -0,0 +1,98 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the throughput of every SHA1 implementation available on this CPU.
+//
+// usage: bench01Sha1 [file]
+//   without argument, hashes 1 GiB from memory (the CPU cost only)
+//   with a file, also hashes it through SequentialFile (the CPU + I/O cost)
+
+#include <giga/utils/Sha1Engine.h>
+#include <giga/utils/SequentialFile.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using giga::utils::SequentialFile;
+using giga::utils::Sha1Engine;
+
+namespace
+{
+
+static constexpr std::size_t BUFFER_SIZE = 16u * 1024u * 1024u;
+static constexpr std::size_t ROUNDS      = 64u;
+
+double
+seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void
+report(const char* name, const char* source, uint64_t bytes, double elapsed)
+{
+    std::cout << std::left << std::setw(10) << name << std::setw(8) << source
+              << std::right << std::fixed << std::setprecision(2)
+              << static_cast<double>(bytes) / elapsed / 1e9 << " GB/s" << std::endl;
+}
+
+} /* anonymous namespace */
+
+int main(int argc, char** argv)
+{
+    std::vector<unsigned char> buffer(BUFFER_SIZE);
+    for (std::size_t i = 0; i < buffer.size(); ++i)
+    {
+        buffer[i] = static_cast<unsigned char>(i * 2654435761u >> 24);
+    }
+
+    std::cout << "best: " << Sha1Engine::name(Sha1Engine::best()) << std::endl;
+    for (auto implementation : {Sha1Engine::Implementation::shaNi, Sha1Engine::Implementation::openssl, Sha1Engine::Implementation::portable})
+    {
+        if (!Sha1Engine::available(implementation))
+        {
+            std::cout << std::left << std::setw(10) << Sha1Engine::name(implementation) << "unavailable" << std::endl;
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        Sha1Engine engine{implementation};
+        for (std::size_t i = 0; i < ROUNDS; ++i)
+        {
+            engine.update(buffer.data(), buffer.size());
+        }
+        engine.digest();
+        report(Sha1Engine::name(implementation), "memory", BUFFER_SIZE * ROUNDS, seconds(start));
+
+        if (argc > 1)
+        {
+            start = std::chrono::steady_clock::now();
+            SequentialFile file{argv[1]};
+            Sha1Engine fileEngine{implementation};
+            uint64_t total = 0u;
+            while (auto read = file.read())
+            {
+                fileEngine.update(file.data(), read);
+                total += read;
+            }
+            fileEngine.digest();
+            report(Sha1Engine::name(implementation), "file", total, seconds(start));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the throughput of the multi-buffer SHA1, on many small messages.
+//
+// usage: bench02MultiSha1 [message size in bytes, default 100000]
+
+#include <giga/utils/MultiSha1.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using giga::utils::MultiSha1;
+
+namespace
+{
+
+static constexpr std::size_t TOTAL_SIZE = 256u * 1024u * 1024u;
+static constexpr std::size_t ROUNDS     = 4u;
+
+} /* anonymous namespace */
+
+int main(int argc, char** argv)
+{
+    const std::size_t messageSize = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000u;
+    const std::size_t count = TOTAL_SIZE / std::max<std::size_t>(messageSize, 1u);
+
+    std::vector<unsigned char> buffer(count * messageSize);
+    for (std::size_t i = 0; i < buffer.size(); ++i)
+    {
+        buffer[i] = static_cast<unsigned char>(i * 2654435761u >> 24);
+    }
+    std::vector<MultiSha1::Message> messages;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        messages.push_back(MultiSha1::Message{buffer.data() + i * messageSize, messageSize});
+    }
+
+    std::cout << count << " messages of " << messageSize << " bytes, best: "
+              << MultiSha1::name(MultiSha1::best()) << std::endl;
+    for (auto implementation : {MultiSha1::Implementation::single, MultiSha1::Implementation::sse2, MultiSha1::Implementation::avx2, MultiSha1::Implementation::avx512})
+    {
+        if (!MultiSha1::available(implementation))
+        {
+            std::cout << std::left << std::setw(10) << MultiSha1::name(implementation) << "unavailable" << std::endl;
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < ROUNDS; ++i)
+        {
+            MultiSha1::hash(messages, implementation);
+        }
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << std::left << std::setw(10) << MultiSha1::name(implementation)
+                  << std::setw(4) << MultiSha1::lanes(implementation) << "lanes "
+                  << std::right << std::fixed << std::setprecision(2)
+                  << static_cast<double>(buffer.size() * ROUNDS) / elapsed / 1e9 << " GB/s" << std::endl;
+    }
+    return 0;
+}
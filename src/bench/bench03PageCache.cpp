@@ -0,0 +1,197 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares the I/O modes of the bulk transfers: throughput and page cache footprint.
+//
+// usage: bench03PageCache file [write size in MiB]
+//   hashes the file in every utils::IoMode (its pages are dropped before each run), then
+//   writes a file of the given size (default: 1024 MiB) next to it, as the downloads do.
+//   The footprint is the part of the file still in the page cache afterwards (mincore()).
+
+#include <giga/utils/PageCache.h>
+#include <giga/utils/ReadAheadFile.h>
+#include <giga/utils/Sha1Engine.h>
+
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using giga::utils::IoMode;
+using giga::utils::PageCacheDropper;
+using giga::utils::ReadAheadFile;
+using giga::utils::Sha1Engine;
+
+namespace
+{
+
+const char*
+name(IoMode mode)
+{
+    switch (mode)
+    {
+        case IoMode::cached:    return "cached";
+        case IoMode::streaming: return "streaming";
+        case IoMode::direct:    return "direct";
+    }
+    return "";
+}
+
+double
+seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+#ifndef _WIN32
+/** Drop the clean pages of the file, so that every run starts cold. */
+void
+evict(const boost::filesystem::path& file)
+{
+    auto fd = ::open(file.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+        fdatasync(fd);
+#if defined(POSIX_FADV_DONTNEED)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+        ::close(fd);
+    }
+}
+
+/** @return the part of the file in the page cache, in percents. */
+double
+residency(const boost::filesystem::path& file)
+{
+    auto size = boost::filesystem::file_size(file);
+    auto fd   = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0 || size == 0)
+    {
+        return 0.0;
+    }
+    auto map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+    {
+        return 0.0;
+    }
+    auto pageSize = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    std::vector<unsigned char> pages((size + pageSize - 1) / pageSize);
+#if defined(__APPLE__)
+    mincore(map, size, reinterpret_cast<char*>(pages.data()));
+#else
+    mincore(map, size, pages.data());
+#endif
+    munmap(map, size);
+    std::size_t resident = 0u;
+    for (auto page : pages)
+    {
+        resident += page & 1u;
+    }
+    return 100.0 * static_cast<double>(resident) / static_cast<double>(pages.size());
+}
+#endif
+
+void
+report(const char* step, IoMode mode, uint64_t bytes, double elapsed, double resident)
+{
+    std::cout << std::left << std::setw(7) << step << std::setw(11) << name(mode)
+              << std::right << std::fixed << std::setprecision(2)
+              << std::setw(8) << static_cast<double>(bytes) / elapsed / 1e9 << " GB/s"
+              << std::setw(8) << std::setprecision(1) << resident << " % cached" << std::endl;
+}
+
+} /* anonymous namespace */
+
+int main(int argc, char** argv)
+{
+#ifdef _WIN32
+    (void) argc;
+    (void) argv;
+    std::cout << "the I/O modes are not supported on Windows" << std::endl;
+#else
+    if (argc < 2)
+    {
+        std::cerr << "usage: " << argv[0] << " file [write size in MiB]" << std::endl;
+        return 1;
+    }
+    boost::filesystem::path file{argv[1]};
+    uint64_t writeSize = (argc > 2 ? std::stoull(argv[2]) : 1024u) * 1024u * 1024u;
+
+    for (auto mode : {IoMode::cached, IoMode::streaming, IoMode::direct})
+    {
+        evict(file);
+        auto start = std::chrono::steady_clock::now();
+        ReadAheadFile reader{file};
+        reader.setIoMode(mode);
+        Sha1Engine engine{Sha1Engine::best()};
+        uint64_t total = 0u;
+        while (auto read = reader.next())
+        {
+            engine.update(reader.data(), read);
+            total += read;
+        }
+        reader.close();
+        engine.digest();
+        report("hash", mode, total, seconds(start), residency(file));
+    }
+
+    // the same writes as details::CurlWriter
+    auto out = file.parent_path() / boost::filesystem::unique_path("bench03-%%%%-%%%%.tmp");
+    std::vector<char> chunk(16u * 1024u, 'g');
+    for (auto mode : {IoMode::cached, IoMode::streaming})
+    {
+        auto start = std::chrono::steady_clock::now();
+        {
+            std::ofstream os{out.c_str(), std::ios::binary | std::ios::trunc};
+            auto fd = mode == IoMode::cached ? -1 : ::open(out.c_str(), O_WRONLY | O_CLOEXEC);
+            PageCacheDropper dropper;
+            dropper.attach(fd, 0u, true);
+            uint64_t unflushed = 0u;
+            for (uint64_t written = 0u; written < writeSize; written += chunk.size())
+            {
+                os.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+                unflushed += chunk.size();
+                if (fd >= 0 && unflushed >= PageCacheDropper::WINDOW)
+                {
+                    os.flush();
+                    dropper.advance(unflushed);
+                    unflushed = 0u;
+                }
+            }
+            os.close();
+            if (fd >= 0)
+            {
+                dropper.advance(unflushed);
+                dropper.flush();
+                ::close(fd);
+            }
+        }
+        report("write", mode, writeSize, seconds(start), residency(out));
+        boost::filesystem::remove(out);
+    }
+#endif
+    return 0;
+}
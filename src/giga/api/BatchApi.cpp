@@ -0,0 +1,64 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "GigaApi.h"
+#include "data/User.h"
+
+#include <string>
+
+using utility::string_t;
+
+namespace giga
+{
+using namespace data;
+
+pplx::task<std::vector<BatchResult<Node>>>
+GigaApi::BatchApi::getNodesById (const std::vector<std::string>& nodeIds) const
+{
+    auto nodes = &api.nodes;
+    return run<Node>(nodeIds.size(), [nodes, nodeIds](std::size_t i) {
+        return nodes->getNodeById(nodeIds[i]);
+    });
+}
+
+pplx::task<std::vector<BatchResult<IdContainer>>>
+GigaApi::BatchApi::deleteNodes (const std::vector<std::string>& nodeIds) const
+{
+    auto nodes = &api.nodes;
+    return run<IdContainer>(nodeIds.size(), [nodes, nodeIds](std::size_t i) {
+        return nodes->deleteNode(nodeIds[i]);
+    });
+}
+
+pplx::task<std::vector<BatchResult<Node>>>
+GigaApi::BatchApi::renameNodes (const std::vector<std::pair<std::string, string_t>>& renames) const
+{
+    auto nodes = &api.nodes;
+    return run<Node>(renames.size(), [nodes, renames](std::size_t i) {
+        return nodes->renameNode(renames[i].first, renames[i].second);
+    });
+}
+
+pplx::task<std::vector<BatchResult<User>>>
+GigaApi::BatchApi::getUsersById (const std::vector<uint64_t>& userIds) const
+{
+    auto users = &api.users;
+    return run<User>(userIds.size(), [users, userIds](std::size_t i) {
+        return users->getUserById(userIds[i]);
+    });
+}
+
+} // namespace giga
@@ -54,6 +54,12 @@ GigaApi::authenticate (const string_t& login, const string_t& password)
     });
 }
 
+GigaApi::BatchApi
+GigaApi::batch(std::size_t maxConcurrency)
+{
+    return BatchApi{*this, maxConcurrency};
+}
+
 data::User&
 GigaApi::getCurrentUser()
 {
@@ -69,6 +75,12 @@ GigaApi::refreshToken() const
     return _client.refreshToken();
 }
 
+pplx::task<void>
+GigaApi::refreshRejectedToken(const utility::string_t& accessToken) const
+{
+    return _client.refreshRejectedToken(accessToken);
+}
+
 utility::string_t
 GigaApi::accessToken() const
 {
@@ -81,4 +93,40 @@ GigaApi::setUserAgent(utility::string_t userAgent)
     _client.setUserAgent(std::move(userAgent));
 }
 
+void
+GigaApi::setClientLimits(const ClientPool::Limits& limits)
+{
+    _client.setClientLimits(limits);
+}
+
+ClientPool::HostStats
+GigaApi::clientStats() const
+{
+    return _client.clientStats();
+}
+
+RequestCoalescer::Stats
+GigaApi::coalescingStats() const
+{
+    return _client.coalescingStats();
+}
+
+void
+GigaApi::setCacheLimits(const ResponseCache::Limits& limits)
+{
+    _client.setCacheLimits(limits);
+}
+
+ResponseCache::Stats
+GigaApi::cacheStats() const
+{
+    return _client.cacheStats();
+}
+
+void
+GigaApi::clearCache()
+{
+    _client.clearCache();
+}
+
 } // namespace giga
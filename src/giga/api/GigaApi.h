@@ -31,6 +31,7 @@
 #include "data/UserExists.h"
 #include "data/SmallNode.h"
 
+#include "../rest/BatchExecutor.h"
 #include "../rest/HttpClient.h"
 #include "../rest/JsonObj.h"
 #include "../rest/Empty.h"
@@ -39,6 +40,8 @@
 #include <pplx/pplxtasks.h>
 #include <memory>
 #include <mutex>
+#include <utility>
+#include <vector>
 
 namespace giga {
 
@@ -66,12 +69,42 @@ public:
     pplx::task<void>
     refreshToken() const;
 
+    pplx::task<void>
+    refreshRejectedToken(const utility::string_t& accessToken) const;
+
     utility::string_t
     accessToken() const;
 
     void
     setUserAgent(utility::string_t userAgent);
 
+    /**
+     * @see HttpClient::setClientLimits()
+     */
+    void
+    setClientLimits(const ClientPool::Limits& limits);
+
+    ClientPool::HostStats
+    clientStats() const;
+
+    /**
+     * @brief How many GET requests were served by an identical one in flight (hits), or sent (misses).
+     */
+    RequestCoalescer::Stats
+    coalescingStats() const;
+
+    /**
+     * @brief Set the memory, freshness and invalidation of the cached node and user replies (see ```ResponseCache```).
+     */
+    void
+    setCacheLimits(const ResponseCache::Limits& limits);
+
+    ResponseCache::Stats
+    cacheStats() const;
+
+    void
+    clearCache();
+
 public:
     class GroupsApi final
     {
@@ -244,6 +277,48 @@ public:
         GigaApi& api;
     };
 
+    class BatchApi final
+    {
+    private:
+        friend class GigaApi;
+        BatchApi(GigaApi& api, std::size_t maxConcurrency):api(api), _executor{maxConcurrency}{}
+    public:
+        pplx::task<std::vector<BatchResult<data::Node>>>
+        getNodesById (const std::vector<std::string>& nodeIds) const;
+
+        pplx::task<std::vector<BatchResult<data::IdContainer>>>
+        deleteNodes (const std::vector<std::string>& nodeIds) const;
+
+        /**
+         * @param renames is a list of (nodeId, name).
+         */
+        pplx::task<std::vector<BatchResult<data::Node>>>
+        renameNodes (const std::vector<std::pair<std::string, utility::string_t>>& renames) const;
+
+        pplx::task<std::vector<BatchResult<data::User>>>
+        getUsersById (const std::vector<uint64_t>& userIds) const;
+
+        /**
+         * @brief Batches any other request: ```call(i)``` for ```i``` in ```[0, count)```.
+         */
+        template<typename T> pplx::task<std::vector<BatchResult<T>>>
+        run (std::size_t count, BatchExecutor::Call<T> call) const
+        {
+            return _executor.run<T>(count, std::move(call));
+        }
+    private:
+        GigaApi&      api;
+        BatchExecutor _executor;
+    };
+
+    /**
+     * @brief Runs the requests on many items, with at most ```maxConcurrency``` of them in flight.
+     *
+     * Each item gets its value or its error, in the order of the input.
+     */
+    BatchApi
+    batch(std::size_t maxConcurrency = BatchExecutor::DEFAULT_CONCURRENCY);
+
 public:
     GroupsApi   groups;
     NetworkApi  network;
@@ -129,7 +129,7 @@ pplx::task<std::shared_ptr<Node>>
 GigaApi::NodesApi::getNodeById (const std::string& nodeId) const
 {
     auto uri = api._client.uri (U("nodes"), str2wstr(nodeId));
-    return api._client.request<Node> (methods::GET, uri);
+    return api._client.cachedRequest<Node> (uri);
 }
 
 pplx::task<std::shared_ptr<Node>>
@@ -152,7 +152,7 @@ pplx::task<std::shared_ptr<std::vector<Node>>>
 GigaApi::NodesApi::getChildrenNode (const std::string& nodeId) const
 {
     auto uri = api._client.uri (U("nodes"), str2wstr(nodeId), U("nodes"));
-    return api._client.request<std::vector<Node>> (methods::GET, uri);
+    return api._client.cachedRequest<std::vector<Node>> (uri);
 }
 
 pplx::task<std::shared_ptr<Node>>
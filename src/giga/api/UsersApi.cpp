@@ -33,7 +33,7 @@ pplx::task<std::shared_ptr<User>>
 GigaApi::UsersApi::getCurrentUser () const
 {
     auto uri = api._client.uri (U("me"));
-    return api._client.request<User> (methods::GET, uri);
+    return api._client.cachedRequest<User> (uri);
 }
 
 pplx::task<std::shared_ptr<std::vector<string_t>>>
@@ -77,7 +77,7 @@ pplx::task<std::shared_ptr<User>>
 GigaApi::UsersApi::getUserById (uint64_t userId) const
 {
     auto uri = api._client.uri (U("users"), userId);
-    return api._client.request<User> (methods::GET, uri);
+    return api._client.cachedRequest<User> (uri);
 }
 
 pplx::task<std::shared_ptr<User>>
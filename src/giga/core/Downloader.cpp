@@ -53,7 +53,11 @@ Downloader::Downloader (const Application& app) :
         _onErrorFct{[](const std::string& /*id*/, const utility::string_t& /*name*/, std::string&&){}},
         _rate{0},
         _isPaused{false},
+        _ioMode{utils::IoMode::cached},
+        _fileIo{nullptr},
         _clearing{0},
+        _progressNotifier{std::make_shared<details::ProgressNotifier>()},
+        _dispatcher{nullptr},
         _app{&app},
         _cts{}
 {
@@ -102,6 +106,70 @@ Downloader::setOnErrorFct(OnErrorFct fct)
     _onErrorFct = fct;
 }
 
+void
+Downloader::setAsyncCallbacks(bool async)
+{
+    std::lock_guard<std::mutex> l{_mut};
+    if (!async)
+    {
+        _dispatcher = nullptr;
+    }
+    else if (_dispatcher == nullptr)
+    {
+        _dispatcher = giga::make_unique<details::CallbackDispatcher>();
+    }
+}
+
+void
+Downloader::callProgress (const std::shared_ptr<FileDownloader>& downloader, TransferProgress progress) const
+{
+    if (_dispatcher == nullptr)
+    {
+        _progressCallback(*downloader, progress);
+        return;
+    }
+    auto fct = _progressCallback;
+    _dispatcher->post([fct, downloader, progress] { fct(*downloader, progress); });
+}
+
+void
+Downloader::callDownloaded (const Node& node, const boost::filesystem::path& path) const
+{
+    if (_dispatcher == nullptr)
+    {
+        _onDownloadedFct(node, path);
+        return;
+    }
+    auto fct  = _onDownloadedFct;
+    auto copy = std::shared_ptr<Node>{Node::create(node).release()};
+    _dispatcher->post([fct, copy, path] { fct(*copy, path); });
+}
+
+void
+Downloader::callFileDownloaded (const Node& node, const boost::filesystem::path& path, FileDownloader::Action action) const
+{
+    if (_dispatcher == nullptr)
+    {
+        _onFileDownloadedFct(node, path, action);
+        return;
+    }
+    auto fct  = _onFileDownloadedFct;
+    auto copy = std::shared_ptr<Node>{Node::create(node).release()};
+    _dispatcher->post([fct, copy, path, action] { fct(*copy, path, action); });
+}
+
+void
+Downloader::callError (const std::string& id, const utility::string_t& name, std::string&& error) const
+{
+    if (_dispatcher == nullptr)
+    {
+        _onErrorFct(id, name, std::move(error));
+        return;
+    }
+    auto fct = _onErrorFct;
+    _dispatcher->post([fct, id, name, error]() mutable { fct(id, name, std::move(error)); });
+}
+
 std::shared_ptr<FileDownloader>
 Downloader::downloadingFile ()
 {
@@ -113,6 +181,7 @@ void
 Downloader::start ()
 {
     _isStarted = true;
+    _progressNotifier->reset();
     auto dlTask = pplx::create_task([this]() {
         std::unique_ptr<QueueElement> element = nullptr;
         for(_queue.wait_dequeue(element); element != nullptr || _clearing > 0; _queue.wait_dequeue(element))
@@ -131,7 +200,7 @@ Downloader::start ()
 
                 downloadNode(*element->first, element->second);
                 std::lock_guard<std::mutex> l{_mut};
-                _onDownloadedFct(*element->first, element->second);
+                callDownloaded(*element->first, element->second);
             }
             catch (...)
             {
@@ -141,7 +210,7 @@ Downloader::start ()
                 try
                 {
                     std::lock_guard<std::mutex> l{_mut};
-                    _onErrorFct(element->first->id(), element->first->name(), std::move(error));
+                    callError(element->first->id(), element->first->name(), std::move(error));
                 }
                 catch (...)
                 {
@@ -150,18 +219,19 @@ Downloader::start ()
             }
         }
         _isFinished = true;
+        _progressNotifier->stop();
     }, _cts.get_token());
 
     auto progressTask = pplx::create_task([this]() {
-        while(!_isFinished)
+        // Woken by the FileDownloader, when its progress changes
+        while(_progressNotifier->wait())
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(500));
             std::lock_guard<std::mutex> l(_mut);
             if (_downloading != nullptr)
             {
                 try
                 {
-                    _progressCallback(*_downloading, _progress.getProgressAddByte(_downloading->progress().transfered));
+                    callProgress(_downloading, _progress.getProgressAddByte(_downloading->progress().transfered));
                 }
                 catch (...)
                 {
@@ -184,6 +254,10 @@ Downloader::join()
         _queue.enqueue(nullptr);
         _mainTask.wait();
         _isStarted = false;
+        if (_dispatcher != nullptr)
+        {
+            _dispatcher->flush();
+        }
     }
 }
 
@@ -215,6 +289,26 @@ Downloader::limitRate(uint64_t rate)
     }
 }
 
+void
+Downloader::setProgressInterval(std::chrono::milliseconds interval)
+{
+    _progressNotifier->setMinInterval(interval);
+}
+
+void
+Downloader::setIoMode(utils::IoMode mode)
+{
+    std::lock_guard<std::mutex> l(_mut);
+    _ioMode = mode;
+}
+
+void
+Downloader::setFileIo(std::shared_ptr<utils::FileIo> io)
+{
+    std::lock_guard<std::mutex> l(_mut);
+    _fileIo = std::move(io);
+}
+
 void
 Downloader::pause()
 {
@@ -258,7 +352,7 @@ Downloader::clear ()
 
             if (_downloading != nullptr)
             {
-                _progressCallback(*_downloading, _progress);
+                callProgress(_downloading, _progress);
             }
         }
     }
@@ -269,7 +363,7 @@ Downloader::callProgressFct () const
 {
     if (_downloading != nullptr)
     {
-        _progressCallback(*_downloading, _progress.getProgressAddByte(_downloading->progress().transfered));
+        callProgress(_downloading, _progress.getProgressAddByte(_downloading->progress().transfered));
     }
 }
 
@@ -336,7 +430,7 @@ Downloader::downloadNode (Node& node, const boost::filesystem::path& path)
 
             std::lock_guard<std::mutex> l{_mut};
             _progress = saved;
-            _onErrorFct(node.id(), node.name(), std::move(error));
+            callError(node.id(), node.name(), std::move(error));
             _downloading = nullptr;
         }
         catch (...)
@@ -387,6 +481,9 @@ Downloader::doDownloadNode (Node& node, const boost::filesystem::path& path)
         {
             std::lock_guard<std::mutex> l{_mut};
             fdownloader->limitRate(_rate);
+            fdownloader->setProgressNotifier(_progressNotifier);
+            fdownloader->setIoMode(_ioMode);
+            fdownloader->setFileIo(_fileIo);
             fdownloader->start();
             if (_isPaused)
             {
@@ -397,14 +494,14 @@ Downloader::doDownloadNode (Node& node, const boost::filesystem::path& path)
         {
             std::lock_guard<std::mutex> l{_mut};
             _downloading = std::move(fdownloader);
-            _progressCallback(*_downloading, _progress);
+            callProgress(_downloading, _progress);
         }
         auto result = task.get();
         {
             std::lock_guard<std::mutex> l{_mut};
             _progress.fileDone += 1;
             _progress.bytesTransfered += node.size();
-            _onFileDownloadedFct(node, result.path, result.action);
+            callFileDownloaded(node, result.path, result.action);
         }
     }
     else if (!npathExists)
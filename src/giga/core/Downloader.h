@@ -20,10 +20,13 @@
 #include "FileTransferer.h"
 #include "FileDownloader.h"
 #include "TransferProgress.h"
+#include "details/CallbackDispatcher.h"
+#include "details/ProgressNotifier.h"
 #include "../utils/readerwriterqueue.h"
 
 #include <boost/filesystem.hpp>
 #include <pplx/pplxtasks.h>
+#include <chrono>
 #include <string>
 #include <memory>
 
@@ -67,7 +70,7 @@ public:
      * ```fct``` will be called :
      *
      * - At the beginning of the download for each file
-     * - For long download it is called periodically.
+     * - For long download it is called each time the progress changes (see ```setProgressInterval()```).
      *
      * You should not do any long lasting computation in this function.
      */
@@ -83,6 +86,13 @@ public:
     void
     setOnErrorFct(OnErrorFct fct);
 
+    /**
+     * @brief Call the callbacks and the progress function on a dedicated thread.
+     * @see Uploader::setAsyncCallbacks()
+     */
+    void
+    setAsyncCallbacks(bool async);
+
     /**
      * @brief add a file or folder to the list of download
      *
@@ -118,6 +128,27 @@ public:
     void
     limitRate(uint64_t rate);
 
+    /**
+     * @brief Set the minimum time between two calls of the progress function (default: 100 ms).
+     */
+    void
+    setProgressInterval(std::chrono::milliseconds interval);
+
+    /**
+     * @brief Choose how the downloaded files are written (default: ```utils::IoMode::cached```).
+     * With ```utils::IoMode::streaming``` a bulk download does not fill the page cache.
+     * @see FileDownloader::setIoMode()
+     */
+    void
+    setIoMode(utils::IoMode mode);
+
+    /**
+     * @brief Write the downloaded files through ```io``` (default: nullptr, blocking writes).
+     * @see FileDownloader::setFileIo()
+     */
+    void
+    setFileIo(std::shared_ptr<utils::FileIo> io);
+
     /**
      * @brief Pause the current download. Uses ```resume()``` to restart.
      */
@@ -161,6 +192,21 @@ public:
     callProgressFct() const;
 
 private:
+    /**
+     * @brief Call a user callback now, or queue it when the callbacks are asynchronous. ```_mut``` must be locked.
+     */
+    void
+    callProgress (const std::shared_ptr<FileDownloader>& downloader, TransferProgress progress) const;
+
+    void
+    callDownloaded (const Node& node, const boost::filesystem::path& path) const;
+
+    void
+    callFileDownloaded (const Node& node, const boost::filesystem::path& path, FileDownloader::Action action) const;
+
+    void
+    callError (const std::string& id, const utility::string_t& name, std::string&& error) const;
+
     void
     downloadNode (Node& node, const boost::filesystem::path& path);
 
@@ -187,7 +233,11 @@ private:
 
     uint64_t                        _rate;
     bool                            _isPaused;
+    utils::IoMode                   _ioMode;
+    std::shared_ptr<utils::FileIo>  _fileIo;
     std::atomic<int>                _clearing;
+    std::shared_ptr<details::ProgressNotifier> _progressNotifier;
+    std::unique_ptr<details::CallbackDispatcher> _dispatcher;
 
 
     const Application*              _app;
@@ -18,6 +18,7 @@
 #include "Node.h"
 #include "FileNode.h"
 #include "details/CurlWriter.h"
+#include "details/CurlPool.h"
 #include "details/CurlProgress.h"
 #include "../Application.h"
 #include "../api/GigaApi.h"
@@ -74,7 +75,7 @@ namespace core
 FileDownloader::FileDownloader (const boost::filesystem::path& folder, const Node& node, const Application& app, pplx::cancellation_token_source cts, Policy policy) :
         FileTransferer{cts}, _task{}, _tempFile{}, _destFile{}, _action{Action::fileDownloaded}, _fileUri{},
         _fileSize{node.size()}, _startAt{0}, _lastUpdateDate{node.lastUpdateDate()}, _policy{policy},
-        _app(&app)
+        _ioMode{utils::IoMode::cached}, _fileIo{nullptr}, _app(&app)
 {
     if (!is_directory(folder))
     {
@@ -149,6 +150,8 @@ FileDownloader::FileDownloader (FileDownloader&& other) :
                 _startAt{other._startAt},
                 _lastUpdateDate{other._lastUpdateDate},
                 _policy{other._policy},
+                _ioMode{other._ioMode},
+                _fileIo{std::move(other._fileIo)},
                 _app{other._app}
 {
 }
@@ -177,6 +180,7 @@ FileDownloader::doStart()
     auto progress = _progress.get();
     auto fileUri  = _fileUri;
     auto action   = _action;
+    auto ioMode   = _ioMode;
     auto lastUpdateDate = _lastUpdateDate;
 
     auto ignore = false;
@@ -197,26 +201,29 @@ FileDownloader::doStart()
         auto cts  = _cts;
         auto& api = _app->api();
         auto ua   = _app->userAgent().c_str();
-        _task = api.refreshToken().then([tempFile, fileUri, progress, fileSize, cts, &api, action, ua]() {
+        auto fileIo = _fileIo;
+        _task = api.refreshToken().then([tempFile, fileUri, progress, fileSize, cts, &api, action, ua, ioMode, fileIo]() {
 
             uint64_t httpCode = 0;
             const auto maxTry = 5;
             for (auto i = 0; i <= maxTry && httpCode != 200; ++i)
             {
+                auto accessToken = api.accessToken();
                 uri_builder b{fileUri};
-                b.append_query(U("access_token"), api.accessToken());
+                b.append_query(U("access_token"), accessToken);
                 auto tokenedFileUri = b.to_uri().to_string();
 
                 try {
-                    details::CurlWriter writer{tempFile};
-                    auto pos = writer.file().tellp();
-                    if (pos == static_cast<int64_t>(fileSize))
+                    details::CurlWriter writer{tempFile, ioMode, fileIo};
+                    auto pos = writer.position();
+                    if (pos == fileSize)
                     {
                         return; // the file is already completed.
                     }
 
                     curl_ios<details::CurlWriter> easyWriter(&writer, &curlWriteCallback);
-                    curl_easy curl(easyWriter);
+                    auto lease = details::CurlPool::instance().lease(easyWriter);
+                    auto& curl = lease.curl();
                     progress->setCurl(curl);
                     writer.setCurl(curl);
 
@@ -240,6 +247,7 @@ FileDownloader::doStart()
                     curl.add<CURLOPT_SSL_VERIFYPEER>(0L);
 //#endif
                     curl.perform();
+                    writer.finish();
                     curl_easy_getinfo (curl.get_curl(), CURLINFO_RESPONSE_CODE, &httpCode);
                     if (httpCode >= 300)
                     {
@@ -260,7 +268,7 @@ FileDownloader::doStart()
                 }
                 catch (ErrorUnauthorized const&)
                 {
-                    api.refreshToken().wait();
+                    api.refreshRejectedToken(accessToken).wait();
 
                     uri_builder bu{fileUri};
                     bu.append_query(U("access_token"), api.accessToken());
@@ -330,6 +338,18 @@ FileDownloader::filename () const
     return _destFile;
 }
 
+void
+FileDownloader::setIoMode (utils::IoMode mode)
+{
+    _ioMode = mode;
+}
+
+void
+FileDownloader::setFileIo (std::shared_ptr<utils::FileIo> io)
+{
+    _fileIo = std::move(io);
+}
+
 FileTransferer::Progress
 FileDownloader::progress () const
 {
@@ -18,6 +18,8 @@
 #define GIGA_CORE_FILEDOWNLOADER_H_
 
 #include "FileTransferer.h"
+#include "../utils/FileIo.h"
+#include "../utils/PageCache.h"
 
 #include <boost/filesystem.hpp>
 #include <cpprest/http_client.h>
@@ -133,6 +135,20 @@ public:
     const boost::filesystem::path&
     filename() const override;
 
+    /**
+     * @brief Set how the file is written (default: ```utils::IoMode::cached```).
+     * Must be called before ```start()```.
+     */
+    void
+    setIoMode(utils::IoMode mode);
+
+    /**
+     * @brief Write the file through ```io``` (default: nullptr, blocking writes).
+     * Must be called before ```start()```.
+     */
+    void
+    setFileIo(std::shared_ptr<utils::FileIo> io);
+
 protected:
     void
     doStart () override;
@@ -148,6 +164,8 @@ private:
     uint64_t                 _startAt;
     std::chrono::system_clock::time_point _lastUpdateDate;
     Policy                   _policy;
+    utils::IoMode            _ioMode;
+    std::shared_ptr<utils::FileIo> _fileIo;
     const Application*       _app;
 };
 
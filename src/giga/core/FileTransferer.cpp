@@ -118,5 +118,11 @@ FileTransferer::limitRate (uint64_t rate)
     _progress->setLimitRate(rate);
 }
 
+void
+FileTransferer::setProgressNotifier (std::shared_ptr<details::ProgressNotifier> notifier)
+{
+    _progress->setNotifier(std::move(notifier));
+}
+
 } /* namespace core */
 } /* namespace giga */
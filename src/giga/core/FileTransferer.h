@@ -20,12 +20,14 @@
 #include <boost/filesystem.hpp>
 #include <cpprest/details/basic_types.h>
 #include <pplx/pplxtasks.h>
+#include <memory>
 #include <mutex>
 
 namespace giga
 {
 namespace details {
 class CurlProgress;
+class ProgressNotifier;
 }
 
 namespace core
@@ -107,6 +109,13 @@ public:
     void
     limitRate (uint64_t rate);
 
+    /**
+     * @brief Notify ```notifier``` each time the progress of this transfer changes.
+     * Must be called before ```start()```.
+     */
+    void
+    setProgressNotifier (std::shared_ptr<details::ProgressNotifier> notifier);
+
     virtual FileTransferer::Progress
     progress () const = 0;
 
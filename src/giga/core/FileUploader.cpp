@@ -89,7 +89,15 @@ FileUploader::FileUploader (const path& filename, const string_t& nodeName, cons
         _fkey{fkey},
         _fileSize{boost::filesystem::file_size(filename)},
         _fileCDate{static_cast<uint64_t>(boost::filesystem::last_write_time(filename))},
-        _app(&app)
+        _app(&app),
+        _parallelChunks{1u},
+        _chunkSizer{std::make_shared<details::ChunkSizer>(details::ChunkSizing::fixed(ChunkUploader::CHUNK_SIZE))},
+        _resumePosition{0ul},
+        _onAcknowledgedFct{[](uint64_t){}},
+        _uploadUrl{},
+        _content{nullptr},
+        _ioMode{utils::IoMode::cached},
+        _fileIo{nullptr}
 {
 }
 
@@ -119,61 +127,53 @@ FileUploader::doStart ()
     auto cts        = _cts;
     auto progress   = _progress.get();
     auto app        = _app;
+    auto parallelChunks = _parallelChunks;
+    auto chunkSizer = _chunkSizer;
+    auto resumePosition    = _resumePosition;
+    auto onAcknowledgedFct = _onAcknowledgedFct;
+    auto content           = _content;
+    auto ioMode            = _ioMode;
+    auto fileIo            = _fileIo;
 
 
-    _task = _app->api().refreshToken().then([=] {
-        try {
-
-            //
-            // Test if the file is on giga (and add it if possible)
-            //
-
-            auto res = app->api().nodes.addNode(nodeName, U("file"), parentId, fkey, fid, fileCDate).get();
-            return std::shared_ptr<data::Node>{std::move(res->data)};
-        } catch (const ErrorNotFound& e) {
+    // The upload url is known when the node was already added (see instantUpload())
+    auto added = _uploadUrl.empty()
+        ? instantUpload(filename, nodeName, parentId, fid, fkey, *app)
+        : pplx::task_from_result(InstantUpload{nullptr, _uploadUrl});
 
-            //
-            // The file is not yet on giga
-            //
+    _task = added.then([=] (InstantUpload found) {
+        if (found.node != nullptr)
+        {
+            return found.node;
+        }
 
-            if (e.getJson().has_field(U("uploadUrl"))) {
-                auto uploadUrl = e.getJson().at(U("uploadUrl")).as_string();
-                auto uriBuilder = uri_builder(uri{U("https:") + uploadUrl + web::uri::encode_data_string(utils::str2wstr(nodeKeyCl))});
-                uriBuilder.append_query(U("mdate"), fileCDate);
-                const auto maxTry = 3;
-                for (auto i = 1; i <= maxTry; ++i)
+        auto uriBuilder = uri_builder(uri{U("https:") + found.uploadUrl + web::uri::encode_data_string(utils::str2wstr(nodeKeyCl))});
+        uriBuilder.append_query(U("mdate"), fileCDate);
+        const auto maxTry = 3;
+        for (auto i = 1; ; ++i)
+        {
+            try
+            {
+                ChunkUploader ch{uriBuilder, nodeName, sha1, filename, U("application/octet-stream"), progress, *app};
+                ch.setParallelChunks(parallelChunks);
+                ch.setChunkSizer(chunkSizer);
+                ch.setResumePosition(resumePosition);
+                ch.setOnAcknowledgedFct(onAcknowledgedFct);
+                ch.setContent(content);
+                ch.setIoMode(ioMode);
+                ch.setFileIo(fileIo);
+                return std::shared_ptr<Node>(Node::create(ch.upload(), *app).release());
+            }
+            catch (...)
+            {
+                if (i == maxTry || cts.get_token().is_canceled())
                 {
-                    try
-                    {
-                        ChunkUploader ch{uriBuilder, nodeName, sha1, filename, U("application/octet-stream"), progress, *app};
-                        return ch.upload();
-                    }
-                    catch (...)
-                    {
-                        if (i == maxTry || cts.get_token().is_canceled())
-                        {
-                            throw;
-                        }
-                        GIGA_DEBUG_LOG(trace, utils::exceptionInfos());
-                        std::this_thread::sleep_for(std::chrono::milliseconds(250 * i));
-                    }
+                    throw;
                 }
+                GIGA_DEBUG_LOG(trace, utils::exceptionInfos());
+                std::this_thread::sleep_for(std::chrono::milliseconds(250 * i));
             }
-            throw;
-        } catch (const ErrorLocked& e) {
-
-            //
-            // The file is already on giga (same fid/name).
-            //
-
-            if (e.getJson().has_field(U("data"))) {
-                auto s = JSonUnserializer{e.getJson().at(U("data"))};
-                return s.unserialize<std::shared_ptr<data::Node>>();
-            }
-            throw;
         }
-    }, _cts.get_token()).then([=] (std::shared_ptr<data::Node> n) {
-        return std::shared_ptr<Node>(Node::create(n, *app).release());
     }, _cts.get_token());
 }
 
@@ -212,5 +212,113 @@ FileUploader::fileSize() const
     return _fileSize;
 }
 
+void
+FileUploader::setParallelChunks(unsigned count)
+{
+    _parallelChunks = count;
+}
+
+void
+FileUploader::setChunkSizing(const details::ChunkSizing& sizing)
+{
+    _chunkSizer = std::make_shared<details::ChunkSizer>(sizing);
+}
+
+uint64_t
+FileUploader::throughput() const
+{
+    return _chunkSizer->throughput();
+}
+
+uint64_t
+FileUploader::chunkSize() const
+{
+    return _chunkSizer->size();
+}
+
+void
+FileUploader::setResumePosition(uint64_t position)
+{
+    _resumePosition = position;
+}
+
+void
+FileUploader::setOnAcknowledgedFct(std::function<void(uint64_t)> fct)
+{
+    _onAcknowledgedFct = fct;
+}
+
+void
+FileUploader::setUploadUrl(const string_t& uploadUrl)
+{
+    _uploadUrl = uploadUrl;
+}
+
+void
+FileUploader::setContent(details::FileContent content)
+{
+    if (content != nullptr)
+    {
+        _fileSize = content->size();
+    }
+    _content = std::move(content);
+}
+
+void
+FileUploader::setIoMode(utils::IoMode mode)
+{
+    _ioMode = mode;
+}
+
+void
+FileUploader::setFileIo(std::shared_ptr<utils::FileIo> io)
+{
+    _fileIo = std::move(io);
+}
+
+pplx::task<FileUploader::InstantUpload>
+FileUploader::instantUpload (const path& filename, const string_t& nodeName, const std::string& parentId,
+                             const std::string& fid, const std::string& fkey, const Application& app)
+{
+    auto mdate   = static_cast<uint64_t>(boost::filesystem::last_write_time(filename));
+    auto appPtr  = &app;
+
+    return app.api().refreshToken().then([=] {
+        return appPtr->api().nodes.addNode(nodeName, U("file"), parentId, fkey, fid, mdate);
+    }).then([=](task<std::shared_ptr<data::DataNode>> t) {
+        std::shared_ptr<data::Node> n = nullptr;
+        try {
+
+            //
+            // Test if the file is on giga (and add it if possible)
+            //
+
+            n = std::shared_ptr<data::Node>{std::move(t.get()->data)};
+        } catch (const ErrorNotFound& e) {
+
+            //
+            // The file is not yet on giga
+            //
+
+            if (e.getJson().has_field(U("uploadUrl"))) {
+                return InstantUpload{nullptr, e.getJson().at(U("uploadUrl")).as_string()};
+            }
+            throw;
+        } catch (const ErrorLocked& e) {
+
+            //
+            // The file is already on giga (same fid/name).
+            //
+
+            if (!e.getJson().has_field(U("data"))) {
+                throw;
+            }
+            auto s = JSonUnserializer{e.getJson().at(U("data"))};
+            n = s.unserialize<std::shared_ptr<data::Node>>();
+        }
+        return InstantUpload{std::shared_ptr<Node>(Node::create(n, *appPtr).release()), string_t{}};
+    });
+}
+
 } /* namespace api */
 } /* namespace giga */
@@ -18,10 +18,16 @@
 #define GIGA_API_FILEUPLOADER_H_
 
 #include "FileTransferer.h"
+#include "details/ChunkSizer.h"
+#include "details/FileBufferPool.h"
+#include "../utils/FileIo.h"
+#include "../utils/PageCache.h"
 
 #include <pplx/pplxtasks.h>
 #include <cpprest/details/basic_types.h>
 #include <boost/filesystem.hpp>
+#include <functional>
+#include <memory>
 
 namespace giga
 {
@@ -43,6 +49,16 @@ class UploadState;
  */
 class FileUploader final : public FileTransferer
 {
+public:
+    /**
+     * The answer of GiGa.GG when a file is added by its fid:
+     * the new node if its content already is on GiGa.GG, the url to upload it to otherwise.
+     */
+    struct InstantUpload {
+        std::shared_ptr<Node> node;
+        utility::string_t     uploadUrl;
+    };
+
 public:
     explicit
     FileUploader (const boost::filesystem::path& filename, const utility::string_t& nodeName, const std::string& parentId,
@@ -56,6 +72,18 @@ public:
     FileUploader (const FileUploader&)           = delete;
 
 public:
+    /**
+     * @brief Add the node of ```filename``` without sending its content.
+     *
+     * It succeeds with ```InstantUpload::node``` set when the content is already on GiGa.GG,
+     * and with ```InstantUpload::uploadUrl``` set when it must be uploaded (see ```setUploadUrl()```).
+     * It is the first step of every ```FileUploader```: calling it for many files at the same time
+     * skips the upload process of the deduplicated ones.
+     */
+    static pplx::task<InstantUpload>
+    instantUpload (const boost::filesystem::path& filename, const utility::string_t& nodeName, const std::string& parentId,
+                   const std::string& fid, const std::string& fkey, const Application& app);
+
 
     /**
      * @brief Gets the task managing the upload process.
@@ -82,6 +110,76 @@ public:
     uint64_t
     fileSize() const;
 
+    /**
+     * @brief Send up to ```count``` chunks of this file at the same time (default: 1).
+     * Must be called before ```start()```.
+     */
+    void
+    setParallelChunks(unsigned count);
+
+    /**
+     * @brief Choose how the chunks of this file are sized (default: fixed 1 MiB chunks).
+     * Must be called before ```start()```.
+     */
+    void
+    setChunkSizing(const details::ChunkSizing& sizing);
+
+    /**
+     * @brief Gets the mean throughput of the chunks sent so far, in Bytes/s.
+     * It is 0 when nothing was sent (the file already was on GiGa.GG for example).
+     */
+    uint64_t
+    throughput() const;
+
+    /**
+     * @brief Gets the size of the next chunk to be sent.
+     */
+    uint64_t
+    chunkSize() const;
+
+    /**
+     * @brief Resume a previous upload of this file: start at ```position```.
+     * Must be called before ```start()```.
+     * @see setOnAcknowledgedFct()
+     */
+    void
+    setResumePosition(uint64_t position);
+
+    /**
+     * @param fct called with the number of bytes acknowledged by the server, after each chunk.
+     * Must be called before ```start()```.
+     */
+    void
+    setOnAcknowledgedFct(std::function<void(uint64_t)> fct);
+
+    /**
+     * @brief Upload the content to ```uploadUrl``` (as given by ```instantUpload()```) without adding the node first.
+     * Must be called before ```start()```.
+     */
+    void
+    setUploadUrl(const utility::string_t& uploadUrl);
+
+    /**
+     * @brief Send ```content``` (the whole file, read when it was prepared) instead of reading the file again.
+     * Must be called before ```start()```.
+     */
+    void
+    setContent(details::FileContent content);
+
+    /**
+     * @brief Set how the file is read (default: ```utils::IoMode::cached```).
+     * Must be called before ```start()```.
+     */
+    void
+    setIoMode(utils::IoMode mode);
+
+    /**
+     * @brief Read the file through ```io``` (default: nullptr, blocking reads).
+     * Must be called before ```start()```.
+     */
+    void
+    setFileIo(std::shared_ptr<utils::FileIo> io);
+
 protected:
     void
     doStart () override;
@@ -99,6 +197,14 @@ private:
     uint64_t           _fileSize;
     uint64_t           _fileCDate;
     const Application* _app;
+    unsigned           _parallelChunks;
+    std::shared_ptr<details::ChunkSizer> _chunkSizer;
+    uint64_t                             _resumePosition;
+    std::function<void(uint64_t)>        _onAcknowledgedFct;
+    utility::string_t                    _uploadUrl;
+    details::FileContent                 _content;
+    utils::IoMode                        _ioMode;
+    std::shared_ptr<utils::FileIo>       _fileIo;
 };
 
 } /* namespace api */
@@ -5,27 +5,21 @@
  *      Author: thomas
  */
 
-#include "crypto++/filters.h"
-#include "crypto++/hex.h"
-
 #include "Sha1Calculator.h"
 
 #include "details/CurlProgress.h"
 #include "../rest/HttpErrors.h"
+#include "../utils/Sha1Engine.h"
 #include "../utils/Utils.h"
 
 #include <boost/filesystem.hpp>
 #include <boost/throw_exception.hpp>
 #include <curl/curl.h>
-#include <openssl/sha.h>
 #include <chrono>
 #include <memory>
 #include <thread>
 
 using boost::filesystem::path;
-using CryptoPP::HexEncoder;
-using CryptoPP::StringSink;
-using CryptoPP::StringSource;
 using std::chrono::milliseconds;
 
 namespace giga
@@ -33,20 +27,13 @@ namespace giga
 namespace core
 {
 
-static constexpr uint32_t BUF_SIZE = 8192;
-
 Sha1Calculator::Sha1Calculator(const path& filename, pplx::cancellation_token_source cts):
         FileTransferer{cts},
         _filename{filename},
         _task{},
-        _is{filename.c_str(), std::ifstream::binary},
-        _buf{std::unique_ptr<char[]>(new char[BUF_SIZE])},
+        _file{filename},
         _fileSize{boost::filesystem::file_size(filename)}
 {
-    if (!_is)
-    {
-        BOOST_THROW_EXCEPTION(ErrorException{U("Cannot open file")});
-    }
 }
 
 Sha1Calculator::~Sha1Calculator()
@@ -57,10 +44,7 @@ Sha1Calculator::~Sha1Calculator()
         {
             _task.wait();
         }
-        if (_is.is_open())
-        {
-            _is.close();
-        }
+        _file.close();
     }
     catch (...)
     {
@@ -92,66 +76,50 @@ Sha1Calculator::filename() const
     return _filename;
 }
 
+void
+Sha1Calculator::setReadAhead (std::size_t blockSize, std::size_t depth)
+{
+    _file.setBuffers(blockSize, depth);
+}
+
+void
+Sha1Calculator::setIoMode (utils::IoMode mode)
+{
+    _file.setIoMode(mode);
+}
+
+void
+Sha1Calculator::setFileIo (std::shared_ptr<utils::FileIo> io)
+{
+    _file.setFileIo(std::move(io));
+}
+
 void
 Sha1Calculator::doStart ()
 {
     _task = pplx::create_task([this] {
-        SHA_CTX ctx;
-        SHA1_Init(&ctx);
+        utils::Sha1Engine engine;
         uint64_t processed = 0;
-        uint64_t count = 0;
-        do {
-            _is.read (_buf.get(), BUF_SIZE);
-            if ((_is.rdstate() & std::ifstream::eofbit) == 0 &&
-                (_is.rdstate() & std::ifstream::failbit) != 0)
-            {
-                BOOST_THROW_EXCEPTION(ErrorException{U("Error reading file")});
-            }
+        // the next blocks are read in the background while this one is hashed
+        while (auto read = _file.next())
+        {
+            engine.update(_file.data(), read);
+            processed += read;
 
-            auto read = _is.gcount();
-            if (read > 0)
+            // a block is large (see ReadAheadFile): report the progress after each one
+            auto result = _progress->onCallback(0, 0, _fileSize, processed);
+            if (result == CURLE_ABORTED_BY_CALLBACK)
             {
-                SHA1_Update(&ctx, _buf.get(), static_cast<std::size_t>(read));
-                processed += read;
-                count += 1;
+                BOOST_THROW_EXCEPTION(ErrorException{U("Calculation canceled")});
             }
-
-            if ((count % 8192) == 0)
+            while (_progress->isPaused())
             {
-                auto result = _progress->onCallback(0, 0, _fileSize, processed);
-                if (result == CURLE_ABORTED_BY_CALLBACK)
-                {
-                    BOOST_THROW_EXCEPTION(ErrorException{U("Calculation canceled")});
-                }
-                while (_progress->isPaused())
-                {
-                    std::this_thread::sleep_for(milliseconds(500));
-                }
+                std::this_thread::sleep_for(milliseconds(500));
             }
-
-        } while ((_is.rdstate() & std::ifstream::eofbit) == 0);
-
-        if (_is.is_open())
-        {
-            _is.close();
         }
+        _file.close();
 
-        unsigned char hashBuf[SHA_DIGEST_LENGTH];
-        SHA1_Final(hashBuf, &ctx);
-
-        std::string hash;
-        StringSource ss(hashBuf, SHA_DIGEST_LENGTH, true,
-            new HexEncoder(
-                new StringSink(hash)
-            ) // HexEncoder
-        ); // StringSource
-
-        std::locale l{"C"};
-        std::transform(hash.begin(), hash.end(), hash.begin(), [&l](char c) {
-            return std::tolower(c, l);
-        });
-
-        return hash;
+        return engine.hexDigest();
     });
 }
 
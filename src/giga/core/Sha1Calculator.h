@@ -9,11 +9,11 @@
 #define GIGA_CORE_SHA1CALCULATOR_H_
 
 #include "FileTransferer.h"
+#include "../utils/ReadAheadFile.h"
 
 #include <cpprest/details/basic_types.h>
 #include <pplx/pplxtasks.h>
 #include <boost/filesystem.hpp>
-#include <fstream>
 #include <memory>
 
 namespace giga
@@ -53,6 +53,25 @@ public:
     const boost::filesystem::path&
     filename() const override;
 
+    /**
+     * @brief Set how the file is read: ```depth``` buffers (at least 2) of ```blockSize``` bytes.
+     * A buffer is hashed while the next ones are being read. Must be called before ```start()```.
+     */
+    void
+    setReadAhead (std::size_t blockSize, std::size_t depth);
+
+    /**
+     * @brief Set how the file is read (default: ```utils::IoMode::cached```). Must be called before ```start()```.
+     */
+    void
+    setIoMode (utils::IoMode mode);
+
+    /**
+     * @brief Read the file through ```io``` (default: nullptr, blocking reads). Must be called before ```start()```.
+     */
+    void
+    setFileIo (std::shared_ptr<utils::FileIo> io);
+
 protected:
     void
     doStart () override;
@@ -60,8 +79,7 @@ protected:
 private:
     boost::filesystem::path _filename;
     pplx::task<std::string> _task;
-    std::ifstream           _is;
-    std::unique_ptr<char[]> _buf;
+    utils::ReadAheadFile    _file;
     uint64_t                _fileSize;
 
 };
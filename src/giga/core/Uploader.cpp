@@ -16,6 +16,8 @@
 
 #include "Uploader.h"
 
+#include "details/ChunkUploader.h"
+#include "details/DirectoryScanner.h"
 #include "../rest/HttpErrors.h"
 #include "../utils/make_unique.h"
 
@@ -24,6 +26,10 @@
 #include <boost/algorithm/string.hpp>
 #include <cpprest/asyncrt_utils.h>
 #include <pplx/pplxtasks.h>
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <map>
 #include <string>
 #include <memory>
 #include <thread>
@@ -32,11 +38,48 @@
 
 #include "../Application.h"
 #include "../utils/Crypto.h"
+#include "../utils/MultiSha1.h"
+#include "../utils/SequentialFile.h"
 #include "../utils/Utils.h"
 using boost::filesystem::path;
-using moodycamel::BlockingReaderWriterQueue;
 using utility::details::make_unique;
 
+namespace
+{
+// Each preparation worker keeps a pplx thread busy while its Sha1Calculator
+// runs on another one: keep enough threads in the pplx pool for the rest of the pipeline.
+constexpr unsigned MAX_PREPARE_WORKERS = 16u;
+constexpr unsigned MAX_UPLOAD_WORKERS  = 8u;
+// The probes are asynchronous: they do not keep a pplx thread busy.
+constexpr unsigned MAX_PROBES = 32u;
+// Folders created at the same time when the skeleton of an upload is created.
+constexpr unsigned MAX_SKELETON_WORKERS = 4u;
+// Directories listed at the same time by the scan.
+constexpr unsigned MAX_SCAN_WORKERS = 4u;
+// Memory used by the files waiting to be prepared (and to be uploaded).
+constexpr std::size_t DEFAULT_QUEUE_BYTES = 64u * 1024u * 1024u;
+// The files hashed by batches (read whole in memory).
+constexpr uint64_t DEFAULT_BATCH_HASH_THRESHOLD = 256u * 1024u;
+
+unsigned
+clampPrepareWorkers(unsigned count)
+{
+    return std::max(1u, std::min(count, MAX_PREPARE_WORKERS));
+}
+
+unsigned
+clampUploadWorkers(unsigned count)
+{
+    return std::max(1u, std::min(count, MAX_UPLOAD_WORKERS));
+}
+
+unsigned
+clampProbes(unsigned count)
+{
+    return std::max(1u, std::min(count, MAX_PROBES));
+}
+}
+
 namespace giga
 {
 namespace core
@@ -44,39 +87,148 @@ namespace core
 
 struct UploadRequest
 {
-    explicit UploadRequest(FolderNode dest, std::vector<boost::filesystem::path> pathes):
-                    dest{std::move(dest)}, pathes{std::move(pathes)}
+    explicit UploadRequest(FolderNode dest, std::vector<boost::filesystem::path> pathes, uint64_t id, int priority):
+                    dest{std::move(dest)}, pathes{std::move(pathes)}, id{id}, priority{priority}
     {}
     FolderNode                           dest;
     std::vector<boost::filesystem::path> pathes;
+    uint64_t                             id;
+    int                                  priority;
 };
 
+struct ProbedFile
+{
+    explicit ProbedFile(PreparedFile prepared, utility::string_t uploadUrl):
+                    prepared{std::move(prepared)}, uploadUrl{std::move(uploadUrl)}
+    {}
+    PreparedFile      prepared;
+    utility::string_t uploadUrl; // empty if the probe failed: the FileUploader adds the node itself
+};
+
+namespace
+{
+// Approximate memory used by the elements of the pipeline queues (the markers weigh nothing).
+std::size_t
+requestWeight(const std::unique_ptr<UploadRequest>& request)
+{
+    if (!request)
+    {
+        return 0u;
+    }
+    auto weight = sizeof(UploadRequest) + request->pathes.capacity() * sizeof(path);
+    for (const auto& p : request->pathes)
+    {
+        weight += p.native().capacity();
+    }
+    return weight;
+}
+
+std::size_t
+scannedFileWeight(const ScannedFile& file)
+{
+    return sizeof(ScannedFile)
+        + file.request.parentId.capacity()
+        + file.request.path.native().capacity()
+        + file.nodePath.native().capacity();
+}
+
+std::size_t
+scannedWeight(const std::unique_ptr<ScannedFile>& file)
+{
+    return file ? scannedFileWeight(*file) : 0u;
+}
+
+std::size_t
+preparedFileWeight(const PreparedFile& file)
+{
+    return sizeof(PreparedFile) - sizeof(ScannedFile)
+        + scannedFileWeight(file.scanned)
+        + file.sha1.capacity() + file.fkey.capacity() + file.fid.capacity() + file.fkeyEnc.capacity()
+        + (file.content != nullptr ? file.content->size() : 0u);
+}
+
+std::size_t
+preparedWeight(const std::unique_ptr<PreparedFile>& file)
+{
+    return file ? preparedFileWeight(*file) : 0u;
+}
+
+details::SchedulingTicket
+ticket(const PreparedFile& file)
+{
+    const auto& request = file.scanned.request;
+    return details::SchedulingTicket{file.scanned.size, request.requestId, request.priority};
+}
+
+std::size_t
+probedWeight(const std::unique_ptr<ProbedFile>& file)
+{
+    if (!file)
+    {
+        return 0u;
+    }
+    return sizeof(ProbedFile) - sizeof(PreparedFile)
+        + preparedFileWeight(file->prepared)
+        + file->uploadUrl.capacity() * sizeof(utility::char_t);
+}
+}
+
 Uploader::Uploader(const Application& app):
     _requests{},
     _scanned{},
     _prepared{},
+    _probed{},
     _clearRequestQueue{0},
     _clearScannedQueue{0},
     _clearPreparedQueue{0},
+    _clearProbedQueue{0},
+    _nextRequestId{1u},
     _scanningFile{nullptr},
-    _preparingFile{nullptr},
-    _uploadingFile{nullptr},
+    _preparingFiles{},
+    _prepareWorkerCount{clampPrepareWorkers(std::thread::hardware_concurrency())},
+    _runningPreparers{0},
+    _batchHashThreshold{DEFAULT_BATCH_HASH_THRESHOLD},
+    _uploadingFiles{},
+    _maxConcurrentUploads{1u},
+    _runningUploaders{0},
+    _maxConcurrentProbes{8u},
+    _probeMut{},
+    _probeDone{},
+    _probesInFlight{0u},
+    _instantUploads{0u},
+    _uploadingSha1s{},
+    _heldBack{},
+    _progressNotifier{std::make_shared<details::ProgressNotifier>()},
     _cts{},
     _mainTask{},
     _isStarted{false},
     _mut{},
-    _mutQueue{},
     _upProgressFct{[](FileTransferer&, TransferProgress){}},
     _sha1ProgressFct{[](FileTransferer&, TransferProgress){}},
     _onScannedFct{[](const ScannedFile&){}},
     _onPreparedFct{[](const PreparedFile&){}},
     _onUploadedFct{[](UploadedFile&&){}},
     _onErrorFct{[](UploadErrorData&&, std::string&&, Step){}},
+    _uploadedBatch{nullptr},
+    _dispatcher{nullptr},
     _isFinished{false},
     _app(&app),
     _rate{0},
-    _isPaused{false}
+    _isPaused{false},
+    _parallelChunks{1u},
+    _chunkSizing(details::ChunkSizing::fixed()),
+    _ioMode{utils::IoMode::cached},
+    _fileIo{nullptr},
+    _preparedCache{nullptr},
+    _journal{nullptr},
+    _folders{app},
+    _scannedFolders{},
+    _skeletonTasks{}
 {
+    _requests.setLimits(0u, 0u, &requestWeight);
+    _scanned.setLimits(0u, DEFAULT_QUEUE_BYTES, &scannedWeight);
+    _prepared.setLimits(0u, DEFAULT_QUEUE_BYTES, &preparedWeight);
+    _probed.setLimits(0u, DEFAULT_QUEUE_BYTES, &probedWeight);
 }
 
 Uploader::~Uploader()
@@ -136,6 +288,301 @@ Uploader::setOnErrorFct(OnErrorFct fct)
     _onErrorFct = fct;
 }
 
+void
+Uploader::setAsyncCallbacks(bool async)
+{
+    std::lock_guard<std::mutex> l(_mut);
+    if (!async)
+    {
+        _uploadedBatch = nullptr;
+        _dispatcher    = nullptr;
+    }
+    else if (_dispatcher == nullptr)
+    {
+        _dispatcher = giga::make_unique<details::CallbackDispatcher>();
+    }
+}
+
+void
+Uploader::setOnUploadedBatchFct(OnUploadedBatchFct fct, std::size_t maxBatch)
+{
+    setAsyncCallbacks(true);
+    std::lock_guard<std::mutex> l(_mut);
+    _uploadedBatch = giga::make_unique<details::CallbackBatch<UploadedFile>>(*_dispatcher, fct, maxBatch);
+}
+
+void
+Uploader::callScanned (const ScannedFile& file) const
+{
+    if (_dispatcher == nullptr)
+    {
+        _onScannedFct(file);
+        return;
+    }
+    auto fct = _onScannedFct;
+    _dispatcher->post([fct, file] { fct(file); });
+}
+
+void
+Uploader::callPrepared (const PreparedFile& file) const
+{
+    if (file.content != nullptr)
+    {
+        // the callbacks must not keep the pooled buffer
+        PreparedFile withoutContent{file};
+        withoutContent.content = nullptr;
+        callPrepared(withoutContent);
+        return;
+    }
+    if (_dispatcher == nullptr)
+    {
+        _onPreparedFct(file);
+        return;
+    }
+    auto fct = _onPreparedFct;
+    _dispatcher->post([fct, file] { fct(file); });
+}
+
+void
+Uploader::callUploaded (UploadedFile&& file) const
+{
+    file.prepared.content = nullptr;
+    if (_uploadedBatch != nullptr)
+    {
+        _uploadedBatch->push(std::move(file));
+        return;
+    }
+    if (_dispatcher == nullptr)
+    {
+        _onUploadedFct(std::move(file));
+        return;
+    }
+    auto fct = _onUploadedFct;
+    _dispatcher->post([fct, file]() mutable { fct(std::move(file)); });
+}
+
+void
+Uploader::callError (UploadErrorData&& data, std::string&& error, Step step) const
+{
+    const UploadRequestedFile* request = boost::get<UploadRequestedFile>(&data);
+    if (auto scanned = boost::get<ScannedFile>(&data))
+    {
+        request = &scanned->request;
+    }
+    if (auto prepared = boost::get<PreparedFile>(&data))
+    {
+        prepared->content = nullptr;
+        request = &prepared->scanned.request;
+    }
+    if (_journal != nullptr && !_cts.get_token().is_canceled())
+    {
+        // not pending anymore (the uploads canceled by kill() are resumed)
+        _journal->failed(request->parentId, request->path);
+    }
+    if (_dispatcher == nullptr)
+    {
+        _onErrorFct(std::move(data), std::move(error), step);
+        return;
+    }
+    auto fct = _onErrorFct;
+    _dispatcher->post([fct, data, error, step]() mutable { fct(std::move(data), std::move(error), step); });
+}
+
+void
+Uploader::callUploadProgress (const std::shared_ptr<FileUploader>& uploader, TransferProgress progress) const
+{
+    if (_dispatcher == nullptr)
+    {
+        _upProgressFct(*uploader, progress);
+        return;
+    }
+    // the uploader is kept alive until the callback
+    auto fct = _upProgressFct;
+    _dispatcher->post([fct, uploader, progress] { fct(*uploader, progress); });
+}
+
+void
+Uploader::callPreparationProgress (const std::shared_ptr<Sha1Calculator>& calculator, TransferProgress progress) const
+{
+    if (_dispatcher == nullptr)
+    {
+        _sha1ProgressFct(*calculator, progress);
+        return;
+    }
+    auto fct = _sha1ProgressFct;
+    _dispatcher->post([fct, calculator, progress] { fct(*calculator, progress); });
+}
+
+void
+Uploader::setPreparationWorkerCount(unsigned count)
+{
+    std::lock_guard<std::mutex> l(_mut);
+    _prepareWorkerCount = clampPrepareWorkers(count);
+}
+
+void
+Uploader::setBatchHashThreshold(uint64_t maxSize)
+{
+    std::lock_guard<std::mutex> l(_mut);
+    _batchHashThreshold = maxSize;
+}
+
+void
+Uploader::setSmallFileMemoryCap(uint64_t bytes)
+{
+    details::FileBufferPool::instance().setCapacity(static_cast<std::size_t>(
+        std::min<uint64_t>(bytes, std::numeric_limits<std::size_t>::max())));
+}
+
+void
+Uploader::setMaxConcurrentUploads(unsigned count)
+{
+    std::lock_guard<std::mutex> l(_mut);
+    _maxConcurrentUploads = clampUploadWorkers(count);
+}
+
+void
+Uploader::setProgressInterval(std::chrono::milliseconds interval)
+{
+    _progressNotifier->setMinInterval(interval);
+}
+
+void
+Uploader::setMaxConcurrentProbes(unsigned count)
+{
+    std::lock_guard<std::mutex> l(_mut);
+    _maxConcurrentProbes = clampProbes(count);
+}
+
+void
+Uploader::setParallelChunks(unsigned count)
+{
+    std::lock_guard<std::mutex> l(_mut);
+    _parallelChunks = std::max(1u, count);
+}
+
+void
+Uploader::setChunkSizing(const details::ChunkSizing& sizing)
+{
+    std::lock_guard<std::mutex> l(_mut);
+    _chunkSizing = sizing;
+}
+
+void
+Uploader::setIoMode(utils::IoMode mode)
+{
+    std::lock_guard<std::mutex> l(_mut);
+    _ioMode = mode;
+}
+
+void
+Uploader::setFileIo(std::shared_ptr<utils::FileIo> io)
+{
+    std::lock_guard<std::mutex> l(_mut);
+    _fileIo = std::move(io);
+}
+
+void
+Uploader::setPreparedFileCache(const boost::filesystem::path& cacheFile)
+{
+    _preparedCache.reset(new details::PreparedFileCache{cacheFile});
+}
+
+void
+Uploader::setJournal(const boost::filesystem::path& journalPath)
+{
+    _journal.reset(new details::UploadJournal{journalPath, details::UploadJournal::OpenMode::truncate});
+}
+
+void
+Uploader::resume(const boost::filesystem::path& journalPath)
+{
+    _journal.reset(new details::UploadJournal{journalPath, details::UploadJournal::OpenMode::resume});
+
+    for (const auto& file : _journal->pendingFiles())
+    {
+        try
+        {
+            // a file modified, or replaced, since it was hashed gets prepared again
+            auto identity = details::PreparedFileCache::key(file.path);
+            if (file.isPrepared && identity && *identity == file.identity)
+            {
+                addPreparedFile(ScannedFile{UploadRequestedFile{file.parentId, file.path}, file.nodePath, file.size}, file.sha1);
+            }
+            else
+            {
+                addScannedFile(UploadRequestedFile{file.parentId, file.path}, file.nodePath);
+            }
+        }
+        catch (...)
+        {
+            auto info = utils::exceptionInfos();
+            std::lock_guard<std::mutex> l(_mut);
+            callError(UploadRequestedFile{file.parentId, file.path}, std::move(info), Step::scanning);
+        }
+    }
+
+    // The interrupted requests are scanned again: the journaled files are skipped.
+    std::map<std::string, std::vector<boost::filesystem::path>> requests;
+    for (const auto& request : _journal->pendingRequests())
+    {
+        requests[request.parentId].push_back(request.path);
+    }
+    for (auto& request : requests)
+    {
+        try
+        {
+            auto node = _app->getNodeById(request.first);
+            if (node->type() == Node::Type::file)
+            {
+                BOOST_THROW_EXCEPTION(ErrorException{U("dest should be FolderNode")});
+            }
+            addUploads(*static_cast<FolderNode*>(node.get()), std::move(request.second));
+        }
+        catch (...)
+        {
+            auto info = utils::exceptionInfos();
+            std::lock_guard<std::mutex> l(_mut);
+            for (const auto& path : request.second)
+            {
+                callError(UploadRequestedFile{request.first, path}, std::string{info}, Step::scanning);
+            }
+        }
+    }
+}
+
+void
+Uploader::setQueueLimits(Step step, QueueLimits limits)
+{
+    switch (step)
+    {
+        case Step::preparing:
+            _scanned.setLimits(limits.maxItems, limits.maxBytes, &scannedWeight);
+            break;
+        case Step::uploading:
+            _prepared.setLimits(limits.maxItems, limits.maxBytes, &preparedWeight);
+            _probed.setLimits(limits.maxItems, limits.maxBytes, &probedWeight);
+            break;
+        case Step::scanning:
+            BOOST_THROW_EXCEPTION(ErrorException{U("The upload requests cannot be limited")});
+    }
+}
+
+Uploader::QueueDepth
+Uploader::queueDepth(Step step) const
+{
+    switch (step)
+    {
+        case Step::scanning:
+            return QueueDepth{_requests.size_approx(), _requests.size_bytes()};
+        case Step::preparing:
+            return QueueDepth{_scanned.size_approx(), _scanned.size_bytes()};
+        case Step::uploading:
+            return QueueDepth{_prepared.size_approx() + _probed.size_approx(), _prepared.size_bytes() + _probed.size_bytes()};
+    }
+    BOOST_THROW_EXCEPTION(ErrorException{U("unreachable")});
+}
+
 void
 Uploader::addUpload (FolderNode parent, boost::filesystem::path&& path)
 {
@@ -147,7 +594,26 @@ Uploader::addUpload (FolderNode parent, boost::filesystem::path&& path)
 void
 Uploader::addUploads(FolderNode parent, std::vector<boost::filesystem::path>&& pathes)
 {
-    _requests.enqueue(giga::make_unique<UploadRequest>(std::move(parent), std::move(pathes)));
+    addUploads(std::move(parent), std::move(pathes), 0);
+}
+
+void
+Uploader::addUploads(FolderNode parent, std::vector<boost::filesystem::path>&& pathes, int priority)
+{
+    if (_journal != nullptr)
+    {
+        for (const auto& path : pathes)
+        {
+            _journal->requested(parent.id(), path);
+        }
+    }
+    _requests.enqueue(giga::make_unique<UploadRequest>(std::move(parent), std::move(pathes), _nextRequestId++, priority));
+}
+
+void
+Uploader::setSchedulingPolicy(details::SchedulingPolicy policy)
+{
+    _probed.setPolicy(policy);
 }
 
 void
@@ -157,6 +623,7 @@ Uploader::start()
     {
         _cts = pplx::cancellation_token_source{};
     }
+    _progressNotifier->reset();
     auto scanTask = pplx::create_task([this]() {
         std::unique_ptr<UploadRequest> element = nullptr;
         for(_requests.wait_dequeue(element); element != nullptr || _clearRequestQueue > 0; _requests.wait_dequeue(element))
@@ -166,7 +633,7 @@ Uploader::start()
                 if (element == nullptr)
                 {
                     _clearRequestQueue -= 1;
-                    enqueue<ScannedFile>(_scanned, nullptr);
+                    _scanned.enqueue(nullptr);
                 }
                 continue;
             }
@@ -178,7 +645,7 @@ Uploader::start()
             {
                 try
                 {
-                    scanFiles(_scanningFile->dest, {}, path);
+                    scanFiles(*_scanningFile, path);
                 }
                 catch (...)
                 {
@@ -186,79 +653,221 @@ Uploader::start()
                     GIGA_DEBUG_LOG(debug, info);
 
                     std::lock_guard<std::mutex> l(_mut);
-                    _onErrorFct(UploadRequestedFile{_scanningFile->dest.id(), path}, std::move(info), Step::scanning);
+                    callError(UploadRequestedFile{_scanningFile->dest.id(), path}, std::move(info), Step::scanning);
+                }
+
+                if (_journal != nullptr && !_cts.get_token().is_canceled() && _clearRequestQueue == 0)
+                {
+                    _journal->requestScanned(_scanningFile->dest.id(), path);
                 }
 
                 // notify that the scan of path is complete
                 ScannedFile sf{UploadRequestedFile{_scanningFile->dest.id(), path}, {}, 0ul};
                 std::lock_guard<std::mutex> l{_mut};
-                _onScannedFct(sf);
+                callScanned(sf);
+            }
+
+            // Create the folders of the request ahead of the uploads
+            std::vector<boost::filesystem::path> folders;
+            {
+                std::lock_guard<std::mutex> l{_mut};
+                folders.assign(_scannedFolders.begin(), _scannedFolders.end());
+                _scannedFolders.clear();
+            }
+            if (!folders.empty())
+            {
+                auto rootId = _scanningFile->dest.id();
+                _skeletonTasks.push_back(pplx::create_task([this, rootId, folders]() {
+                    _folders.resolveAll(rootId, folders, MAX_SKELETON_WORKERS);
+                }));
             }
         }
-        enqueue<ScannedFile>(_scanned, nullptr);
-    });
+        _scanned.enqueue(nullptr);
 
-    auto prepareTask = pplx::create_task([this]() {
-        std::unique_ptr<ScannedFile> element = nullptr;
-        for(_scanned.wait_dequeue(element); element != nullptr || _clearScannedQueue > 0; _scanned.wait_dequeue(element))
+        if (!_skeletonTasks.empty())
         {
-            if (_clearScannedQueue > 0)
+            pplx::when_all(_skeletonTasks.begin(), _skeletonTasks.end()).wait();
+            _skeletonTasks.clear();
+        }
+    });
+
+    std::vector<pplx::task<void>> tasks{scanTask};
+
+    uint64_t batchThreshold = 0u;
+    {
+        std::lock_guard<std::mutex> l(_mut);
+        _preparingFiles.clear();
+        _preparingFiles.resize(_prepareWorkerCount);
+        _runningPreparers = _prepareWorkerCount;
+        batchThreshold = _batchHashThreshold;
+    }
+    const auto batchSize = utils::MultiSha1::lanes(utils::MultiSha1::best());
+    for (std::size_t slot = 0; slot < _preparingFiles.size(); ++slot)
+    {
+        tasks.push_back(pplx::create_task([this, slot, batchThreshold, batchSize]() {
+            std::unique_ptr<ScannedFile> element = nullptr;
+            std::vector<std::unique_ptr<ScannedFile>> batch;
+            while (true)
             {
+                // a partial batch is hashed as soon as no file is waiting
+                if (batch.empty() || !_scanned.try_dequeue(element))
+                {
+                    prepareBatch(batch, slot);
+                    _scanned.wait_dequeue(element);
+                }
                 if (element == nullptr)
                 {
-                    _clearScannedQueue -= 1;
-                    enqueue<PreparedFile>(_prepared, nullptr);
+                    prepareBatch(batch, slot);
+                    if (takeClearMarker(_clearScannedQueue))
+                    {
+                        _prepared.enqueue(nullptr);
+                        continue;
+                    }
+                    break;
                 }
-                continue;
+                if (_clearScannedQueue > 0)
+                {
+                    continue;
+                }
+
+                if (element->size <= batchThreshold)
+                {
+                    batch.push_back(std::move(element));
+                    if (batch.size() >= batchSize)
+                    {
+                        prepareBatch(batch, slot);
+                    }
+                    continue;
+                }
+                prepare(*element, slot);
             }
 
-            prepare(*element);
-        }
-        enqueue<PreparedFile>(_prepared, nullptr);
-    });
+            // The end marker is handed over to the other workers,
+            // the last one to stop forwards it to the upload queue.
+            if (--_runningPreparers == 0)
+            {
+                _prepared.enqueue(nullptr);
+            }
+            else
+            {
+                _scanned.enqueue(nullptr);
+            }
+        }));
+    }
 
-    auto uploadTask = pplx::create_task([this]() {
+    // The prepared files already on GiGa.GG never reach the upload workers
+    unsigned maxProbes = 0u;
+    {
+        std::lock_guard<std::mutex> l(_mut);
+        maxProbes = _maxConcurrentProbes;
+        _instantUploads = 0u;
+    }
+    tasks.push_back(pplx::create_task([this, maxProbes]() {
         std::unique_ptr<PreparedFile> element = nullptr;
-        for(_prepared.wait_dequeue(element); element != nullptr || _clearPreparedQueue > 0; _prepared.wait_dequeue(element))
+        while (true)
         {
-            if (_clearPreparedQueue > 0)
+            _prepared.wait_dequeue(element);
+            if (element == nullptr)
             {
-                if (element == nullptr)
+                // the running probes go before the marker
+                waitProbes(0u);
+                _probed.enqueue_barrier(nullptr);
+                if (takeClearMarker(_clearPreparedQueue))
                 {
-                    _clearPreparedQueue -= 1;
+                    continue;
                 }
+                break;
+            }
+            if (_clearPreparedQueue > 0)
+            {
                 continue;
             }
 
-            uploadFile(*element);
+            waitProbes(maxProbes - 1u);
+            _probed.wait_not_full();
+            probe(std::move(element));
         }
-        _isFinished = true;
-    });
+        GIGA_DEBUG_LOG(debug, _instantUploads.load() << " files were already on GiGa.GG");
+    }));
 
-    auto progressTask = pplx::create_task([this]() {
+    {
+        std::lock_guard<std::mutex> l(_mut);
+        _uploadingFiles.clear();
+        _uploadingFiles.resize(_maxConcurrentUploads);
+        _runningUploaders = _maxConcurrentUploads;
+    }
+    for (std::size_t slot = 0; slot < _uploadingFiles.size(); ++slot)
+    {
+        tasks.push_back(pplx::create_task([this, slot]() {
+            std::unique_ptr<ProbedFile> element = nullptr;
+            while (true)
+            {
+                _probed.wait_dequeue(element);
+                if (element == nullptr)
+                {
+                    if (takeClearMarker(_clearProbedQueue))
+                    {
+                        continue;
+                    }
+                    break;
+                }
+                if (_clearProbedQueue > 0 || holdBack(element))
+                {
+                    continue;
+                }
 
-        FileTransferer::Progress upProgress{0, 0};
+                auto sha1 = element->prepared.sha1;
+                uploadFile(element->prepared, slot, element->uploadUrl);
+                uploadHeldBack(sha1, slot);
+            }
 
-        Sha1Calculator* sha1Saved = nullptr;
-        FileTransferer::Progress sha1Progress{0, 0};
+            if (--_runningUploaders == 0)
+            {
+                _isFinished = true;
+                _progressNotifier->stop();
+            }
+            else
+            {
+                _probed.enqueue_barrier(nullptr);
+            }
+        }));
+    }
 
-        while(!_isFinished)
+    auto progressTask = pplx::create_task([this]() {
+
+        std::vector<Sha1Calculator*>           sha1Saved(_preparingFiles.size(), nullptr);
+        std::vector<FileTransferer::Progress> sha1Progress(_preparingFiles.size(), FileTransferer::Progress{0, 0});
+        std::vector<FileUploader*>             upSaved(_uploadingFiles.size(), nullptr);
+        std::vector<FileTransferer::Progress> upProgress(_uploadingFiles.size(), FileTransferer::Progress{0, 0});
+
+        // Woken by the transfers, when their progress changes
+        while(_progressNotifier->wait())
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(500));
             {
                 try
                 {
                     std::lock_guard<std::mutex> l(_mut);
-                    if (_uploadingFile != nullptr) // && (upSaved != _uploadingFile.get() || upProgress != _uploadingFile->progress() || upSaved->state() != _uploadingFile->state()))
+                    auto uploading = uploadingBytes();
+                    for (std::size_t i = 0; i < _uploadingFiles.size(); ++i)
                     {
-                        upProgress = _uploadingFile->progress();
-                        _upProgressFct(*_uploadingFile, _upProgress.getProgressAddByte(upProgress.transfered));
+                        const auto& uploader = _uploadingFiles[i];
+                        if (uploader != nullptr && (upSaved[i] != uploader.get() || upProgress[i] != uploader->progress()))
+                        {
+                            upProgress[i] = uploader->progress();
+                            upSaved[i]    = uploader.get();
+                            callUploadProgress(uploader, _upProgress.getProgressAddByte(uploading));
+                        }
                     }
-                    if (_preparingFile != nullptr && (sha1Saved != _preparingFile.get() || sha1Progress != _preparingFile->progress() || sha1Saved->state() != _preparingFile->state()))
+                    auto preparing = preparingBytes();
+                    for (std::size_t i = 0; i < _preparingFiles.size(); ++i)
                     {
-                        sha1Progress = _preparingFile->progress();
-                        sha1Saved    = _preparingFile.get();
-                        _sha1ProgressFct(*_preparingFile, _sha1Progress.getProgressAddByte(sha1Progress.transfered));
+                        const auto& calculator = _preparingFiles[i];
+                        if (calculator != nullptr && (sha1Saved[i] != calculator.get() || sha1Progress[i] != calculator->progress() || sha1Saved[i]->state() != calculator->state()))
+                        {
+                            sha1Progress[i] = calculator->progress();
+                            sha1Saved[i]    = calculator.get();
+                            callPreparationProgress(calculator, _sha1Progress.getProgressAddByte(preparing));
+                        }
                     }
                 }
                 catch (...)
@@ -269,7 +878,7 @@ Uploader::start()
         }
     });
 
-    auto tasks = {scanTask, prepareTask, uploadTask, progressTask};
+    tasks.push_back(progressTask);
     _mainTask =  pplx::when_all(tasks.begin(), tasks.end());
     _isStarted = true;
 }
@@ -282,6 +891,10 @@ Uploader::join()
         _requests.enqueue(nullptr);
         _mainTask.wait();
         _isStarted = false;
+        if (_dispatcher != nullptr)
+        {
+            _dispatcher->flush();
+        }
     }
 }
 
@@ -291,6 +904,7 @@ Uploader::kill()
     if (_isStarted)
     {
         // Clear everything
+        _clearProbedQueue   += 1;
         _clearPreparedQueue += 1;
         _clearScannedQueue  += 1;
         _clearRequestQueue  += 1;
@@ -298,13 +912,18 @@ Uploader::kill()
 
         // do the cancel
         _cts.cancel();
-        if (_preparingFile != nullptr)
         {
-            _preparingFile->cancel();
-        }
-        if (_uploadingFile != nullptr)
-        {
-            _uploadingFile->cancel();
+            std::lock_guard<std::mutex> l(_mut);
+            cancelPreparingFiles();
+            _heldBack.clear();
+            for (const auto& uploader : _uploadingFiles)
+            {
+                auto ustate = uploader != nullptr ? uploader->state() : FileTransferer::State::canceled;
+                if (ustate == FileTransferer::State::started || ustate == FileTransferer::State::paused)
+                {
+                    uploader->cancel();
+                }
+            }
         }
 
         // wait for it
@@ -317,32 +936,37 @@ Uploader::limitRate(uint64_t rate)
 {
     std::lock_guard<std::mutex> l(_mut);
     _rate = rate;
-    if (_uploadingFile != nullptr)
-    {
-        _uploadingFile->limitRate(rate);
-    }
+    splitTransferRate();
 }
 
 void
 Uploader::pause()
 {
     std::lock_guard<std::mutex> l(_mut);
-    if (_uploadingFile != nullptr)
+    for (const auto& uploader : _uploadingFiles)
     {
-        _uploadingFile->pause();
+        if (uploader != nullptr && uploader->state() == FileTransferer::State::started)
+        {
+            uploader->pause();
+        }
     }
     _isPaused = true;
+    splitTransferRate();
 }
 
 void
 Uploader::resume()
 {
     std::lock_guard<std::mutex> l(_mut);
-    if (_uploadingFile != nullptr)
+    for (const auto& uploader : _uploadingFiles)
     {
-        _uploadingFile->resume();
+        if (uploader != nullptr && uploader->state() == FileTransferer::State::paused)
+        {
+            uploader->resume();
+        }
     }
     _isPaused = false;
+    splitTransferRate();
 }
 
 void
@@ -350,41 +974,72 @@ Uploader::clear()
 {
     if (_isStarted)
     {
+        _clearProbedQueue   += 1;
         _clearPreparedQueue += 1;
         _clearScannedQueue  += 1;
         _clearRequestQueue  += 1;
+        if (_journal != nullptr)
+        {
+            _journal->clear();
+        }
 
         {
             std::lock_guard<std::mutex> l(_mut);
-            if (_preparingFile != nullptr)
-            {
-                _preparingFile->cancel();
-            }
+            cancelPreparingFiles();
+            _heldBack.clear();
             _requests.enqueue(nullptr);
 
-            auto ustate = _uploadingFile != nullptr ? _uploadingFile->state() : FileTransferer::State::canceled;
-            auto isUploading = ustate == FileTransferer::State::started || ustate == FileTransferer::State::paused;
+            uint64_t uploadingTransfered = 0ul;
+            uint64_t uploadingSize       = 0ul;
+            uint64_t uploadingCount      = 0ul;
+            for (const auto& uploader : _uploadingFiles)
+            {
+                auto ustate = uploader != nullptr ? uploader->state() : FileTransferer::State::canceled;
+                if (ustate == FileTransferer::State::started || ustate == FileTransferer::State::paused)
+                {
+                    uploadingTransfered += uploader->progress().transfered;
+                    uploadingSize       += uploader->progress().size;
+                    uploadingCount      += 1;
+                }
+            }
 
-            auto pstate = _preparingFile != nullptr ? _preparingFile->state() : FileTransferer::State::canceled;
-            auto isPreparing = pstate == FileTransferer::State::started || pstate == FileTransferer::State::paused;
+            uint64_t preparingTransfered = 0ul;
+            uint64_t preparingSize       = 0ul;
+            uint64_t preparingCount      = 0ul;
+            for (const auto& calculator : _preparingFiles)
+            {
+                auto pstate = calculator != nullptr ? calculator->state() : FileTransferer::State::canceled;
+                if (pstate == FileTransferer::State::started || pstate == FileTransferer::State::paused)
+                {
+                    preparingTransfered += calculator->progress().transfered;
+                    preparingSize       += calculator->progress().size;
+                    preparingCount      += 1;
+                }
+            }
 
-            _upProgress.bytesTransfered = isUploading ? _uploadingFile->progress().transfered : 0ul;
-            _upProgress.bytesTotal      = isUploading ? _uploadingFile->progress().size : 0ul;
+            _upProgress.bytesTransfered = uploadingTransfered;
+            _upProgress.bytesTotal      = uploadingSize;
             _upProgress.fileDone        = 0ul;
-            _upProgress.fileCount       = isUploading ? 1ul: 0ul;
+            _upProgress.fileCount       = uploadingCount;
 
-            _sha1Progress.bytesTransfered = isPreparing ? _preparingFile->progress().transfered : 0ul;
-            _sha1Progress.bytesTotal      = isPreparing ? _preparingFile->progress().size : 0ul;
+            _sha1Progress.bytesTransfered = preparingTransfered;
+            _sha1Progress.bytesTotal      = preparingSize;
             _sha1Progress.fileDone        = 0ul;
-            _sha1Progress.fileCount       = isPreparing ? 1ul: 0ul;
+            _sha1Progress.fileCount       = preparingCount;
 
-            if (_preparingFile != nullptr)
+            for (const auto& calculator : _preparingFiles)
             {
-                _sha1ProgressFct(*_preparingFile, _sha1Progress);
+                if (calculator != nullptr)
+                {
+                    callPreparationProgress(calculator, _sha1Progress);
+                }
             }
-            if (_uploadingFile != nullptr)
+            for (const auto& uploader : _uploadingFiles)
             {
-                _upProgressFct(*_uploadingFile, _upProgress);
+                if (uploader != nullptr)
+                {
+                    callUploadProgress(uploader, _upProgress);
+                }
             }
         }
     }
@@ -394,7 +1049,21 @@ FileTransferer::State
 Uploader::state()
 {
     std::lock_guard<std::mutex> l(_mut);
-    return _uploadingFile->state();
+    auto any = [this](FileTransferer::State state) {
+        return std::any_of(_uploadingFiles.begin(), _uploadingFiles.end(), [state](const std::shared_ptr<FileUploader>& uploader) {
+            return uploader != nullptr && uploader->state() == state;
+        });
+    };
+    // the state of the busiest slot: started if any is started, paused if all those not done are paused...
+    for (auto state : {FileTransferer::State::started, FileTransferer::State::pending, FileTransferer::State::paused,
+                       FileTransferer::State::error, FileTransferer::State::canceled})
+    {
+        if (any(state))
+        {
+            return state;
+        }
+    }
+    return FileTransferer::State::pending;
 }
 
 bool
@@ -406,20 +1075,51 @@ Uploader::isStarted() const
 FileUploader*
 Uploader::uploadingFile()
 {
-    return _uploadingFile.get();
+    std::lock_guard<std::mutex> l(_mut);
+    for (const auto& uploader : _uploadingFiles)
+    {
+        if (uploader != nullptr)
+        {
+            return uploader.get();
+        }
+    }
+    return nullptr;
+}
+
+std::vector<FileUploader*>
+Uploader::uploadingFiles()
+{
+    std::lock_guard<std::mutex> l(_mut);
+    std::vector<FileUploader*> uploaders;
+    for (const auto& uploader : _uploadingFiles)
+    {
+        if (uploader != nullptr)
+        {
+            uploaders.push_back(uploader.get());
+        }
+    }
+    return uploaders;
 }
 
 void
 Uploader::callProgressFct () const
 {
     std::lock_guard<std::mutex> l{_mut};
-    if (_uploadingFile != nullptr)
+    auto uploading = uploadingBytes();
+    for (const auto& uploader : _uploadingFiles)
     {
-        _upProgressFct(*_uploadingFile, _upProgress.getProgressAddByte(_uploadingFile->progress().transfered));
+        if (uploader != nullptr)
+        {
+            callUploadProgress(uploader, _upProgress.getProgressAddByte(uploading));
+        }
     }
-    if (_preparingFile != nullptr)
+    auto preparing = preparingBytes();
+    for (const auto& calculator : _preparingFiles)
     {
-        _sha1ProgressFct(*_preparingFile, _sha1Progress.getProgressAddByte(_preparingFile->progress().transfered));
+        if (calculator != nullptr)
+        {
+            callPreparationProgress(calculator, _sha1Progress.getProgressAddByte(preparing));
+        }
     }
 }
 
@@ -434,7 +1134,7 @@ Uploader::addScannedFile (UploadRequestedFile request, boost::filesystem::path n
     }
     auto scanned = giga::make_unique<ScannedFile>(std::move(request), std::move(nodePath), size);
     const auto& s = *scanned;
-    enqueue<ScannedFile>(_scanned, std::move(scanned));
+    _scanned.enqueue(std::move(scanned));
     return s;
 }
 
@@ -457,13 +1157,14 @@ Uploader::addPreparedFile (ScannedFile scanned, const std::string& sha1)
         _upProgress.bytesTotal   += scanned.size;
     }
     const auto& p = *prepared;
-    enqueue<PreparedFile>(_prepared, std::move(prepared));
+    _prepared.enqueue(std::move(prepared));
     return p;
 }
 
 void
-Uploader::scanFiles(const FolderNode& dest, boost::filesystem::path relativeNodePath, const boost::filesystem::path& realPath)
+Uploader::scanFiles(const UploadRequest& request, const boost::filesystem::path& realPath)
 {
+    const auto& dest = request.dest;
     if (dest.type() == Node::Type::file)
     {
         BOOST_THROW_EXCEPTION(ErrorException{U("dest should be FolderNode")});
@@ -473,56 +1174,45 @@ Uploader::scanFiles(const FolderNode& dest, boost::filesystem::path relativeNode
         return;
     }
 
-    auto isDirectory = is_directory(realPath);
-    auto name        = utils::replaceInvalidUtf8(realPath.filename().native());
-    boost::algorithm::trim(name);
-    if (!exists (realPath) || (!isDirectory && !is_regular_file(realPath)))
-    {
-        BOOST_THROW_EXCEPTION(ErrorException{U("dest should be a regular file")});
-    }
-    if (name == U("") || name[0] == U('.'))
-    {
-        return;
-    }
-
-    if (!isDirectory)
-    {
-        uint64_t size  = boost::filesystem::file_size(realPath);
-        if (size == 0ul)
+    auto nodeName = [](const boost::filesystem::path& p) {
+        auto name = utils::replaceInvalidUtf8(p.filename().native());
+        boost::algorithm::trim(name);
+        return name == U("") || name[0] == U('.') ? utility::string_t{} : name;
+    };
+    auto isCanceled = [this]() {
+        return _cts.get_token().is_canceled() || _clearRequestQueue > 0;
+    };
+    auto onFile = [this, &dest, &request](details::DirectoryScanner::File&& file) {
+        if (file.size == 0ul)
         {
             return;
         }
-        auto scannedFile = giga::make_unique<ScannedFile>(UploadRequestedFile{dest.id(), realPath}, relativeNodePath / name, size);
+        if (_journal != nullptr && !_journal->scanned(dest.id(), file.path, file.nodePath, file.size))
         {
-            std::lock_guard<std::mutex> l{_mut};
-            _sha1Progress.fileCount  += 1;
-            _sha1Progress.bytesTotal += size;
-            _onScannedFct(*scannedFile);
+            return; // already queued by resume()
         }
-        enqueue(_scanned, std::move(scannedFile));
-        return;
-    }
-    else
-    {
-        using namespace boost::filesystem;
-        auto rng = boost::make_iterator_range(directory_iterator(realPath), directory_iterator());
-        std::vector<directory_entry> entries;
-        std::copy(directory_iterator(realPath), directory_iterator(), std::back_inserter(entries));
-        std::sort(entries.begin(), entries.end());
-
-        for (auto& entry : entries)
+        auto scannedFile = giga::make_unique<ScannedFile>(UploadRequestedFile{dest.id(), std::move(file.path)}, std::move(file.nodePath), file.size);
+        scannedFile->request.requestId = request.id;
+        scannedFile->request.priority  = request.priority;
         {
-            if (_cts.get_token().is_canceled())
+            std::lock_guard<std::mutex> l{_mut};
+            if (scannedFile->nodePath.has_parent_path())
             {
-                return;
+                _scannedFolders.insert(scannedFile->nodePath.parent_path());
             }
-            scanFiles(dest, relativeNodePath / name, entry.path());
+            _sha1Progress.fileCount  += 1;
+            _sha1Progress.bytesTotal += scannedFile->size;
+            callScanned(*scannedFile);
         }
-    }
+        _scanned.wait_enqueue(std::move(scannedFile)); // blocks while the preparation is behind
+    };
+
+    details::DirectoryScanner scanner{MAX_SCAN_WORKERS, nodeName, onFile, isCanceled};
+    scanner.scan(realPath);
 }
 
 void
-Uploader::prepare (const ScannedFile& scanned)
+Uploader::prepare (const ScannedFile& scanned, std::size_t slot)
 {
     const auto& path = scanned.request.path;
 
@@ -541,8 +1231,23 @@ Uploader::prepare (const ScannedFile& scanned)
         auto nodeName = path.filename().native();
         auto decodedNodeKey = Crypto::base64decode(_app->currentUser().personalData().nodeKeyClear());
 
-        // WARNING: uploader gets moved into _preparingFile
+        // taken before the hash: a file modified meanwhile is not cached, and prepared again on resume
+        auto identity = _preparedCache != nullptr || _journal != nullptr ? details::PreparedFileCache::key(path) : boost::none;
+        auto cached   = identity && _preparedCache != nullptr ? _preparedCache->find(*identity) : boost::none;
+        if (cached)
+        {
+            enqueuePrepared(scanned, identity, cached->sha1, cached->fid, cached->fkey);
+            return;
+        }
+
+        // WARNING: calculator gets moved into _preparingFiles[slot]
         auto calculator = std::unique_ptr<Sha1Calculator>{new Sha1Calculator(path)};
+        calculator->setProgressNotifier(_progressNotifier);
+        {
+            std::lock_guard<std::mutex> l{_mut};
+            calculator->setIoMode(_ioMode);
+            calculator->setFileIo(_fileIo);
+        }
         calculator->start();
 
         auto task = calculator->task().then([=](std::string sha1) {
@@ -562,37 +1267,286 @@ Uploader::prepare (const ScannedFile& scanned)
             std::lock_guard<std::mutex> l{_mut};
             _upProgress.fileCount    += 1;
             _upProgress.bytesTotal   += scanned.size;
-            _preparingFile = std::move(calculator);
-            _sha1ProgressFct(*_preparingFile, _sha1Progress);
+            _preparingFiles[slot] = std::move(calculator);
+            callPreparationProgress(_preparingFiles[slot], _sha1Progress.getProgressAddByte(preparingBytes()));
         }
         std::shared_ptr<PreparedFile> prepared = task.get();
-        _onPreparedFct(*prepared);
-        enqueue(_prepared, giga::make_unique<PreparedFile>(std::move(*prepared)));
+        if (identity && _preparedCache != nullptr)
+        {
+            _preparedCache->insert(*identity, details::PreparedFileCache::Entry{prepared->sha1, prepared->fid, prepared->fkey});
+        }
+        if (identity && _journal != nullptr)
+        {
+            _journal->prepared(scanned.request.parentId, path, *identity, prepared->sha1, prepared->fid, prepared->fkey);
+        }
+        {
+            std::lock_guard<std::mutex> l{_mut};
+            callPrepared(*prepared);
+        }
+        _prepared.wait_enqueue(giga::make_unique<PreparedFile>(std::move(*prepared)));
+
+        std::shared_ptr<Sha1Calculator> done = nullptr;
         {
             std::lock_guard<std::mutex> l{_mut};
-            _sha1Progress.bytesTransfered += _preparingFile->progress().transfered;
+            done = std::move(_preparingFiles[slot]);
+            _sha1Progress.bytesTransfered += done->progress().transfered;
             _sha1Progress.fileDone += 1;
         }
     }
     catch (...)
     {
         auto info =  utils::exceptionInfos();
-        if (_uploadingFile != nullptr && _uploadingFile->state() == FileTransferer::State::canceled)
+        std::shared_ptr<Sha1Calculator> failed = nullptr;
+
+        std::lock_guard<std::mutex> l{_mut};
+        failed = std::move(_preparingFiles[slot]);
+        if (failed != nullptr && failed->state() == FileTransferer::State::canceled)
         {
             info = "canceled";
         }
         GIGA_DEBUG_LOG(debug, info);
 
-        std::lock_guard<std::mutex> l{_mut};
-        _onErrorFct(std::move(scanned), std::move(info), Step::preparing);
-        if (_preparingFile != nullptr)
+        callError(std::move(scanned), std::move(info), Step::preparing);
+        if (failed != nullptr)
         {
-            _sha1Progress.bytesTransfered += _preparingFile->progress().size;
+            _sha1Progress.bytesTransfered += failed->progress().size;
             _sha1Progress.fileDone += 1;
         }
     }
 }
 
+void
+Uploader::prepareBatch (std::vector<std::unique_ptr<ScannedFile>>& batch, std::size_t slot)
+{
+    if (batch.empty())
+    {
+        return;
+    }
+    if (_cts.get_token().is_canceled() || _clearScannedQueue > 0)
+    {
+        batch.clear();
+        return;
+    }
+
+    auto onError = [this](const ScannedFile& scanned) {
+        auto info = utils::exceptionInfos();
+        GIGA_DEBUG_LOG(debug, info);
+
+        std::lock_guard<std::mutex> l{_mut};
+        callError(ScannedFile{scanned}, std::move(info), Step::preparing);
+        _sha1Progress.bytesTransfered += scanned.size;
+        _sha1Progress.fileDone += 1;
+    };
+
+    utils::IoMode                  ioMode;
+    std::shared_ptr<utils::FileIo> fileIo;
+    {
+        std::lock_guard<std::mutex> l{_mut};
+        ioMode = _ioMode;
+        fileIo = _fileIo;
+    }
+
+    // The files are small: they are read whole, then hashed together.
+    // The pooled buffers are kept for the upload: the file is not read again.
+    auto& pool = details::FileBufferPool::instance();
+    std::vector<const ScannedFile*>                                files;
+    std::vector<std::shared_ptr<std::vector<unsigned char>>>      contents;
+    std::vector<bool>                                              pooled;
+    std::vector<boost::optional<details::PreparedFileCache::Key>> identities;
+    for (const auto& scanned : batch)
+    {
+        const auto& path = scanned->request.path;
+        try
+        {
+            if (!boost::filesystem::exists(path) || !boost::filesystem::is_regular_file(path))
+            {
+                BOOST_THROW_EXCEPTION(ErrorException{U("Not a file")});
+            }
+            auto identity = _preparedCache != nullptr || _journal != nullptr ? details::PreparedFileCache::key(path) : boost::none;
+            auto cached   = identity && _preparedCache != nullptr ? _preparedCache->find(*identity) : boost::none;
+            if (cached)
+            {
+                enqueuePrepared(*scanned, identity, cached->sha1, cached->fid, cached->fkey);
+                continue;
+            }
+
+            auto bufferSize = static_cast<std::size_t>(scanned->size) + 1u;
+            auto content    = pool.acquire(bufferSize);
+            auto isPooled   = content != nullptr;
+            if (!isPooled)
+            {
+                content = std::make_shared<std::vector<unsigned char>>(bufferSize);
+            }
+            utils::SequentialFile file{path, 0u, ioMode};
+#ifndef _WIN32
+            content->resize(fileIo != nullptr && ioMode != utils::IoMode::direct
+                ? fileIo->readAll(file.descriptor(), 0u, content->data(), content->size())
+                : file.read(content->data(), content->size()));
+#else
+            content->resize(file.read(content->data(), content->size()));
+#endif
+            if (content->size() > scanned->size)
+            {
+                // it grew since the scan
+                content = nullptr;
+                prepare(*scanned, slot);
+                continue;
+            }
+            files.push_back(scanned.get());
+            contents.push_back(std::move(content));
+            pooled.push_back(isPooled);
+            identities.push_back(identity);
+        }
+        catch (...)
+        {
+            onError(*scanned);
+        }
+    }
+
+    std::vector<utils::MultiSha1::Message> messages;
+    messages.reserve(contents.size());
+    for (const auto& content : contents)
+    {
+        messages.push_back(utils::MultiSha1::Message{content->data(), content->size()});
+    }
+    auto digests = utils::MultiSha1::hash(messages);
+
+    for (std::size_t i = 0; i < files.size(); ++i)
+    {
+        try
+        {
+            auto sha1 = utils::Sha1Engine::toHex(digests[i]);
+            auto fid  = Crypto::calculateFid(sha1);
+            auto fkey = Crypto::calculateFkey(sha1);
+            if (identities[i] && _preparedCache != nullptr)
+            {
+                _preparedCache->insert(*identities[i], details::PreparedFileCache::Entry{sha1, fid, fkey});
+            }
+            enqueuePrepared(*files[i], identities[i], sha1, fid, fkey, pooled[i] ? std::move(contents[i]) : nullptr);
+        }
+        catch (...)
+        {
+            onError(*files[i]);
+        }
+    }
+    batch.clear();
+}
+
+void
+Uploader::enqueuePrepared (const ScannedFile& scanned, const boost::optional<details::PreparedFileCache::Key>& identity,
+                           const std::string& sha1, const std::string& fid, const std::string& fkey,
+                           details::FileContent content)
+{
+    if (identity && _journal != nullptr)
+    {
+        _journal->prepared(scanned.request.parentId, scanned.request.path, *identity, sha1, fid, fkey);
+    }
+    auto decodedNodeKey = Crypto::base64decode(_app->currentUser().personalData().nodeKeyClear());
+    auto prepared = giga::make_unique<PreparedFile>(
+        ScannedFile{scanned},
+        sha1,
+        fkey,
+        fid,
+        Crypto::base64encode(Crypto::aesEncrypt(decodedNodeKey.substr(0, 16), decodedNodeKey.substr(16, 16), fkey)),
+        std::move(content)
+    );
+    {
+        std::lock_guard<std::mutex> l{_mut};
+        _upProgress.fileCount         += 1;
+        _upProgress.bytesTotal        += scanned.size;
+        _sha1Progress.bytesTransfered += scanned.size;
+        _sha1Progress.fileDone        += 1;
+        callPrepared(*prepared);
+    }
+    _prepared.wait_enqueue(std::move(prepared));
+}
+
+uint64_t
+Uploader::preparingBytes () const
+{
+    uint64_t bytes = 0ul;
+    for (const auto& calculator : _preparingFiles)
+    {
+        if (calculator != nullptr)
+        {
+            bytes += calculator->progress().transfered;
+        }
+    }
+    return bytes;
+}
+
+void
+Uploader::cancelPreparingFiles ()
+{
+    for (const auto& calculator : _preparingFiles)
+    {
+        auto state = calculator != nullptr ? calculator->state() : FileTransferer::State::canceled;
+        if (state == FileTransferer::State::started || state == FileTransferer::State::paused)
+        {
+            calculator->cancel();
+        }
+    }
+}
+
+uint64_t
+Uploader::uploadingBytes () const
+{
+    uint64_t bytes = 0ul;
+    for (const auto& uploader : _uploadingFiles)
+    {
+        if (uploader != nullptr)
+        {
+            bytes += uploader->progress().transfered;
+        }
+    }
+    return bytes;
+}
+
+uint64_t
+Uploader::transferRate () const
+{
+    if (_rate == 0ul)
+    {
+        return _rate;
+    }
+    uint64_t started = 0ul;
+    for (const auto& uploader : _uploadingFiles)
+    {
+        if (uploader != nullptr && uploader->state() == FileTransferer::State::started)
+        {
+            started += 1;
+        }
+    }
+    return std::max<uint64_t>(1ul, _rate / std::max<uint64_t>(1ul, started));
+}
+
+void
+Uploader::splitTransferRate ()
+{
+    auto rate = transferRate();
+    for (const auto& uploader : _uploadingFiles)
+    {
+        if (uploader != nullptr)
+        {
+            uploader->limitRate(rate);
+        }
+    }
+}
+
+bool
+Uploader::takeClearMarker (std::atomic<int>& clearCounter)
+{
+    auto count = clearCounter.load();
+    while (count > 0)
+    {
+        if (clearCounter.compare_exchange_weak(count, count - 1))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 bool
 Uploader::isPaused () const
 {
@@ -602,87 +1556,271 @@ Uploader::isPaused () const
 
 
 void
-Uploader::uploadFile (const PreparedFile& prepared, int retryCount)
+Uploader::probe (std::unique_ptr<PreparedFile> prepared)
 {
-    const auto& scanned = prepared.scanned;
+    std::shared_ptr<PreparedFile> file{std::move(prepared)};
+    const auto& scanned = file->scanned;
     const auto& request = scanned.request;
+
+    auto added = pplx::task<FileUploader::InstantUpload>{};
     try
     {
-        auto filename = scanned.nodePath.filename().native();
+        // The folder cache is shared by all the upload workers (and the skeleton creation)
+        auto folderPath = scanned.nodePath.parent_path();
+        auto destId     = _folders.resolve(request.parentId, folderPath);
+        for (auto& folder : _folders.takeCreated(request.parentId, folderPath))
+        {
+            std::lock_guard<std::mutex> l(_mut);
+            callUploaded(UploadedFile{*file, std::move(folder)});
+        }
+        added = FileUploader::instantUpload(request.path, scanned.nodePath.filename().native(), destId,
+                                            file->fid, file->fkeyEnc, *_app);
+    }
+    catch (...)
+    {
+        // The upload worker tries again, and reports the error
+        GIGA_DEBUG_LOG(trace, utils::exceptionInfos());
+        auto fileTicket = ticket(*file);
+        _probed.enqueue(giga::make_unique<ProbedFile>(std::move(*file), utility::string_t{}), fileTicket);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> l{_probeMut};
+        _probesInFlight += 1;
+    }
+    added.then([this, file](pplx::task<FileUploader::InstantUpload> t) {
+        auto found = FileUploader::InstantUpload{nullptr, utility::string_t{}};
+        try
+        {
+            found = t.get();
+        }
+        catch (...)
+        {
+            GIGA_DEBUG_LOG(trace, utils::exceptionInfos());
+        }
 
-        auto p = scanned.nodePath.parent_path();
-        if (_cacheNode == nullptr || _cacheNode->id().compare(request.parentId) != 0)
+        if (found.node == nullptr || _cts.get_token().is_canceled())
         {
-            _cacheNode = _app->getNodeById(request.parentId);
+            auto fileTicket = ticket(*file);
+            _probed.enqueue(giga::make_unique<ProbedFile>(std::move(*file), std::move(found.uploadUrl)), fileTicket);
         }
-        auto* dest = &(*_cacheNode);
-        for (auto itPath = p.begin(); itPath != p.end(); ++itPath)
+        else
+        {
+            onInstantUpload(*file, found.node);
+        }
+
+        // Notify under the lock: the Uploader may be gone as soon as the last probe is done
+        std::lock_guard<std::mutex> l{_probeMut};
+        _probesInFlight -= 1;
+        _probeDone.notify_all();
+    });
+}
+
+void
+Uploader::waitProbes (std::size_t maxInFlight)
+{
+    std::unique_lock<std::mutex> l{_probeMut};
+    _probeDone.wait(l, [this, maxInFlight]{ return _probesInFlight <= maxInFlight; });
+}
+
+void
+Uploader::onInstantUpload (const PreparedFile& file, std::shared_ptr<Node> node)
+{
+    const auto& request = file.scanned.request;
+    try
+    {
+        std::lock_guard<std::mutex> l(_mut);
+        callUploaded(UploadedFile{file, std::move(node)});
+        _upProgress.bytesTransfered += file.scanned.size;
+        _upProgress.fileDone += 1;
+    }
+    catch (...)
+    {
+        auto info = utils::exceptionInfos();
+        GIGA_DEBUG_LOG(debug, info);
+
+        std::lock_guard<std::mutex> l(_mut);
+        callError(PreparedFile{file}, std::move(info), Step::uploading);
+        _upProgress.bytesTransfered += file.scanned.size;
+        _upProgress.fileDone += 1;
+    }
+    if (_journal != nullptr)
+    {
+        _journal->done(request.parentId, request.path);
+    }
+    _instantUploads += 1;
+}
+
+bool
+Uploader::holdBack (std::unique_ptr<ProbedFile>& probed)
+{
+    // Two uploads of the same content would send their chunks to the same server session
+    std::lock_guard<std::mutex> l{_mut};
+    const auto& sha1 = probed->prepared.sha1;
+    if (_uploadingSha1s.insert(sha1).second)
+    {
+        return false;
+    }
+    _heldBack[sha1].push_back(std::move(probed));
+    return true;
+}
+
+void
+Uploader::uploadHeldBack (const std::string& sha1, std::size_t slot)
+{
+    while (true)
+    {
+        std::vector<std::unique_ptr<ProbedFile>> held;
         {
-            auto name = itPath->filename();
-            const auto& children = dest->getChildren();
-            auto it = std::find_if(children.begin(), children.end(), [&name](const std::unique_ptr<Node>& e){
-                return e->type() == Node::Type::folder && e->name() == name;
-            });
+            std::lock_guard<std::mutex> l{_mut};
+            auto it = _heldBack.find(sha1);
+            if (it == _heldBack.end())
+            {
+                _uploadingSha1s.erase(sha1);
+                return;
+            }
+            held = std::move(it->second);
+            _heldBack.erase(it);
+        }
 
-            if (it != children.end())
+        // the sha1 stays in _uploadingSha1s: the files of the same content arriving meanwhile wait for these ones
+        for (auto& probed : held)
+        {
+            if (_clearProbedQueue > 0)
             {
-                dest = &**it;
+                continue;
             }
-            else
+            auto& file = probed->prepared;
+            try
             {
-                auto& node = dest->addChildFolder(name.c_str());
-                dest = &node;
-                std::lock_guard<std::mutex> l(_mut);
-                _onUploadedFct(UploadedFile{prepared, std::shared_ptr<Node>(new FolderNode(node))});
+                const auto& request = file.scanned.request;
+                auto destId = _folders.resolve(request.parentId, file.scanned.nodePath.parent_path());
+                auto found  = FileUploader::instantUpload(request.path, file.scanned.nodePath.filename().native(), destId,
+                                                          file.fid, file.fkeyEnc, *_app).get();
+                if (found.node != nullptr)
+                {
+                    onInstantUpload(file, found.node);
+                    continue;
+                }
+                probed->uploadUrl = std::move(found.uploadUrl);
+            }
+            catch (...)
+            {
+                // uploadFile() tries again, and reports the error
+                GIGA_DEBUG_LOG(trace, utils::exceptionInfos());
             }
+            uploadFile(file, slot, probed->uploadUrl);
         }
+    }
+}
+
+void
+Uploader::uploadFile (const PreparedFile& prepared, std::size_t slot, const utility::string_t& uploadUrl, int retryCount)
+{
+    const auto& scanned = prepared.scanned;
+    const auto& request = scanned.request;
+    try
+    {
+        auto filename = scanned.nodePath.filename().native();
 
+        // The folder cache is shared by all the upload workers (and the skeleton creation)
+        auto folderPath = scanned.nodePath.parent_path();
+        auto destId     = _folders.resolve(request.parentId, folderPath);
+        for (auto& folder : _folders.takeCreated(request.parentId, folderPath))
+        {
+            std::lock_guard<std::mutex> l(_mut);
+            callUploaded(UploadedFile{prepared, std::move(folder)});
+        }
 
-        // WARNING: uploader gets moved into _uploadingFile
+        // WARNING: uploader gets moved into _uploadingFiles[slot]
         auto uploader = giga::make_unique<FileUploader>(request.path,
                                                         filename,
-                                                        dest->id(),
+                                                        destId,
                                                         prepared.sha1,
                                                         prepared.fid,
                                                         prepared.fkeyEnc,
                                                         *_app);
+        std::shared_ptr<FileUploader> previous = nullptr;
         {
             std::lock_guard<std::mutex> l(_mut);
-            _uploadingFile = std::move(uploader);
-            _uploadingFile->limitRate(_rate);
-            _uploadingFile->start();
+            previous = std::move(_uploadingFiles[slot]);
+            _uploadingFiles[slot] = std::move(uploader);
+            auto& uploading = *_uploadingFiles[slot];
+            uploading.limitRate(transferRate());
+            uploading.setParallelChunks(_parallelChunks);
+            uploading.setChunkSizing(_chunkSizing);
+            uploading.setIoMode(_ioMode);
+            uploading.setFileIo(_fileIo);
+            uploading.setUploadUrl(uploadUrl);
+            uploading.setContent(prepared.content);
+            uploading.setProgressNotifier(_progressNotifier);
+            if (_journal != nullptr)
+            {
+                // the Session-Id of the upload (see ChunkUploader)
+                auto sessionId = details::ChunkUploader::sessionId(_app->currentUser().id(), prepared.sha1);
+                auto journaled = _journal->find(request.parentId, request.path);
+                if (journaled && journaled->sessionId == sessionId)
+                {
+                    uploading.setResumePosition(journaled->acknowledged);
+                }
+                auto journal  = _journal.get();
+                auto parentId = request.parentId;
+                auto path     = request.path;
+                uploading.setOnAcknowledgedFct([journal, parentId, path, sessionId](uint64_t end) {
+                    journal->acknowledged(parentId, path, sessionId, end);
+                });
+            }
+            uploading.start();
             if (_isPaused)
             {
-                _uploadingFile->pause();
+                uploading.pause();
             }
-            _upProgressFct(*_uploadingFile, _upProgress);
+            splitTransferRate();
+            callUploadProgress(_uploadingFiles[slot], _upProgress.getProgressAddByte(uploadingBytes()));
         }
+        previous = nullptr;
         while (isPaused())
         {
             std::this_thread::sleep_for(std::chrono::milliseconds(100));
         }
-        auto node = _uploadingFile->task().get();
+
+        // Only this worker replaces _uploadingFiles[slot]
+        auto node = _uploadingFiles[slot]->task().get();
+        std::shared_ptr<FileUploader> done = nullptr;
         {
             std::lock_guard<std::mutex> l(_mut);
-            _onUploadedFct(UploadedFile{prepared, node});  // I must do the _onUploadedFct() first, in case it throw an exception
-            _upProgress.bytesTransfered += _uploadingFile->progress().transfered;
+            callUploaded(UploadedFile{prepared, node});  // I must do the callUploaded() first, in case it throw an exception
+            done = std::move(_uploadingFiles[slot]);
+            splitTransferRate();
+            _upProgress.bytesTransfered += done->progress().transfered;
             _upProgress.fileDone += 1;
         }
+        if (_journal != nullptr)
+        {
+            _journal->done(request.parentId, request.path);
+        }
     }
     catch (const ErrorNotFound&)
     {
-        if (_cacheNode != nullptr && retryCount == 0) {
-            _cacheNode = nullptr;
-            uploadFile(prepared, retryCount + 1);
+        // The remote folders may have been modified: forget them and retry once.
+        if (retryCount == 0)
+        {
+            _folders.clear();
+            uploadFile(prepared, slot, utility::string_t{}, retryCount + 1);
         }
         else
         {
             auto info = utils::exceptionInfos();
+            std::shared_ptr<FileUploader> failed = nullptr;
+
             std::lock_guard<std::mutex> l(_mut);
-            _onErrorFct(std::move(prepared), std::move(info), Step::uploading);
-            if (_uploadingFile != nullptr)
+            failed = std::move(_uploadingFiles[slot]);
+            splitTransferRate();
+            callError(std::move(prepared), std::move(info), Step::uploading);
+            if (failed != nullptr)
             {
-                _upProgress.bytesTransfered += _uploadingFile->progress().size;
+                _upProgress.bytesTransfered += failed->progress().size;
                 _upProgress.fileDone += 1;
             }
         }
@@ -690,17 +1828,21 @@ Uploader::uploadFile (const PreparedFile& prepared, int retryCount)
     catch (...)
     {
         auto info = utils::exceptionInfos();
-        if (_uploadingFile != nullptr && _uploadingFile->state() == FileTransferer::State::canceled)
+        std::shared_ptr<FileUploader> failed = nullptr;
+
+        std::lock_guard<std::mutex> l(_mut);
+        failed = std::move(_uploadingFiles[slot]);
+        splitTransferRate();
+        if (failed != nullptr && failed->state() == FileTransferer::State::canceled)
         {
             info = "canceled";
         }
         GIGA_DEBUG_LOG(debug, info);
 
-        std::lock_guard<std::mutex> l(_mut);
-        _onErrorFct(std::move(prepared), std::move(info), Step::uploading);
-        if (_uploadingFile != nullptr)
+        callError(std::move(prepared), std::move(info), Step::uploading);
+        if (failed != nullptr)
         {
-            _upProgress.bytesTransfered += _uploadingFile->progress().size;
+            _upProgress.bytesTransfered += failed->progress().size;
             _upProgress.fileDone += 1;
         }
     }
@@ -19,11 +19,26 @@
 
 #include "FolderNode.h"
 #include "TransferProgress.h"
-#include "../utils/readerwriterqueue.h"
+#include "details/CallbackDispatcher.h"
+#include "details/ChunkSizer.h"
+#include "details/FileBufferPool.h"
+#include "details/FolderPathCache.h"
+#include "details/PreparedFileCache.h"
+#include "details/ProgressNotifier.h"
+#include "details/UploadJournal.h"
+#include "details/UploadScheduler.h"
+#include "../utils/BlockingQueue.h"
+#include "../utils/FileIo.h"
+#include "../utils/PageCache.h"
 
 #include <boost/filesystem.hpp>
 #include <boost/variant.hpp>
 #include <pplx/pplxtasks.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <set>
 #include <string>
 #include <memory>
 #include <utility>
@@ -42,6 +57,7 @@ struct PreparedFile;
 struct UploadedFile;
 
 struct UploadRequest;
+struct ProbedFile;
 
 /**
  * Upload files and folders.
@@ -53,7 +69,10 @@ struct UploadRequest;
  * There are 3 phases in the upload process :
  *  - First the folder to upload is scanned, and every file found will be sent to the preparation process
  *  - Every file to upload needs to get prepared (calculate its sha1 etc...)
- *  - The prepared files gets finally uploaded.
+ *  - The prepared files gets finally uploaded (the ones already on GiGa.GG are only added, without sending their content).
+ *
+ * Several files can be prepared and uploaded at the same time
+ * (see ```setPreparationWorkerCount()``` and ```setMaxConcurrentUploads()```).
  */
 class Uploader
 {
@@ -67,10 +86,23 @@ public:
     typedef std::function<void(const ScannedFile&)>  OnScannedFct;
     typedef std::function<void(const PreparedFile&)> OnPreparedFct;
     typedef std::function<void(UploadedFile&&)> OnUploadedFct;
+    typedef std::function<void(std::vector<UploadedFile>&&)> OnUploadedBatchFct;
 
     typedef boost::variant<UploadRequestedFile, ScannedFile, PreparedFile> UploadErrorData;
     typedef std::function<void(UploadErrorData&&, std::string&&, Step)>    OnErrorFct;
 
+    /** The bounds of a pipeline queue. 0 means no limit. */
+    struct QueueLimits {
+        std::size_t maxItems;
+        std::size_t maxBytes;
+    };
+
+    /** The content of a pipeline queue: its number of elements and their approximate memory. */
+    struct QueueDepth {
+        std::size_t items;
+        std::size_t bytes;
+    };
+
 
 public:
     /**
@@ -97,7 +129,7 @@ public:
      * ```fct``` will be called :
      *
      * - At the beginning of the upload for each file
-     * - For long upload it is called periodically.
+     * - For long upload it is called each time the progress changes (see ```setProgressInterval()```).
      *
      * You should not do any long lasting computation in this function.
      */
@@ -143,6 +175,170 @@ public:
     void
     setOnErrorFct(OnErrorFct fct);
 
+    /**
+     * @brief Call the callbacks and the progress functions on a dedicated thread.
+     *
+     * The workers only queue the events: a slow callback no longer holds back the upload process.
+     * The callbacks are called in the same order, a bit later. An exception thrown by a callback
+     * is logged and ignored (synchronously, it fails the file). ```join()``` returns once every
+     * event has been delivered. Must be called before ```start()```.
+     */
+    void
+    setAsyncCallbacks(bool async);
+
+    /**
+     * @brief Get the nodes created during the upload process by batches, instead of one by one.
+     * @param fct replaces the function given to ```setOnUploadedFct()```
+     * @param maxBatch the maximum number of nodes given to a call of ```fct```
+     *
+     * It enables the asynchronous callbacks (see ```setAsyncCallbacks()```): the nodes created while
+     * ```fct``` runs are given to the next call.
+     */
+    void
+    setOnUploadedBatchFct(OnUploadedBatchFct fct, std::size_t maxBatch = 256u);
+
+    /**
+     * @brief Set the number of files prepared (sha1 calculated) in parallel.
+     * @param count the number of preparation workers. It is clamped to [1, 16].
+     *
+     * Defaults to the number of hardware threads.
+     * The new value is used by the next call to ```start()```.
+     */
+    void
+    setPreparationWorkerCount(unsigned count);
+
+    /**
+     * @brief Hash the files up to ```maxSize``` bytes by batches (default: 256 KiB, 0 disables the batches).
+     *
+     * Each preparation worker collects the small files, reads them whole and hashes several of them
+     * at once, one per SIMD lane (see ```utils::MultiSha1```). They skip the ```Sha1Calculator```:
+     * there is no preparation progress for them, only the prepared callback.
+     * Their content is kept in memory and uploaded from there, when ```setSmallFileMemoryCap()``` allows it.
+     * The new value is used by the next call to ```start()```.
+     */
+    void
+    setBatchHashThreshold(uint64_t maxSize);
+
+    /**
+     * @brief Limit the memory holding the small files between their preparation and their upload (default: 64 MiB).
+     *
+     * The small files (see ```setBatchHashThreshold()```) are read once: the same buffer is hashed and uploaded.
+     * When the cap is reached, the next small files are read again from disk at upload time.
+     * The cap is shared by all the ```Uploader```s of the process. 0 reads every file twice.
+     */
+    static void
+    setSmallFileMemoryCap(uint64_t bytes);
+
+    /**
+     * @brief Set the number of files uploaded at the same time.
+     * @param count the maximum number of ```FileUploader``` in flight. It is clamped to [1, 8].
+     *
+     * Defaults to 1. The rate limit (see ```limitRate()```) is shared between the uploading files.
+     * The new value is used by the next call to ```start()```.
+     */
+    void
+    setMaxConcurrentUploads(unsigned count);
+
+    /**
+     * @brief Set the minimum time between two calls of a progress function (default: 100 ms).
+     *
+     * The progress functions are called when the progress of a transfer changes, never while nothing happens.
+     */
+    void
+    setProgressInterval(std::chrono::milliseconds interval);
+
+    /**
+     * @brief Set the number of prepared files looked up on GiGa.GG at the same time.
+     * @param count the maximum number of ```FileUploader::instantUpload()``` in flight. It is clamped to [1, 32].
+     *
+     * Before being uploaded, every prepared file is added by its fid: the files already on GiGa.GG
+     * are done without taking an upload worker, only the others are uploaded.
+     * Defaults to 8. The new value is used by the next call to ```start()```.
+     */
+    void
+    setMaxConcurrentProbes(unsigned count);
+
+    /**
+     * @brief Set the number of chunks of a same file sent at the same time.
+     * @param count the number of connections used for each uploading file (default: 1).
+     * @see FileUploader::setParallelChunks()
+     */
+    void
+    setParallelChunks(unsigned count);
+
+    /**
+     * @brief Choose how the chunks of the uploaded files are sized.
+     * @see FileUploader::setChunkSizing()
+     */
+    void
+    setChunkSizing(const details::ChunkSizing& sizing);
+
+    /**
+     * @brief Choose how the files are read, to be hashed then uploaded (default: ```utils::IoMode::cached```).
+     *
+     * With ```utils::IoMode::streaming``` or ```utils::IoMode::direct``` a bulk upload does not fill
+     * the page cache, at the cost of reading the small files twice when they are not kept in memory
+     * (see ```setSmallFileMemoryCap()```).
+     */
+    void
+    setIoMode(utils::IoMode mode);
+
+    /**
+     * @brief Read the files, to be hashed then uploaded, through ```io``` (default: nullptr, blocking reads).
+     *
+     * A single backend, e.g. ```utils::FileIo::shared()```, serves all the files being hashed and uploaded.
+     */
+    void
+    setFileIo(std::shared_ptr<utils::FileIo> io);
+
+    /**
+     * @brief Bound the queue of the files waiting for ```step```.
+     * @param step ```Step::preparing``` (the scanned files) or ```Step::uploading``` (the prepared files)
+     *
+     * When a queue is full, the step feeding it waits for the next one to catch up:
+     * a large folder is no longer fully held in memory while its first files are hashed.
+     * Both queues default to 64 MiB. The upload requests cannot be limited.
+     */
+    void
+    setQueueLimits(Step step, QueueLimits limits);
+
+    /**
+     * @return the files waiting for ```step``` (the upload requests for ```Step::scanning```).
+     */
+    QueueDepth
+    queueDepth(Step step) const;
+
+    /**
+     * @brief Keep the prepared files (sha1, fid and fkey) in ```cacheFile```.
+     *
+     * The files found in the cache, with the same device, inode, size and modification time,
+     * are not hashed again: they go straight to the upload phase.
+     * Must be called before ```start()```.
+     */
+    void
+    setPreparedFileCache(const boost::filesystem::path& cacheFile);
+
+    /**
+     * @brief Record the upload process in ```journalPath``` (a previous journal is overwritten).
+     *
+     * The journal keeps the requested, scanned and prepared files, and the bytes acknowledged by the server
+     * for each file being uploaded, so that an interrupted process can be continued with ```resume()```.
+     * Must be called before ```start()```.
+     */
+    void
+    setJournal(const boost::filesystem::path& journalPath);
+
+    /**
+     * @brief Continue the upload process recorded in ```journalPath```.
+     *
+     * The files not uploaded yet are queued again (prepared files are not hashed again,
+     * and their upload restarts from the last acknowledged byte), the requests whose scan
+     * was interrupted are scanned again. The journal keeps recording the process.
+     * Must be called before ```start()```.
+     */
+    void
+    resume(const boost::filesystem::path& journalPath);
+
     /**
      * @brief add a file or folder to the list of uploads
      *
@@ -155,6 +351,25 @@ public:
     void
     addUploads(FolderNode parent, std::vector<boost::filesystem::path>&& pathes);
 
+    /**
+     * @brief add files or folders to the list of uploads, with a priority
+     *
+     * @param priority used by the ```SchedulingPolicy::priority``` and ```SchedulingPolicy::fair``` policies
+     *        (the higher, the sooner). The other requests have a priority of 0.
+     * @see setSchedulingPolicy()
+     */
+    void
+    addUploads(FolderNode parent, std::vector<boost::filesystem::path>&& pathes, int priority);
+
+    /**
+     * @brief Choose the order in which the prepared files are uploaded (default: ```SchedulingPolicy::fifo```).
+     *
+     * With several upload workers (see ```setMaxConcurrentUploads()```), ```SchedulingPolicy::smallestFirst```
+     * lets the small files go on while a large one is uploading.
+     */
+    void
+    setSchedulingPolicy(details::SchedulingPolicy policy);
+
     /**
      * @brief start the uploading process
      */
@@ -176,12 +391,14 @@ public:
     /**
      * @brief Limit the current upload rate
      * @param rate the upload rate in Octet/s. Uses 0 for no limit.
+     *
+     * The limit applies to the whole Uploader: each concurrent upload gets its share.
      */
     void
     limitRate(uint64_t rate);
 
     /**
-     * @brief Pause the current upload. Uses ```resume()``` to restart.
+     * @brief Pause the current uploads. Uses ```resume()``` to restart.
      */
     void
     pause();
@@ -193,14 +410,16 @@ public:
     resume();
 
     /**
-     * @brief Remove all the files waiting to be process. Only the current uploading file remains.
+     * @brief Remove all the files waiting to be process. Only the current uploading files remain.
      * The Error queue is cleared (@see ```consumeError()```)
      */
     void
     clear();
 
     /**
-     * @brief Gets the current upload state
+     * @brief Gets the current upload state, over all the upload slots
+     *
+     * Started if any file is started, paused if all the files not done are paused...
      */
     FileTransferer::State
     state();
@@ -208,9 +427,19 @@ public:
     bool
     isStarted() const;
 
+    /**
+     * @brief Gets one of the files being uploaded, or nullptr.
+     * @see uploadingFiles()
+     */
     FileUploader*
     uploadingFile();
 
+    /**
+     * @brief Gets the files being uploaded.
+     */
+    std::vector<FileUploader*>
+    uploadingFiles();
+
     void
     callProgressFct() const;
 
@@ -221,44 +450,172 @@ public:
     addPreparedFile(ScannedFile scanned, const std::string& sha1);
 
 private:
+    /**
+     * @brief Scan ```realPath``` (a file or a folder) and queue its files, found by several workers.
+     */
+    void
+    scanFiles(const UploadRequest& request, const boost::filesystem::path& realPath);
+
+    void
+    prepare (const ScannedFile& scanned, std::size_t slot);
+
+    /**
+     * @brief Prepare the small files of ```batch```, hashed together, then clear it.
+     */
+    void
+    prepareBatch (std::vector<std::unique_ptr<ScannedFile>>& batch, std::size_t slot);
+
+    /**
+     * @brief Queue the prepared file of ```scanned``` for upload, once its sha1 is known.
+     */
+    void
+    enqueuePrepared (const ScannedFile& scanned, const boost::optional<details::PreparedFileCache::Key>& identity,
+                     const std::string& sha1, const std::string& fid, const std::string& fkey,
+                     details::FileContent content = nullptr);
+
+    /**
+     * @brief Call a user callback now, or queue it when the callbacks are asynchronous. ```_mut``` must be locked.
+     */
+    void
+    callScanned (const ScannedFile& file) const;
+
+    void
+    callPrepared (const PreparedFile& file) const;
+
+    void
+    callUploaded (UploadedFile&& file) const;
+
+    void
+    callError (UploadErrorData&& data, std::string&& error, Step step) const;
+
+    void
+    callUploadProgress (const std::shared_ptr<FileUploader>& uploader, TransferProgress progress) const;
+
+    void
+    callPreparationProgress (const std::shared_ptr<Sha1Calculator>& calculator, TransferProgress progress) const;
+
+    /**
+     * @brief Add the node of ```prepared``` if its content is already on GiGa.GG, queue it for upload otherwise.
+     */
+    void
+    probe (std::unique_ptr<PreparedFile> prepared);
+
+    /**
+     * @brief Wait until at most ```maxInFlight``` probes are running.
+     */
     void
-    scanFiles(const FolderNode& dest,  boost::filesystem::path relativeNodePath, const boost::filesystem::path& realPath);
+    waitProbes (std::size_t maxInFlight);
+
+    /**
+     * @brief Report ```file``` as added to GiGa.GG without sending its content.
+     */
+    void
+    onInstantUpload (const PreparedFile& file, std::shared_ptr<Node> node);
+
+    /**
+     * @brief Keep ```probed``` aside if another worker is uploading the same content (same Session-Id).
+     * @return false if the content is not being uploaded: the caller uploads it, then calls ```uploadHeldBack()```.
+     */
+    bool
+    holdBack (std::unique_ptr<ProbedFile>& probed);
 
+    /**
+     * @brief Probe again, then upload if needed, the files kept aside while ```sha1``` was uploaded.
+     * Most of them are instant uploads now.
+     */
     void
-    prepare (const ScannedFile& scanned);
+    uploadHeldBack (const std::string& sha1, std::size_t slot);
 
     void
-    uploadFile (const PreparedFile& element, int retryCount = 0);
+    uploadFile (const PreparedFile& element, std::size_t slot, const utility::string_t& uploadUrl = {}, int retryCount = 0);
 
     bool
     isPaused () const;
 
-    template <typename T> void
-    enqueue(moodycamel::BlockingReaderWriterQueue<std::unique_ptr<T>>& queue, std::unique_ptr<T>&& element);
+    /**
+     * @brief Sum of the bytes hashed by the running preparation workers. ```_mut``` must be locked.
+     */
+    uint64_t
+    preparingBytes () const;
+
+    /**
+     * @brief Cancel the running preparation workers. ```_mut``` must be locked.
+     */
+    void
+    cancelPreparingFiles ();
+
+    /**
+     * @brief Sum of the bytes sent by the running upload workers. ```_mut``` must be locked.
+     */
+    uint64_t
+    uploadingBytes () const;
+
+    /**
+     * @brief The rate limit of each uploading file: the limit split between the started ones. ```_mut``` must be locked.
+     */
+    uint64_t
+    transferRate () const;
+
+    /**
+     * @brief Sets ```transferRate()``` on each uploading file, when their count changes. ```_mut``` must be locked.
+     */
+    void
+    splitTransferRate ();
+
+    /**
+     * @brief Consume one pending "clear" marker, if any.
+     * @return true if the ```nullptr``` just dequeued was a clear marker, false if it ends the queue.
+     */
+    static bool
+    takeClearMarker(std::atomic<int>& clearCounter);
 
 private:
-    typedef moodycamel::BlockingReaderWriterQueue<std::unique_ptr<UploadRequest>> RequestQueue;
-    typedef moodycamel::BlockingReaderWriterQueue<std::unique_ptr<ScannedFile>>   ScannedQueue;
-    typedef moodycamel::BlockingReaderWriterQueue<std::unique_ptr<PreparedFile>>  PreparedQueue;
+    typedef utils::BlockingQueue<std::unique_ptr<UploadRequest>> RequestQueue;
+    typedef utils::BlockingQueue<std::unique_ptr<ScannedFile>>   ScannedQueue;
+    typedef utils::BlockingQueue<std::unique_ptr<PreparedFile>>  PreparedQueue;
+    typedef details::UploadScheduler<std::unique_ptr<ProbedFile>> ProbedQueue;
 
     RequestQueue                    _requests;
     ScannedQueue                    _scanned;
     PreparedQueue                   _prepared;
+    ProbedQueue                     _probed;    // the prepared files that are not on GiGa.GG yet
 
     std::atomic<int>                _clearRequestQueue;
     std::atomic<int>                _clearScannedQueue;
     std::atomic<int>                _clearPreparedQueue;
+    std::atomic<int>                _clearProbedQueue;
+    std::atomic<uint64_t>           _nextRequestId;
 
     std::unique_ptr<UploadRequest>  _scanningFile;
-    std::unique_ptr<Sha1Calculator> _preparingFile;
-    std::unique_ptr<FileUploader>   _uploadingFile;
+
+    // one slot per preparation worker
+    std::vector<std::shared_ptr<Sha1Calculator>> _preparingFiles;
+    unsigned                        _prepareWorkerCount;
+    std::atomic<unsigned>           _runningPreparers;
+    uint64_t                        _batchHashThreshold;
+
+    // one slot per upload worker
+    std::vector<std::shared_ptr<FileUploader>> _uploadingFiles;
+    unsigned                        _maxConcurrentUploads;
+    std::atomic<unsigned>           _runningUploaders;
+
+    unsigned                        _maxConcurrentProbes;
+    std::mutex                      _probeMut;
+    std::condition_variable         _probeDone;
+    std::size_t                     _probesInFlight;  // guarded by _probeMut
+    std::atomic<uint64_t>           _instantUploads;
+
+    // the contents being uploaded, and the files of the same content waiting for them (guarded by _mut)
+    std::set<std::string>           _uploadingSha1s;
+    std::map<std::string, std::vector<std::unique_ptr<ProbedFile>>> _heldBack;
+
+    std::shared_ptr<details::ProgressNotifier> _progressNotifier;
 
     pplx::cancellation_token_source _cts;
     pplx::task<void>                _mainTask;
     bool                            _isStarted;
 
     mutable std::mutex              _mut;
-    std::mutex                      _mutQueue;
 
     TransferProgress                _upProgress;
     TransferProgress                _sha1Progress;
@@ -268,22 +625,26 @@ private:
     OnPreparedFct                   _onPreparedFct;
     OnUploadedFct                   _onUploadedFct;
     OnErrorFct                      _onErrorFct;
+    // the batch posts to the dispatcher: it is destroyed after it
+    std::unique_ptr<details::CallbackBatch<UploadedFile>> _uploadedBatch;
+    std::unique_ptr<details::CallbackDispatcher>          _dispatcher;
     std::atomic<bool>               _isFinished;
     const Application*              _app;
 
     uint64_t                        _rate;
     bool                            _isPaused;
-
-    std::unique_ptr<Node>           _cacheNode;
+    unsigned                        _parallelChunks;
+    details::ChunkSizing            _chunkSizing;
+    utils::IoMode                   _ioMode;
+    std::shared_ptr<utils::FileIo>  _fileIo;
+    std::unique_ptr<details::PreparedFileCache> _preparedCache;
+    std::unique_ptr<details::UploadJournal>     _journal;
+
+    details::FolderPathCache        _folders;
+    std::set<boost::filesystem::path> _scannedFolders;  // folders of the request being scanned (guarded by _mut)
+    std::vector<pplx::task<void>>   _skeletonTasks;
 };
 
-template <typename T> void
-Uploader::enqueue(moodycamel::BlockingReaderWriterQueue<std::unique_ptr<T>>& queue, std::unique_ptr<T>&& element)
-{
-    std::lock_guard<std::mutex> l{_mutQueue};
-    queue.enqueue(std::move(element));
-}
-
 struct UploadRequestedFile
 {
     explicit
@@ -301,6 +662,8 @@ struct UploadRequestedFile
 
     std::string             parentId;
     boost::filesystem::path path;
+    uint64_t                requestId = 0u; //!< the ```Uploader::addUploads()``` call the file comes from
+    int                     priority  = 0;
 };
 
 struct ScannedFile
@@ -326,9 +689,11 @@ struct ScannedFile
 struct PreparedFile
 {
     explicit
-    PreparedFile (ScannedFile scanned, std::string sha1, std::string fkey, std::string fid, std::string fkeyEnc) :
+    PreparedFile (ScannedFile scanned, std::string sha1, std::string fkey, std::string fid, std::string fkeyEnc,
+                  details::FileContent content = nullptr) :
         scanned{std::move(scanned)},
-        sha1(std::move(sha1)), fkey(std::move(fkey)), fid(std::move(fid)), fkeyEnc(std::move(fkeyEnc))
+        sha1(std::move(sha1)), fkey(std::move(fkey)), fid(std::move(fid)), fkeyEnc(std::move(fkeyEnc)),
+        content(std::move(content))
     {}
 
     PreparedFile(PreparedFile&&)                 = default;
@@ -343,6 +708,7 @@ struct PreparedFile
     std::string fkey;
     std::string fid;
     std::string fkeyEnc;
+    details::FileContent content; // the small files read once, uploaded from memory (always nullptr in the callbacks)
 };
 
 struct UploadedFile
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CallbackDispatcher.h"
+#include "../../rest/HttpErrors.h"
+#include "../../utils/Utils.h"
+
+namespace giga
+{
+namespace details
+{
+
+CallbackDispatcher::CallbackDispatcher() :
+        _mut{}, _cond{}, _events{}, _delivering{false}, _stopped{false}, _thread{}
+{
+    _thread = std::thread{[this] { run(); }};
+}
+
+CallbackDispatcher::~CallbackDispatcher()
+{
+    {
+        std::lock_guard<std::mutex> l{_mut};
+        _stopped = true;
+    }
+    _cond.notify_all();
+    _thread.join();
+}
+
+void
+CallbackDispatcher::post(Event event)
+{
+    {
+        std::lock_guard<std::mutex> l{_mut};
+        _events.push_back(std::move(event));
+    }
+    _cond.notify_all();
+}
+
+void
+CallbackDispatcher::flush()
+{
+    if (std::this_thread::get_id() == _thread.get_id())
+    {
+        return; // called by a callback (e.g. through Uploader::join()): it would wait for itself
+    }
+    std::unique_lock<std::mutex> l{_mut};
+    _cond.wait(l, [this] { return _events.empty() && !_delivering; });
+}
+
+void
+CallbackDispatcher::run()
+{
+    std::unique_lock<std::mutex> l{_mut};
+    while (true)
+    {
+        _cond.wait(l, [this] { return !_events.empty() || _stopped; });
+        if (_events.empty())
+        {
+            return; // stopped, every event is delivered
+        }
+
+        auto event = std::move(_events.front());
+        _events.pop_front();
+        _delivering = true;
+        l.unlock();
+        try
+        {
+            event();
+        }
+        catch (...)
+        {
+            GIGA_DEBUG_LOG(warning, utils::exceptionInfos());
+        }
+        l.lock();
+        _delivering = false;
+        _cond.notify_all();
+    }
+}
+
+} /* namespace details */
+} /* namespace giga */
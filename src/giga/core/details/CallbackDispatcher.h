@@ -0,0 +1,151 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GIGA_CORE_DETAILS_CALLBACKDISPATCHER_H_
+#define GIGA_CORE_DETAILS_CALLBACKDISPATCHER_H_
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace giga
+{
+namespace details
+{
+
+/**
+ * Calls the user callbacks on its own thread, in the order they were posted.
+ *
+ * The transfer workers only queue the events: a slow callback no longer holds
+ * back the transfers (nor the callers of ```pause()``` or ```limitRate()```).
+ * An exception thrown by a callback is logged and ignored.
+ */
+class CallbackDispatcher final
+{
+public:
+    typedef std::function<void()> Event;
+
+public:
+    CallbackDispatcher();
+    ~CallbackDispatcher();
+
+    CallbackDispatcher(CallbackDispatcher&&)                 = delete;
+    CallbackDispatcher(const CallbackDispatcher&)            = delete;
+    CallbackDispatcher& operator=(const CallbackDispatcher&) = delete;
+    CallbackDispatcher& operator=(CallbackDispatcher&&)      = delete;
+
+public:
+    void
+    post(Event event);
+
+    /**
+     * @brief Wait until every event posted so far has been delivered.
+     * Does not wait when called from a callback (the events posted after it are delivered later).
+     */
+    void
+    flush();
+
+private:
+    void
+    run();
+
+private:
+    std::mutex              _mut;
+    std::condition_variable _cond;
+    std::deque<Event>       _events;
+    bool                    _delivering;
+    bool                    _stopped;
+    std::thread             _thread;
+};
+
+/**
+ * Groups the items given to ```push()``` and delivers them, by batches of at most ```maxBatch```,
+ * on the thread of a ```CallbackDispatcher```.
+ *
+ * The items pile up while the callback runs: the slower the callback, the larger the batches.
+ * The batch must outlive the events it posted (see ```CallbackDispatcher::flush()```).
+ */
+template <typename T>
+class CallbackBatch final
+{
+public:
+    typedef std::function<void(std::vector<T>&&)> BatchFct;
+
+public:
+    explicit
+    CallbackBatch(CallbackDispatcher& dispatcher, BatchFct fct, std::size_t maxBatch) :
+        _dispatcher(dispatcher), _fct{std::move(fct)}, _maxBatch{std::max<std::size_t>(maxBatch, 1u)}, _mut{}, _items{}
+    {
+    }
+
+    CallbackBatch(CallbackBatch&&)                 = delete;
+    CallbackBatch(const CallbackBatch&)            = delete;
+    CallbackBatch& operator=(const CallbackBatch&) = delete;
+    CallbackBatch& operator=(CallbackBatch&&)      = delete;
+
+    void
+    push(T&& item)
+    {
+        bool first = false;
+        {
+            std::lock_guard<std::mutex> l{_mut};
+            first = _items.empty();
+            _items.push_back(std::move(item));
+        }
+        if (first)
+        {
+            _dispatcher.post([this] { deliver(); });
+        }
+    }
+
+private:
+    void
+    deliver()
+    {
+        std::vector<T> batch;
+        {
+            std::lock_guard<std::mutex> l{_mut};
+            auto count = std::min(_items.size(), _maxBatch);
+            batch.reserve(count);
+            std::move(_items.begin(), _items.begin() + static_cast<std::ptrdiff_t>(count), std::back_inserter(batch));
+            _items.erase(_items.begin(), _items.begin() + static_cast<std::ptrdiff_t>(count));
+            if (!_items.empty())
+            {
+                _dispatcher.post([this] { deliver(); });
+            }
+        }
+        _fct(std::move(batch));
+    }
+
+private:
+    CallbackDispatcher& _dispatcher;
+    BatchFct            _fct;
+    std::size_t         _maxBatch;
+    std::mutex          _mut;
+    std::deque<T>       _items;
+};
+
+} /* namespace details */
+} /* namespace giga */
+
+#endif /* GIGA_CORE_DETAILS_CALLBACKDISPATCHER_H_ */
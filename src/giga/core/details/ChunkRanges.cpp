@@ -0,0 +1,115 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ChunkRanges.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace giga
+{
+namespace details
+{
+
+void
+ChunkRanges::add (uint64_t start, uint64_t end)
+{
+    if (end <= start)
+    {
+        return;
+    }
+
+    // merge with the previous range if they touch
+    auto it = _ranges.upper_bound(start);
+    if (it != _ranges.begin())
+    {
+        auto prev = std::prev(it);
+        if (prev->second >= start)
+        {
+            start = prev->first;
+            end   = std::max(end, prev->second);
+            it    = _ranges.erase(prev);
+        }
+    }
+
+    // absorb the following ranges
+    while (it != _ranges.end() && it->first <= end)
+    {
+        end = std::max(end, it->second);
+        it  = _ranges.erase(it);
+    }
+    _ranges.emplace(start, end);
+}
+
+void
+ChunkRanges::clear ()
+{
+    _ranges.clear();
+}
+
+bool
+ChunkRanges::contains (uint64_t start, uint64_t end) const
+{
+    if (end <= start)
+    {
+        return true;
+    }
+    auto it = _ranges.upper_bound(start);
+    if (it == _ranges.begin())
+    {
+        return false;
+    }
+    --it;
+    return it->first <= start && it->second >= end;
+}
+
+uint64_t
+ChunkRanges::contiguousEnd () const
+{
+    return nextMissing(0ul);
+}
+
+uint64_t
+ChunkRanges::acknowledged () const
+{
+    uint64_t total = 0ul;
+    for (const auto& range : _ranges)
+    {
+        total += range.second - range.first;
+    }
+    return total;
+}
+
+uint64_t
+ChunkRanges::nextMissing (uint64_t from) const
+{
+    auto it = _ranges.upper_bound(from);
+    if (it == _ranges.begin())
+    {
+        return from;
+    }
+    --it;
+    return std::max(from, it->second);
+}
+
+std::vector<ChunkRanges::Range>
+ChunkRanges::ranges () const
+{
+    return std::vector<Range>(_ranges.begin(), _ranges.end());
+}
+
+} /* namespace details */
+} /* namespace giga */
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GIGA_CORE_DETAILS_CHUNKRANGES_H_
+#define GIGA_CORE_DETAILS_CHUNKRANGES_H_
+
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace giga
+{
+namespace details
+{
+
+/**
+ * An ordered record of the byte ranges acknowledged by the server.
+ *
+ * Ranges are half-open ```[start, end)```. Adjacent and overlapping ranges are merged.
+ */
+class ChunkRanges final
+{
+public:
+    typedef std::pair<uint64_t, uint64_t> Range;
+
+public:
+    ChunkRanges()                              = default;
+    ChunkRanges(const ChunkRanges&)            = default;
+    ChunkRanges(ChunkRanges&&)                 = default;
+    ChunkRanges& operator=(const ChunkRanges&) = default;
+    ChunkRanges& operator=(ChunkRanges&&)      = default;
+
+    void
+    add (uint64_t start, uint64_t end);
+
+    void
+    clear ();
+
+    /**
+     * @return true if every byte of ```[start, end)``` has been acknowledged.
+     */
+    bool
+    contains (uint64_t start, uint64_t end) const;
+
+    /**
+     * @return the end of the acknowledged range starting at 0 (0 if there is none).
+     */
+    uint64_t
+    contiguousEnd () const;
+
+    /**
+     * @return the number of acknowledged bytes.
+     */
+    uint64_t
+    acknowledged () const;
+
+    /**
+     * @return the first byte, at or after ```from```, that has not been acknowledged.
+     */
+    uint64_t
+    nextMissing (uint64_t from) const;
+
+    std::vector<Range>
+    ranges () const;
+
+private:
+    std::map<uint64_t, uint64_t> _ranges; // start -> end
+};
+
+} /* namespace details */
+} /* namespace giga */
+
+#endif /* GIGA_CORE_DETAILS_CHUNKRANGES_H_ */
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ChunkSession.h"
+
+#include <algorithm>
+
+namespace giga
+{
+namespace details
+{
+
+constexpr unsigned ChunkSession::MAX_RESTARTS;
+
+uint64_t
+ChunkSession::onSerialReply (uint64_t start, uint64_t end)
+{
+    // the server lost the beginning of the file: restart at 0.
+    if (start > 0 && end > start)
+    {
+        restart();
+        return 0ul;
+    }
+    _acked.add(0, end);
+    return end;
+}
+
+void
+ChunkSession::startParallel (uint64_t position)
+{
+    _acked.clear();
+    _acked.add(0, position);
+    _inFlight.clear();
+}
+
+ChunkRanges::Range
+ChunkSession::nextGap (uint64_t fileSize) const
+{
+    auto start = _acked.nextMissing(0);
+    for (const auto& chunk : _inFlight)
+    {
+        if (chunk.first > start)
+        {
+            break; // the chunks are sorted: start is in a gap
+        }
+        start = std::max(start, _acked.nextMissing(std::max(start, chunk.second)));
+    }
+    if (start >= fileSize)
+    {
+        return ChunkRanges::Range{fileSize, fileSize};
+    }
+
+    // up to the next acknowledged or in flight byte
+    auto end = fileSize;
+    auto next = _inFlight.upper_bound(start);
+    if (next != _inFlight.end())
+    {
+        end = std::min(end, next->first);
+    }
+    for (const auto& range : _acked.ranges())
+    {
+        if (range.first > start)
+        {
+            end = std::min(end, range.first);
+            break;
+        }
+    }
+    return ChunkRanges::Range{start, end};
+}
+
+void
+ChunkSession::sending (uint64_t start, uint64_t end)
+{
+    _inFlight[start] = end;
+}
+
+bool
+ChunkSession::onParallelReply (uint64_t chunkStart, uint64_t chunkEnd, uint64_t start, uint64_t end)
+{
+    (void) chunkEnd; // not acknowledged unless the server reports it
+    _inFlight.erase(chunkStart);
+    if (_serialOnly)
+    {
+        return false; // sent before the restart
+    }
+    if (end < _acked.contiguousEnd())
+    {
+        restart();
+        return false;
+    }
+    _acked.add(start, end);
+    return true;
+}
+
+bool
+ChunkSession::serialOnly () const
+{
+    return _serialOnly;
+}
+
+bool
+ChunkSession::tooManyRestarts () const
+{
+    return _restarts > MAX_RESTARTS;
+}
+
+const ChunkRanges&
+ChunkSession::acked () const
+{
+    return _acked;
+}
+
+void
+ChunkSession::restart ()
+{
+    _acked.clear();
+    _inFlight.clear();
+    _restarts  += 1;
+    _serialOnly = true;
+}
+
+} /* namespace details */
+} /* namespace giga */
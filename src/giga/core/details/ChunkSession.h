@@ -0,0 +1,115 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GIGA_CORE_DETAILS_CHUNKSESSION_H_
+#define GIGA_CORE_DETAILS_CHUNKSESSION_H_
+
+#include "ChunkRanges.h"
+
+#include <cstdint>
+#include <map>
+
+namespace giga
+{
+namespace details
+{
+
+/**
+ * What the server acknowledged of a chunked upload, and when the upload restarts at 0.
+ *
+ * The chunks are first sent one after the other (serial), then possibly several at the same time (parallel).
+ * Only the ranges reported by the server are acknowledged: a parallel chunk it did not
+ * keep (out of order) is sent again once it is no longer in flight.
+ * Once the server lost the beginning of the file, the upload restarts at 0 and stays serial.
+ * Not thread safe.
+ */
+class ChunkSession final
+{
+public:
+    static constexpr unsigned MAX_RESTARTS = 3u;
+
+public:
+    ChunkSession()                               = default;
+    ChunkSession(const ChunkSession&)            = default;
+    ChunkSession(ChunkSession&&)                 = default;
+    ChunkSession& operator=(const ChunkSession&) = default;
+    ChunkSession& operator=(ChunkSession&&)      = default;
+
+    /**
+     * @brief Records the reply ```[start, end)``` to a serial chunk.
+     * @return the next position to send: 0 when the server lost the beginning of the file.
+     */
+    uint64_t
+    onSerialReply (uint64_t start, uint64_t end);
+
+    /**
+     * @brief The bytes before ```position``` are acknowledged, the next chunks are sent in parallel.
+     */
+    void
+    startParallel (uint64_t position);
+
+    /**
+     * @return the first range of the file neither acknowledged nor in flight (```fileSize``` to ```fileSize``` if none).
+     */
+    ChunkRanges::Range
+    nextGap (uint64_t fileSize) const;
+
+    /**
+     * @brief The parallel chunk ```[start, end)``` is sent, until its reply.
+     */
+    void
+    sending (uint64_t start, uint64_t end);
+
+    /**
+     * @brief Records the reply ```[start, end)``` to the parallel chunk ```[chunkStart, chunkEnd)```.
+     *
+     * Only ```[start, end)``` is acknowledged, whatever the chunk was.
+     * A reply ending before the acknowledged prefix means that the server dropped it.
+     * @return false when the upload restarts at 0 (or already did, for a reply arriving late).
+     */
+    bool
+    onParallelReply (uint64_t chunkStart, uint64_t chunkEnd, uint64_t start, uint64_t end);
+
+    /**
+     * @return true once the upload restarted: the chunks are then sent one after the other.
+     */
+    bool
+    serialOnly () const;
+
+    /**
+     * @return true if the upload restarted more than ```MAX_RESTARTS``` times.
+     */
+    bool
+    tooManyRestarts () const;
+
+    const ChunkRanges&
+    acked () const;
+
+private:
+    void
+    restart ();
+
+private:
+    ChunkRanges _acked      = {};
+    std::map<uint64_t, uint64_t> _inFlight = {}; // the parallel chunks sent, start -> end
+    unsigned    _restarts   = 0u;
+    bool        _serialOnly = false;
+};
+
+} /* namespace details */
+} /* namespace giga */
+
+#endif /* GIGA_CORE_DETAILS_CHUNKSESSION_H_ */
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ChunkSizer.h"
+
+#include <algorithm>
+
+namespace
+{
+// a chunk must be sent that much faster than the previous one to grow the size.
+constexpr double GROW_THRESHOLD = 1.1;
+
+uint64_t
+rate (uint64_t bytes, giga::details::ChunkSizer::Duration elapsed)
+{
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+    return bytes * 1000ul / static_cast<uint64_t>(std::max<decltype(ms)>(ms, 1));
+}
+}
+
+namespace giga
+{
+namespace details
+{
+
+constexpr unsigned ChunkSizer::HOLD_DOWN_CHUNKS;
+
+ChunkSizing
+ChunkSizing::fixed (uint64_t size)
+{
+    return ChunkSizing{Policy::fixed, size, size};
+}
+
+ChunkSizing
+ChunkSizing::adaptive (uint64_t maxSize, uint64_t minSize)
+{
+    return ChunkSizing{Policy::adaptive, std::min(minSize, maxSize), maxSize};
+}
+
+ChunkSizer::ChunkSizer (const ChunkSizing& sizing) :
+        _mut{},
+        _sizing(sizing),
+        _size{sizing.policy == ChunkSizing::Policy::fixed ? sizing.maxSize : sizing.minSize},
+        _lastRate{0ul},
+        _holdDown{0u},
+        _sentBytes{0ul},
+        _firstStart{},
+        _lastEnd{}
+{
+}
+
+uint64_t
+ChunkSizer::size () const
+{
+    std::lock_guard<std::mutex> l{_mut};
+    return _size;
+}
+
+void
+ChunkSizer::onChunkSent (uint64_t bytes, Duration elapsed, TimePoint end)
+{
+    std::lock_guard<std::mutex> l{_mut};
+    auto start  = end - elapsed;
+    _firstStart = _sentBytes == 0 ? start : std::min(_firstStart, start);
+    _lastEnd    = _sentBytes == 0 ? end : std::max(_lastEnd, end);
+    _sentBytes += bytes;
+
+    auto current = rate(bytes, elapsed);
+    if (_holdDown > 0u)
+    {
+        _holdDown -= 1;
+    }
+    else if (_sizing.policy == ChunkSizing::Policy::adaptive
+            && static_cast<double>(current) > static_cast<double>(_lastRate) * GROW_THRESHOLD)
+    {
+        _size = std::min(_size * 2, _sizing.maxSize);
+    }
+    _lastRate = current;
+}
+
+void
+ChunkSizer::onChunkRetry ()
+{
+    std::lock_guard<std::mutex> l{_mut};
+    if (_sizing.policy == ChunkSizing::Policy::adaptive)
+    {
+        _size     = std::max(_size / 2, _sizing.minSize);
+        _holdDown = HOLD_DOWN_CHUNKS; // the last rate is kept: do not grow back to the failing size at once
+    }
+}
+
+uint64_t
+ChunkSizer::throughput () const
+{
+    std::lock_guard<std::mutex> l{_mut};
+    return _sentBytes == 0 ? 0ul : rate(_sentBytes, _lastEnd - _firstStart);
+}
+
+uint64_t
+ChunkSizer::lastThroughput () const
+{
+    std::lock_guard<std::mutex> l{_mut};
+    return _lastRate;
+}
+
+} /* namespace details */
+} /* namespace giga */
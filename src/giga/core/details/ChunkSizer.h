@@ -0,0 +1,120 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GIGA_CORE_DETAILS_CHUNKSIZER_H_
+#define GIGA_CORE_DETAILS_CHUNKSIZER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+namespace giga
+{
+namespace details
+{
+
+/**
+ * How the size of the uploaded chunks is chosen.
+ */
+struct ChunkSizing
+{
+    enum class Policy {
+        fixed,   ///< every chunk is ```maxSize``` bytes
+        adaptive ///< start at ```minSize```, grow up to ```maxSize``` while the throughput rises
+    };
+
+    Policy   policy;
+    uint64_t minSize;
+    uint64_t maxSize;
+
+    /**
+     * @brief The historical behaviour: chunks of ```size``` bytes (1 MiB by default).
+     */
+    static ChunkSizing
+    fixed (uint64_t size = 1024ul * 1024ul);
+
+    static ChunkSizing
+    adaptive (uint64_t maxSize = 64ul * 1024ul * 1024ul, uint64_t minSize = 1024ul * 1024ul);
+};
+
+/**
+ * Gives the size of the next chunk to send, and measures the upload throughput.
+ *
+ * With the adaptive policy, the size is doubled after each chunk sent faster
+ * than the previous one (up to ```maxSize```), and halved (down to ```minSize```)
+ * each time a chunk has to be retried. After a retry, it does not grow again
+ * before ```HOLD_DOWN_CHUNKS``` chunks were sent.
+ * It may be shared by several connections of a same transfer.
+ */
+class ChunkSizer final
+{
+public:
+    typedef std::chrono::steady_clock::duration   Duration;
+    typedef std::chrono::steady_clock::time_point TimePoint;
+
+    static constexpr unsigned HOLD_DOWN_CHUNKS = 4u;
+
+public:
+    explicit
+    ChunkSizer (const ChunkSizing& sizing);
+
+    ChunkSizer()                             = delete;
+    ChunkSizer(const ChunkSizer&)            = delete;
+    ChunkSizer(ChunkSizer&&)                 = delete;
+    ChunkSizer& operator=(const ChunkSizer&) = delete;
+    ChunkSizer& operator=(ChunkSizer&&)      = delete;
+
+    uint64_t
+    size () const;
+
+    /**
+     * @param end when the chunk was acknowledged (it was sent during ```elapsed``` before).
+     */
+    void
+    onChunkSent (uint64_t bytes, Duration elapsed, TimePoint end = std::chrono::steady_clock::now());
+
+    void
+    onChunkRetry ();
+
+    /**
+     * @return the mean throughput of the sent chunks, in Bytes/s (0 if nothing was sent yet).
+     * The time is measured from the start of the first chunk to the end of the last one,
+     * so that the chunks sent at the same time are not counted twice.
+     */
+    uint64_t
+    throughput () const;
+
+    /**
+     * @return the throughput of the last sent chunk, in Bytes/s.
+     */
+    uint64_t
+    lastThroughput () const;
+
+private:
+    mutable std::mutex _mut;
+    const ChunkSizing  _sizing;
+    uint64_t           _size;
+    uint64_t           _lastRate;
+    unsigned           _holdDown;  // chunks to send before growing again
+    uint64_t           _sentBytes;
+    TimePoint          _firstStart;
+    TimePoint          _lastEnd;
+};
+
+} /* namespace details */
+} /* namespace giga */
+
+#endif /* GIGA_CORE_DETAILS_CHUNKSIZER_H_ */
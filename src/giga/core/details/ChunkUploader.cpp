@@ -15,11 +15,14 @@
  */
 
 #include "ChunkUploader.h"
+#include "CurlPool.h"
 #include "../../Application.h"
 #include "../../api/GigaApi.h"
 #include "../../api/data/Node.h"
 #include "../../rest/HttpErrors.h"
+#include "../../utils/SequentialFile.h"
 #include "../../utils/Utils.h"
+#include "../../utils/make_unique.h"
 
 #include <boost/filesystem.hpp>
 #include <boost/regex.hpp>
@@ -27,6 +30,8 @@
 #include <cpprest/http_client.h>
 #include <curl_easy.h>
 #include <pplx/pplxtasks.h>
+#include <chrono>
+#include <cstring>
 #include <iosfwd>
 #include <mutex>
 #include <string>
@@ -42,13 +47,17 @@ using web::uri;
 using web::uri_builder;
 using utility::string_t;
 using giga::utils::to_string;
+using giga::utils::AlignedBuffer;
+using giga::utils::FileIo;
+using giga::utils::IoMode;
+using giga::utils::SequentialFile;
 
 namespace
 {
 class ReadCallbackData
 {
 public:
-    explicit ReadCallbackData(const path filename);
+    ReadCallbackData(const path filename, giga::details::FileContent content, IoMode mode, std::shared_ptr<FileIo> io);
     ~ReadCallbackData();
     ReadCallbackData(const ReadCallbackData&)            = delete;
     ReadCallbackData(ReadCallbackData&&)                 = delete;
@@ -62,22 +71,36 @@ public:
     callback(char* buffer, size_t size, size_t nitems) noexcept;
 
 private:
-    std::ifstream  _file;
-    uint64_t       _start;
-    uint64_t       _end;
+    std::unique_ptr<SequentialFile> _file;    // nullptr when the content is in memory
+    giga::details::FileContent      _content; // read from memory when set
+    std::shared_ptr<FileIo>         _io;      // the blocks are read through it when set (not with IoMode::direct)
+    AlignedBuffer                   _block;   // IoMode::direct or FileIo only: curl's buffer is not aligned
+    std::size_t                     _blockStart;
+    std::size_t                     _blockEnd;
+    uint64_t                        _start;
+    uint64_t                        _end;
 };
 
-ReadCallbackData::ReadCallbackData (const path filename) :
-        _file{}, _start{0}, _end{0}
+ReadCallbackData::ReadCallbackData (const path filename, giga::details::FileContent content, IoMode mode, std::shared_ptr<FileIo> io) :
+        _file{nullptr}, _content{std::move(content)}, _io{_content == nullptr && mode != IoMode::direct ? std::move(io) : nullptr}, // O_DIRECT needs aligned offsets
+        _block{_content == nullptr && (mode == IoMode::direct || _io != nullptr) ? SequentialFile::DEFAULT_BLOCK_SIZE : 0u},
+        _blockStart{0u}, _blockEnd{0u}, _start{0}, _end{0}
 {
-    _file.open(filename.c_str(), std::fstream::binary);
+    if (_content == nullptr)
+    {
+        _file = giga::make_unique<SequentialFile>(filename, 0u, mode);
+    }
+    if (_io != nullptr)
+    {
+        _io->registerBuffer(_block.data(), _block.size());
+    }
 }
 
 ReadCallbackData::~ReadCallbackData ()
 {
-    if (_file.is_open())
+    if (_io != nullptr)
     {
-        _file.close();
+        _io->unregisterBuffer(_block.data());
     }
 }
 
@@ -86,7 +109,12 @@ ReadCallbackData::setChunck (uint64_t start, uint64_t end)
 {
     _start = start;
     _end = end;
-    _file.seekg(start);
+    if (_file != nullptr)
+    {
+        _file->seek(start); // the same file is used for every chunk
+        _blockStart = 0u;
+        _blockEnd   = 0u;
+    }
 }
 
 size_t
@@ -95,7 +123,49 @@ ReadCallbackData::callback (char* buffer, size_t size, size_t nitems) noexcept
     try
     {
         auto sizeToRead = std::min(size * nitems, static_cast<size_t>(_end - _start));
-        _file.read(buffer, sizeToRead);
+        if (_content != nullptr)
+        {
+            std::memcpy(buffer, _content->data() + _start, sizeToRead);
+        }
+        else if (_block.size() == 0u)
+        {
+            if (_file->read(reinterpret_cast<unsigned char*>(buffer), sizeToRead) != sizeToRead)
+            {
+                return CURL_READFUNC_ABORT; // the file was truncated
+            }
+        }
+        else
+        {
+            if (_blockStart == _blockEnd && sizeToRead > 0u)
+            {
+#ifndef _WIN32
+                if (_io != nullptr)
+                {
+                    auto size   = static_cast<size_t>(std::min<uint64_t>(_block.size(), _end - _start));
+                    _blockStart = 0u;
+                    _blockEnd   = _io->readAll(_file->descriptor(), _start, _block.data(), size);
+                }
+                else
+#endif
+                {
+                    // O_DIRECT: read the aligned blocks around the chunk, whatever its boundaries
+                    auto offset = static_cast<size_t>(_start % AlignedBuffer::ALIGNMENT);
+                    auto wanted = offset + static_cast<size_t>(std::min<uint64_t>(_block.size() - offset, _end - _start));
+                    auto size   = std::min(_block.size(), (wanted + AlignedBuffer::ALIGNMENT - 1u) / AlignedBuffer::ALIGNMENT * AlignedBuffer::ALIGNMENT);
+                    _file->seek(_start - offset);
+                    auto read   = _file->read(_block.data(), size);
+                    _blockStart = offset;
+                    _blockEnd   = std::max(offset, std::min(read, wanted));
+                }
+                if (_blockEnd == _blockStart)
+                {
+                    return CURL_READFUNC_ABORT;
+                }
+            }
+            sizeToRead = std::min(sizeToRead, _blockEnd - _blockStart);
+            std::memcpy(buffer, _block.data() + _blockStart, sizeToRead);
+            _blockStart += sizeToRead;
+        }
         _start += sizeToRead;
         return sizeToRead;
     }
@@ -125,6 +195,8 @@ namespace giga
 namespace details
 {
 
+constexpr uint64_t ChunkUploader::CHUNK_SIZE;
+
 ChunkUploader::ChunkUploader (web::uri_builder& uploadUrl, const string_t& nodeName, const std::string& sha1, const path& filename,
                               const string_t& mime, details::CurlProgress* progress, const Application& app) :
                _uploadUrl{uri_builder{uploadUrl}.append_query(U("access_token"), app.api().accessToken()).to_uri()},
@@ -134,63 +206,285 @@ ChunkUploader::ChunkUploader (web::uri_builder& uploadUrl, const string_t& nodeN
                _mime{mime},
                _fileSize{file_size(filename)},
                _progress{progress},
-               _app(&app)
+               _app(&app),
+               _parallelChunks{1u},
+               _sizer{std::make_shared<ChunkSizer>(ChunkSizing::fixed(CHUNK_SIZE))},
+               _resumePosition{0ul},
+               _onAcknowledgedFct{[](uint64_t){}},
+               _content{nullptr},
+               _ioMode{IoMode::cached},
+               _fileIo{nullptr},
+               _parallelMut{},
+               _session{},
+               _inFlight{0ul},
+               _parallelStop{false},
+               _parallelNode{nullptr},
+               _parallelError{nullptr}
+{
+}
+
+std::string
+ChunkUploader::sessionId (uint64_t userId, const std::string& sha1)
+{
+    return std::to_string(userId) + "-" + sha1;
+}
+
+void
+ChunkUploader::setParallelChunks (unsigned count)
+{
+    _parallelChunks = std::max(1u, count);
+}
+
+void
+ChunkUploader::setChunkSizer (std::shared_ptr<ChunkSizer> sizer)
+{
+    if (sizer != nullptr)
+    {
+        _sizer = std::move(sizer);
+    }
+}
+
+void
+ChunkUploader::setResumePosition (uint64_t position)
+{
+    _resumePosition = position;
+}
+
+void
+ChunkUploader::setOnAcknowledgedFct (OnAcknowledgedFct fct)
 {
+    _onAcknowledgedFct = fct;
+}
+
+void
+ChunkUploader::setIoMode (utils::IoMode mode)
+{
+    _ioMode = mode;
+}
+
+void
+ChunkUploader::setFileIo (std::shared_ptr<utils::FileIo> io)
+{
+    _fileIo = std::move(io);
+}
+
+void
+ChunkUploader::setContent (FileContent content)
+{
+    if (content != nullptr)
+    {
+        _fileSize = content->size();
+    }
+    _content = std::move(content);
 }
 
 std::shared_ptr<Node>
 ChunkUploader::upload ()
 {
-    auto position = 0ul;
-    do {
-        ReadCallbackData callbackData{_filename};
+    ReadCallbackData callbackData{_filename, _content, _ioMode, _fileIo};
+    std::ostringstream str;
+    curl_ios<std::ostringstream> writer(str);
+    auto lease = CurlPool::instance().lease(writer);
+    auto& curl = lease.curl();
 
-        std::ostringstream str;
-        curl_ios<std::ostringstream> writer(str);
-        curl_easy curl(writer);
+    auto position = _resumePosition < _fileSize ? _resumePosition : 0ul;
+    do {
         _progress->setCurl(curl);
 
-        auto response = sendChunk(position, callbackData, curl, str);
-        auto regex    = boost::regex{"^([0-9]+)-([0-9]+)/([0-9]+).*"};
-        auto what     = boost::cmatch{};
-        auto resp     = utils::wstr2str(response);
-        if(boost::regex_match(resp.c_str(), what, regex))
+        auto reply = parseReply(sendChunk(position, chunkSize(position), callbackData, curl, str));
+        if (reply.node != nullptr)
+        {
+            GIGA_DEBUG_LOG(debug, "Uploaded " << _fileSize << " bytes at " << _sizer->throughput() << " B/s");
+            return reply.node;
+        }
+        position = _session.onSerialReply(reply.start, reply.end);
+        if (_session.tooManyRestarts())
+        {
+            BOOST_THROW_EXCEPTION(ErrorException{U("Upload error: the server keeps losing the file")});
+        }
+        _onAcknowledgedFct(position);
+
+        if (_parallelChunks > 1 && !_session.serialOnly() && position > 0 && position < _fileSize)
         {
-            auto start = std::stoul(string_t{what[1].first, what[1].second});
-            auto end = std::stoul(string_t{what[2].first, what[2].second});
-            if (start > 0 && end > start)
+            _progress->resetCurl(); // the parallel workers handle pause themselves
+            auto node = uploadParallel(position);
+            if (node != nullptr)
             {
-                position = 0;
+                GIGA_DEBUG_LOG(debug, "Uploaded " << _fileSize << " bytes at " << _sizer->throughput() << " B/s");
+                return node;
             }
-            else
+            std::lock_guard<std::mutex> l{_parallelMut};
+            position = _session.acked().contiguousEnd();
+            if (_session.tooManyRestarts())
             {
-                position = end;
+                BOOST_THROW_EXCEPTION(ErrorException{U("Upload error: the server keeps losing the file")});
             }
         }
-        else
+    } while (position < _fileSize);
+
+    BOOST_THROW_EXCEPTION(ErrorException{U("Upload error")});
+}
+
+ChunkUploader::Reply
+ChunkUploader::parseReply (const string_t& response) const
+{
+    auto regex    = boost::regex{"^([0-9]+)-([0-9]+)/([0-9]+).*"};
+    auto what     = boost::cmatch{};
+    auto resp     = utils::wstr2str(response);
+    if(boost::regex_match(resp.c_str(), what, regex))
+    {
+        auto start = std::stoul(std::string{what[1].first, what[1].second});
+        auto end = std::stoul(std::string{what[2].first, what[2].second});
+        return Reply{nullptr, start, end};
+    }
+
+    try
+    {
+        auto nodes = JSonUnserializer::fromString<std::vector<std::shared_ptr<Node>>>(response);
+        if (nodes.size() != 1)
         {
-            try
+            BOOST_THROW_EXCEPTION(ErrorException{U("Wrong number of nodes")});
+        }
+        return Reply{nodes[0], 0ul, _fileSize};
+    }
+    catch (const web::json::json_exception& e)
+    {
+        GIGA_DEBUG_LOG(error, "Error parsing: " << resp);
+        throw;
+    }
+}
+
+uint64_t
+ChunkUploader::chunkSize (uint64_t position) const
+{
+    return std::min(position == 0 ? 1024 : _sizer->size(), _fileSize - position);
+}
+
+std::shared_ptr<Node>
+ChunkUploader::uploadParallel (uint64_t position)
+{
+    {
+        std::lock_guard<std::mutex> l{_parallelMut};
+        _session.startParallel(position);
+        _inFlight      = 0ul;
+        _parallelStop  = false;
+        _parallelNode  = nullptr;
+        _parallelError = nullptr;
+    }
+    _progress->setUploadPosition(0);
+
+    std::vector<pplx::task<void>> workers;
+    for (auto i = 0u; i < _parallelChunks; ++i)
+    {
+        workers.push_back(pplx::create_task([this] {
+            parallelWorker();
+        }));
+    }
+    pplx::when_all(workers.begin(), workers.end()).wait();
+
+    std::lock_guard<std::mutex> l{_parallelMut};
+    if (_parallelError != nullptr)
+    {
+        std::rethrow_exception(_parallelError);
+    }
+    return _parallelNode;
+}
+
+void
+ChunkUploader::parallelWorker ()
+{
+    ChunkSlot slot{this, 0ul};
+    try
+    {
+        ReadCallbackData callbackData{_filename, _content, _ioMode, _fileIo};
+        std::ostringstream str;
+        curl_ios<std::ostringstream> writer(str);
+        auto lease = CurlPool::instance().lease(writer);
+        auto& curl = lease.curl();
+
+        while (true)
+        {
+            uint64_t position = 0ul;
+            uint64_t size     = 0ul;
+            {
+                std::lock_guard<std::mutex> l{_parallelMut};
+                // the chunks in flight are left to their worker, which sends again what the server did not keep
+                auto gap = _session.nextGap(_fileSize);
+                if (_parallelStop || gap.first >= _fileSize)
+                {
+                    return;
+                }
+                position = gap.first;
+                size     = std::min(chunkSize(position), gap.second - gap.first);
+                _session.sending(position, position + size);
+            }
+
+            auto reply = parseReply(sendChunk(position, size, callbackData, curl, str, &slot));
+
+            uint64_t acknowledged = 0ul;
             {
-                auto nodes = JSonUnserializer::fromString<std::vector<std::shared_ptr<Node>>>(response);
-                if (nodes.size() != 1)
+                std::lock_guard<std::mutex> l{_parallelMut};
+                _inFlight -= slot.sent;
+                slot.sent = 0ul;
+                if (reply.node != nullptr)
                 {
-                    BOOST_THROW_EXCEPTION(ErrorException{U("Wrong number of nodes")});
+                    _parallelNode = reply.node;
+                    _parallelStop = true;
+                }
+                else if (!_session.onParallelReply(position, position + size, reply.start, reply.end))
+                {
+                    _parallelStop = true; // restart at 0, one chunk after the other
+                }
+                else
+                {
+                    acknowledged = _session.acked().contiguousEnd();
                 }
-                return nodes[0];
             }
-            catch (const web::json::json_exception& e)
+            if (reply.node == nullptr)
             {
-                GIGA_DEBUG_LOG(error, "Error parsing: " << resp);
-                throw;
+                _onAcknowledgedFct(acknowledged);
             }
         }
-    } while (position < _fileSize);
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> l{_parallelMut};
+        _inFlight -= slot.sent;
+        if (_parallelError == nullptr)
+        {
+            _parallelError = std::current_exception();
+        }
+        _parallelStop = true;
+    }
+}
 
-    BOOST_THROW_EXCEPTION(ErrorException{U("Upload error")});
+int
+ChunkUploader::onParallelProgress (ChunkSlot& slot, uint64_t ulnow) noexcept
+{
+    // The shared CurlProgress only knows about one curl handle:
+    // pause here by holding the callback instead of pausing the handle.
+    while (_progress->isPaused() && !_progress->isCanceled())
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+
+    std::lock_guard<std::mutex> l{_parallelMut};
+    _inFlight -= slot.sent;
+    _inFlight += ulnow;
+    slot.sent  = ulnow;
+    auto total = static_cast<curl_off_t>(_session.acked().acknowledged() + _inFlight);
+    return _progress->onCallback(0, 0, static_cast<curl_off_t>(_fileSize), total);
+}
+
+int
+ChunkUploader::parallelProgressCallback (void* clientp, curl_off_t, curl_off_t, curl_off_t, curl_off_t ulnow)
+{
+    auto slot = static_cast<ChunkSlot*>(clientp);
+    return slot->uploader->onParallelProgress(*slot, static_cast<uint64_t>(ulnow));
 }
 
 string_t
-ChunkUploader::sendChunk (uint64_t position, ReadCallbackData& data, curl_easy& curl, std::ostringstream& str)
+ChunkUploader::sendChunk (uint64_t position, uint64_t size, ReadCallbackData& data, curl_easy& curl, std::ostringstream& str, ChunkSlot* slot)
 {
     if (position >= _fileSize)
     {
@@ -203,7 +497,13 @@ ChunkUploader::sendChunk (uint64_t position, ReadCallbackData& data, curl_easy&
         try
         {
             count++;
-            return doSendChunk(position, data, curl, str);
+            auto start = std::chrono::steady_clock::now();
+            auto reply = doSendChunk(position, size, data, curl, str, slot);
+            if (position > 0) // the first chunk is too small to be meaningful
+            {
+                _sizer->onChunkSent(size, std::chrono::steady_clock::now() - start);
+            }
+            return reply;
         }
         catch (const curl::curl_easy_exception& ex)
         {
@@ -211,6 +511,7 @@ ChunkUploader::sendChunk (uint64_t position, ReadCallbackData& data, curl_easy&
             {
                 throw;
             }
+            _sizer->onChunkRetry();
             auto info = utils::exceptionInfos();
             GIGA_DEBUG_LOG(debug, info + " retry in (s) " + std::to_string(count));
             std::this_thread::sleep_for(std::chrono::milliseconds(1000 * count));
@@ -221,6 +522,7 @@ ChunkUploader::sendChunk (uint64_t position, ReadCallbackData& data, curl_easy&
             {
                 throw;
             }
+            _sizer->onChunkRetry();
             auto info = utils::exceptionInfos();
             GIGA_DEBUG_LOG(debug, info + " retry in (s) " + std::to_string(count));
             std::this_thread::sleep_for(std::chrono::milliseconds(1000 * count));
@@ -229,12 +531,15 @@ ChunkUploader::sendChunk (uint64_t position, ReadCallbackData& data, curl_easy&
 }
 
 string_t
-ChunkUploader::doSendChunk (uint64_t position, ReadCallbackData& data, curl_easy& curl, std::ostringstream& str)
+ChunkUploader::doSendChunk (uint64_t position, uint64_t chunkSize, ReadCallbackData& data, curl_easy& curl, std::ostringstream& str, ChunkSlot* slot)
 {
-    _progress->setUploadPosition(position);
-
-    auto chunkSize = std::min(position == 0 ? 1024 : CHUNK_SIZE, _fileSize - position);
+    if (slot == nullptr)
+    {
+        _progress->setUploadPosition(position);
+    }
     data.setChunck(position, position + chunkSize);
+    str.str("");
+    str.clear();
 
     {
         auto upUri = utils::wstr2str(_uploadUrl.to_uri().to_string());
@@ -245,8 +550,16 @@ ChunkUploader::doSendChunk (uint64_t position, ReadCallbackData& data, curl_easy
     curl.add<CURLOPT_SSL_VERIFYPEER>(0L);
 //#endif
     curl.add<CURLOPT_FOLLOWLOCATION>(1L);
-    curl.add<CURLOPT_XFERINFOFUNCTION>(curlProgressCallback);
-    curl.add<CURLOPT_PROGRESSDATA>(_progress);
+    if (slot == nullptr)
+    {
+        curl.add<CURLOPT_XFERINFOFUNCTION>(curlProgressCallback);
+        curl.add<CURLOPT_PROGRESSDATA>(_progress);
+    }
+    else
+    {
+        curl.add<CURLOPT_XFERINFOFUNCTION>(&ChunkUploader::parallelProgressCallback);
+        curl.add<CURLOPT_PROGRESSDATA>(slot);
+    }
     curl.add<CURLOPT_NOPROGRESS>(0L);
 
     curl.add<CURLOPT_POST>(1L);
@@ -261,7 +574,7 @@ ChunkUploader::doSendChunk (uint64_t position, ReadCallbackData& data, curl_easy
     try {
         {
             auto hcontentDisposition = "Content-Disposition: attachment, filename=\"" + utils::wstr2str(web::uri::encode_data_string(_nodeName)) + "\"";
-            auto hSession            = "Session-Id: " + std::to_string(userId) + "-" + _sha1;
+            auto hSession            = "Session-Id: " + sessionId(userId, _sha1);
             auto hcontentRange       = "Content-Range: bytes " + std::to_string(position) + "-" + std::to_string(chunkSize - 1 + position) + "/" + std::to_string(_fileSize);
             auto hcontentType        = "Content-Type: application/octet-stream";
             list = curl_slist_append(list, hcontentDisposition.c_str());
@@ -18,12 +18,21 @@
 #define GIGA_API_CHUNKUPLOADER_H_
 
 #include "ChunkUploader.h"
+#include "ChunkSession.h"
+#include "ChunkSizer.h"
 #include "CurlProgress.h"
+#include "FileBufferPool.h"
+#include "../../utils/FileIo.h"
+#include "../../utils/PageCache.h"
 
 #include <cpprest/http_client.h>
 #include <iosfwd>
 #include <cpprest/details/basic_types.h>
 #include <boost/filesystem.hpp>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
 
 namespace
 {
@@ -52,6 +61,14 @@ class ChunkUploader
 public:
     static constexpr uint64_t CHUNK_SIZE = 1024ul * 1024ul;
 
+    typedef std::function<void(uint64_t)> OnAcknowledgedFct;
+
+    /**
+     * @brief The Session-Id of the upload of ```sha1``` by ```userId```: the server resumes the uploads by it.
+     */
+    static std::string
+    sessionId (uint64_t userId, const std::string& sha1);
+
     explicit
     ChunkUploader (web::uri_builder& uploadUrl, const utility::string_t& nodeName, const std::string& sha1,
                    const boost::filesystem::path& filename, const utility::string_t& mime, CurlProgress* progress,
@@ -66,12 +83,92 @@ public:
     std::shared_ptr<data::Node>
     upload ();
 
+    /**
+     * @brief Send up to ```count``` chunks of the file at the same time.
+     *
+     * The first chunk is always sent alone (it opens the upload session).
+     * Then each chunk is sent on its own connection, with the same Session-Id.
+     * If the server loses the beginning of the file, the upload restarts at 0 without parallel chunks.
+     * Defaults to 1 (chunks are sent one after the other).
+     */
+    void
+    setParallelChunks (unsigned count);
+
+    /**
+     * @brief Use ```sizer``` to choose the chunk sizes (a fixed 1 MiB by default).
+     * Sharing it between the retries of a same file keeps the learned size.
+     */
+    void
+    setChunkSizer (std::shared_ptr<ChunkSizer> sizer);
+
+    /**
+     * @brief Start the upload at ```position``` (the bytes already acknowledged by the server for this session).
+     * The server reply to the first chunk tells if the upload really resumes, or restarts at 0.
+     */
+    void
+    setResumePosition (uint64_t position);
+
+    /**
+     * @param fct called with the end of the range acknowledged by the server (from 0), after each chunk.
+     */
+    void
+    setOnAcknowledgedFct (OnAcknowledgedFct fct);
+
+    /**
+     * @brief Send ```content``` (the whole file, already in memory) instead of reading the file.
+     */
+    void
+    setContent (FileContent content);
+
+    /**
+     * @brief Set how the file is read (default: ```utils::IoMode::cached```).
+     */
+    void
+    setIoMode (utils::IoMode mode);
+
+    /**
+     * @brief Read the chunks through ```io``` (default: nullptr, blocking reads).
+     */
+    void
+    setFileIo (std::shared_ptr<utils::FileIo> io);
+
 private:
+    struct Reply
+    {
+        std::shared_ptr<data::Node> node;
+        uint64_t                    start;
+        uint64_t                    end;
+    };
+
+    struct ChunkSlot
+    {
+        ChunkUploader* uploader;
+        uint64_t       sent; // guarded by _parallelMut
+    };
+
+    Reply
+    parseReply (const utility::string_t& response) const;
+
+    uint64_t
+    chunkSize (uint64_t position) const;
+
+    std::shared_ptr<data::Node>
+    uploadParallel (uint64_t position);
+
+    void
+    parallelWorker ();
+
+    int
+    onParallelProgress (ChunkSlot& slot, uint64_t ulnow) noexcept;
+
+    static int
+    parallelProgressCallback (void* clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow);
+
     utility::string_t
-    sendChunk (uint64_t position, ReadCallbackData& data, curl::curl_easy& curl, std::ostringstream& str);
+    sendChunk (uint64_t position, uint64_t size, ReadCallbackData& data, curl::curl_easy& curl, std::ostringstream& str, ChunkSlot* slot = nullptr);
 
     utility::string_t
-    doSendChunk (uint64_t position, ReadCallbackData& data, curl::curl_easy& curl, std::ostringstream& str);
+    doSendChunk (uint64_t position, uint64_t size, ReadCallbackData& data, curl::curl_easy& curl, std::ostringstream& str, ChunkSlot* slot);
 
 private:
     web::uri_builder        _uploadUrl;
@@ -82,6 +179,21 @@ private:
     uint64_t                _fileSize;
     CurlProgress*           _progress;
     const Application*      _app;
+    unsigned                _parallelChunks;
+    std::shared_ptr<ChunkSizer> _sizer;
+    uint64_t                _resumePosition;
+    OnAcknowledgedFct       _onAcknowledgedFct;
+    FileContent             _content;
+    utils::IoMode           _ioMode;
+    std::shared_ptr<utils::FileIo> _fileIo;
+
+    // state shared by the parallel chunk workers (guarded by _parallelMut)
+    std::mutex                  _parallelMut;
+    ChunkSession                _session;
+    uint64_t                    _inFlight;
+    bool                        _parallelStop;
+    std::shared_ptr<data::Node> _parallelNode;
+    std::exception_ptr          _parallelError;
 };
 
 } /* namespace details */
@@ -0,0 +1,144 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CurlPool.h"
+
+#include <utility>
+
+namespace
+{
+// more handles than that are closed when given back.
+constexpr std::size_t MAX_IDLE_HANDLES = 32u;
+}
+
+namespace giga
+{
+namespace details
+{
+
+CurlPool::Lease::Lease (CurlPool& pool, std::unique_ptr<curl::curl_easy> curl) :
+        _pool{&pool},
+        _curl{std::move(curl)}
+{
+}
+
+CurlPool::Lease::Lease (Lease&& other) :
+        _pool{other._pool},
+        _curl{std::move(other._curl)}
+{
+}
+
+CurlPool::Lease::~Lease ()
+{
+    if (_curl != nullptr)
+    {
+        _pool->release(std::move(_curl));
+    }
+}
+
+curl::curl_easy&
+CurlPool::Lease::curl ()
+{
+    return *_curl;
+}
+
+CurlPool&
+CurlPool::instance ()
+{
+    static CurlPool pool;
+    return pool;
+}
+
+CurlPool::CurlPool () :
+        _mut{},
+        _idle{},
+        _share{nullptr},
+        _shareMut{}
+{
+    curl_global_init(CURL_GLOBAL_ALL);
+    _share = curl_share_init();
+    curl_share_setopt(_share, CURLSHOPT_LOCKFUNC, &CurlPool::lockShare);
+    curl_share_setopt(_share, CURLSHOPT_UNLOCKFUNC, &CurlPool::unlockShare);
+    curl_share_setopt(_share, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    // not CURL_LOCK_DATA_CONNECT: sharing the connection cache between threads is not supported by libcurl.
+    // Each leased handle keeps its own live connections instead.
+}
+
+CurlPool::~CurlPool ()
+{
+    // the handles must be closed before the share they use.
+    _idle.clear();
+    curl_share_cleanup(_share);
+    curl_global_cleanup();
+}
+
+CurlPool::Lease
+CurlPool::lease ()
+{
+    std::unique_ptr<curl::curl_easy> curl;
+    {
+        std::lock_guard<std::mutex> l{_mut};
+        if (!_idle.empty())
+        {
+            curl = std::move(_idle.back());
+            _idle.pop_back();
+        }
+    }
+    if (curl == nullptr)
+    {
+        curl.reset(new curl::curl_easy{});
+    }
+
+    // curl_easy_reset() keeps the live connections and the caches.
+    curl->reset();
+    curl_easy_setopt(curl->get_curl(), CURLOPT_SHARE, _share);
+    curl_easy_setopt(curl->get_curl(), CURLOPT_TCP_KEEPALIVE, 1L);
+    return Lease{*this, std::move(curl)};
+}
+
+std::size_t
+CurlPool::idleCount () const
+{
+    std::lock_guard<std::mutex> l{_mut};
+    return _idle.size();
+}
+
+void
+CurlPool::release (std::unique_ptr<curl::curl_easy> curl)
+{
+    std::lock_guard<std::mutex> l{_mut};
+    if (_idle.size() < MAX_IDLE_HANDLES)
+    {
+        _idle.push_back(std::move(curl));
+    }
+}
+
+void
+CurlPool::lockShare (CURL*, curl_lock_data data, curl_lock_access, void* userptr)
+{
+    static_cast<CurlPool*>(userptr)->_shareMut[static_cast<std::size_t>(data)].lock();
+}
+
+void
+CurlPool::unlockShare (CURL*, curl_lock_data data, void* userptr)
+{
+    static_cast<CurlPool*>(userptr)->_shareMut[static_cast<std::size_t>(data)].unlock();
+}
+
+} /* namespace details */
+} /* namespace giga */
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GIGA_CORE_DETAILS_CURLPOOL_H_
+#define GIGA_CORE_DETAILS_CURLPOOL_H_
+
+#include <curl/curl.h>
+#include <curl_easy.h>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace giga
+{
+namespace details
+{
+
+/**
+ * A process wide pool of curl handles.
+ *
+ * Every handle is bound to the same curl share object (DNS cache and TLS sessions).
+ * The handles are reused, and each one keeps its own connection cache, so the
+ * connections stay alive across chunks, files and ```Uploader```/```Downloader``` instances.
+ *
+ * Usage:
+ * ```
+ * auto lease = CurlPool::instance().lease(writer);
+ * lease.curl().add<CURLOPT_URL>(url);
+ * lease.curl().perform();
+ * ```
+ */
+class CurlPool final
+{
+public:
+    /**
+     * A leased handle, given back to the pool when destroyed.
+     */
+    class Lease final
+    {
+    public:
+        Lease (CurlPool& pool, std::unique_ptr<curl::curl_easy> curl);
+        ~Lease ();
+        Lease (Lease&& other);
+
+        Lease()                        = delete;
+        Lease(const Lease&)            = delete;
+        Lease& operator=(const Lease&) = delete;
+        Lease& operator=(Lease&&)      = delete;
+
+        curl::curl_easy&
+        curl ();
+
+    private:
+        CurlPool*                        _pool;
+        std::unique_ptr<curl::curl_easy> _curl;
+    };
+
+public:
+    static CurlPool&
+    instance ();
+
+    CurlPool(const CurlPool&)            = delete;
+    CurlPool(CurlPool&&)                 = delete;
+    CurlPool& operator=(const CurlPool&) = delete;
+    CurlPool& operator=(CurlPool&&)      = delete;
+
+    /**
+     * @brief Lease a handle with its default options (and the shared caches).
+     */
+    Lease
+    lease ();
+
+    /**
+     * @brief Lease a handle writing its responses in ```writer```.
+     */
+    template <typename T>
+    Lease
+    lease (curl::curl_ios<T>& writer)
+    {
+        auto l = lease();
+        l.curl().add<CURLOPT_WRITEFUNCTION>(writer.get_function());
+        l.curl().add<CURLOPT_WRITEDATA>(static_cast<void*>(writer.get_stream()));
+        return l;
+    }
+
+    /**
+     * @return the number of handles waiting to be leased.
+     */
+    std::size_t
+    idleCount () const;
+
+private:
+    CurlPool ();
+    ~CurlPool ();
+
+    void
+    release (std::unique_ptr<curl::curl_easy> curl);
+
+    static void
+    lockShare (CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr);
+
+    static void
+    unlockShare (CURL* handle, curl_lock_data data, void* userptr);
+
+private:
+    mutable std::mutex                            _mut;
+    std::vector<std::unique_ptr<curl::curl_easy>> _idle;
+    CURLSH*                                       _share;
+    std::array<std::mutex, CURL_LOCK_DATA_LAST>   _shareMut;
+};
+
+} /* namespace details */
+} /* namespace giga */
+
+#endif /* GIGA_CORE_DETAILS_CURLPOOL_H_ */
@@ -15,6 +15,7 @@
  */
 
 #include "CurlProgress.h"
+#include "ProgressNotifier.h"
 #include "../../rest/HttpErrors.h"
 
 #include <curl_easy.h>
@@ -31,55 +32,62 @@ namespace details
 {
 
 CurlProgress::CurlProgress (pplx::cancellation_token token) :
-        _mut{}, _item{0ul, 0ul, 0ul, 0ul}, _cancelToken{token}, _pause{false}, _isPaused{false}, _curl{nullptr},
+        _mut{}, _dltotal{0ul}, _dlnow{0ul}, _ultotal{0ul}, _ulnow{0ul}, _cancelToken{token}, _pause{false}, _isPaused{false},
+        _curl{nullptr}, _notifier{nullptr},
         _limitRate{0ul}, _currentLimitRate{0ul}, _rateTime{}, _rateBytes{0ul}, _bucket{0ul}, _upPostion{0ul}
 {
 }
 
 CurlProgress::CurlProgress (const CurlProgress& other) :
         _mut{},
-        _item{other._item.dltotal, other._item.dlnow, other._item.ultotal, other._item.ulnow},
+        _dltotal{other._dltotal.load()},
+        _dlnow{other._dlnow.load()},
+        _ultotal{other._ultotal.load()},
+        _ulnow{other._ulnow.load()},
         _cancelToken{other._cancelToken},
-        _pause{other._pause},
-        _isPaused{other._isPaused},
+        _pause{other._pause.load()},
+        _isPaused{other._isPaused.load()},
         _curl{other._curl},
-        _limitRate{other._limitRate},
+        _notifier{other._notifier},
+        _limitRate{other._limitRate.load()},
         _currentLimitRate{other._currentLimitRate},
         _rateTime{other._rateTime},
         _rateBytes{other._rateBytes},
         _bucket{other._bucket},
-        _upPostion{other._upPostion}
+        _upPostion{other._upPostion.load()}
 {
 }
 
 CurlProgress::Item
 CurlProgress::data () const
 {
-    std::lock_guard<std::mutex> l(_mut);
-    return _item;
+    return Item{_dltotal.load(), _dlnow.load(), _ultotal.load(), _ulnow.load()};
 }
 
 void
 CurlProgress::setPause (bool pause)
 {
-    std::lock_guard<std::mutex> l(_mut);
     _pause = pause;
 }
 
 void
 CurlProgress::setUploadPosition (uint64_t pos)
 {
-    std::lock_guard<std::mutex> l(_mut);
     _upPostion = pos;
 }
 
 void
 CurlProgress::setLimitRate (uint64_t rate)
 {
-    std::lock_guard<std::mutex> l(_mut);
     _limitRate = rate;
 }
 
+void
+CurlProgress::setNotifier (std::shared_ptr<ProgressNotifier> notifier)
+{
+    _notifier = std::move(notifier);
+}
+
 void
 CurlProgress::setCurl (curl::curl_easy& curl)
 {
@@ -87,44 +95,65 @@ CurlProgress::setCurl (curl::curl_easy& curl)
     _curl = &curl;
 }
 
+void
+CurlProgress::resetCurl ()
+{
+    std::lock_guard<std::mutex> l(_mut);
+    _curl = nullptr;
+}
+
 bool
 CurlProgress::isPaused () const
 {
-    std::lock_guard<std::mutex> l(_mut);
     return _pause;
 }
 
 bool
 CurlProgress::isCanceled () const
 {
-    std::lock_guard<std::mutex> l(_mut);
     return _cancelToken.is_canceled();
 }
 
+void
+CurlProgress::update (std::atomic<uint64_t>& counter, uint64_t value, bool& changed) noexcept
+{
+    if (counter.load(std::memory_order_relaxed) != value)
+    {
+        counter.store(value, std::memory_order_relaxed);
+        changed = true;
+    }
+}
+
 int
 CurlProgress::onCallback (curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow) noexcept
 {
     try {
-        uint64_t limitRate = 0;
+        uint64_t limitRate  = _limitRate;
+        uint64_t upPosition = _upPostion;
+
+        auto changed = false;
+        update(_dltotal, static_cast<uint64_t>(dltotal), changed);
+        update(_dlnow,   static_cast<uint64_t>(dlnow), changed);
+        update(_ultotal, static_cast<uint64_t>(ultotal) + upPosition, changed);
+        update(_ulnow,   static_cast<uint64_t>(ulnow) + upPosition, changed);
+        if (changed && _notifier != nullptr)
         {
-            std::lock_guard<std::mutex> l(_mut);
-            limitRate = _limitRate;
-
-            _item.dltotal = static_cast<uint64_t>(dltotal);
-            _item.dlnow   = static_cast<uint64_t>(dlnow);
-            _item.ultotal = static_cast<uint64_t>(ultotal + _upPostion);
-            _item.ulnow   = static_cast<uint64_t>(ulnow + _upPostion);
+            _notifier->notify();
+        }
 
+        if (_pause != _isPaused)
+        {
+            std::lock_guard<std::mutex> l(_mut);
             if (_pause != _isPaused && _curl != nullptr)
             {
-                _curl->pause(_pause ? CURLPAUSE_ALL : CURLPAUSE_CONT);
-                _isPaused = _pause;
-            }
-            if (_cancelToken.is_canceled())
-            {
-                return CURLE_ABORTED_BY_CALLBACK;
+                _isPaused = _pause.load();
+                _curl->pause(_isPaused ? CURLPAUSE_ALL : CURLPAUSE_CONT);
             }
         }
+        if (_cancelToken.is_canceled())
+        {
+            return CURLE_ABORTED_BY_CALLBACK;
+        }
 
         // Do the limit rate outside of the mutex locked zone
         // because there is waiting here.
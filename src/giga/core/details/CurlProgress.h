@@ -17,7 +17,9 @@
 #ifndef GIGA_CORE_DETAILS_CURLPROGRESS_H_
 #define GIGA_CORE_DETAILS_CURLPROGRESS_H_
 
+#include <atomic>
 #include <chrono>
+#include <memory>
 #include <mutex>
 #include <curl/system.h>
 #include <pplx/pplxtasks.h>
@@ -31,7 +33,13 @@ namespace giga
 {
 namespace details
 {
+class ProgressNotifier;
 
+/**
+ * The progress of a transfer, updated by the libcurl callbacks.
+ *
+ * The counters are atomic: reading them (```data()```) never waits for the transfer.
+ */
 class CurlProgress
 {
 public:
@@ -71,9 +79,21 @@ public:
     void
     setLimitRate (uint64_t rate);
 
+    /**
+     * @param notifier notified when the counters change. Must be set before the transfer starts.
+     */
+    void
+    setNotifier (std::shared_ptr<ProgressNotifier> notifier);
+
     void
     setCurl (curl::curl_easy& curl);
 
+    /**
+     * Forget the curl handle given to ```setCurl()``` (before it gets destroyed).
+     */
+    void
+    resetCurl ();
+
     bool
     isPaused () const;
 
@@ -81,21 +101,29 @@ public:
     isCanceled() const;
 
 private:
-    mutable std::mutex       _mut;
-    Item                     _item;
+    void
+    update (std::atomic<uint64_t>& counter, uint64_t value, bool& changed) noexcept;
+
+private:
+    mutable std::mutex       _mut;     // guards _curl
+    std::atomic<uint64_t>    _dltotal;
+    std::atomic<uint64_t>    _dlnow;
+    std::atomic<uint64_t>    _ultotal;
+    std::atomic<uint64_t>    _ulnow;
     pplx::cancellation_token _cancelToken;
-    bool                     _pause;
-    bool                     _isPaused;
+    std::atomic<bool>        _pause;
+    std::atomic<bool>        _isPaused;
     curl::curl_easy*         _curl;
+    std::shared_ptr<ProgressNotifier> _notifier;
 
     typedef std::chrono::high_resolution_clock::time_point Time;
-    uint64_t   _limitRate;
+    std::atomic<uint64_t> _limitRate;
     uint64_t   _currentLimitRate;
     Time       _rateTime;
     uint64_t   _rateBytes;
     uint64_t   _bucket;
 
-    uint64_t   _upPostion;
+    std::atomic<uint64_t> _upPostion;
 
 };
 
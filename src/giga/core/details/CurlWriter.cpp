@@ -15,11 +15,20 @@
  */
 
 #include "CurlWriter.h"
+#include "../../rest/HttpErrors.h"
 #include "../../utils/Utils.h"
 
 #include <curl_easy.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <ios>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 using utility::string_t;
 using giga::utils::str2wstr;
 
@@ -28,18 +37,93 @@ namespace giga
 namespace details
 {
 
-CurlWriter::CurlWriter (const boost::filesystem::path& path) :
-        _file{}, _stream{}, _curl{nullptr}, _httpCode{0}
+constexpr std::size_t CurlWriter::BLOCK_SIZE;
+constexpr std::size_t CurlWriter::DEPTH;
+
+CurlWriter::CurlWriter (const boost::filesystem::path& path, utils::IoMode mode, std::shared_ptr<utils::FileIo> io) :
+        _file{}, _stream{}, _curl{nullptr}, _httpCode{0}, _fd{-1}, _unflushed{0u}, _dropper{},
+        _io{nullptr}, _blocks{}, _pending{}, _current{0u}, _filled{0u}, _position{0u}, _synced{0u}, _error{0},
+        _mut{}, _written{}
 {
+#ifndef _WIN32
+    if (io != nullptr)
+    {
+        _fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        auto end = _fd >= 0 ? ::lseek(_fd, 0, SEEK_END) : -1;
+        if (end < 0)
+        {
+            auto error = errno;
+            if (_fd >= 0)
+            {
+                ::close(_fd);
+            }
+            BOOST_THROW_EXCEPTION(ErrorException{U("Cannot open ") + path.native() + U(": ") + str2wstr(std::strerror(error))});
+        }
+        _position = static_cast<uint64_t>(end);
+        _synced   = _position;
+        _io       = std::move(io);
+        for (std::size_t i = 0u; i < DEPTH; ++i)
+        {
+            _blocks.emplace_back(BLOCK_SIZE);
+            _io->registerBuffer(_blocks.back().data(), BLOCK_SIZE);
+        }
+        _pending.assign(DEPTH, 0);
+        if (mode != utils::IoMode::cached)
+        {
+            _dropper.attach(_fd, _position, true);
+        }
+        return;
+    }
+#else
+    (void) io;
+#endif
     _file.open(path.native(), std::ios::binary | std::ios::app);
+#ifndef _WIN32
+    if (mode != utils::IoMode::cached && _file.is_open())
+    {
+        // a second descriptor on the same file, only to drop its pages
+        _fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+        if (_fd >= 0)
+        {
+            boost::system::error_code ec;
+            auto size = boost::filesystem::file_size(path, ec);
+            _dropper.attach(_fd, ec ? 0u : static_cast<uint64_t>(size), true);
+        }
+    }
+#else
+    (void) mode;
+#endif
 }
 
 CurlWriter::~CurlWriter ()
 {
+    if (_io != nullptr)
+    {
+        try
+        {
+            submitBlock(); // what was received is kept, to resume the download
+        }
+        catch (...)
+        {
+        }
+        for (std::size_t i = 0u; i < DEPTH; ++i)
+        {
+            wait(i);
+            _io->unregisterBuffer(_blocks[i].data());
+        }
+    }
     if (_file.is_open())
     {
         _file.close();
     }
+#ifndef _WIN32
+    if (_fd >= 0)
+    {
+        _dropper.advance(_unflushed);
+        _dropper.flush();
+        ::close(_fd);
+    }
+#endif
 }
 
 size_t
@@ -62,9 +146,35 @@ CurlWriter::write (const char * contents, size_t size) noexcept
         {
             _stream.write(contents, size);
         }
+        else if (_io != nullptr)
+        {
+            for (std::size_t copied = 0u; copied < size; )
+            {
+                auto count = std::min(size - copied, BLOCK_SIZE - _filled);
+                std::memcpy(_blocks[_current].data() + _filled, contents + copied, count);
+                _filled += count;
+                copied  += count;
+                if (_filled == BLOCK_SIZE)
+                {
+                    submitBlock();
+                }
+            }
+            std::lock_guard<std::mutex> l(_mut);
+            if (_error != 0)
+            {
+                throw _error;
+            }
+        }
         else
         {
             _file.write(contents, size);
+            _unflushed += size;
+            if (_fd >= 0 && _unflushed >= utils::PageCacheDropper::WINDOW)
+            {
+                _file.flush();
+                _dropper.advance(_unflushed);
+                _unflushed = 0u;
+            }
         }
         return size;
     }
@@ -91,6 +201,103 @@ CurlWriter::file()
     return _file;
 }
 
+uint64_t
+CurlWriter::position () const
+{
+    if (_io != nullptr)
+    {
+        return _position + _filled;
+    }
+    auto pos = const_cast<std::ofstream&>(_file).tellp();
+    return pos < 0 ? 0u : static_cast<uint64_t>(pos);
+}
+
+void
+CurlWriter::finish ()
+{
+    if (_io == nullptr)
+    {
+        _file.flush();
+        if (!_file)
+        {
+            BOOST_THROW_EXCEPTION(ErrorException{U("Cannot write the downloaded file")});
+        }
+        return;
+    }
+    submitBlock();
+    for (std::size_t i = 0u; i < DEPTH; ++i)
+    {
+        wait(i);
+    }
+    _dropper.advance(_position - _synced);
+    _synced = _position;
+
+    std::lock_guard<std::mutex> l(_mut);
+    if (_error != 0)
+    {
+        BOOST_THROW_EXCEPTION(ErrorException{U("Cannot write the downloaded file: ") + str2wstr(std::strerror(_error))});
+    }
+}
+
+void
+CurlWriter::submitBlock ()
+{
+    if (_filled == 0u)
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> l(_mut);
+        _pending[_current] = 1;
+    }
+    writeBlock(_current, _position, 0u, _filled);
+    _io->submit();
+    _position += _filled;
+    _filled    = 0u;
+    _current   = (_current + 1u) % DEPTH;
+
+    // the oldest block is refilled next: once it is written, so is everything but the DEPTH - 1 last blocks
+    wait(_current);
+    auto written = _position - std::min<uint64_t>(_position - _synced, (DEPTH - 1u) * BLOCK_SIZE);
+    _dropper.advance(written - _synced);
+    _synced = written;
+}
+
+void
+CurlWriter::writeBlock (std::size_t index, uint64_t offset, std::size_t done, std::size_t size)
+{
+    _io->write(_fd, offset + done, _blocks[index].data() + done, size - done,
+               [this, index, offset, done, size](std::size_t count, int error) {
+        onWritten(index, offset, done, size, count, error);
+    });
+}
+
+void
+CurlWriter::onWritten (std::size_t index, uint64_t offset, std::size_t done, std::size_t size, std::size_t count, int error)
+{
+    if (error == 0 && count > 0u && done + count < size)
+    {
+        // short write: the rest of the block is written from here
+        writeBlock(index, offset, done + count, size);
+        _io->submit();
+        return;
+    }
+    std::lock_guard<std::mutex> l(_mut);
+    if (_error == 0 && (error != 0 || count == 0u))
+    {
+        _error = error != 0 ? error : EIO;
+    }
+    _pending[index] = 0;
+    _written.notify_all();
+}
+
+void
+CurlWriter::wait (std::size_t index)
+{
+    std::unique_lock<std::mutex> l(_mut);
+    _written.wait(l, [this, index]() { return _pending[index] == 0; });
+}
+
 
 } /* namespace details */
 } /* namespace giga */
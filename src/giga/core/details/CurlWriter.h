@@ -17,10 +17,18 @@
 #ifndef GIGA_CORE_DETAILS_CURLWRITER_H_
 #define GIGA_CORE_DETAILS_CURLWRITER_H_
 
+#include "../../utils/FileIo.h"
+#include "../../utils/PageCache.h"
+#include "../../utils/SequentialFile.h"
+
 #include <boost/filesystem.hpp>
 #include <cpprest/details/basic_types.h>
+#include <condition_variable>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <vector>
 
 namespace curl
 {
@@ -32,10 +40,25 @@ namespace giga
 namespace details
 {
 
+/**
+ * Writes a downloaded file, or keeps the error body of the reply.
+ *
+ * With ```utils::IoMode::streaming``` (or ```utils::IoMode::direct```, the writes being unaligned)
+ * the written pages are given back to the kernel (see ```utils::PageCacheDropper```).
+ *
+ * With a ```utils::FileIo``` the data is gathered in ```BLOCK_SIZE``` blocks written behind the download:
+ * up to ```DEPTH``` blocks are in flight while curl fills the next one. ```finish()``` must then be called
+ * once the transfer is done, to know that the file was fully written.
+ */
 class CurlWriter
 {
 public:
-    explicit CurlWriter(const boost::filesystem::path& path);
+    static constexpr std::size_t BLOCK_SIZE = 1024u * 1024u;
+    static constexpr std::size_t DEPTH      = 3u;
+
+public:
+    explicit CurlWriter(const boost::filesystem::path& path, utils::IoMode mode = utils::IoMode::cached,
+                        std::shared_ptr<utils::FileIo> io = nullptr);
     ~CurlWriter();
     CurlWriter()                             = delete;
     CurlWriter(const CurlWriter&)            = delete;
@@ -55,11 +78,51 @@ public:
     std::ofstream&
     file();
 
+    /**
+     * @brief The size of the file, with the bytes not written yet.
+     */
+    uint64_t
+    position () const;
+
+    /**
+     * @brief Write the last block and wait for the pending writes. Throws when a write failed.
+     */
+    void
+    finish ();
+
+private:
+    void
+    submitBlock ();
+
+    void
+    writeBlock (std::size_t index, uint64_t offset, std::size_t done, std::size_t size);
+
+    void
+    onWritten (std::size_t index, uint64_t offset, std::size_t done, std::size_t size, std::size_t count, int error);
+
+    void
+    wait (std::size_t index);
+
 private:
     std::ofstream       _file;
     std::ostringstream  _stream;
     curl::curl_easy*    _curl;
     long                _httpCode;
+    int                 _fd;        // to give the pages back, -1 in IoMode::cached
+    uint64_t            _unflushed; // bytes written since the last flush
+    utils::PageCacheDropper _dropper;
+
+    // with a FileIo only (_fd is then the file written)
+    std::shared_ptr<utils::FileIo>  _io;
+    std::vector<utils::AlignedBuffer> _blocks;
+    std::vector<char>               _pending;  // per block, guarded by _mut
+    std::size_t                     _current;  // the block being filled
+    std::size_t                     _filled;   // bytes in the current block
+    uint64_t                        _position; // file offset of the current block
+    uint64_t                        _synced;   // everything before is written
+    int                             _error;    // first write error, guarded by _mut
+    std::mutex                      _mut;
+    std::condition_variable         _written;
 
 };
 
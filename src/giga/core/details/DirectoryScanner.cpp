@@ -0,0 +1,243 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DirectoryScanner.h"
+#include "../../rest/HttpErrors.h"
+
+#include <pplx/pplxtasks.h>
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#   include <dirent.h>
+#   include <fcntl.h>
+#   include <sys/stat.h>
+#   include <sys/types.h>
+#endif
+
+using boost::filesystem::path;
+
+namespace giga
+{
+namespace details
+{
+
+DirectoryScanner::DirectoryScanner (unsigned workerCount, NodeNameFct nodeNameFct, OnFileFct onFileFct, IsCanceledFct isCanceledFct) :
+        _workerCount{std::max(1u, workerCount)},
+        _nodeNameFct{std::move(nodeNameFct)},
+        _onFileFct{std::move(onFileFct)},
+        _isCanceledFct{std::move(isCanceledFct)},
+        _mut{},
+        _cond{},
+        _directories{},
+        _busyWorkers{0u},
+        _error{nullptr}
+{
+}
+
+void
+DirectoryScanner::scan (const path& root)
+{
+    boost::system::error_code ec;
+    auto status = boost::filesystem::status(root, ec);
+    if (!boost::filesystem::is_directory(status) && !boost::filesystem::is_regular_file(status))
+    {
+        BOOST_THROW_EXCEPTION(ErrorException{U("dest should be a regular file")});
+    }
+
+    auto name = _nodeNameFct(root);
+    if (name.empty())
+    {
+        return;
+    }
+    if (boost::filesystem::is_regular_file(status))
+    {
+        _onFileFct(File{root, path{name}, boost::filesystem::file_size(root)});
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> l{_mut};
+        _directories.clear();
+        _directories.push_back(Directory{root, path{name}});
+        _busyWorkers = 0u;
+        _error       = nullptr;
+    }
+
+    // the calling thread is one of the workers
+    std::vector<pplx::task<void>> workers;
+    for (auto i = 1u; i < _workerCount; ++i)
+    {
+        workers.push_back(pplx::create_task([this] {
+            work();
+        }));
+    }
+    work();
+    if (!workers.empty())
+    {
+        pplx::when_all(workers.begin(), workers.end()).wait();
+    }
+
+    if (_error != nullptr)
+    {
+        std::rethrow_exception(_error);
+    }
+}
+
+void
+DirectoryScanner::work ()
+{
+    while (true)
+    {
+        Directory dir;
+        {
+            std::unique_lock<std::mutex> l{_mut};
+            _cond.wait(l, [this] { return !_directories.empty() || _busyWorkers == 0; });
+            if (_directories.empty())
+            {
+                return; // nothing left, and nobody can find more
+            }
+            dir = std::move(_directories.front());
+            _directories.pop_front();
+            ++_busyWorkers;
+        }
+
+        try
+        {
+            if (!_isCanceledFct())
+            {
+                scanDirectory(dir);
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> l{_mut};
+            if (_error == nullptr)
+            {
+                _error = std::current_exception();
+            }
+        }
+
+        std::lock_guard<std::mutex> l{_mut};
+        if (--_busyWorkers == 0 && _directories.empty())
+        {
+            _cond.notify_all();
+        }
+    }
+}
+
+#ifndef _WIN32
+
+void
+DirectoryScanner::scanDirectory (const Directory& dir)
+{
+    auto handle = std::unique_ptr<DIR, int(*)(DIR*)>{opendir(dir.path.c_str()), &closedir};
+    if (handle == nullptr)
+    {
+        BOOST_THROW_EXCEPTION(ErrorException{U("Cannot open directory: ") + dir.path.native()});
+    }
+
+    while (auto entry = readdir(handle.get()))
+    {
+        if (_isCanceledFct())
+        {
+            return;
+        }
+        auto name = std::string{entry->d_name};
+        if (name == "." || name == "..")
+        {
+            continue;
+        }
+
+        // only the files (to get their size), the links and the unknown entries are stat'ed.
+        auto isDirectory = entry->d_type == DT_DIR;
+        auto isFile      = false;
+        auto size        = uint64_t{0};
+        if (!isDirectory)
+        {
+            struct stat st;
+            if (fstatat(dirfd(handle.get()), entry->d_name, &st, 0) != 0)
+            {
+                continue; // removed, or a broken link
+            }
+            isDirectory = S_ISDIR(st.st_mode);
+            isFile      = S_ISREG(st.st_mode);
+            size        = static_cast<uint64_t>(st.st_size);
+        }
+        if (isDirectory || isFile)
+        {
+            onEntry(dir, dir.path / name, isDirectory, size);
+        }
+    }
+}
+
+#else
+
+void
+DirectoryScanner::scanDirectory (const Directory& dir)
+{
+    using namespace boost::filesystem;
+    for (auto it = directory_iterator{dir.path}; it != directory_iterator{}; ++it)
+    {
+        if (_isCanceledFct())
+        {
+            return;
+        }
+        boost::system::error_code ec;
+        auto status = it->status(ec); // cached by the directory entry
+        if (is_directory(status))
+        {
+            onEntry(dir, it->path(), true, 0ul);
+        }
+        else if (is_regular_file(status))
+        {
+            auto size = file_size(it->path(), ec);
+            if (!ec)
+            {
+                onEntry(dir, it->path(), false, size);
+            }
+        }
+    }
+}
+
+#endif
+
+void
+DirectoryScanner::onEntry (const Directory& dir, const path& p, bool isDirectory, uint64_t size)
+{
+    auto name = _nodeNameFct(p);
+    if (name.empty())
+    {
+        return;
+    }
+    if (isDirectory)
+    {
+        {
+            std::lock_guard<std::mutex> l{_mut};
+            _directories.push_back(Directory{p, dir.nodePath / name});
+        }
+        _cond.notify_one();
+    }
+    else
+    {
+        _onFileFct(File{p, dir.nodePath / name, size});
+    }
+}
+
+} /* namespace details */
+} /* namespace giga */
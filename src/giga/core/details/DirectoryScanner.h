@@ -0,0 +1,108 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GIGA_CORE_DETAILS_DIRECTORYSCANNER_H_
+#define GIGA_CORE_DETAILS_DIRECTORYSCANNER_H_
+
+#include <boost/filesystem.hpp>
+#include <cpprest/details/basic_types.h>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+
+namespace giga
+{
+namespace details
+{
+
+/**
+ * Walk a directory tree with several workers.
+ *
+ * The files are reported as soon as they are found (in no particular order).
+ * The type given by the directory entries is used whenever possible:
+ * a directory costs no stat call, a file costs one (to get its size).
+ */
+class DirectoryScanner final
+{
+public:
+    struct File
+    {
+        boost::filesystem::path path;
+        boost::filesystem::path nodePath;
+        uint64_t                size;
+    };
+
+    /** Gets the node name of a file/folder, or an empty string to skip it. */
+    typedef std::function<utility::string_t(const boost::filesystem::path&)> NodeNameFct;
+    /** Called by the workers for each file found (concurrently). */
+    typedef std::function<void(File&&)>                                        OnFileFct;
+    typedef std::function<bool()>                                              IsCanceledFct;
+
+public:
+    explicit
+    DirectoryScanner (unsigned workerCount, NodeNameFct nodeNameFct, OnFileFct onFileFct, IsCanceledFct isCanceledFct);
+
+    DirectoryScanner()                                   = delete;
+    DirectoryScanner(const DirectoryScanner&)            = delete;
+    DirectoryScanner(DirectoryScanner&&)                 = delete;
+    DirectoryScanner& operator=(const DirectoryScanner&) = delete;
+    DirectoryScanner& operator=(DirectoryScanner&&)      = delete;
+
+    /**
+     * @brief Scan ```root``` (a file or a directory) and wait for the end of the scan.
+     *
+     * An unreadable sub-directory does not stop the scan of the others:
+     * the first error is thrown once every directory has been scanned.
+     */
+    void
+    scan (const boost::filesystem::path& root);
+
+private:
+    struct Directory
+    {
+        boost::filesystem::path path;
+        boost::filesystem::path nodePath;
+    };
+
+    void
+    work ();
+
+    void
+    scanDirectory (const Directory& dir);
+
+    void
+    onEntry (const Directory& dir, const boost::filesystem::path& path, bool isDirectory, uint64_t size);
+
+private:
+    const unsigned        _workerCount;
+    const NodeNameFct     _nodeNameFct;
+    const OnFileFct       _onFileFct;
+    const IsCanceledFct   _isCanceledFct;
+
+    std::mutex              _mut;
+    std::condition_variable _cond;
+    std::deque<Directory>   _directories;
+    unsigned                _busyWorkers;
+    std::exception_ptr      _error;
+};
+
+} /* namespace details */
+} /* namespace giga */
+
+#endif /* GIGA_CORE_DETAILS_DIRECTORYSCANNER_H_ */
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FileBufferPool.h"
+
+#include <algorithm>
+#include <mutex>
+#include <utility>
+
+namespace
+{
+// more buffers than that are freed when given back.
+constexpr std::size_t MAX_IDLE_BUFFERS = 16u;
+}
+
+namespace giga
+{
+namespace details
+{
+
+constexpr std::size_t FileBufferPool::DEFAULT_CAPACITY;
+
+struct FileBufferPool::State
+{
+    typedef std::unique_ptr<std::vector<unsigned char>> Buffer;
+
+    /** Free the idle buffers until ```bytes``` more fit in the capacity. _mut must be locked. */
+    bool
+    makeRoom (std::size_t bytes)
+    {
+        while (held + bytes > capacity && !idle.empty())
+        {
+            held -= idle.back()->capacity();
+            idle.pop_back();
+        }
+        return held + bytes <= capacity;
+    }
+
+    void
+    release (std::vector<unsigned char>* raw) noexcept
+    {
+        Buffer buffer{raw};
+        std::lock_guard<std::mutex> l{mut};
+        if (idle.size() < MAX_IDLE_BUFFERS && held <= capacity)
+        {
+            buffer->clear();
+            idle.push_back(std::move(buffer));
+        }
+        else
+        {
+            held -= buffer->capacity();
+        }
+    }
+
+    mutable std::mutex  mut;
+    std::vector<Buffer> idle;
+    std::size_t         capacity;
+    std::size_t         held;
+};
+
+FileBufferPool&
+FileBufferPool::instance ()
+{
+    static FileBufferPool pool;
+    return pool;
+}
+
+FileBufferPool::FileBufferPool () :
+        _state{std::make_shared<State>()}
+{
+    _state->capacity = DEFAULT_CAPACITY;
+    _state->held     = 0u;
+}
+
+std::shared_ptr<std::vector<unsigned char>>
+FileBufferPool::acquire (std::size_t size)
+{
+    auto state = _state;
+    State::Buffer buffer = nullptr;
+    {
+        std::lock_guard<std::mutex> l{state->mut};
+        // the smallest idle buffer big enough, if it does not waste more than half of it
+        auto best = state->idle.end();
+        for (auto it = state->idle.begin(); it != state->idle.end(); ++it)
+        {
+            auto cap = (*it)->capacity();
+            if (cap >= size && cap / 2u <= size && (best == state->idle.end() || cap < (*best)->capacity()))
+            {
+                best = it;
+            }
+        }
+        if (best != state->idle.end())
+        {
+            buffer = std::move(*best);
+            state->idle.erase(best);
+        }
+        else
+        {
+            if (!state->makeRoom(size))
+            {
+                return nullptr;
+            }
+            state->held += size;
+        }
+    }
+
+    if (buffer == nullptr)
+    {
+        try
+        {
+            buffer.reset(new std::vector<unsigned char>{});
+            buffer->reserve(size);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> l{state->mut};
+            state->held -= size;
+            throw;
+        }
+        std::lock_guard<std::mutex> l{state->mut};
+        state->held += buffer->capacity() - size; // the allocator may round it up
+    }
+    buffer->resize(size);
+    return std::shared_ptr<std::vector<unsigned char>>{buffer.release(), [state](std::vector<unsigned char>* raw) {
+        state->release(raw);
+    }};
+}
+
+void
+FileBufferPool::setCapacity (std::size_t bytes)
+{
+    std::lock_guard<std::mutex> l{_state->mut};
+    _state->capacity = bytes;
+    _state->makeRoom(0u);
+}
+
+std::size_t
+FileBufferPool::capacity () const
+{
+    std::lock_guard<std::mutex> l{_state->mut};
+    return _state->capacity;
+}
+
+std::size_t
+FileBufferPool::heldBytes () const
+{
+    std::lock_guard<std::mutex> l{_state->mut};
+    return _state->held;
+}
+
+std::size_t
+FileBufferPool::idleCount () const
+{
+    std::lock_guard<std::mutex> l{_state->mut};
+    return _state->idle.size();
+}
+
+} /* namespace details */
+} /* namespace giga */
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GIGA_CORE_DETAILS_FILEBUFFERPOOL_H_
+#define GIGA_CORE_DETAILS_FILEBUFFERPOOL_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace giga
+{
+namespace details
+{
+
+/** The content of a small file, read once and shared until it is uploaded. */
+typedef std::shared_ptr<const std::vector<unsigned char>> FileContent;
+
+/**
+ * A process wide pool of buffers holding whole small files.
+ *
+ * The memory held by the buffers (leased or idle) never goes above ```capacity()```:
+ * when it would, ```acquire()``` returns nullptr and the file is read from disk as usual.
+ * A buffer is given back to the pool when the last copy of its ```shared_ptr``` is destroyed.
+ *
+ * Usage:
+ * ```
+ * auto buffer = FileBufferPool::instance().acquire(size);
+ * if (buffer != nullptr) { buffer->resize(read(buffer->data(), size)); }
+ * ```
+ */
+class FileBufferPool final
+{
+public:
+    static constexpr std::size_t DEFAULT_CAPACITY = 64u * 1024u * 1024u;
+
+    static FileBufferPool&
+    instance ();
+
+    FileBufferPool ();
+
+    FileBufferPool(const FileBufferPool&)            = delete;
+    FileBufferPool(FileBufferPool&&)                 = delete;
+    FileBufferPool& operator=(const FileBufferPool&) = delete;
+    FileBufferPool& operator=(FileBufferPool&&)      = delete;
+
+    /**
+     * @brief Lease a buffer of ```size``` bytes, or nullptr if the pool is full. It never blocks.
+     */
+    std::shared_ptr<std::vector<unsigned char>>
+    acquire (std::size_t size);
+
+    /**
+     * @brief Limit the memory held by the buffers (default: 64 MiB, 0 disables the pool).
+     * The buffers already leased are kept until they are given back.
+     */
+    void
+    setCapacity (std::size_t bytes);
+
+    std::size_t
+    capacity () const;
+
+    /**
+     * @return the bytes held by the buffers, leased or idle.
+     */
+    std::size_t
+    heldBytes () const;
+
+    /**
+     * @return the number of buffers waiting to be leased.
+     */
+    std::size_t
+    idleCount () const;
+
+private:
+    struct State;
+
+    // shared with the leased buffers, which may outlive the pool
+    std::shared_ptr<State> _state;
+};
+
+} /* namespace details */
+} /* namespace giga */
+
+#endif /* GIGA_CORE_DETAILS_FILEBUFFERPOOL_H_ */
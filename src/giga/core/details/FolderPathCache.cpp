@@ -0,0 +1,223 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FolderPathCache.h"
+#include "../Node.h"
+#include "../../Application.h"
+#include "../../api/GigaApi.h"
+#include "../../api/data/Node.h"
+#include "../../rest/HttpErrors.h"
+#include "../../utils/Utils.h"
+
+#include <pplx/pplxtasks.h>
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+
+using boost::filesystem::path;
+using utility::string_t;
+
+namespace giga
+{
+namespace details
+{
+
+FolderPathCache::FolderPathCache (const Application& app) :
+        _app{&app},
+        _mut{},
+        _ids{},
+        _listed{},
+        _locks{},
+        _created{}
+{
+}
+
+std::string
+FolderPathCache::resolve (const std::string& rootId, const path& relativePath)
+{
+    auto id = rootId;
+    path current;
+    for (const auto& name : relativePath)
+    {
+        auto child = current / name;
+        id         = resolveChild(rootId, current, id, child);
+        current    = child;
+    }
+    return id;
+}
+
+void
+FolderPathCache::resolveAll (const std::string& rootId, const std::vector<path>& folders, unsigned parallelism)
+{
+    // depth -> folders of that depth (ancestors included)
+    std::map<std::size_t, std::set<path>> levels;
+    for (const auto& folder : folders)
+    {
+        path current;
+        std::size_t depth = 0;
+        for (const auto& name : folder)
+        {
+            current /= name;
+            levels[++depth].insert(current);
+        }
+    }
+
+    for (const auto& level : levels)
+    {
+        auto items   = std::vector<path>(level.second.begin(), level.second.end());
+        auto next    = std::make_shared<std::atomic<std::size_t>>(0u);
+        auto workers = std::min<std::size_t>(std::max(1u, parallelism), items.size());
+
+        std::vector<pplx::task<void>> tasks;
+        for (std::size_t i = 0; i < workers; ++i)
+        {
+            tasks.push_back(pplx::create_task([this, &rootId, &items, next] {
+                for (auto index = (*next)++; index < items.size(); index = (*next)++)
+                {
+                    try
+                    {
+                        resolve(rootId, items[index]);
+                    }
+                    catch (...)
+                    {
+                        GIGA_DEBUG_LOG(debug, utils::exceptionInfos());
+                    }
+                }
+            }));
+        }
+        pplx::when_all(tasks.begin(), tasks.end()).wait();
+    }
+}
+
+std::vector<std::shared_ptr<core::Node>>
+FolderPathCache::takeCreated (const std::string& rootId, const path& relativePath)
+{
+    std::vector<std::shared_ptr<core::Node>> created;
+    std::lock_guard<std::mutex> l{_mut};
+    if (_created.empty())
+    {
+        return created;
+    }
+
+    path current;
+    for (const auto& name : relativePath)
+    {
+        current /= name;
+        auto it = _created.find(makeKey(rootId, current));
+        if (it != _created.end())
+        {
+            created.push_back(std::move(it->second));
+            _created.erase(it);
+        }
+    }
+    return created;
+}
+
+void
+FolderPathCache::clear ()
+{
+    std::lock_guard<std::mutex> l{_mut};
+    _ids.clear();
+    _listed.clear();
+    _created.clear();
+}
+
+std::string
+FolderPathCache::resolveChild (const std::string& rootId, const path& parentPath, const std::string& parentId, const path& childPath)
+{
+    auto key = makeKey(rootId, childPath);
+    auto cachedId = [this, &key] (std::string& id) {
+        std::lock_guard<std::mutex> l{_mut};
+        auto it = _ids.find(key);
+        if (it == _ids.end())
+        {
+            return false;
+        }
+        id = it->second;
+        return true;
+    };
+
+    std::string id;
+    if (cachedId(id))
+    {
+        return id;
+    }
+
+    {
+        // the children of the parent are listed once.
+        auto parentLock = lockFor(makeKey(rootId, parentPath));
+        std::lock_guard<std::mutex> lp{*parentLock};
+        auto isListed = false;
+        {
+            std::lock_guard<std::mutex> l{_mut};
+            isListed = _listed.count(parentId) != 0;
+        }
+        if (!isListed)
+        {
+            auto children = _app->api().nodes.getChildrenNode(parentId).get();
+            std::lock_guard<std::mutex> l{_mut};
+            for (const auto& child : *children)
+            {
+                if (child.type == U("folder"))
+                {
+                    _ids.emplace(makeKey(rootId, parentPath / child.name), child.id);
+                }
+            }
+            _listed.insert(parentId);
+        }
+    }
+    if (cachedId(id))
+    {
+        return id;
+    }
+
+    auto childLock = lockFor(key);
+    std::lock_guard<std::mutex> lc{*childLock};
+    if (cachedId(id))
+    {
+        return id;
+    }
+
+    auto result = _app->api().nodes.addFolderNode(childPath.filename().native(), parentId).get();
+    auto node   = std::shared_ptr<core::Node>{core::Node::create(std::shared_ptr<data::Node>{std::move(result->data)}, *_app)};
+
+    std::lock_guard<std::mutex> l{_mut};
+    _ids[key] = node->id();
+    _listed.insert(node->id()); // a new folder is empty
+    _created[key] = node;
+    return node->id();
+}
+
+std::shared_ptr<std::mutex>
+FolderPathCache::lockFor (const std::string& key)
+{
+    std::lock_guard<std::mutex> l{_mut};
+    auto& lock = _locks[key];
+    if (lock == nullptr)
+    {
+        lock = std::make_shared<std::mutex>();
+    }
+    return lock;
+}
+
+std::string
+FolderPathCache::makeKey (const std::string& rootId, const path& relativePath)
+{
+    return rootId + '/' + utils::wstr2str(relativePath.generic_string<string_t>());
+}
+
+} /* namespace details */
+} /* namespace giga */
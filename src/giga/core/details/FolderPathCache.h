@@ -0,0 +1,109 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GIGA_CORE_DETAILS_FOLDERPATHCACHE_H_
+#define GIGA_CORE_DETAILS_FOLDERPATHCACHE_H_
+
+#include <boost/filesystem.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace giga
+{
+class Application;
+
+namespace core
+{
+class Node;
+}
+
+namespace details
+{
+
+/**
+ * Maps the folder paths of an upload to the id of the remote folders.
+ *
+ * A path is relative to a root folder (the destination of an upload request).
+ * The cache is filled as the folders are discovered (the children of a folder are
+ * listed once) or created. The missing folders are created on demand,
+ * a same folder is never created twice, even by concurrent calls.
+ */
+class FolderPathCache final
+{
+public:
+    explicit
+    FolderPathCache (const Application& app);
+
+    FolderPathCache()                                  = delete;
+    FolderPathCache(const FolderPathCache&)            = delete;
+    FolderPathCache(FolderPathCache&&)                 = delete;
+    FolderPathCache& operator=(const FolderPathCache&) = delete;
+    FolderPathCache& operator=(FolderPathCache&&)      = delete;
+
+    /**
+     * @brief Gets the id of the folder ```rootId/relativePath```, the missing folders are created.
+     */
+    std::string
+    resolve (const std::string& rootId, const boost::filesystem::path& relativePath);
+
+    /**
+     * @brief Resolve every folder of ```folders``` (and their ancestors), level by level.
+     * The folders of a same level are created by ```parallelism``` workers.
+     * The errors are only logged: ```resolve()``` will fail again later.
+     */
+    void
+    resolveAll (const std::string& rootId, const std::vector<boost::filesystem::path>& folders, unsigned parallelism);
+
+    /**
+     * @return the folders created along ```rootId/relativePath``` not taken yet (from the root).
+     */
+    std::vector<std::shared_ptr<core::Node>>
+    takeCreated (const std::string& rootId, const boost::filesystem::path& relativePath);
+
+    /**
+     * @brief Forget everything (the remote folders were modified).
+     */
+    void
+    clear ();
+
+private:
+    std::string
+    resolveChild (const std::string& rootId, const boost::filesystem::path& parentPath, const std::string& parentId,
+                  const boost::filesystem::path& childPath);
+
+    std::shared_ptr<std::mutex>
+    lockFor (const std::string& key);
+
+    static std::string
+    makeKey (const std::string& rootId, const boost::filesystem::path& relativePath);
+
+private:
+    const Application*                                  _app;
+    std::mutex                                          _mut;
+    std::map<std::string, std::string>                  _ids;    // key -> folder id
+    std::set<std::string>                               _listed; // folders whose children are in _ids
+    std::map<std::string, std::shared_ptr<std::mutex>>  _locks;  // key -> lock held while creating/listing it
+    std::map<std::string, std::shared_ptr<core::Node>>  _created;
+};
+
+} /* namespace details */
+} /* namespace giga */
+
+#endif /* GIGA_CORE_DETAILS_FOLDERPATHCACHE_H_ */
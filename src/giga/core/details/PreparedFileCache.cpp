@@ -0,0 +1,188 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PreparedFileCache.h"
+#include "../../rest/HttpErrors.h"
+#include "../../utils/Utils.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sstream>
+#include <utility>
+
+using boost::filesystem::path;
+
+namespace
+{
+const std::string HEADER = "giga-prepared-cache 1";
+
+bool
+readField (std::istream& is, std::string& field)
+{
+    return static_cast<bool>(std::getline(is, field, '\t'));
+}
+}
+
+namespace giga
+{
+namespace details
+{
+
+PreparedFileCache::PreparedFileCache (const path& file) :
+        _mut{},
+        _file{file},
+        _entries{},
+        _journal{}
+{
+    load();
+}
+
+boost::optional<PreparedFileCache::Key>
+PreparedFileCache::key (const path& p)
+{
+    int64_t mtime = 0;
+#ifdef _MSC_VER
+    struct _stat64 st;
+    if (_wstat64(p.c_str(), &st) != 0)
+    {
+        return boost::none;
+    }
+    mtime = static_cast<int64_t>(st.st_mtime) * 1000000000;
+#else
+    struct stat st;
+    if (::stat(p.c_str(), &st) != 0)
+    {
+        return boost::none;
+    }
+#   ifdef __APPLE__
+    mtime = static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#   else
+    mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#   endif
+#endif
+    return Key{static_cast<uint64_t>(st.st_dev), static_cast<uint64_t>(st.st_ino),
+               static_cast<uint64_t>(st.st_size), mtime, utils::wstr2str(p.native())};
+}
+
+boost::optional<PreparedFileCache::Entry>
+PreparedFileCache::find (const Key& key) const
+{
+    std::lock_guard<std::mutex> l{_mut};
+    auto it = _entries.find(key.path);
+    if (it == _entries.end() || it->second.first != key)
+    {
+        return boost::none;
+    }
+    return it->second.second;
+}
+
+void
+PreparedFileCache::insert (const Key& key, const Entry& entry)
+{
+    if (key.path.find('\n') != std::string::npos || PreparedFileCache::key(utils::str2wstr(key.path)) != key)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> l{_mut};
+    _entries[key.path] = std::make_pair(key, entry);
+    if (_journal.is_open())
+    {
+        write(_journal, key, entry);
+        _journal.flush();
+    }
+}
+
+std::size_t
+PreparedFileCache::size () const
+{
+    std::lock_guard<std::mutex> l{_mut};
+    return _entries.size();
+}
+
+void
+PreparedFileCache::load ()
+{
+    auto lines = 0ul;
+    auto valid = false;
+    {
+        std::ifstream is{_file.c_str(), std::ios::binary};
+        std::string line;
+        valid = is && std::getline(is, line) && line == HEADER;
+        if (valid)
+        {
+            while (std::getline(is, line))
+            {
+                ++lines;
+                std::istringstream ls{line};
+                std::string device, inode, size, mtime;
+                Key   key;
+                Entry entry;
+                if (!readField(ls, device) || !readField(ls, inode) || !readField(ls, size) || !readField(ls, mtime)
+                        || !readField(ls, entry.sha1) || !readField(ls, entry.fid) || !readField(ls, entry.fkey)
+                        || !std::getline(ls, key.path))
+                {
+                    continue;
+                }
+                try
+                {
+                    key.device = std::stoull(device);
+                    key.inode  = std::stoull(inode);
+                    key.size   = std::stoull(size);
+                    key.mtime  = std::stoll(mtime);
+                }
+                catch (const std::exception&)
+                {
+                    continue;
+                }
+                auto pathKey = key.path;
+                _entries[pathKey] = std::make_pair(std::move(key), std::move(entry));
+            }
+        }
+    }
+
+    if (!valid || lines != _entries.size())
+    {
+        // compact the journal: only the last entry of each path is kept.
+        auto tmp = path{_file}.concat(".tmp");
+        {
+            std::ofstream os{tmp.c_str(), std::ios::binary | std::ios::trunc};
+            os << HEADER << '\n';
+            for (const auto& e : _entries)
+            {
+                write(os, e.second.first, e.second.second);
+            }
+        }
+        boost::system::error_code ec;
+        boost::filesystem::rename(tmp, _file, ec);
+        if (ec)
+        {
+            GIGA_DEBUG_LOG(warning, "Cannot write the prepared file cache: " << ec.message());
+            return;
+        }
+    }
+    _journal.open(_file.c_str(), std::ios::binary | std::ios::app);
+}
+
+void
+PreparedFileCache::write (std::ostream& os, const Key& key, const Entry& entry) const
+{
+    os << key.device << '\t' << key.inode << '\t' << key.size << '\t' << key.mtime << '\t'
+       << entry.sha1 << '\t' << entry.fid << '\t' << entry.fkey << '\t' << key.path << '\n';
+}
+
+} /* namespace details */
+} /* namespace giga */
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GIGA_CORE_DETAILS_PREPAREDFILECACHE_H_
+#define GIGA_CORE_DETAILS_PREPAREDFILECACHE_H_
+
+#include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace giga
+{
+namespace details
+{
+
+/**
+ * An on-disk cache of the prepared files (sha1, fid and fkey),
+ * so that unchanged files do not get hashed again.
+ *
+ * A file is identified by its device, inode, size, modification time and path:
+ * an entry is only returned while all of them are unchanged.
+ *
+ * The cache file is a journal: every new entry is appended to it,
+ * it is compacted when loaded.
+ */
+class PreparedFileCache final
+{
+public:
+    struct Key
+    {
+        uint64_t    device;
+        uint64_t    inode;
+        uint64_t    size;
+        int64_t     mtime; // in ns
+        std::string path;
+
+        bool operator==(const Key& rhs) const {
+            return device == rhs.device && inode == rhs.inode && size == rhs.size && mtime == rhs.mtime && path == rhs.path;
+        }
+
+        bool operator!=(const Key& rhs) const {
+            return !(*this == rhs);
+        }
+    };
+
+    struct Entry
+    {
+        std::string sha1;
+        std::string fid;
+        std::string fkey;
+    };
+
+public:
+    /**
+     * @brief Load (or create) the cache stored in ```file```.
+     */
+    explicit
+    PreparedFileCache (const boost::filesystem::path& file);
+
+    PreparedFileCache()                                    = delete;
+    PreparedFileCache(const PreparedFileCache&)            = delete;
+    PreparedFileCache(PreparedFileCache&&)                 = delete;
+    PreparedFileCache& operator=(const PreparedFileCache&) = delete;
+    PreparedFileCache& operator=(PreparedFileCache&&)      = delete;
+
+    /**
+     * @return the identity of ```path```, or nothing if it cannot be stat'ed.
+     */
+    static boost::optional<Key>
+    key (const boost::filesystem::path& path);
+
+    boost::optional<Entry>
+    find (const Key& key) const;
+
+    /**
+     * @brief Store ```entry```, computed from the file identified by ```key```.
+     * Nothing is stored if the file changed since ```key``` was taken.
+     */
+    void
+    insert (const Key& key, const Entry& entry);
+
+    std::size_t
+    size () const;
+
+private:
+    void
+    load ();
+
+    void
+    write (std::ostream& os, const Key& key, const Entry& entry) const;
+
+private:
+    mutable std::mutex                              _mut;
+    const boost::filesystem::path                   _file;
+    std::map<std::string, std::pair<Key, Entry>>    _entries; // path -> entry
+    std::ofstream                                   _journal;
+};
+
+} /* namespace details */
+} /* namespace giga */
+
+#endif /* GIGA_CORE_DETAILS_PREPAREDFILECACHE_H_ */
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ProgressNotifier.h"
+
+namespace giga
+{
+namespace details
+{
+
+ProgressNotifier::ProgressNotifier(std::chrono::milliseconds minInterval) :
+        _changed{false}, _stopped{false}, _mut{}, _cond{}, _minInterval{minInterval}, _last{}
+{
+}
+
+void
+ProgressNotifier::setMinInterval(std::chrono::milliseconds minInterval)
+{
+    std::lock_guard<std::mutex> l{_mut};
+    _minInterval = minInterval;
+}
+
+void
+ProgressNotifier::notify() noexcept
+{
+    if (!_changed.exchange(true))
+    {
+        // lock: the reporting thread may be between its check and its wait
+        std::lock_guard<std::mutex> l{_mut};
+        _cond.notify_one();
+    }
+}
+
+bool
+ProgressNotifier::wait()
+{
+    std::unique_lock<std::mutex> l{_mut};
+    _cond.wait(l, [this]{ return _changed || _stopped; });
+    if (!_changed)
+    {
+        return false;
+    }
+
+    // Coalesce the changes until the end of the interval (the last ones are reported right away when stopping)
+    _cond.wait_until(l, _last + _minInterval, [this]{ return _stopped; });
+    _changed = false;
+    _last    = Clock::now();
+    return true;
+}
+
+void
+ProgressNotifier::stop()
+{
+    std::lock_guard<std::mutex> l{_mut};
+    _stopped = true;
+    _cond.notify_all();
+}
+
+void
+ProgressNotifier::reset()
+{
+    std::lock_guard<std::mutex> l{_mut};
+    _stopped = false;
+}
+
+} /* namespace details */
+} /* namespace giga */
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GIGA_CORE_DETAILS_PROGRESSNOTIFIER_H_
+#define GIGA_CORE_DETAILS_PROGRESSNOTIFIER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace giga
+{
+namespace details
+{
+
+/**
+ * Wakes the thread reporting the progress of the transfers when a counter changes.
+ *
+ * The transfer threads call ```notify()``` (lock-free when a change is already pending),
+ * the reporting thread loops on ```wait()```: it sleeps while nothing changes, and the
+ * changes are coalesced so that it is woken at most once per ```minInterval```.
+ */
+class ProgressNotifier final
+{
+public:
+    explicit
+    ProgressNotifier(std::chrono::milliseconds minInterval = std::chrono::milliseconds{100});
+
+    ProgressNotifier(ProgressNotifier&&)                 = delete;
+    ProgressNotifier(const ProgressNotifier&)            = delete;
+    ProgressNotifier& operator=(const ProgressNotifier&) = delete;
+    ProgressNotifier& operator=(ProgressNotifier&&)      = delete;
+
+    void
+    setMinInterval(std::chrono::milliseconds minInterval);
+
+    /**
+     * @brief Something changed.
+     */
+    void
+    notify() noexcept;
+
+    /**
+     * @brief Wait for a change.
+     * @return false when ```stop()``` was called and every change has been reported.
+     */
+    bool
+    wait();
+
+    /**
+     * @brief Wake the reporting thread for good.
+     */
+    void
+    stop();
+
+    /**
+     * @brief Make the notifier usable again after ```stop()```.
+     */
+    void
+    reset();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    std::atomic<bool>         _changed;
+    bool                      _stopped;
+    std::mutex                _mut;
+    std::condition_variable   _cond;
+    std::chrono::milliseconds _minInterval;
+    Clock::time_point         _last;
+};
+
+} /* namespace details */
+} /* namespace giga */
+
+#endif /* GIGA_CORE_DETAILS_PROGRESSNOTIFIER_H_ */
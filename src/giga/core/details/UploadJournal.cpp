@@ -0,0 +1,431 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "UploadJournal.h"
+#include "../../rest/HttpErrors.h"
+#include "../../utils/Utils.h"
+
+#include <iterator>
+#include <sstream>
+#include <utility>
+
+using boost::filesystem::path;
+
+namespace
+{
+const std::string HEADER = "giga-upload-journal 2";
+
+std::string
+toUtf8 (const path& p)
+{
+    return giga::utils::wstr2str(p.native());
+}
+
+path
+fromUtf8 (const std::string& str)
+{
+    return path{giga::utils::str2wstr(str)};
+}
+
+std::string
+makeKey (const std::string& parentId, const std::string& path)
+{
+    return parentId + '\t' + path;
+}
+
+/**
+ * @return true if the file ```key``` is ```requestKey``` or in it.
+ */
+bool
+isUnder (const std::string& key, const std::string& requestKey)
+{
+    return key.compare(0, requestKey.size(), requestKey) == 0
+        && (key.size() == requestKey.size() || key[requestKey.size()] == '/' || key[requestKey.size()] == '\\');
+}
+
+std::string
+escape (const std::string& field)
+{
+    std::string escaped;
+    escaped.reserve(field.size());
+    for (auto c : field)
+    {
+        switch (c)
+        {
+            case '\\': escaped += "\\\\"; break;
+            case '\t': escaped += "\\t";  break;
+            case '\n': escaped += "\\n";  break;
+            default:   escaped += c;      break;
+        }
+    }
+    return escaped;
+}
+
+std::vector<std::string>
+split (const std::string& line)
+{
+    std::vector<std::string> fields(1);
+    for (std::size_t i = 0; i < line.size(); ++i)
+    {
+        auto c = line[i];
+        if (c == '\t')
+        {
+            fields.emplace_back();
+        }
+        else if (c == '\\' && i + 1 < line.size())
+        {
+            ++i;
+            fields.back() += line[i] == 't' ? '\t' : line[i] == 'n' ? '\n' : line[i];
+        }
+        else
+        {
+            fields.back() += c;
+        }
+    }
+    return fields;
+}
+}
+
+namespace giga
+{
+namespace details
+{
+
+UploadJournal::UploadJournal (const path& file, OpenMode mode) :
+        _mut{},
+        _file{file},
+        _requests{},
+        _files{},
+        _done{},
+        _resumed{},
+        _journal{}
+{
+    if (mode == OpenMode::resume)
+    {
+        load();
+    }
+    else
+    {
+        _journal.open(_file.c_str(), std::ios::binary | std::ios::trunc);
+        _journal << HEADER << '\n';
+        _journal.flush();
+    }
+}
+
+void
+UploadJournal::requested (const std::string& parentId, const path& p)
+{
+    std::lock_guard<std::mutex> l{_mut};
+    auto record = std::vector<std::string>{"R", parentId, toUtf8(p)};
+    apply(record);
+    append(record);
+}
+
+void
+UploadJournal::requestScanned (const std::string& parentId, const path& p)
+{
+    std::lock_guard<std::mutex> l{_mut};
+    auto record = std::vector<std::string>{"r", parentId, toUtf8(p)};
+    apply(record);
+    append(record);
+
+    // the files of the request not found again
+    auto requestKey = makeKey(parentId, toUtf8(p));
+    for (auto it = _resumed.begin(); it != _resumed.end();)
+    {
+        it = isUnder(*it, requestKey) ? _resumed.erase(it) : std::next(it);
+    }
+}
+
+bool
+UploadJournal::scanned (const std::string& parentId, const path& p, const path& nodePath, uint64_t size)
+{
+    std::lock_guard<std::mutex> l{_mut};
+    if (_resumed.erase(makeKey(parentId, toUtf8(p))) != 0)
+    {
+        return false;
+    }
+    auto record = std::vector<std::string>{"S", parentId, toUtf8(p), toUtf8(nodePath), std::to_string(size)};
+    apply(record);
+    append(record);
+    return true;
+}
+
+void
+UploadJournal::prepared (const std::string& parentId, const path& p, const PreparedFileCache::Key& identity,
+                         const std::string& sha1, const std::string& fid, const std::string& fkey)
+{
+    std::lock_guard<std::mutex> l{_mut};
+    auto record = std::vector<std::string>{"P", parentId, toUtf8(p), sha1, fid, fkey,
+                                           std::to_string(identity.device), std::to_string(identity.inode),
+                                           std::to_string(identity.size), std::to_string(identity.mtime)};
+    apply(record);
+    append(record);
+}
+
+void
+UploadJournal::acknowledged (const std::string& parentId, const path& p, const std::string& sessionId, uint64_t end)
+{
+    std::lock_guard<std::mutex> l{_mut};
+    auto it = _files.find(makeKey(parentId, toUtf8(p)));
+    if (it != _files.end() && it->second.sessionId == sessionId && it->second.acknowledged == end)
+    {
+        return;
+    }
+    auto record = std::vector<std::string>{"A", parentId, toUtf8(p), sessionId, std::to_string(end)};
+    apply(record);
+    append(record);
+}
+
+void
+UploadJournal::done (const std::string& parentId, const path& p)
+{
+    std::lock_guard<std::mutex> l{_mut};
+    auto record = std::vector<std::string>{"D", parentId, toUtf8(p)};
+    apply(record);
+    append(record);
+}
+
+void
+UploadJournal::failed (const std::string& parentId, const path& p)
+{
+    std::lock_guard<std::mutex> l{_mut};
+    auto record = std::vector<std::string>{"F", parentId, toUtf8(p)};
+    apply(record);
+    append(record);
+}
+
+void
+UploadJournal::clear ()
+{
+    std::lock_guard<std::mutex> l{_mut};
+    _requests.clear();
+    _files.clear();
+    _done.clear();
+    _resumed.clear();
+    _journal.close();
+    _journal.open(_file.c_str(), std::ios::binary | std::ios::trunc);
+    _journal << HEADER << '\n';
+    _journal.flush();
+}
+
+boost::optional<UploadJournal::File>
+UploadJournal::find (const std::string& parentId, const path& p) const
+{
+    std::lock_guard<std::mutex> l{_mut};
+    auto it = _files.find(makeKey(parentId, toUtf8(p)));
+    if (it == _files.end())
+    {
+        return boost::none;
+    }
+    return it->second;
+}
+
+std::vector<UploadJournal::Request>
+UploadJournal::pendingRequests () const
+{
+    std::lock_guard<std::mutex> l{_mut};
+    std::vector<Request> requests;
+    for (const auto& r : _requests)
+    {
+        requests.push_back(r.second);
+    }
+    return requests;
+}
+
+std::vector<UploadJournal::File>
+UploadJournal::pendingFiles () const
+{
+    std::lock_guard<std::mutex> l{_mut};
+    std::vector<File> files;
+    for (const auto& f : _files)
+    {
+        files.push_back(f.second);
+    }
+    return files;
+}
+
+void
+UploadJournal::load ()
+{
+    {
+        std::ifstream is{_file.c_str(), std::ios::binary};
+        std::string line;
+        if (is && std::getline(is, line) && line == HEADER)
+        {
+            while (std::getline(is, line))
+            {
+                try
+                {
+                    apply(split(line));
+                }
+                catch (const std::exception&)
+                {
+                    GIGA_DEBUG_LOG(warning, "Ignoring invalid upload journal record: " << line);
+                }
+            }
+        }
+    }
+
+    // the pending requests are scanned again: skip what they already queued or uploaded
+    auto underRequest = [this](const std::string& key) {
+        for (const auto& r : _requests)
+        {
+            if (isUnder(key, r.first))
+            {
+                return true;
+            }
+        }
+        return false;
+    };
+    for (auto it = _done.begin(); it != _done.end();)
+    {
+        it = underRequest(*it) ? std::next(it) : _done.erase(it);
+    }
+    _resumed = _done;
+    for (const auto& f : _files)
+    {
+        if (underRequest(f.first))
+        {
+            _resumed.insert(f.first);
+        }
+    }
+
+    // compact the journal: only the pending state is kept.
+    auto tmp = path{_file}.concat(".tmp");
+    {
+        std::ofstream os{tmp.c_str(), std::ios::binary | std::ios::trunc};
+        os << HEADER << '\n';
+        for (const auto& r : _requests)
+        {
+            write(os, {"R", r.second.parentId, toUtf8(r.second.path)});
+        }
+        for (const auto& d : _done)
+        {
+            auto sep = d.find('\t');
+            write(os, {"D", d.substr(0, sep), d.substr(sep + 1)});
+        }
+        for (const auto& f : _files)
+        {
+            const auto& file = f.second;
+            auto p = toUtf8(file.path);
+            write(os, {"S", file.parentId, p, toUtf8(file.nodePath), std::to_string(file.size)});
+            if (file.isPrepared)
+            {
+                const auto& id = file.identity;
+                write(os, {"P", file.parentId, p, file.sha1, file.fid, file.fkey, std::to_string(id.device),
+                           std::to_string(id.inode), std::to_string(id.size), std::to_string(id.mtime)});
+            }
+            if (!file.sessionId.empty())
+            {
+                write(os, {"A", file.parentId, p, file.sessionId, std::to_string(file.acknowledged)});
+            }
+        }
+    }
+    boost::system::error_code ec;
+    boost::filesystem::rename(tmp, _file, ec);
+    if (ec)
+    {
+        GIGA_DEBUG_LOG(warning, "Cannot compact the upload journal: " << ec.message());
+    }
+    _journal.open(_file.c_str(), std::ios::binary | std::ios::app);
+}
+
+void
+UploadJournal::apply (const std::vector<std::string>& record)
+{
+    if (record.size() < 3)
+    {
+        return;
+    }
+    const auto& type = record[0];
+    auto key         = makeKey(record[1], record[2]);
+
+    if (type == "R")
+    {
+        _requests[key] = Request{record[1], fromUtf8(record[2])};
+    }
+    else if (type == "r")
+    {
+        _requests.erase(key);
+    }
+    else if (type == "S" && record.size() == 5)
+    {
+        _files[key] = File{record[1], fromUtf8(record[2]), fromUtf8(record[3]), std::stoull(record[4]),
+                           false, {}, {}, {}, {}, {}, 0ul};
+        _done.erase(key);
+    }
+    else if (type == "P" && record.size() == 10)
+    {
+        auto it = _files.find(key);
+        if (it != _files.end())
+        {
+            it->second.identity   = PreparedFileCache::Key{std::stoull(record[6]), std::stoull(record[7]),
+                                                           std::stoull(record[8]), std::stoll(record[9]), record[2]};
+            it->second.isPrepared = true;
+            it->second.sha1       = record[3];
+            it->second.fid        = record[4];
+            it->second.fkey       = record[5];
+        }
+    }
+    else if (type == "A" && record.size() == 5)
+    {
+        auto it = _files.find(key);
+        if (it != _files.end())
+        {
+            it->second.sessionId    = record[3];
+            it->second.acknowledged = std::stoull(record[4]);
+        }
+    }
+    else if (type == "D")
+    {
+        _files.erase(key);
+        _done.insert(key);
+        _resumed.erase(key);
+    }
+    else if (type == "F")
+    {
+        _files.erase(key);
+        _resumed.erase(key);
+    }
+}
+
+void
+UploadJournal::append (const std::vector<std::string>& record)
+{
+    if (_journal.is_open())
+    {
+        write(_journal, record);
+        _journal.flush();
+    }
+}
+
+void
+UploadJournal::write (std::ostream& os, const std::vector<std::string>& record) const
+{
+    for (std::size_t i = 0; i < record.size(); ++i)
+    {
+        if (i > 0)
+        {
+            os << '\t';
+        }
+        os << escape(record[i]);
+    }
+    os << '\n';
+}
+
+} /* namespace details */
+} /* namespace giga */
@@ -0,0 +1,169 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GIGA_CORE_DETAILS_UPLOADJOURNAL_H_
+#define GIGA_CORE_DETAILS_UPLOADJOURNAL_H_
+
+#include "PreparedFileCache.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace giga
+{
+namespace details
+{
+
+/**
+ * A durable record of an upload process.
+ *
+ * It records the requested paths, the scanned and prepared files,
+ * the bytes acknowledged by the server for each upload session and the uploaded files.
+ * A file is identified by the id of its destination folder and its local path.
+ * A prepared file keeps the identity (device, inode, size and modification time) it had when hashed.
+ *
+ * Every change is appended to the journal file (and flushed),
+ * the journal is compacted when it is loaded again.
+ * The files journaled under an interrupted request are queued again by the resume:
+ * the scan of that request skips each of them once.
+ */
+class UploadJournal final
+{
+public:
+    enum class OpenMode {
+        truncate, ///< start a new journal
+        resume    ///< load the journal, and continue it
+    };
+
+    struct Request
+    {
+        std::string             parentId;
+        boost::filesystem::path path;
+    };
+
+    struct File
+    {
+        std::string             parentId;
+        boost::filesystem::path path;
+        boost::filesystem::path nodePath;
+        uint64_t                size;
+
+        bool                    isPrepared;
+        PreparedFileCache::Key  identity; // of the file when prepared
+        std::string             sha1;
+        std::string             fid;
+        std::string             fkey;
+
+        std::string             sessionId;
+        uint64_t                acknowledged; // bytes acknowledged by the server for sessionId
+    };
+
+public:
+    explicit
+    UploadJournal (const boost::filesystem::path& file, OpenMode mode);
+
+    UploadJournal()                                = delete;
+    UploadJournal(const UploadJournal&)            = delete;
+    UploadJournal(UploadJournal&&)                 = delete;
+    UploadJournal& operator=(const UploadJournal&) = delete;
+    UploadJournal& operator=(UploadJournal&&)      = delete;
+
+    void
+    requested (const std::string& parentId, const boost::filesystem::path& path);
+
+    /**
+     * @brief Every file of the requested ```path``` has been scanned.
+     */
+    void
+    requestScanned (const std::string& parentId, const boost::filesystem::path& path);
+
+    /**
+     * @return false if the file was already queued by the resume (it must not be queued again).
+     */
+    bool
+    scanned (const std::string& parentId, const boost::filesystem::path& path, const boost::filesystem::path& nodePath, uint64_t size);
+
+    void
+    prepared (const std::string& parentId, const boost::filesystem::path& path, const PreparedFileCache::Key& identity,
+              const std::string& sha1, const std::string& fid, const std::string& fkey);
+
+    void
+    acknowledged (const std::string& parentId, const boost::filesystem::path& path, const std::string& sessionId, uint64_t end);
+
+    void
+    done (const std::string& parentId, const boost::filesystem::path& path);
+
+    /**
+     * @brief The file will not be uploaded: it is not pending anymore.
+     */
+    void
+    failed (const std::string& parentId, const boost::filesystem::path& path);
+
+    /**
+     * @brief Forget everything (the uploads were cleared).
+     */
+    void
+    clear ();
+
+    boost::optional<File>
+    find (const std::string& parentId, const boost::filesystem::path& path) const;
+
+    /**
+     * @return the requested paths whose scan did not complete.
+     */
+    std::vector<Request>
+    pendingRequests () const;
+
+    /**
+     * @return the scanned files not uploaded yet.
+     */
+    std::vector<File>
+    pendingFiles () const;
+
+private:
+    void
+    load ();
+
+    void
+    apply (const std::vector<std::string>& record);
+
+    void
+    append (const std::vector<std::string>& record);
+
+    void
+    write (std::ostream& os, const std::vector<std::string>& record) const;
+
+private:
+    mutable std::mutex             _mut;
+    const boost::filesystem::path  _file;
+    std::map<std::string, Request> _requests; // pending requests
+    std::map<std::string, File>    _files;    // pending files
+    std::set<std::string>          _done;     // under the pending requests
+    std::set<std::string>          _resumed;  // queued by the resume, skipped once by scanned()
+    std::ofstream                  _journal;
+};
+
+} /* namespace details */
+} /* namespace giga */
+
+#endif /* GIGA_CORE_DETAILS_UPLOADJOURNAL_H_ */
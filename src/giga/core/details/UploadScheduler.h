@@ -0,0 +1,353 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GIGA_CORE_DETAILS_UPLOADSCHEDULER_H_
+#define GIGA_CORE_DETAILS_UPLOADSCHEDULER_H_
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <set>
+#include <utility>
+
+namespace giga
+{
+namespace details
+{
+
+/**
+ * The order in which the files waiting for an upload worker are uploaded.
+ */
+enum class SchedulingPolicy {
+    fifo,          //!< in the order they were prepared
+    smallestFirst, //!< the smallest files first (one file out of 4 is still taken in FIFO order)
+    priority,      //!< the files of the requests with the highest priority first, FIFO for a same priority
+    fair           //!< the requests share the upload in proportion of their weight (1 + their priority)
+};
+
+/**
+ * What the scheduler knows about a queued file.
+ */
+struct SchedulingTicket
+{
+    uint64_t size;
+    uint64_t requestId;
+    int      priority;
+};
+
+/**
+ * A blocking queue for multiple producers and consumers that hands out its elements in the
+ * order chosen by a ```SchedulingPolicy```.
+ *
+ * Barriers (see ```enqueue_barrier()```) are never reordered: a barrier is dequeued after every
+ * element enqueued before it, and before every element enqueued after it.
+ *
+ * Like ```utils::BlockingQueue```, the queue can be bounded (see ```setLimits()```).
+ */
+template <typename T>
+class UploadScheduler final
+{
+public:
+    /** The approximate memory used by an element, in bytes. */
+    typedef std::function<std::size_t(const T&)> WeightFct;
+
+    /** With ```SchedulingPolicy::smallestFirst```, one dequeue out of ```AGING_PERIOD``` takes the oldest element. */
+    static constexpr unsigned AGING_PERIOD = 4u;
+
+public:
+    UploadScheduler()  = default;
+    ~UploadScheduler() = default;
+
+    UploadScheduler(UploadScheduler&&)                 = delete;
+    UploadScheduler(const UploadScheduler&)            = delete;
+    UploadScheduler& operator=(const UploadScheduler&) = delete;
+    UploadScheduler& operator=(UploadScheduler&&)      = delete;
+
+public:
+    /**
+     * @brief Change the policy. The elements already queued are reordered.
+     */
+    void
+    setPolicy(SchedulingPolicy policy)
+    {
+        std::lock_guard<std::mutex> l{_mut};
+        _policy = policy;
+        for (auto& segment : _segments)
+        {
+            segment.ranked.clear();
+            for (const auto& entry : segment.entries)
+            {
+                segment.ranked.emplace(rank(entry.second.ticket), entry.first);
+            }
+        }
+    }
+
+    SchedulingPolicy
+    policy() const
+    {
+        std::lock_guard<std::mutex> l{_mut};
+        return _policy;
+    }
+
+    /**
+     * @brief Bound the queue. 0 means no limit.
+     * @see utils::BlockingQueue::setLimits()
+     */
+    void
+    setLimits(std::size_t maxItems, std::size_t maxBytes, WeightFct weightFct)
+    {
+        {
+            std::lock_guard<std::mutex> l{_mut};
+            _maxItems  = maxItems;
+            _maxBytes  = maxBytes;
+            _weightFct = weightFct;
+        }
+        _notFull.notify_all();
+    }
+
+    /**
+     * @brief Enqueue an element, even if the queue is full.
+     */
+    void
+    enqueue(T&& element, SchedulingTicket ticket)
+    {
+        {
+            std::lock_guard<std::mutex> l{_mut};
+            auto& segment = _segments.back();
+            auto  seq     = _nextSeq++;
+            auto  weight  = _weightFct ? _weightFct(element) : 0u;
+            segment.entries.emplace(seq, Entry{std::move(element), ticket, weight});
+            segment.ranked.emplace(rank(ticket), seq);
+            segment.requests[ticket.requestId].insert(seq);
+            _size  += 1;
+            _bytes += weight;
+        }
+        _notEmpty.notify_one();
+    }
+
+    /**
+     * @brief Enqueue an element that is never reordered (an end or a clear marker for example).
+     */
+    void
+    enqueue_barrier(T&& element)
+    {
+        {
+            std::lock_guard<std::mutex> l{_mut};
+            _segments.back().barrier    = std::move(element);
+            _segments.back().hasBarrier = true;
+            _segments.emplace_back();
+        }
+        _notEmpty.notify_one();
+    }
+
+    /**
+     * @brief Wait until the queue is not full.
+     *
+     * Another producer may fill it again before the next ```enqueue()```.
+     */
+    void
+    wait_not_full()
+    {
+        std::unique_lock<std::mutex> l{_mut};
+        _notFull.wait(l, [this]{ return !isFull(); });
+    }
+
+    /**
+     * @brief Wait until an element (or a barrier) is available, then dequeue it.
+     */
+    void
+    wait_dequeue(T& element)
+    {
+        {
+            std::unique_lock<std::mutex> l{_mut};
+            _notEmpty.wait(l, [this]{ return !_segments.front().entries.empty() || _segments.front().hasBarrier; });
+            pop(element);
+        }
+        _notFull.notify_one();
+    }
+
+    /**
+     * @return the number of elements (barriers excluded).
+     */
+    std::size_t
+    size_approx() const
+    {
+        std::lock_guard<std::mutex> l{_mut};
+        return _size;
+    }
+
+    /**
+     * @return the memory used by the queued elements (0 if no ```WeightFct``` was given).
+     */
+    std::size_t
+    size_bytes() const
+    {
+        std::lock_guard<std::mutex> l{_mut};
+        return _bytes;
+    }
+
+private:
+    struct Entry
+    {
+        T                element;
+        SchedulingTicket ticket;
+        std::size_t      weight;
+    };
+
+    // The elements between two barriers.
+    struct Segment
+    {
+        std::map<uint64_t, Entry>                    entries;  // seq -> entry, in arrival order
+        std::set<std::pair<int64_t, uint64_t>>       ranked;   // (rank, seq)
+        std::map<uint64_t, std::set<uint64_t>>       requests; // requestId -> seqs, in arrival order
+        bool                                         hasBarrier = false;
+        T                                            barrier{};
+    };
+
+    int64_t
+    rank(const SchedulingTicket& ticket) const
+    {
+        switch (_policy)
+        {
+            case SchedulingPolicy::smallestFirst:
+                return static_cast<int64_t>(std::min<uint64_t>(ticket.size, std::numeric_limits<int64_t>::max()));
+            case SchedulingPolicy::priority:
+                return -static_cast<int64_t>(ticket.priority);
+            case SchedulingPolicy::fifo:
+            case SchedulingPolicy::fair:
+                break;
+        }
+        return 0;
+    }
+
+    static double
+    fairWeight(const SchedulingTicket& ticket)
+    {
+        return 1.0 + std::max(0, ticket.priority);
+    }
+
+    bool
+    isFull() const
+    {
+        return _size > 0 && ((_maxItems > 0 && _size >= _maxItems) || (_maxBytes > 0 && _bytes >= _maxBytes));
+    }
+
+    /**
+     * @return the seq of the next element of ```segment``` (that must not be empty).
+     */
+    uint64_t
+    next(Segment& segment)
+    {
+        switch (_policy)
+        {
+            case SchedulingPolicy::smallestFirst:
+                if (++_dequeued % AGING_PERIOD == 0)
+                {
+                    return segment.entries.begin()->first;
+                }
+                return segment.ranked.begin()->second;
+            case SchedulingPolicy::priority:
+                return segment.ranked.begin()->second;
+            case SchedulingPolicy::fair:
+            {
+                // the request that received the least, relatively to its weight
+                auto best = segment.requests.end();
+                for (auto it = segment.requests.begin(); it != segment.requests.end(); ++it)
+                {
+                    if (_served.find(it->first) == _served.end())
+                    {
+                        _served[it->first] = _virtualTime; // a new request starts with the others
+                    }
+                    if (best == segment.requests.end() || _served[it->first] < _served[best->first])
+                    {
+                        best = it;
+                    }
+                }
+                auto seq = *best->second.begin();
+                const auto& ticket = segment.entries.at(seq).ticket;
+                _virtualTime = _served[best->first];
+                _served[best->first] += static_cast<double>(std::max<uint64_t>(ticket.size, 1u)) / fairWeight(ticket);
+                return seq;
+            }
+            case SchedulingPolicy::fifo:
+                break;
+        }
+        return segment.entries.begin()->first;
+    }
+
+    void
+    pop(T& element)
+    {
+        auto& segment = _segments.front();
+        if (segment.entries.empty())
+        {
+            // only the barrier is left
+            element = std::move(segment.barrier);
+            _segments.pop_front();
+            if (_segments.empty())
+            {
+                _segments.emplace_back();
+            }
+            return;
+        }
+
+        auto seq   = next(segment);
+        auto it    = segment.entries.find(seq);
+        auto& reqs = segment.requests[it->second.ticket.requestId];
+        reqs.erase(seq);
+        if (reqs.empty())
+        {
+            segment.requests.erase(it->second.ticket.requestId);
+            _served.erase(it->second.ticket.requestId);
+        }
+        segment.ranked.erase(std::make_pair(rank(it->second.ticket), seq));
+
+        element = std::move(it->second.element);
+        _size  -= 1;
+        _bytes -= it->second.weight;
+        segment.entries.erase(it);
+    }
+
+private:
+    mutable std::mutex             _mut;
+    std::condition_variable        _notEmpty;
+    std::condition_variable        _notFull;
+    std::deque<Segment>            _segments    = std::deque<Segment>(1u);
+    SchedulingPolicy               _policy      = SchedulingPolicy::fifo;
+    uint64_t                       _nextSeq     = 0u;
+    uint64_t                       _dequeued    = 0u;
+    std::map<uint64_t, double>     _served;            // requestId -> virtual finish time (fair policy)
+    double                         _virtualTime = 0.0;
+    std::size_t                    _size        = 0u;
+    std::size_t                    _bytes       = 0u;
+    std::size_t                    _maxItems    = 0u;
+    std::size_t                    _maxBytes    = 0u;
+    WeightFct                      _weightFct;
+};
+
+template <typename T>
+constexpr unsigned UploadScheduler<T>::AGING_PERIOD;
+
+} /* namespace details */
+} /* namespace giga */
+
+#endif /* GIGA_CORE_DETAILS_UPLOADSCHEDULER_H_ */
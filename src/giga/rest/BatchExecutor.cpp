@@ -0,0 +1,35 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BatchExecutor.h"
+
+namespace giga
+{
+
+constexpr std::size_t BatchExecutor::DEFAULT_CONCURRENCY;
+
+BatchExecutor::BatchExecutor (std::size_t maxConcurrency) :
+        _maxConcurrency{std::max(maxConcurrency, std::size_t{1u})}
+{
+}
+
+std::size_t
+BatchExecutor::maxConcurrency () const
+{
+    return _maxConcurrency;
+}
+
+}  // namespace giga
@@ -0,0 +1,189 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef REST_BATCHEXECUTOR_H_
+#define REST_BATCHEXECUTOR_H_
+
+#include <pplx/pplxtasks.h>
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace giga
+{
+
+/**
+ * The outcome of one item of a batch: either its value or the error it raised.
+ */
+template<typename T>
+struct BatchResult
+{
+    std::shared_ptr<T> value = nullptr;
+    std::exception_ptr error = nullptr;
+
+    bool
+    ok () const
+    {
+        return error == nullptr;
+    }
+
+    /**
+     * @brief The value, or rethrows the error.
+     */
+    std::shared_ptr<T>
+    get () const
+    {
+        if (error != nullptr)
+        {
+            std::rethrow_exception(error);
+        }
+        return value;
+    }
+};
+
+/**
+ * Runs many requests with at most ```maxConcurrency()``` of them in flight.
+ *
+ * The results are in the order of the calls, and a failing call does not stop the others.
+ * Any ```HttpClient::request<T>()``` can be batched, as long as it is wrapped in a call taking the item index.
+ */
+class BatchExecutor final
+{
+public:
+    static constexpr std::size_t DEFAULT_CONCURRENCY = 8u;
+
+    template<typename T>
+    using Call = std::function<pplx::task<std::shared_ptr<T>>(std::size_t)>;
+
+public:
+    explicit BatchExecutor (std::size_t maxConcurrency = DEFAULT_CONCURRENCY);
+    ~BatchExecutor ()                               = default;
+    BatchExecutor (const BatchExecutor&)            = default;
+    BatchExecutor (BatchExecutor&&)                 = default;
+    BatchExecutor& operator= (const BatchExecutor&) = default;
+    BatchExecutor& operator= (BatchExecutor&&)      = default;
+
+    /**
+     * @brief Calls ```call(0)``` to ```call(count - 1)```, the result of ```call(i)``` being at index ```i```.
+     */
+    template<typename T> pplx::task<std::vector<BatchResult<T>>>
+    run (std::size_t count, Call<T> call) const;
+
+    std::size_t
+    maxConcurrency () const;
+
+private:
+    template<typename T>
+    struct State
+    {
+        std::mutex                                               mut;
+        Call<T>                                                  call;
+        std::vector<BatchResult<T>>                              results;   // in the order of the calls
+        std::size_t                                              next;      // the next call to start
+        std::size_t                                              remaining; // the calls not done yet
+        pplx::task_completion_event<std::vector<BatchResult<T>>> done;
+    };
+
+    template<typename T> static void
+    runNext (std::shared_ptr<State<T>> state);
+
+private:
+    std::size_t _maxConcurrency;
+};
+
+template<typename T>
+pplx::task<std::vector<BatchResult<T>>>
+BatchExecutor::run (std::size_t count, Call<T> call) const
+{
+    if (count == 0u)
+    {
+        return pplx::task_from_result(std::vector<BatchResult<T>>{});
+    }
+
+    auto state       = std::make_shared<State<T>>();
+    state->call      = std::move(call);
+    state->results.resize(count);
+    state->next      = 0u;
+    state->remaining = count;
+
+    auto result  = pplx::create_task(state->done);
+    auto workers = std::min(count, _maxConcurrency);
+    for (auto i = std::size_t{0u}; i < workers; ++i)
+    {
+        runNext(state);
+    }
+    return result;
+}
+
+template<typename T>
+void
+BatchExecutor::runNext (std::shared_ptr<State<T>> state)
+{
+    auto index = std::size_t{0u};
+    {
+        std::lock_guard<std::mutex> l{state->mut};
+        if (state->next == state->results.size())
+        {
+            return;
+        }
+        index = state->next++;
+    }
+
+    auto sent = pplx::task<std::shared_ptr<T>>{};
+    try
+    {
+        sent = state->call(index);
+    }
+    catch (...)
+    {
+        sent = pplx::task_from_exception<std::shared_ptr<T>>(std::current_exception());
+    }
+
+    sent.then([state, index](pplx::task<std::shared_ptr<T>> previous) {
+        auto item = BatchResult<T>{};
+        try
+        {
+            item.value = previous.get();
+        }
+        catch (...)
+        {
+            item.error = std::current_exception();
+        }
+
+        auto last = false;
+        {
+            std::lock_guard<std::mutex> l{state->mut};
+            state->results[index] = std::move(item);
+            last = --state->remaining == 0u;
+        }
+        if (last)
+        {
+            state->done.set(std::move(state->results));
+        }
+        else
+        {
+            runNext(state);
+        }
+    });
+}
+
+}  // namespace giga
+
+#endif /* REST_BATCHEXECUTOR_H_ */
@@ -0,0 +1,215 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ClientPool.h"
+
+#include <algorithm>
+
+using web::http::client::http_client;
+using web::http::http_request;
+using web::http::http_response;
+using web::http::status_codes;
+using std::chrono::steady_clock;
+using utility::string_t;
+
+namespace giga
+{
+
+ClientPool::ClientPool (web::http::client::http_client_config config) :
+        _mut{}, _config{std::move(config)}, _limits{}, _hosts{}
+{
+}
+
+pplx::task<http_response>
+ClientPool::request (const string_t& host, http_request msg)
+{
+    auto self = shared_from_this();
+    return acquire(host).then([self, host, msg](std::shared_ptr<http_client> http) {
+        try
+        {
+            return http->request(msg).then([self, host, http](pplx::task<http_response> previous) {
+                try
+                {
+                    auto response = previous.get();
+                    auto code     = response.status_code();
+                    self->release(host, http, code != status_codes::BadGateway && code != status_codes::ServiceUnavailable
+                                              && code != status_codes::GatewayTimeout);
+                    return response;
+                }
+                catch (...)
+                {
+                    self->release(host, http, false);
+                    throw;
+                }
+            });
+        }
+        catch (...)
+        {
+            self->release(host, http, false);
+            throw;
+        }
+    });
+}
+
+void
+ClientPool::setLimits (const Limits& limits)
+{
+    std::lock_guard<std::mutex> l{_mut};
+    _limits = limits;
+}
+
+ClientPool::Limits
+ClientPool::limits () const
+{
+    std::lock_guard<std::mutex> l{_mut};
+    return _limits;
+}
+
+ClientPool::HostStats
+ClientPool::stats (const string_t& host) const
+{
+    std::lock_guard<std::mutex> l{_mut};
+    auto stats = HostStats{};
+    auto it    = _hosts.find(host);
+    if (it == _hosts.end())
+    {
+        return stats;
+    }
+    auto now             = steady_clock::now();
+    stats.inFlight       = it->second.inFlight;
+    stats.waiting        = it->second.waiting.size();
+    stats.requests       = it->second.requests;
+    stats.failures       = it->second.failures;
+    stats.healthyClients = static_cast<std::size_t>(std::count_if(it->second.clients.begin(), it->second.clients.end(),
+        [this, now](const Client& c) {
+            return _limits.maxFailures == 0u || c.failures < _limits.maxFailures || c.setAsideUntil <= now;
+        }));
+    return stats;
+}
+
+pplx::task<std::shared_ptr<http_client>>
+ClientPool::acquire (const string_t& host)
+{
+    pplx::task_completion_event<void> turn;
+    {
+        std::lock_guard<std::mutex> l{_mut};
+        auto& h = _hosts[host];
+        ++h.requests;
+        if (h.inFlight < std::max<std::size_t>(_limits.requestsPerHost, 1u))
+        {
+            ++h.inFlight;
+            return pplx::task_from_result(pick(host));
+        }
+        h.waiting.push_back(turn);
+    }
+
+    // the turn is handed over by release(): it is already counted in h.inFlight
+    auto self = shared_from_this();
+    return pplx::create_task(turn).then([self, host]() {
+        std::lock_guard<std::mutex> l{self->_mut};
+        return self->pick(host);
+    });
+}
+
+std::shared_ptr<http_client>
+ClientPool::pick (const string_t& host)
+{
+    auto& h = _hosts[host];
+    while (h.clients.size() < std::max<std::size_t>(_limits.clientsPerHost, 1u))
+    {
+        h.clients.push_back(Client{std::make_shared<http_client>(host, _config), 0u, 0u, {}});
+    }
+
+    auto    now     = steady_clock::now();
+    Client* best    = nullptr;
+    Client* soonest = nullptr; // the first to come back, when all are set aside
+    for (auto& c : h.clients)
+    {
+        if (_limits.maxFailures > 0u && c.failures >= _limits.maxFailures)
+        {
+            if (now < c.setAsideUntil)
+            {
+                if (soonest == nullptr || c.setAsideUntil < soonest->setAsideUntil)
+                {
+                    soonest = &c;
+                }
+                continue;
+            }
+            // tried again, on new connections when the old ones are not used anymore:
+            // one more failure sets it aside again
+            if (c.inFlight == 0u)
+            {
+                c.http = std::make_shared<http_client>(host, _config);
+            }
+            c.failures = _limits.maxFailures - 1u;
+        }
+        if (best == nullptr || c.inFlight < best->inFlight)
+        {
+            best = &c;
+        }
+    }
+    if (best == nullptr)
+    {
+        best = soonest;
+    }
+    ++best->inFlight;
+    return best->http;
+}
+
+void
+ClientPool::release (const string_t& host, const std::shared_ptr<http_client>& http, bool healthy)
+{
+    pplx::task_completion_event<void> next;
+    auto handOver = false;
+    {
+        std::lock_guard<std::mutex> l{_mut};
+        auto& h = _hosts[host];
+        auto  c = std::find_if(h.clients.begin(), h.clients.end(), [&http](const Client& c) { return c.http == http; });
+        if (c != h.clients.end())
+        {
+            --c->inFlight;
+            if (healthy)
+            {
+                c->failures = 0u;
+            }
+            else if (++c->failures == _limits.maxFailures)
+            {
+                c->setAsideUntil = steady_clock::now() + _limits.cooldown;
+            }
+        }
+        if (!healthy)
+        {
+            ++h.failures;
+        }
+
+        if (!h.waiting.empty() && h.inFlight <= std::max<std::size_t>(_limits.requestsPerHost, 1u))
+        {
+            next = h.waiting.front();
+            h.waiting.pop_front();
+            handOver = true;
+        }
+        else
+        {
+            --h.inFlight;
+        }
+    }
+    if (handOver)
+    {
+        next.set();
+    }
+}
+
+}  // namespace giga
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef REST_CLIENTPOOL_H_
+#define REST_CLIENTPOOL_H_
+
+#include <cpprest/http_client.h>
+#include <pplx/pplxtasks.h>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace giga
+{
+
+/**
+ * The ```http_client```s of the API requests, several per host.
+ *
+ * A request goes to the healthy client with the fewest requests in flight. A client failing
+ * ```Limits::maxFailures``` times in a row (no reply, or a 502/503/504) is set aside for
+ * ```Limits::cooldown```, then recreated (new connections) once its last request is done.
+ * Beyond ```Limits::requestsPerHost``` requests in flight, the others wait for their turn.
+ *
+ * The clients carry no credentials (see ```TokenManager```): a new token never recreates them.
+ */
+class ClientPool final : public std::enable_shared_from_this<ClientPool>
+{
+public:
+    struct Limits
+    {
+        std::size_t               clientsPerHost  = 4u;
+        std::size_t               requestsPerHost = 32u;
+        unsigned                  maxFailures     = 3u;
+        std::chrono::milliseconds cooldown        = std::chrono::seconds{10};
+    };
+
+    struct HostStats
+    {
+        std::size_t inFlight       = 0u;
+        std::size_t waiting        = 0u;
+        std::size_t healthyClients = 0u;
+        uint64_t    requests       = 0u;
+        uint64_t    failures       = 0u;
+    };
+
+public:
+    explicit
+    ClientPool (web::http::client::http_client_config config);
+    ~ClientPool ()                            = default;
+    ClientPool (const ClientPool&)            = delete;
+    ClientPool (ClientPool&&)                 = delete;
+    ClientPool& operator= (const ClientPool&) = delete;
+    ClientPool& operator= (ClientPool&&)      = delete;
+
+    /**
+     * @brief Send ```msg``` to ```host``` (e.g. ```https://giga.gg```).
+     */
+    pplx::task<web::http::http_response>
+    request (const utility::string_t& host, web::http::http_request msg);
+
+    /**
+     * @brief Change the limits. The clients already created are kept.
+     */
+    void
+    setLimits (const Limits& limits);
+
+    Limits
+    limits () const;
+
+    HostStats
+    stats (const utility::string_t& host) const;
+
+private:
+    struct Client
+    {
+        std::shared_ptr<web::http::client::http_client> http;
+        std::size_t                                     inFlight;
+        unsigned                                        failures;
+        std::chrono::steady_clock::time_point           setAsideUntil;
+    };
+
+    struct Host
+    {
+        std::vector<Client>                             clients;
+        std::deque<pplx::task_completion_event<void>>   waiting;
+        std::size_t                                     inFlight;
+        uint64_t                                        requests;
+        uint64_t                                        failures;
+    };
+
+    pplx::task<std::shared_ptr<web::http::client::http_client>>
+    acquire (const utility::string_t& host);
+
+    std::shared_ptr<web::http::client::http_client>
+    pick (const utility::string_t& host);
+
+    void
+    release (const utility::string_t& host, const std::shared_ptr<web::http::client::http_client>& http, bool healthy);
+
+private:
+    mutable std::mutex                          _mut;
+    const web::http::client::http_client_config _config;
+    Limits                                      _limits;
+    std::map<utility::string_t, Host>           _hosts;
+};
+
+}  // namespace giga
+
+#endif /* REST_CLIENTPOOL_H_ */
@@ -17,6 +17,7 @@
 #include <cpprest/http_client.h>
 #include <boost/regex.hpp>
 #include <chrono>
+#include <vector>
 
 #include "Empty.h"
 #include "JsonObj.h"
@@ -28,11 +29,13 @@
 using namespace web::http;
 using namespace web::http::client;
 using namespace web::http::oauth2::experimental;
-using std::chrono::high_resolution_clock;
 using utility::string_t;
+using giga::TokenManager;
 
 namespace {
 
+constexpr int64_t DEFAULT_TOKEN_LIFETIME = 3600; // seconds, when the server does not tell
+
 web::http::client::http_client_config getConfig() {
     auto config = web::http::client::http_client_config{};
 #ifdef USE_DEV_GG
@@ -41,23 +44,50 @@ web::http::client::http_client_config getConfig() {
     return config;
 }
 
+TokenManager::Token
+tokenOf (const oauth2_config& config)
+{
+    auto expiresIn = config.token().expires_in();
+    return TokenManager::Token{config.token().access_token(),
+        std::chrono::steady_clock::now() + std::chrono::seconds{expiresIn > 0 ? expiresIn : DEFAULT_TOKEN_LIFETIME}};
 }
 
-namespace giga
+/**
+ * The cached replies that a write on ```uri``` may change.
+ * A node write also changes the listing of its parent (which is not in the uri),
+ * and a user write the reply of ```me```.
+ */
+std::vector<string_t>
+invalidatedBy (const string_t& uri)
 {
+    auto api  = string_t{giga::HttpClient::API};
+    auto path = uri.substr(0, uri.find(U('?')));
+    if (path.compare(0, api.size(), api) != 0)
+    {
+        return {path};
+    }
+    auto resource = path.substr(api.size(), path.find(U('/'), api.size()) - api.size());
+    if (resource == U("nodes"))
+    {
+        return {api + U("nodes")};
+    }
+    if (resource == U("users") || resource == U("me"))
+    {
+        return {api + U("users"), api + U("me")};
+    }
+    return {path};
+}
 
-class RefreshingState
+}
+
+namespace giga
 {
-public:
-    bool                              isRefreshing  = false;
-    high_resolution_clock::time_point tokenExpireAt = {};
-    mutable std::mutex                mut           = {};
-};
 
 HttpClient::HttpClient () :
-        _http (Config::get().apiHost(), getConfig()), _rstate{std::make_shared<RefreshingState>()},
-        _userAgent{U(GIGA_UA)},
-        _accessToken{}
+        _clients{std::make_shared<ClientPool>(getConfig())}, _tokens{std::make_shared<TokenManager>()},
+        _coalescer{std::make_shared<RequestCoalescer>()},
+        _cache{std::make_shared<ResponseCache>()},
+        _userAgent{U(GIGA_UA)}
 {
 }
 
@@ -105,7 +135,7 @@ HttpClient::authenticate (const string_t& login, const string_t& password)
     msg.set_body(JSonSerializer::toString(body), JSON_CONTENT_TYPE);
     msg.headers().add(header_names::user_agent, _userAgent);
 
-    auto request = http().request(msg).then([=](web::http::http_response response) {
+    auto request = dispatch(msg).then([=](web::http::http_response response) {
         onRequest<Empty>(response);
         auto headers = response.headers();
 
@@ -126,7 +156,7 @@ HttpClient::authenticate (const string_t& login, const string_t& password)
         if (it != headers.end()) {
             r.headers().add(U("Cookie"), it->second);
         }
-        auto request = http().request(r).then([=](web::http::http_response response) -> string_t {
+        auto request = dispatch(r).then([=](web::http::http_response response) -> string_t {
             auto redirect = onRequest<Redirect>(response);
             return redirect.redirect;
         });
@@ -138,15 +168,21 @@ HttpClient::authenticate (const string_t& login, const string_t& password)
     auto uri = uri_builder{request.get()}.to_uri();
     m_oauth2_config.token_from_redirected_uri(uri).wait();
 
-
-    // regenerate client, with the oauth2 config.
-    auto config = getConfig();
-    config.set_oauth2(m_oauth2_config);
-
-    std::lock_guard<std::mutex> l(_rstate->mut);
-    _http = {Config::get().apiHost(), config};
-    _rstate->tokenExpireAt = std::chrono::high_resolution_clock::now() + std::chrono::seconds{3600};
-    _accessToken = config.oauth2()->token().access_token();
+    // only the refreshes use it, one at a time (see TokenManager)
+    auto oauth2 = std::make_shared<oauth2_config>(m_oauth2_config);
+    _cache->clear(); // the replies of the previous account
+    _tokens->reset(tokenOf(*oauth2), [oauth2]() {
+        auto refreshToken = oauth2->token().refresh_token();
+        oauth2->token_from_refresh().get();
+        if (oauth2->token().refresh_token().empty() && !refreshToken.empty())
+        {
+            GIGA_DEBUG_LOG(debug, "Keep the refresh token: " + refreshToken);
+            auto token = oauth2->token();
+            token.set_refresh_token(refreshToken);
+            oauth2->set_token(token);
+        }
+        return tokenOf(*oauth2);
+    });
 }
 
 void
@@ -188,81 +224,126 @@ HttpClient::throwHttpError(unsigned short status, web::json::value&& json) const
     }
 }
 
-web::http::client::http_client&
-HttpClient::http ()
+pplx::task<http_response>
+HttpClient::dispatch (http_request msg)
 {
-    std::lock_guard<std::mutex> l{_rstate->mut};
-    return _http;
+    return _clients->request(Config::get().apiHost(), std::move(msg));
 }
 
-pplx::task<void>
-HttpClient::refreshToken()
+pplx::task<http_response>
+HttpClient::send (const method& mtd, const string_t& uri, boost::optional<string_t> body, http_headers headers)
 {
-  GIGA_DEBUG_LOG(debug, "Refreshing access token (maybe ?)");
-    bool shouldRefresh = false;
-    {
-      std::lock_guard<std::mutex> l{_rstate->mut};
-      shouldRefresh = !_rstate->isRefreshing
-             && _http.client_config().oauth2() != nullptr;
-        // shouldRefresh = !_rstate->isRefreshing
-        //                     && _http.client_config().oauth2() != nullptr
-        //                     && _rstate->tokenExpireAt < (std::chrono::high_resolution_clock::now() + std::chrono::seconds{300}); // gets 300s to do the refresh
-        _rstate->isRefreshing = shouldRefresh || _rstate->isRefreshing;
-
-
-    }
+    auto userAgent   = _userAgent;
+    auto makeRequest = [mtd, uri, body, headers, userAgent](const std::shared_ptr<const TokenManager::Token>& token) {
+        http_request msg(mtd);
+        msg.set_request_uri(uri);
+        if (body)
+        {
+            msg.set_body(*body, JSON_CONTENT_TYPE);
+        }
+        for (const auto& header : headers)
+        {
+            msg.headers().add(header.first, header.second);
+        }
+        msg.headers().add(header_names::user_agent, userAgent);
+        if (token != nullptr)
+        {
+            msg.headers().add(header_names::authorization, U("Bearer ") + token->accessToken);
+        }
+        return msg;
+    };
 
-    if (shouldRefresh)
-    {
-        auto rstate        = _rstate;
-        auto& http         = _http;
-        auto& accessToken  = _accessToken;
-        auto& config       = _http.client_config();
-        auto& refreshToken = _http.client_config().oauth2()->token().refresh_token();
-
-        //
-        // All this is an ugly hack to make sure the refresh works
-        // cf: const_cast etc ...
-        //
-
-        // config and refreshToken are copied here:
-        return pplx::create_task([rstate, &http, &accessToken, config, refreshToken]() {
-            try
+    auto tokens = _tokens;
+    auto sent   = tokens->valid().then([this, tokens, makeRequest](std::shared_ptr<const TokenManager::Token> token) {
+        return dispatch(makeRequest(token)).then([this, tokens, makeRequest, token](http_response response) {
+            if (response.status_code() != status_codes::Unauthorized || token == nullptr)
             {
-                GIGA_DEBUG_LOG(debug, "Refreshing access token with: " + refreshToken);
-                config.oauth2()->token_from_refresh().get();
-
-                std::lock_guard<std::mutex> l{ rstate->mut };
-                if (config.oauth2()->token().refresh_token().empty() && !refreshToken.empty())
+                return pplx::task_from_result(response);
+            }
+            // one refresh (shared with the other rejected requests), then one retry
+            return tokens->rejected(token->accessToken).then([this, makeRequest, token, response](std::shared_ptr<const TokenManager::Token> renewed) {
+                if (renewed == nullptr || renewed->accessToken == token->accessToken)
                 {
-                    GIGA_DEBUG_LOG(debug, "Set new refresh token to: " + refreshToken);
-                    const_cast<oauth2_token&>(config.oauth2()->token()).set_refresh_token(refreshToken);
+                    return pplx::task_from_result(response);
                 }
-                rstate->tokenExpireAt = std::chrono::high_resolution_clock::now() + std::chrono::seconds{ 3600 };
-                accessToken = config.oauth2()->token().access_token();
-                http = {Config::get().apiHost(), config};
-
-                rstate->isRefreshing = false;
-            }
-            catch (std::exception e)
-            {
-                // Ignore errors here (no throw)
-                // because the token may be still valid
-                GIGA_DEBUG_LOG(error, utils::exceptionInfos());
-                std::lock_guard<std::mutex> l{ rstate->mut };
-                rstate->isRefreshing = false;
-            }
+                return dispatch(makeRequest(renewed));
+            });
         });
+    });
 
+    if (mtd == methods::GET || !_cache->limits().invalidateOnWrite)
+    {
+        return sent;
     }
-    return pplx::create_task([](){});
+    // dropped once the change is done, so that no GET stores the previous state meanwhile
+    auto cache = _cache;
+    auto paths = invalidatedBy(uri);
+    return sent.then([cache, paths](pplx::task<http_response> previous) {
+        for (const auto& path : paths)
+        {
+            cache->invalidate(path);
+        }
+        return previous.get();
+    });
+}
+
+pplx::task<void>
+HttpClient::refreshToken()
+{
+    return _tokens->valid().then([](std::shared_ptr<const TokenManager::Token>) {});
+}
+
+pplx::task<void>
+HttpClient::refreshRejectedToken(const string_t& accessToken)
+{
+    return _tokens->rejected(accessToken).then([](std::shared_ptr<const TokenManager::Token>) {});
 }
 
 utility::string_t
 HttpClient::accessToken() const
 {
-    std::lock_guard<std::mutex> l{ _rstate->mut };
-    return _accessToken;
+    auto token = _tokens->current();
+    return token != nullptr ? token->accessToken : string_t{};
+}
+
+void
+HttpClient::setClientLimits(const ClientPool::Limits& limits)
+{
+    _clients->setLimits(limits);
+}
+
+ClientPool::HostStats
+HttpClient::clientStats() const
+{
+    return _clients->stats(Config::get().apiHost());
+}
+
+RequestCoalescer::Stats
+HttpClient::coalescingStats() const
+{
+    return _coalescer->stats();
+}
+
+void
+HttpClient::setCacheLimits(const ResponseCache::Limits& limits)
+{
+    _cache->setLimits(limits);
+    if (limits.maxBytes == 0u)
+    {
+        _cache->clear();
+    }
+}
+
+ResponseCache::Stats
+HttpClient::cacheStats() const
+{
+    return _cache->stats();
+}
+
+void
+HttpClient::clearCache()
+{
+    _cache->clear();
 }
 
 void
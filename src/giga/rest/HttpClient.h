@@ -19,15 +19,20 @@
 
 #include "JsonUnserializer.h"
 #include "JsonSerializer.h"
+#include "ClientPool.h"
 #include "HttpErrors.h"
+#include "RequestCoalescer.h"
+#include "ResponseCache.h"
+#include "TokenManager.h"
 
 #include <cpprest/http_client.h>
+#include <boost/optional.hpp>
+#include <functional>
+#include <memory>
 
 namespace giga
 {
 
-class RefreshingState;
-
 class HttpClient final
 {
 public:
@@ -65,12 +70,21 @@ public:
     template<typename T, typename U> web::uri_builder
     uri (const utility::string_t& resource, const T& id, const utility::string_t& subResource, const U& subId) const;
 
+    /**
+     * @brief Send the request and parse its reply. A GET already in flight is shared (see ```RequestCoalescer```).
+     */
     template<typename T> pplx::task<std::shared_ptr<T>>
     request (const web::http::method &mtd, web::uri_builder uri);
 
     template<typename T, class U> pplx::task<std::shared_ptr<T>>
     request (const web::http::method &mtd, web::uri_builder uri, U&& bodyData);
 
+    /**
+     * @brief A GET request served from the ```ResponseCache``` when the reply did not change (HTTP 304).
+     */
+    template<typename T> pplx::task<std::shared_ptr<T>>
+    cachedRequest (web::uri_builder uri);
+
     template<class U>
     pplx::task<web::http::http_response>
     rawRequest(const web::http::method &mtd, web::uri_builder uri, U&& bodyData);
@@ -87,24 +101,59 @@ public:
     void
     throwHttpError(unsigned short status, web::json::value&& json) const;
 
+    /**
+     * @brief Make sure the access token is valid: ready at once, unless it is about to expire.
+     */
     pplx::task<void>
     refreshToken();
 
+    /**
+     * @brief ```accessToken``` was rejected (HTTP 401): renew it, unless it was already.
+     */
+    pplx::task<void>
+    refreshRejectedToken(const utility::string_t& accessToken);
+
     utility::string_t
     accessToken() const;
 
     void
     setUserAgent(utility::string_t userAgent);
 
+    /**
+     * @brief Set how many clients and requests in flight the API host gets (see ```ClientPool```).
+     */
+    void
+    setClientLimits(const ClientPool::Limits& limits);
+
+    ClientPool::HostStats
+    clientStats() const;
+
+    RequestCoalescer::Stats
+    coalescingStats() const;
+
+    void
+    setCacheLimits(const ResponseCache::Limits& limits);
+
+    ResponseCache::Stats
+    cacheStats() const;
+
+    void
+    clearCache();
+
 private:
-    web::http::client::http_client&
-    http ();
+    pplx::task<web::http::http_response>
+    dispatch (web::http::http_request msg);
+
+    pplx::task<web::http::http_response>
+    send (const web::http::method& mtd, const utility::string_t& uri, boost::optional<utility::string_t> body,
+          web::http::http_headers headers = web::http::http_headers{});
 
 private:
-    web::http::client::http_client   _http;
-    std::shared_ptr<RefreshingState> _rstate;
+    std::shared_ptr<ClientPool>      _clients;  // the token is set on each request (see TokenManager)
+    std::shared_ptr<TokenManager>    _tokens;
+    std::shared_ptr<RequestCoalescer> _coalescer;
+    std::shared_ptr<ResponseCache>   _cache;
     utility::string_t                _userAgent;
-    utility::string_t                _accessToken;
 };
 
 template<typename T>
@@ -138,40 +187,34 @@ HttpClient::rawRequest(const web::http::method &mtd, web::uri_builder uri, U&& b
    auto json      = web::json::value::object();
    auto data      = JSonSerializer{json}.toString(std::move(bodyData));
    auto uriString = uri.to_string();
-   GIGA_DEBUG_LOG(trace, mtd + U("  ") + uri.to_string() + U(" ") + data);
+   GIGA_DEBUG_LOG(trace, mtd + U("  ") + uriString + U(" ") + data);
 
-   web::http::http_request msg(mtd);
-   msg.set_request_uri(uri.to_string());
-   msg.set_body(JSonSerializer{json}.toString(std::move(bodyData)), JSON_CONTENT_TYPE);
-   msg.headers().add(web::http::header_names::user_agent, _userAgent);
-
-   return refreshToken().then([=]() {
-       return http().request(msg);
-   });
+   return send(mtd, uriString, std::move(data));
 }
 
 inline pplx::task<web::http::http_response>
 HttpClient::rawRequest (const web::http::method &mtd, web::uri_builder uri)
 {
-   GIGA_DEBUG_LOG(trace, mtd + U("  ") + uri.to_string());
    auto uriString = uri.to_string();
+   GIGA_DEBUG_LOG(trace, mtd + U("  ") + uriString);
 
-   web::http::http_request msg(mtd);
-   msg.set_request_uri(uri.to_string());
-   msg.headers().add(web::http::header_names::user_agent, _userAgent);
-
-   return refreshToken().then([=]() {
-       return http().request(msg);
-   });
+   return send(mtd, uriString, boost::none);
 }
 
 template<typename T>
 pplx::task<std::shared_ptr<T>>
 HttpClient::request (const web::http::method &mtd, web::uri_builder uri)
 {
-   return rawRequest(mtd, uri).then([=](web::http::http_response response) {
-       return onRequestPtr<T>(response);
-   });
+   auto fetch = std::function<pplx::task<std::shared_ptr<T>>()>{[=]() {
+       return rawRequest(mtd, uri).then([=](web::http::http_response response) {
+           return onRequestPtr<T>(response);
+       });
+   }};
+   if (mtd != web::http::methods::GET)
+   {
+       return fetch();
+   }
+   return _coalescer->join<T>(uri.to_string(), fetch);
 }
 
 template<typename T, class U>
@@ -183,6 +226,54 @@ HttpClient::request (const web::http::method &mtd, web::uri_builder uri, U&& bod
    });
 }
 
+template<typename T>
+pplx::task<std::shared_ptr<T>>
+HttpClient::cachedRequest (web::uri_builder uri)
+{
+   auto key   = uri.to_string();
+   auto cache = _cache;
+   auto fetch = std::function<pplx::task<std::shared_ptr<T>>()>{[=]() -> pplx::task<std::shared_ptr<T>> {
+       auto cached = cache->find<T>(key);
+       if (cached.value != nullptr && cached.fresh)
+       {
+           return pplx::task_from_result(std::make_shared<T>(*cached.value));
+       }
+
+       auto headers = web::http::http_headers{};
+       if (cached.value != nullptr && !cached.validators.etag.empty())
+       {
+           headers.add(web::http::header_names::if_none_match, cached.validators.etag);
+       }
+       if (cached.value != nullptr && !cached.validators.lastModified.empty())
+       {
+           headers.add(web::http::header_names::if_modified_since, cached.validators.lastModified);
+       }
+       GIGA_DEBUG_LOG(trace, U("GET  ") + key);
+       return send(web::http::methods::GET, key, boost::none, std::move(headers)).then([=](web::http::http_response response) {
+           if (response.status_code() == web::http::status_codes::NotModified && cached.value != nullptr)
+           {
+               cache->revalidated(key);
+               return std::make_shared<T>(*cached.value);
+           }
+           auto result     = onRequestPtr<T>(response);
+           auto validators = ResponseCache::Validators{};
+           response.headers().match(web::http::header_names::etag, validators.etag);
+           response.headers().match(web::http::header_names::last_modified, validators.lastModified);
+           if (validators.etag.empty() && validators.lastModified.empty())
+           {
+               cache->missed();
+           }
+           else
+           {
+               cache->store<T>(key, std::make_shared<const T>(*result), std::move(validators),
+                               static_cast<std::size_t>(response.headers().content_length()));
+           }
+           return result;
+       });
+   }};
+   return _coalescer->join<T>(key, fetch);
+}
+
 template<typename T>
 std::shared_ptr<T>
 HttpClient::onRequestPtr (web::http::http_response response) const
@@ -0,0 +1,152 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef REST_REQUESTCOALESCER_H_
+#define REST_REQUESTCOALESCER_H_
+
+#include <cpprest/details/basic_types.h>
+#include <pplx/pplxtasks.h>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <typeindex>
+#include <utility>
+
+namespace giga
+{
+
+/**
+ * Shares the identical requests in flight (single-flight).
+ *
+ * The first caller of a key fetches the result; those arriving before it is there wait on the same fetch.
+ * Each of them gets its own copy of the result, so that they can modify it.
+ * A key is only shared while it is in flight: nothing is cached.
+ */
+class RequestCoalescer final : public std::enable_shared_from_this<RequestCoalescer>
+{
+public:
+    struct Stats
+    {
+        uint64_t hits   = 0u; // requests served by a fetch in flight
+        uint64_t misses = 0u; // fetches
+    };
+
+public:
+    RequestCoalescer ();
+    ~RequestCoalescer ()                                  = default;
+    RequestCoalescer (const RequestCoalescer&)            = delete;
+    RequestCoalescer (RequestCoalescer&&)                 = delete;
+    RequestCoalescer& operator= (const RequestCoalescer&) = delete;
+    RequestCoalescer& operator= (RequestCoalescer&&)      = delete;
+
+    /**
+     * @brief The result of ```fetch()```, called unless the same ```key``` (for the same ```T```) is in flight.
+     */
+    template<typename T> pplx::task<std::shared_ptr<T>>
+    join (const utility::string_t& key, const std::function<pplx::task<std::shared_ptr<T>>()>& fetch);
+
+    Stats
+    stats () const;
+
+private:
+    typedef std::pair<std::type_index, utility::string_t> Key;
+
+    struct Flight
+    {
+        std::shared_ptr<void> task;      // pplx::task<std::shared_ptr<T>>
+        std::size_t           followers;
+    };
+
+private:
+    mutable std::mutex     _mut;
+    std::map<Key, Flight>  _flights;
+    std::atomic<uint64_t>  _hits;
+    std::atomic<uint64_t>  _misses;
+};
+
+template<typename T>
+pplx::task<std::shared_ptr<T>>
+RequestCoalescer::join (const utility::string_t& key, const std::function<pplx::task<std::shared_ptr<T>>()>& fetch)
+{
+    typedef pplx::task<std::shared_ptr<T>> Task;
+
+    auto copy = [](std::shared_ptr<T> result) {
+        return result == nullptr ? result : std::make_shared<T>(*result);
+    };
+
+    auto flightKey = Key{std::type_index{typeid(T)}, key};
+    pplx::task_completion_event<std::shared_ptr<T>> done;
+    {
+        std::lock_guard<std::mutex> l{_mut};
+        auto it = _flights.find(flightKey);
+        if (it != _flights.end())
+        {
+            ++_hits;
+            ++it->second.followers;
+            return std::static_pointer_cast<Task>(it->second.task)->then(copy);
+        }
+        ++_misses;
+        _flights.emplace(flightKey, Flight{std::make_shared<Task>(pplx::create_task(done)), 0u});
+    }
+
+    auto fetched = Task{};
+    try
+    {
+        fetched = fetch();
+    }
+    catch (...)
+    {
+        fetched = pplx::task_from_exception<std::shared_ptr<T>>(std::current_exception());
+    }
+
+    auto self = shared_from_this();
+    return fetched.then([self, flightKey, done, copy](Task previous) {
+        auto followers = std::size_t{0u};
+        {
+            std::lock_guard<std::mutex> l{self->_mut};
+            auto it = self->_flights.find(flightKey);
+            followers = it->second.followers;
+            self->_flights.erase(it);
+        }
+        try
+        {
+            auto result = previous.get();
+            if (followers == 0u)
+            {
+                return result; // nobody else has it
+            }
+            done.set(result);
+            return copy(result);
+        }
+        catch (...)
+        {
+            // only set when observed: an unobserved exception is fatal to pplx
+            if (followers > 0u)
+            {
+                done.set_exception(std::current_exception());
+            }
+            throw;
+        }
+    });
+}
+
+}  // namespace giga
+
+#endif /* REST_REQUESTCOALESCER_H_ */
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ResponseCache.h"
+
+using std::chrono::steady_clock;
+using utility::string_t;
+
+namespace giga
+{
+
+constexpr std::size_t ResponseCache::UNKNOWN_SIZE;
+
+ResponseCache::ResponseCache () :
+        _mut{}, _limits{}, _entries{}, _lru{}, _bytes{0u}, _stats{}
+{
+}
+
+ResponseCache::Lookup<void>
+ResponseCache::findEntry (const string_t& key, std::type_index type)
+{
+    std::lock_guard<std::mutex> l{_mut};
+    auto found = Lookup<void>{nullptr, Validators{}, false};
+    auto it    = _entries.find(key);
+    if (it == _entries.end() || it->second.type != type)
+    {
+        return found;
+    }
+
+    auto age = steady_clock::now() - it->second.validatedAt;
+    if (age > _limits.ttl)
+    {
+        erase(it);
+        return found;
+    }
+    found.value      = it->second.value;
+    found.validators = it->second.validators;
+    found.fresh      = age < _limits.freshFor;
+    if (found.fresh)
+    {
+        ++_stats.fresh;
+    }
+    _lru.splice(_lru.begin(), _lru, it->second.lru);
+    return found;
+}
+
+void
+ResponseCache::storeEntry (const string_t& key, std::type_index type, std::shared_ptr<const void> value,
+                           Validators validators, std::size_t bytes)
+{
+    std::lock_guard<std::mutex> l{_mut};
+    ++_stats.misses;
+    auto it = _entries.find(key);
+    if (it != _entries.end())
+    {
+        erase(it);
+    }
+    bytes = bytes > 0u ? bytes : UNKNOWN_SIZE;
+    if (bytes > _limits.maxBytes)
+    {
+        return;
+    }
+
+    _lru.push_front(key);
+    _entries.emplace(key, Entry{type, std::move(value), std::move(validators), bytes, steady_clock::now(), _lru.begin()});
+    _bytes += bytes;
+    evict();
+}
+
+void
+ResponseCache::revalidated (const string_t& key)
+{
+    std::lock_guard<std::mutex> l{_mut};
+    ++_stats.revalidated;
+    auto it = _entries.find(key);
+    if (it != _entries.end())
+    {
+        it->second.validatedAt = steady_clock::now();
+    }
+}
+
+void
+ResponseCache::missed ()
+{
+    std::lock_guard<std::mutex> l{_mut};
+    ++_stats.misses;
+}
+
+void
+ResponseCache::invalidate (const string_t& path)
+{
+    std::lock_guard<std::mutex> l{_mut};
+    // the keys starting with path are contiguous
+    auto it = _entries.lower_bound(path);
+    while (it != _entries.end() && it->first.compare(0, path.size(), path) == 0)
+    {
+        auto next = std::next(it);
+        if (it->first.size() == path.size() || it->first[path.size()] == U('/') || it->first[path.size()] == U('?'))
+        {
+            erase(it);
+        }
+        it = next;
+    }
+}
+
+void
+ResponseCache::clear ()
+{
+    std::lock_guard<std::mutex> l{_mut};
+    _entries.clear();
+    _lru.clear();
+    _bytes = 0u;
+}
+
+void
+ResponseCache::setLimits (const Limits& limits)
+{
+    std::lock_guard<std::mutex> l{_mut};
+    _limits = limits;
+    evict();
+}
+
+ResponseCache::Limits
+ResponseCache::limits () const
+{
+    std::lock_guard<std::mutex> l{_mut};
+    return _limits;
+}
+
+ResponseCache::Stats
+ResponseCache::stats () const
+{
+    std::lock_guard<std::mutex> l{_mut};
+    auto stats    = _stats;
+    stats.entries = _entries.size();
+    stats.bytes   = _bytes;
+    return stats;
+}
+
+void
+ResponseCache::erase (std::map<string_t, Entry>::iterator it)
+{
+    _bytes -= it->second.bytes;
+    _lru.erase(it->second.lru);
+    _entries.erase(it);
+}
+
+void
+ResponseCache::evict ()
+{
+    while (_bytes > _limits.maxBytes && !_lru.empty())
+    {
+        erase(_entries.find(_lru.back()));
+    }
+}
+
+}  // namespace giga
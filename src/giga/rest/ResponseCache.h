@@ -0,0 +1,174 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef REST_RESPONSECACHE_H_
+#define REST_RESPONSECACHE_H_
+
+#include <cpprest/details/basic_types.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <typeindex>
+
+namespace giga
+{
+
+/**
+ * The parsed replies of the cacheable GET requests, with their validators (```ETag```, ```Last-Modified```).
+ *
+ * An entry is revalidated by a conditional request (```If-None-Match```, ```If-Modified-Since```):
+ * a 304 reply is served from memory, without downloading and parsing the JSON again.
+ * Within ```Limits::freshFor``` of its last validation, an entry is served without any request.
+ * The least recently used entries are dropped beyond ```Limits::maxBytes```.
+ */
+class ResponseCache final
+{
+public:
+    static constexpr std::size_t UNKNOWN_SIZE = 4096u; // the weight of a reply without Content-Length
+
+    struct Limits
+    {
+        std::size_t          maxBytes          = 16u * 1024u * 1024u; // of JSON replies, 0 disables the cache
+        std::chrono::seconds freshFor          = std::chrono::seconds{0};
+        std::chrono::seconds ttl               = std::chrono::seconds{600}; // dropped when not validated since
+        bool                 invalidateOnWrite = true; // a PUT, POST or DELETE drops the entries it may change
+    };
+
+    struct Validators
+    {
+        utility::string_t etag;
+        utility::string_t lastModified;
+    };
+
+    struct Stats
+    {
+        uint64_t    fresh       = 0u; // served without a request
+        uint64_t    revalidated = 0u; // 304 replies
+        uint64_t    misses      = 0u; // full replies
+        std::size_t entries     = 0u;
+        std::size_t bytes       = 0u;
+    };
+
+    template<typename T>
+    struct Lookup
+    {
+        std::shared_ptr<const T> value;      // nullptr when not cached
+        Validators               validators;
+        bool                     fresh;
+    };
+
+public:
+    ResponseCache ();
+    ~ResponseCache ()                               = default;
+    ResponseCache (const ResponseCache&)            = delete;
+    ResponseCache (ResponseCache&&)                 = delete;
+    ResponseCache& operator= (const ResponseCache&) = delete;
+    ResponseCache& operator= (ResponseCache&&)      = delete;
+
+    template<typename T> Lookup<T>
+    find (const utility::string_t& key);
+
+    /**
+     * @brief Keep ```value```, parsed from a reply of ```bytes``` bytes (0 when unknown).
+     */
+    template<typename T> void
+    store (const utility::string_t& key, std::shared_ptr<const T> value, Validators validators, std::size_t bytes);
+
+    /**
+     * @brief A 304 reply: the entry is still valid.
+     */
+    void
+    revalidated (const utility::string_t& key);
+
+    /**
+     * @brief A full reply without validators: nothing to store.
+     */
+    void
+    missed ();
+
+    /**
+     * @brief Drop the entries of ```path``` and below it (e.g. ```/api/1.0/nodes/id``` and ```/api/1.0/nodes/id/nodes```).
+     */
+    void
+    invalidate (const utility::string_t& path);
+
+    void
+    clear ();
+
+    void
+    setLimits (const Limits& limits);
+
+    Limits
+    limits () const;
+
+    Stats
+    stats () const;
+
+private:
+    struct Entry
+    {
+        std::type_index                              type;
+        std::shared_ptr<const void>                  value;
+        Validators                                   validators;
+        std::size_t                                  bytes;
+        std::chrono::steady_clock::time_point        validatedAt;
+        std::list<utility::string_t>::iterator       lru;
+    };
+
+    Lookup<void>
+    findEntry (const utility::string_t& key, std::type_index type);
+
+    void
+    storeEntry (const utility::string_t& key, std::type_index type, std::shared_ptr<const void> value,
+                Validators validators, std::size_t bytes);
+
+    void
+    erase (std::map<utility::string_t, Entry>::iterator it);
+
+    void
+    evict ();
+
+private:
+    mutable std::mutex                       _mut;
+    Limits                                   _limits;
+    std::map<utility::string_t, Entry>       _entries;
+    std::list<utility::string_t>             _lru;     // the most recently used first
+    std::size_t                              _bytes;
+    Stats                                    _stats;
+};
+
+template<typename T>
+ResponseCache::Lookup<T>
+ResponseCache::find (const utility::string_t& key)
+{
+    auto found = findEntry(key, std::type_index{typeid(T)});
+    return Lookup<T>{std::static_pointer_cast<const T>(found.value), std::move(found.validators), found.fresh};
+}
+
+template<typename T>
+void
+ResponseCache::store (const utility::string_t& key, std::shared_ptr<const T> value, Validators validators, std::size_t bytes)
+{
+    storeEntry(key, std::type_index{typeid(T)}, std::move(value), std::move(validators), bytes);
+}
+
+}  // namespace giga
+
+#endif /* REST_RESPONSECACHE_H_ */
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TokenManager.h"
+#include "HttpErrors.h"
+#include "../utils/Utils.h"
+
+using std::chrono::steady_clock;
+
+namespace giga
+{
+
+constexpr std::chrono::seconds TokenManager::REFRESH_AHEAD;
+constexpr std::chrono::seconds TokenManager::EXPIRY_MARGIN;
+constexpr std::chrono::seconds TokenManager::RETRY_DELAY;
+
+TokenManager::TokenManager () :
+        _mut{}, _token{nullptr}, _refresh{nullptr}, _isRefreshing{false}, _refreshing{},
+        _retryAt{}, _refreshCount{0u}
+{
+}
+
+void
+TokenManager::reset (Token token, RefreshFct refresh)
+{
+    std::lock_guard<std::mutex> l{_mut};
+    _refresh = std::move(refresh);
+    _retryAt = {};
+    std::atomic_store(&_token, std::shared_ptr<const Token>{std::make_shared<Token>(std::move(token))});
+}
+
+std::shared_ptr<const TokenManager::Token>
+TokenManager::current () const
+{
+    return std::atomic_load(&_token);
+}
+
+pplx::task<std::shared_ptr<const TokenManager::Token>>
+TokenManager::valid ()
+{
+    auto token = std::atomic_load(&_token);
+    auto now   = steady_clock::now();
+    if (token == nullptr || now + REFRESH_AHEAD < token->expireAt)
+    {
+        return pplx::task_from_result(token);
+    }
+
+    auto renewed = refresh(token);
+    if (now + EXPIRY_MARGIN < token->expireAt)
+    {
+        return pplx::task_from_result(token); // still valid: renewed in the background
+    }
+    return renewed;
+}
+
+pplx::task<std::shared_ptr<const TokenManager::Token>>
+TokenManager::rejected (const utility::string_t& accessToken)
+{
+    auto token = std::atomic_load(&_token);
+    if (token == nullptr || token->accessToken != accessToken)
+    {
+        return pplx::task_from_result(token);
+    }
+    return refresh(token);
+}
+
+uint64_t
+TokenManager::refreshCount () const
+{
+    return _refreshCount;
+}
+
+pplx::task<std::shared_ptr<const TokenManager::Token>>
+TokenManager::refresh (const std::shared_ptr<const Token>& seen)
+{
+    std::lock_guard<std::mutex> l{_mut};
+    auto token = std::atomic_load(&_token);
+    if (_isRefreshing)
+    {
+        return _refreshing;
+    }
+    if (token != seen || _refresh == nullptr || steady_clock::now() < _retryAt)
+    {
+        return pplx::task_from_result(token);
+    }
+
+    _isRefreshing = true;
+    auto self    = shared_from_this();
+    auto refresh = _refresh;
+    _refreshing  = pplx::create_task([self, refresh, token]() {
+        auto renewed = std::shared_ptr<const Token>{nullptr};
+        try
+        {
+            GIGA_DEBUG_LOG(debug, "Refreshing the access token");
+            renewed = std::make_shared<Token>(refresh());
+        }
+        catch (...)
+        {
+            // the current token may still be valid
+            GIGA_DEBUG_LOG(error, utils::exceptionInfos());
+        }
+        ++self->_refreshCount;
+
+        std::lock_guard<std::mutex> l{self->_mut};
+        if (renewed == nullptr)
+        {
+            self->_retryAt = steady_clock::now() + RETRY_DELAY;
+        }
+        else if (std::atomic_load(&self->_token) == token) // not reset() meanwhile
+        {
+            std::atomic_store(&self->_token, renewed);
+        }
+        self->_isRefreshing = false;
+        self->_refreshing   = {}; // it holds this function, holding self
+        return std::atomic_load(&self->_token);
+    });
+    return _refreshing;
+}
+
+}  // namespace giga
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef REST_TOKENMANAGER_H_
+#define REST_TOKENMANAGER_H_
+
+#include <cpprest/details/basic_types.h>
+#include <pplx/pplxtasks.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace giga
+{
+
+/**
+ * Keeps the OAuth access token of a ```HttpClient``` valid.
+ *
+ * The current token is published atomically: a request only loads it (see ```valid()```).
+ * It is renewed ```REFRESH_AHEAD``` before it expires, in the background, while the requests
+ * keep using it. Only when it is about to expire (```EXPIRY_MARGIN```) do they wait for the renewal.
+ * All the callers share the same refresh: a single one is in flight at any time.
+ */
+class TokenManager final : public std::enable_shared_from_this<TokenManager>
+{
+public:
+    struct Token
+    {
+        utility::string_t                     accessToken;
+        std::chrono::steady_clock::time_point expireAt;
+    };
+
+    /**
+     * Gets a new token. Throws on errors.
+     */
+    typedef std::function<Token()> RefreshFct;
+
+    static constexpr std::chrono::seconds REFRESH_AHEAD{300};
+    static constexpr std::chrono::seconds EXPIRY_MARGIN{30};
+    static constexpr std::chrono::seconds RETRY_DELAY{5}; // after a failed refresh
+
+public:
+    TokenManager ();
+    ~TokenManager ()                              = default;
+    TokenManager (const TokenManager&)            = delete;
+    TokenManager (TokenManager&&)                 = delete;
+    TokenManager& operator= (const TokenManager&) = delete;
+    TokenManager& operator= (TokenManager&&)      = delete;
+
+    /**
+     * @brief Use ```token``` (just authenticated), renewed with ```refresh```.
+     */
+    void
+    reset (Token token, RefreshFct refresh);
+
+    /**
+     * @brief The current token, nullptr when not authenticated.
+     */
+    std::shared_ptr<const Token>
+    current () const;
+
+    /**
+     * @brief A token valid for at least ```EXPIRY_MARGIN```, when it can be renewed.
+     * Ready at once, unless it is about to expire.
+     */
+    pplx::task<std::shared_ptr<const Token>>
+    valid ();
+
+    /**
+     * @brief ```accessToken``` was rejected (HTTP 401): get another one.
+     * Nothing is refreshed when the current token is already a newer one.
+     */
+    pplx::task<std::shared_ptr<const Token>>
+    rejected (const utility::string_t& accessToken);
+
+    /**
+     * @brief The number of refreshes done, successful or not.
+     */
+    uint64_t
+    refreshCount () const;
+
+private:
+    pplx::task<std::shared_ptr<const Token>>
+    refresh (const std::shared_ptr<const Token>& seen);
+
+private:
+    mutable std::mutex                       _mut;
+    std::shared_ptr<const Token>             _token;   // std::atomic_load() / std::atomic_store()
+    RefreshFct                               _refresh;
+    bool                                     _isRefreshing;
+    pplx::task<std::shared_ptr<const Token>> _refreshing;
+    std::chrono::steady_clock::time_point    _retryAt;
+    std::atomic<uint64_t>                    _refreshCount;
+};
+
+}  // namespace giga
+
+#endif /* REST_TOKENMANAGER_H_ */
@@ -0,0 +1,204 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GIGA_UTILS_BLOCKINGQUEUE_H_
+#define GIGA_UTILS_BLOCKINGQUEUE_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <utility>
+
+namespace giga
+{
+namespace utils
+{
+
+/**
+ * A blocking FIFO queue for multiple producers and multiple consumers.
+ *
+ * It exposes the same interface as ```moodycamel::BlockingReaderWriterQueue```
+ * (the one used by the ```Downloader```), but any number of threads may
+ * enqueue or dequeue concurrently. Every queue has its own lock, so two
+ * different queues never contend with each other.
+ *
+ * The queue can be bounded (see ```setLimits()```): ```wait_enqueue()``` then blocks
+ * the producers until the consumers make room. ```enqueue()``` never blocks.
+ */
+template <typename T>
+class BlockingQueue final
+{
+public:
+    /** The approximate memory used by an element, in bytes. */
+    typedef std::function<std::size_t(const T&)> WeightFct;
+
+public:
+    BlockingQueue()  = default;
+    ~BlockingQueue() = default;
+
+    BlockingQueue(BlockingQueue&&)                 = delete;
+    BlockingQueue(const BlockingQueue&)            = delete;
+    BlockingQueue& operator=(const BlockingQueue&) = delete;
+    BlockingQueue& operator=(BlockingQueue&&)      = delete;
+
+public:
+    /**
+     * @brief Bound the queue. 0 means no limit.
+     * @param maxItems the maximum number of elements
+     * @param maxBytes the maximum memory used by the elements (as measured by ```weightFct```)
+     *
+     * An element is always accepted by an empty queue, whatever its weight.
+     */
+    void
+    setLimits(std::size_t maxItems, std::size_t maxBytes, WeightFct weightFct)
+    {
+        {
+            std::lock_guard<std::mutex> l{_mut};
+            _maxItems  = maxItems;
+            _maxBytes  = maxBytes;
+            _weightFct = weightFct;
+        }
+        _notFull.notify_all();
+    }
+
+    /**
+     * @brief Enqueue an element, even if the queue is full.
+     */
+    void
+    enqueue(T&& element)
+    {
+        {
+            std::lock_guard<std::mutex> l{_mut};
+            push(std::move(element));
+        }
+        _notEmpty.notify_one();
+    }
+
+    /**
+     * @brief Wait until the queue is not full, then enqueue an element.
+     */
+    void
+    wait_enqueue(T&& element)
+    {
+        {
+            std::unique_lock<std::mutex> l{_mut};
+            _notFull.wait(l, [this]{ return !isFull(); });
+            push(std::move(element));
+        }
+        _notEmpty.notify_one();
+    }
+
+    /**
+     * @brief Wait until the queue is not full.
+     *
+     * Another producer may fill it again before the next ```enqueue()```.
+     */
+    void
+    wait_not_full()
+    {
+        std::unique_lock<std::mutex> l{_mut};
+        _notFull.wait(l, [this]{ return !isFull(); });
+    }
+
+    /**
+     * @brief Wait until an element is available, then dequeue it.
+     */
+    void
+    wait_dequeue(T& element)
+    {
+        {
+            std::unique_lock<std::mutex> l{_mut};
+            _notEmpty.wait(l, [this]{ return !_queue.empty(); });
+            pop(element);
+        }
+        _notFull.notify_one();
+    }
+
+    /**
+     * @return false if the queue was empty
+     */
+    bool
+    try_dequeue(T& element)
+    {
+        {
+            std::lock_guard<std::mutex> l{_mut};
+            if (_queue.empty())
+            {
+                return false;
+            }
+            pop(element);
+        }
+        _notFull.notify_one();
+        return true;
+    }
+
+    std::size_t
+    size_approx() const
+    {
+        std::lock_guard<std::mutex> l{_mut};
+        return _queue.size();
+    }
+
+    /**
+     * @return the memory used by the queued elements (0 if no ```WeightFct``` was given).
+     */
+    std::size_t
+    size_bytes() const
+    {
+        std::lock_guard<std::mutex> l{_mut};
+        return _bytes;
+    }
+
+private:
+    bool
+    isFull() const
+    {
+        return !_queue.empty() && ((_maxItems > 0 && _queue.size() >= _maxItems) || (_maxBytes > 0 && _bytes >= _maxBytes));
+    }
+
+    void
+    push(T&& element)
+    {
+        auto weight = _weightFct ? _weightFct(element) : 0u;
+        _bytes += weight;
+        _queue.emplace_back(std::move(element), weight);
+    }
+
+    void
+    pop(T& element)
+    {
+        element = std::move(_queue.front().first);
+        _bytes -= _queue.front().second;
+        _queue.pop_front();
+    }
+
+private:
+    mutable std::mutex                    _mut;
+    std::condition_variable               _notEmpty;
+    std::condition_variable               _notFull;
+    std::deque<std::pair<T, std::size_t>> _queue; // element, weight
+    std::size_t                           _bytes    = 0u;
+    std::size_t                           _maxItems = 0u;
+    std::size_t                           _maxBytes = 0u;
+    WeightFct                             _weightFct;
+};
+
+} /* namespace utils */
+} /* namespace giga */
+
+#endif /* GIGA_UTILS_BLOCKINGQUEUE_H_ */
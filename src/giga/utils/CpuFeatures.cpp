@@ -0,0 +1,126 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CpuFeatures.h"
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define GIGA_CPU_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace giga
+{
+namespace utils
+{
+
+namespace
+{
+
+#ifdef GIGA_CPU_X86
+
+bool
+cpuid(unsigned leaf, unsigned (&regs)[4])
+{
+#if defined(_MSC_VER)
+    int r[4];
+    __cpuid(r, 0);
+    if (static_cast<unsigned>(r[0]) < leaf)
+    {
+        return false;
+    }
+    __cpuidex(r, static_cast<int>(leaf), 0);
+    for (int i = 0; i < 4; ++i)
+    {
+        regs[i] = static_cast<unsigned>(r[i]);
+    }
+    return true;
+#else
+    if (__get_cpuid_max(0, nullptr) < leaf)
+    {
+        return false;
+    }
+    __cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+    return true;
+#endif
+}
+
+/** The register states saved by the OS on a context switch (XCR0). */
+uint64_t
+xcr0()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (uint64_t{edx} << 32) | eax;
+#endif
+}
+
+CpuFeatures
+detect()
+{
+    CpuFeatures features;
+    unsigned regs[4];
+    if (!cpuid(1u, regs))
+    {
+        return features;
+    }
+    features.sse2  = (regs[3] & (1u << 26)) != 0;
+    features.ssse3 = (regs[2] & (1u << 9)) != 0;
+    features.sse41 = (regs[2] & (1u << 19)) != 0;
+    const bool osxsave = (regs[2] & (1u << 27)) != 0;
+    const auto xcr     = osxsave ? xcr0() : 0u;
+    const bool ymm     = (xcr & 0x06u) == 0x06u; // xmm and ymm
+    const bool zmm     = (xcr & 0xE6u) == 0xE6u; // and opmask, zmm0-15, zmm16-31
+
+    if (cpuid(7u, regs))
+    {
+        features.avx2    = ymm && (regs[1] & (1u << 5)) != 0;
+        features.avx512f = zmm && (regs[1] & (1u << 16)) != 0;
+        features.sha     = (regs[1] & (1u << 29)) != 0;
+    }
+    return features;
+}
+
+#else
+
+CpuFeatures
+detect()
+{
+    return CpuFeatures{};
+}
+
+#endif /* GIGA_CPU_X86 */
+
+} /* anonymous namespace */
+
+const CpuFeatures&
+CpuFeatures::get()
+{
+    static const CpuFeatures features = detect();
+    return features;
+}
+
+} /* namespace utils */
+} /* namespace giga */
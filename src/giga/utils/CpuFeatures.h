@@ -0,0 +1,45 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GIGA_UTILS_CPUFEATURES_H_
+#define GIGA_UTILS_CPUFEATURES_H_
+
+namespace giga
+{
+namespace utils
+{
+
+/**
+ * The instruction sets supported by the running CPU (and enabled by the OS).
+ * Everything is false on the other architectures than x86.
+ */
+struct CpuFeatures final
+{
+    static const CpuFeatures&
+    get();
+
+    bool sse2    = false;
+    bool ssse3   = false;
+    bool sse41   = false;
+    bool avx2    = false;
+    bool avx512f = false;
+    bool sha     = false;
+};
+
+} /* namespace utils */
+} /* namespace giga */
+
+#endif /* GIGA_UTILS_CPUFEATURES_H_ */
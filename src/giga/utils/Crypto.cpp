@@ -47,10 +47,10 @@
 #include "Crypto.h"
 #include "../rest/HttpErrors.h"
 #include "../utils/Utils.h"
+#include "Sha1Engine.h"
 
 #include <cpprest/details/basic_types.h>
 #include <algorithm>
-#include <openssl/sha.h>
 
 using CryptoPP::Exception;
 using CryptoPP::StringSink;
@@ -364,46 +364,10 @@ Crypto::calculateMasterPassword(const std::string& salt, const string_t& passwor
     return base64encode(pbkdf2_sha256(password, salt, 16));
 }
 
-static constexpr uint32_t BUF_SIZE = 8192;
-
 std::string
 Crypto::sha1File (const string_t& sfilename)
 {
-    std::ifstream is (sfilename.c_str(), std::ifstream::binary);
-    if (!is) {
-       BOOST_THROW_EXCEPTION(ErrorException{U("Cannot open file")});
-    }
-    auto buffer = std::unique_ptr<char[]>(new char[BUF_SIZE]);
-
-    SHA_CTX ctx;
-    SHA1_Init(&ctx);
-    do {
-       is.read (buffer.get(), BUF_SIZE);
-       auto read = is.gcount();
-       if (read > 0)
-       {
-          SHA1_Update(&ctx, buffer.get(), static_cast<std::size_t>(read));
-       }
-
-    } while ((is.rdstate() & std::ifstream::eofbit) == 0);
-    is.close();
-
-    unsigned char hashBuf[SHA_DIGEST_LENGTH];
-    SHA1_Final(hashBuf, &ctx);
-
-    std::string hash;
-    StringSource ss(hashBuf, SHA_DIGEST_LENGTH, true,
-       new HexEncoder(
-          new StringSink(hash)
-       ) // HexEncoder
-    ); // StringSource
-
-    std::locale l{"C"};
-    std::transform(hash.begin(), hash.end(), hash.begin(), [&l](char c) {
-       return std::tolower(c, l);
-    });
-
-    return hash;
+    return utils::Sha1Engine::file(sfilename);
 }
 
 std::tuple<std::string, std::string, std::string>
@@ -0,0 +1,310 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FileIo.h"
+#include "FileIoBackends.h"
+#include "Utils.h"
+#include "../rest/HttpErrors.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace giga
+{
+namespace utils
+{
+
+constexpr unsigned FileIo::DEFAULT_DEPTH;
+
+namespace
+{
+
+constexpr unsigned MAX_BLOCKING_THREADS = 16u;
+
+#ifndef _WIN32
+/**
+ * pread()/pwrite() on worker threads.
+ */
+class BlockingFileIo final : public FileIo
+{
+public:
+    explicit
+    BlockingFileIo(unsigned threads) :
+            _mut{}, _queued{}, _tasks{}, _stopped{false}, _threads{}
+    {
+        for (unsigned i = 0; i < threads; ++i)
+        {
+            _threads.emplace_back([this] { run(); });
+        }
+    }
+
+    ~BlockingFileIo()
+    {
+        {
+            std::lock_guard<std::mutex> l{_mut};
+            _stopped = true;
+        }
+        _queued.notify_all();
+        for (auto& thread : _threads)
+        {
+            thread.join();
+        }
+    }
+
+    Backend
+    backend() const override
+    {
+        return Backend::blocking;
+    }
+
+    void
+    read(int fd, uint64_t offset, unsigned char* data, std::size_t size, Completion done) override
+    {
+        push(Task{fd, offset, data, size, false, std::move(done)});
+    }
+
+    void
+    write(int fd, uint64_t offset, const unsigned char* data, std::size_t size, Completion done) override
+    {
+        push(Task{fd, offset, const_cast<unsigned char*>(data), size, true, std::move(done)});
+    }
+
+    void
+    submit() override
+    {
+        // the tasks start as soon as they are queued
+    }
+
+private:
+    struct Task
+    {
+        int            fd;
+        uint64_t       offset;
+        unsigned char* data;
+        std::size_t    size;
+        bool           write;
+        Completion     done;
+    };
+
+    void
+    push(Task&& task)
+    {
+        {
+            std::lock_guard<std::mutex> l{_mut};
+            _tasks.push_back(std::move(task));
+        }
+        _queued.notify_one();
+    }
+
+    void
+    run()
+    {
+        for (;;)
+        {
+            Task task;
+            {
+                std::unique_lock<std::mutex> l{_mut};
+                _queued.wait(l, [this] { return _stopped || !_tasks.empty(); });
+                if (_tasks.empty())
+                {
+                    return; // the queued tasks are done before stopping
+                }
+                task = std::move(_tasks.front());
+                _tasks.pop_front();
+            }
+
+            ssize_t count;
+            do
+            {
+                count = task.write
+                    ? ::pwrite(task.fd, task.data, task.size, static_cast<off_t>(task.offset))
+                    : ::pread(task.fd, task.data, task.size, static_cast<off_t>(task.offset));
+            } while (count < 0 && errno == EINTR);
+            auto error = count < 0 ? errno : 0;
+            try
+            {
+                task.done(count < 0 ? 0u : static_cast<std::size_t>(count), error);
+            }
+            catch (...)
+            {
+                GIGA_DEBUG_LOG(warning, U("file I/O completion failed"));
+            }
+        }
+    }
+
+private:
+    std::mutex               _mut;
+    std::condition_variable  _queued;
+    std::deque<Task>         _tasks;
+    bool                     _stopped;
+    std::vector<std::thread> _threads;
+};
+#endif
+
+/**
+ * Waits for one request.
+ */
+struct Waiter
+{
+    std::size_t
+    wait()
+    {
+        std::unique_lock<std::mutex> l{mut};
+        cond.wait(l, [this] { return done; });
+        done = false;
+        if (error != 0)
+        {
+            BOOST_THROW_EXCEPTION(ErrorException{U("File I/O error: ") + str2wstr(std::strerror(error))});
+        }
+        return transferred;
+    }
+
+    FileIo::Completion
+    completion()
+    {
+        return [this](std::size_t count, int err) {
+            std::lock_guard<std::mutex> l{mut};
+            transferred = count;
+            error       = err;
+            done        = true;
+            cond.notify_one();
+        };
+    }
+
+    std::mutex              mut;
+    std::condition_variable cond;
+    bool                    done        = false;
+    std::size_t             transferred = 0u;
+    int                     error       = 0;
+};
+
+} /* anonymous namespace */
+
+bool
+FileIo::available(Backend backend)
+{
+#ifdef _WIN32
+    (void) backend;
+    return false;
+#else
+    if (backend == Backend::blocking)
+    {
+        return true;
+    }
+    static const bool ioUring = makeIoUringFileIo(8u) != nullptr;
+    return ioUring;
+#endif
+}
+
+const char*
+FileIo::name(Backend backend)
+{
+    switch (backend)
+    {
+        case Backend::ioUring:  return "io_uring";
+        case Backend::blocking: return "blocking";
+    }
+    return "";
+}
+
+std::shared_ptr<FileIo>
+FileIo::create(Backend backend, unsigned depth)
+{
+#ifdef _WIN32
+    (void) backend;
+    (void) depth;
+    return nullptr;
+#else
+    if (backend == Backend::ioUring)
+    {
+        return makeIoUringFileIo(std::max(depth, 8u));
+    }
+    return std::make_shared<BlockingFileIo>(std::min(std::max(depth, 1u), MAX_BLOCKING_THREADS));
+#endif
+}
+
+std::shared_ptr<FileIo>
+FileIo::shared()
+{
+    static const std::shared_ptr<FileIo> io = [] {
+        auto ring = create(Backend::ioUring);
+        return ring != nullptr ? ring : create(Backend::blocking, 8u);
+    }();
+    return io;
+}
+
+bool
+FileIo::registerBuffer(unsigned char* /*data*/, std::size_t /*size*/)
+{
+    return false;
+}
+
+void
+FileIo::unregisterBuffer(unsigned char* /*data*/)
+{
+}
+
+std::size_t
+FileIo::readAll(int fd, uint64_t offset, unsigned char* data, std::size_t size)
+{
+    Waiter waiter;
+    std::size_t filled = 0u;
+    while (filled < size)
+    {
+        read(fd, offset + filled, data + filled, size - filled, waiter.completion());
+        submit();
+        auto count = waiter.wait();
+        if (count == 0u)
+        {
+            break;
+        }
+        filled += count;
+    }
+    return filled;
+}
+
+void
+FileIo::writeAll(int fd, uint64_t offset, const unsigned char* data, std::size_t size)
+{
+    Waiter waiter;
+    std::size_t written = 0u;
+    while (written < size)
+    {
+        write(fd, offset + written, data + written, size - written, waiter.completion());
+        submit();
+        auto count = waiter.wait();
+        if (count == 0u)
+        {
+            BOOST_THROW_EXCEPTION(ErrorException{U("File I/O error: nothing written")});
+        }
+        written += count;
+    }
+}
+
+} /* namespace utils */
+} /* namespace giga */
@@ -0,0 +1,139 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GIGA_UTILS_FILEIO_H_
+#define GIGA_UTILS_FILEIO_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace giga
+{
+namespace utils
+{
+
+/**
+ * A file I/O backend: positioned reads and writes on file descriptors, completed asynchronously.
+ *
+ * One backend is meant to be shared by every file of the process (hashing, chunk reads, download writes):
+ *  - ```ioUring```: Linux io_uring. One ring and one completion thread serve all the files,
+ *    the requests are batched until ```submit()```, and the registered buffers use the fixed buffer opcodes.
+ *  - ```blocking```: ```pread()```/```pwrite()``` on a few worker threads, wherever io_uring is missing.
+ *
+ * Without a backend (the default of the transfers), the files are read and written by blocking calls,
+ * on the thread of each stage. There is no backend on Windows.
+ *
+ * The completion functions are called on a thread of the backend: they must be short and must not wait
+ * for another request. They may issue new requests.
+ */
+class FileIo
+{
+public:
+    enum class Backend
+    {
+        ioUring, blocking
+    };
+
+    /**
+     * Called with the bytes transferred (0 at the end of the file), or an ```errno``` value.
+     */
+    typedef std::function<void(std::size_t transferred, int error)> Completion;
+
+    /** The number of requests the ring holds, or the worker threads of the blocking backend. */
+    static constexpr unsigned DEFAULT_DEPTH = 256u;
+
+public:
+    static bool
+    available(Backend backend);
+
+    static const char*
+    name(Backend backend);
+
+    /**
+     * @return a new backend, or nullptr when it is not available.
+     * @param depth the size of the ring (```ioUring```), or the number of threads (```blocking```, at most 16).
+     */
+    static std::shared_ptr<FileIo>
+    create(Backend backend, unsigned depth = DEFAULT_DEPTH);
+
+    /**
+     * @return the process wide backend: io_uring when the kernel allows it, else blocking. nullptr on Windows.
+     */
+    static std::shared_ptr<FileIo>
+    shared();
+
+public:
+    FileIo()                         = default;
+    virtual ~FileIo()                = default;
+    FileIo(const FileIo&)            = delete;
+    FileIo(FileIo&&)                 = delete;
+    FileIo& operator=(const FileIo&) = delete;
+    FileIo& operator=(FileIo&&)      = delete;
+
+    virtual Backend
+    backend() const = 0;
+
+    /**
+     * @brief Queue the read of up to ```size``` bytes at ```offset``` into ```data```.
+     * ```data``` must stay valid until ```done``` is called.
+     */
+    virtual void
+    read(int fd, uint64_t offset, unsigned char* data, std::size_t size, Completion done) = 0;
+
+    /**
+     * @brief Queue the write of up to ```size``` bytes of ```data``` at ```offset```.
+     * ```data``` must stay valid until ```done``` is called.
+     */
+    virtual void
+    write(int fd, uint64_t offset, const unsigned char* data, std::size_t size, Completion done) = 0;
+
+    /**
+     * @brief Start the requests queued so far. The requests may start before, but only this guarantees it.
+     */
+    virtual void
+    submit() = 0;
+
+    /**
+     * @brief Register a buffer used by many requests: the kernel maps it once, instead of at every request.
+     * @return false when the backend cannot (the buffer still works, as any other).
+     * It must be unregistered before it is freed, with no request in flight on it.
+     */
+    virtual bool
+    registerBuffer(unsigned char* data, std::size_t size);
+
+    virtual void
+    unregisterBuffer(unsigned char* data);
+
+    /**
+     * @brief Read ```size``` bytes at ```offset``` (less only at the end of the file) and wait for them.
+     * Throws on errors.
+     */
+    std::size_t
+    readAll(int fd, uint64_t offset, unsigned char* data, std::size_t size);
+
+    /**
+     * @brief Write ```size``` bytes at ```offset``` and wait for them. Throws on errors.
+     */
+    void
+    writeAll(int fd, uint64_t offset, const unsigned char* data, std::size_t size);
+};
+
+} /* namespace utils */
+} /* namespace giga */
+
+#endif /* GIGA_UTILS_FILEIO_H_ */
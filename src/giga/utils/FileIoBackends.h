@@ -0,0 +1,39 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GIGA_UTILS_FILEIOBACKENDS_H_
+#define GIGA_UTILS_FILEIOBACKENDS_H_
+
+#include "FileIo.h"
+
+#include <memory>
+
+namespace giga
+{
+namespace utils
+{
+
+/**
+ * @return an io_uring backend with a ring of ```entries``` requests,
+ * or nullptr when it is not compiled in or refused by the kernel (too old, seccomp, ...).
+ */
+std::shared_ptr<FileIo>
+makeIoUringFileIo(unsigned entries);
+
+} /* namespace utils */
+} /* namespace giga */
+
+#endif /* GIGA_UTILS_FILEIOBACKENDS_H_ */
@@ -0,0 +1,464 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FileIoBackends.h"
+#include "../rest/HttpErrors.h"
+
+// The ring is driven by the raw system calls: no liburing dependency
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define GIGA_IO_URING 1
+#endif
+#endif
+
+#ifdef GIGA_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace giga
+{
+namespace utils
+{
+
+namespace
+{
+
+constexpr std::size_t MAX_REGISTERED_BUFFERS = 64u;
+constexpr std::size_t MAX_REQUEST_SIZE       = 1u << 30; // the length of a request is 32 bits
+
+template <typename T>
+T
+loadAcquire(const T* p)
+{
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+template <typename T>
+void
+storeRelease(T* p, T value)
+{
+    __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+/**
+ * One io_uring, and the thread reaping its completions.
+ *
+ * The submission queue is guarded by ```_submitMut```. The requests are only queued in the ring
+ * (```_unsubmitted```) until ```submit()```, or until the ring is full: one ```io_uring_enter()``` per batch.
+ */
+class IoUringFileIo final : public FileIo
+{
+public:
+    IoUringFileIo() :
+            _ringFd{-1}, _sqRing{nullptr}, _cqRing{nullptr}, _sqRingSize{0u}, _cqRingSize{0u}, _sqes{nullptr},
+            _sqHead{nullptr}, _sqTail{nullptr}, _sqMask{nullptr}, _sqArray{nullptr}, _sqEntries{0u},
+            _cqHead{nullptr}, _cqTail{nullptr}, _cqMask{nullptr}, _cqes{nullptr}, _cqEntries{0u},
+            _submitMut{}, _unsubmitted{0u}, _inFlight{0u}, _space{}, _reaper{},
+            _buffersMut{}, _buffers{}, _fixedBuffers{false}
+    {
+    }
+
+    ~IoUringFileIo()
+    {
+        if (_reaper.joinable())
+        {
+            {
+                // the callers waited for their requests: wake the reaper with a no-op
+                std::unique_lock<std::mutex> l{_submitMut};
+                auto sqe = nextSqe(l);
+                sqe->opcode    = IORING_OP_NOP;
+                sqe->user_data = 0u;
+                flush();
+            }
+            _reaper.join();
+        }
+        if (_sqes != nullptr)
+        {
+            munmap(_sqes, _sqEntries * sizeof(io_uring_sqe));
+        }
+        if (_cqRing != nullptr && _cqRing != _sqRing)
+        {
+            munmap(_cqRing, _cqRingSize);
+        }
+        if (_sqRing != nullptr)
+        {
+            munmap(_sqRing, _sqRingSize);
+        }
+        if (_ringFd >= 0)
+        {
+            ::close(_ringFd);
+        }
+    }
+
+    /**
+     * @return false when the kernel refuses the ring, or is too old (no IORING_OP_READ before 5.6).
+     */
+    bool
+    init(unsigned entries)
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        _ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (_ringFd < 0 || !(params.features & IORING_FEAT_RW_CUR_POS) || !(params.features & IORING_FEAT_NODROP))
+        {
+            return false;
+        }
+
+        _sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        _cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        auto single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0u;
+        if (single)
+        {
+            _sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+        }
+        _sqRing = map(_sqRingSize, IORING_OFF_SQ_RING);
+        _cqRing = single ? _sqRing : map(_cqRingSize, IORING_OFF_CQ_RING);
+        _sqes   = static_cast<io_uring_sqe*>(static_cast<void*>(map(params.sq_entries * sizeof(io_uring_sqe), IORING_OFF_SQES)));
+        if (_sqRing == nullptr || _cqRing == nullptr || _sqes == nullptr)
+        {
+            return false;
+        }
+
+        _sqHead    = reinterpret_cast<unsigned*>(_sqRing + params.sq_off.head);
+        _sqTail    = reinterpret_cast<unsigned*>(_sqRing + params.sq_off.tail);
+        _sqMask    = reinterpret_cast<unsigned*>(_sqRing + params.sq_off.ring_mask);
+        _sqArray   = reinterpret_cast<unsigned*>(_sqRing + params.sq_off.array);
+        _sqEntries = params.sq_entries;
+        _cqHead    = reinterpret_cast<unsigned*>(_cqRing + params.cq_off.head);
+        _cqTail    = reinterpret_cast<unsigned*>(_cqRing + params.cq_off.tail);
+        _cqMask    = reinterpret_cast<unsigned*>(_cqRing + params.cq_off.ring_mask);
+        _cqes      = reinterpret_cast<io_uring_cqe*>(_cqRing + params.cq_off.cqes);
+        _cqEntries = params.cq_entries;
+
+        initFixedBuffers();
+        _reaper = std::thread{[this] { reap(); }};
+        return true;
+    }
+
+    Backend
+    backend() const override
+    {
+        return Backend::ioUring;
+    }
+
+    void
+    read(int fd, uint64_t offset, unsigned char* data, std::size_t size, Completion done) override
+    {
+        queue(IORING_OP_READ, IORING_OP_READ_FIXED, fd, offset, data, size, std::move(done));
+    }
+
+    void
+    write(int fd, uint64_t offset, const unsigned char* data, std::size_t size, Completion done) override
+    {
+        queue(IORING_OP_WRITE, IORING_OP_WRITE_FIXED, fd, offset, const_cast<unsigned char*>(data), size, std::move(done));
+    }
+
+    void
+    submit() override
+    {
+        std::lock_guard<std::mutex> l{_submitMut};
+        flush();
+    }
+
+    bool
+    registerBuffer(unsigned char* data, std::size_t size) override
+    {
+        std::lock_guard<std::mutex> l{_buffersMut};
+        if (!_fixedBuffers)
+        {
+            return false;
+        }
+        auto slot = std::find_if(_buffers.begin(), _buffers.end(), [](const iovec& v) { return v.iov_base == nullptr; });
+        if (slot == _buffers.end())
+        {
+            return false;
+        }
+        iovec buffer{data, size};
+        if (!updateBuffer(static_cast<unsigned>(slot - _buffers.begin()), buffer))
+        {
+            return false;
+        }
+        *slot = buffer;
+        return true;
+    }
+
+    void
+    unregisterBuffer(unsigned char* data) override
+    {
+        std::lock_guard<std::mutex> l{_buffersMut};
+        for (std::size_t i = 0; i < _buffers.size(); ++i)
+        {
+            if (_buffers[i].iov_base == data)
+            {
+                iovec empty{nullptr, 0u};
+                updateBuffer(static_cast<unsigned>(i), empty);
+                _buffers[i] = empty;
+            }
+        }
+    }
+
+private:
+    struct Request
+    {
+        Completion done;
+    };
+
+    unsigned char*
+    map(std::size_t size, off_t offset)
+    {
+        auto p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringFd, offset);
+        return p == MAP_FAILED ? nullptr : static_cast<unsigned char*>(p);
+    }
+
+    /**
+     * A sparse table of fixed buffers (Linux 5.19): the buffers come and go with the files.
+     */
+    void
+    initFixedBuffers()
+    {
+#if defined(IORING_RSRC_REGISTER_SPARSE)
+        io_uring_rsrc_register reg;
+        std::memset(&reg, 0, sizeof(reg));
+        reg.nr    = MAX_REGISTERED_BUFFERS;
+        reg.flags = IORING_RSRC_REGISTER_SPARSE;
+        _fixedBuffers = syscall(__NR_io_uring_register, _ringFd, IORING_REGISTER_BUFFERS2, &reg, sizeof(reg)) == 0;
+        if (_fixedBuffers)
+        {
+            _buffers.assign(MAX_REGISTERED_BUFFERS, iovec{nullptr, 0u});
+        }
+#endif
+    }
+
+    bool
+    updateBuffer(unsigned index, iovec& buffer)
+    {
+#if defined(IORING_RSRC_REGISTER_SPARSE)
+        io_uring_rsrc_update2 update;
+        std::memset(&update, 0, sizeof(update));
+        update.offset = index;
+        update.data   = reinterpret_cast<uint64_t>(&buffer);
+        update.nr     = 1u;
+        return syscall(__NR_io_uring_register, _ringFd, IORING_REGISTER_BUFFERS_UPDATE, &update, sizeof(update)) == 1;
+#else
+        (void) index;
+        (void) buffer;
+        return false;
+#endif
+    }
+
+    /** @return the index of the registered buffer holding [data, data + size), or -1. */
+    int
+    fixedBuffer(const unsigned char* data, std::size_t size)
+    {
+        std::lock_guard<std::mutex> l{_buffersMut};
+        for (std::size_t i = 0; i < _buffers.size(); ++i)
+        {
+            auto base = static_cast<const unsigned char*>(_buffers[i].iov_base);
+            if (base != nullptr && data >= base && data + size <= base + _buffers[i].iov_len)
+            {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    void
+    queue(uint8_t opcode, uint8_t fixedOpcode, int fd, uint64_t offset, unsigned char* data, std::size_t size, Completion&& done)
+    {
+        auto index   = fixedBuffer(data, size);
+        auto request = new Request{std::move(done)};
+
+        std::unique_lock<std::mutex> l{_submitMut};
+        // the completion queue must not overflow: wait for room, but on the reaper (it would wait for itself)
+        if (std::this_thread::get_id() != _reaper.get_id())
+        {
+            _space.wait(l, [this] { return _inFlight < _cqEntries; });
+        }
+        auto sqe = nextSqe(l);
+        sqe->opcode    = index >= 0 ? fixedOpcode : opcode;
+        sqe->fd        = fd;
+        sqe->off       = offset;
+        sqe->addr      = reinterpret_cast<uint64_t>(data);
+        sqe->len       = static_cast<uint32_t>(std::min(size, MAX_REQUEST_SIZE));
+        sqe->buf_index = static_cast<uint16_t>(index >= 0 ? index : 0);
+        sqe->user_data = reinterpret_cast<uint64_t>(request);
+        ++_inFlight;
+    }
+
+    /** @return a cleared entry, flushing the full ring first. ```_submitMut``` must be locked. */
+    io_uring_sqe*
+    nextSqe(std::unique_lock<std::mutex>& /*locked*/)
+    {
+        auto tail = *_sqTail;
+        while (tail - loadAcquire(_sqHead) >= _sqEntries)
+        {
+            flush();
+        }
+        auto index = tail & *_sqMask;
+        auto sqe   = &_sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        _sqArray[index] = index;
+        storeRelease(_sqTail, tail + 1u); // the kernel only reads it in io_uring_enter()
+        ++_unsubmitted;
+        return sqe;
+    }
+
+    /** Hand the queued entries to the kernel. ```_submitMut``` must be locked. */
+    void
+    flush()
+    {
+        while (_unsubmitted > 0u)
+        {
+            auto submitted = syscall(__NR_io_uring_enter, _ringFd, _unsubmitted, 0u, 0u, nullptr, 0u);
+            if (submitted < 0)
+            {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                {
+                    std::this_thread::yield(); // EBUSY: the completions overflow, the reaper drains them
+                    continue;
+                }
+                GIGA_DEBUG_LOG(error, U("io_uring_enter failed"));
+                return;
+            }
+            _unsubmitted -= static_cast<unsigned>(submitted);
+        }
+    }
+
+    void
+    reap()
+    {
+        for (;;)
+        {
+            auto waited = syscall(__NR_io_uring_enter, _ringFd, 0u, 1u, IORING_ENTER_GETEVENTS, nullptr, 0u);
+            if (waited < 0 && errno != EINTR && errno != EBUSY)
+            {
+                GIGA_DEBUG_LOG(error, U("io_uring_enter failed"));
+            }
+
+            auto head = *_cqHead;
+            auto tail = loadAcquire(_cqTail);
+            auto stop = false;
+            std::vector<std::pair<Request*, int>> done;
+            for (; head != tail; ++head)
+            {
+                const auto& cqe = _cqes[head & *_cqMask];
+                if (cqe.user_data == 0u)
+                {
+                    stop = true;
+                    continue;
+                }
+                done.emplace_back(reinterpret_cast<Request*>(cqe.user_data), cqe.res);
+            }
+            storeRelease(_cqHead, head);
+
+            if (!done.empty())
+            {
+                {
+                    std::lock_guard<std::mutex> l{_submitMut};
+                    _inFlight -= static_cast<unsigned>(done.size());
+                }
+                _space.notify_all();
+            }
+            for (const auto& d : done)
+            {
+                std::unique_ptr<Request> request{d.first};
+                try
+                {
+                    request->done(d.second < 0 ? 0u : static_cast<std::size_t>(d.second), d.second < 0 ? -d.second : 0);
+                }
+                catch (...)
+                {
+                    GIGA_DEBUG_LOG(warning, U("file I/O completion failed"));
+                }
+            }
+            if (stop)
+            {
+                return;
+            }
+        }
+    }
+
+private:
+    int            _ringFd;
+    unsigned char* _sqRing;
+    unsigned char* _cqRing;
+    std::size_t    _sqRingSize;
+    std::size_t    _cqRingSize;
+    io_uring_sqe*  _sqes;
+
+    unsigned*      _sqHead;
+    unsigned*      _sqTail;
+    unsigned*      _sqMask;
+    unsigned*      _sqArray;
+    unsigned       _sqEntries;
+    unsigned*      _cqHead;
+    unsigned*      _cqTail;
+    unsigned*      _cqMask;
+    io_uring_cqe*  _cqes;
+    unsigned       _cqEntries;
+
+    std::mutex              _submitMut;
+    unsigned                _unsubmitted; // guarded by _submitMut
+    unsigned                _inFlight;    // guarded by _submitMut
+    std::condition_variable _space;
+    std::thread             _reaper;
+
+    std::mutex              _buffersMut;
+    std::vector<iovec>      _buffers; // the registered buffers, by index (nullptr: free)
+    bool                    _fixedBuffers;
+};
+
+} /* anonymous namespace */
+
+std::shared_ptr<FileIo>
+makeIoUringFileIo(unsigned entries)
+{
+    auto io = std::make_shared<IoUringFileIo>();
+    return io->init(entries) ? io : nullptr;
+}
+
+} /* namespace utils */
+} /* namespace giga */
+
+#else
+
+namespace giga
+{
+namespace utils
+{
+
+std::shared_ptr<FileIo>
+makeIoUringFileIo(unsigned /*entries*/)
+{
+    return nullptr;
+}
+
+} /* namespace utils */
+} /* namespace giga */
+
+#endif
@@ -0,0 +1,216 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MultiSha1.h"
+#include "CpuFeatures.h"
+#include "MultiSha1Lanes.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace giga
+{
+namespace utils
+{
+
+namespace
+{
+
+static constexpr std::array<uint32_t, 5> SHA1_INIT{{0x67452301u, 0xEFCDAB89u, 0x98BADCFEu, 0x10325476u, 0xC3D2E1F0u}};
+static constexpr std::size_t BLOCK_SIZE = 64u;
+
+const LanesKernel*
+kernel(MultiSha1::Implementation implementation)
+{
+    switch (implementation)
+    {
+        case MultiSha1::Implementation::sse2:
+            return CpuFeatures::get().sse2 ? sha1LanesSse2() : nullptr;
+        case MultiSha1::Implementation::avx2:
+            return CpuFeatures::get().avx2 ? sha1LanesAvx2() : nullptr;
+        case MultiSha1::Implementation::avx512:
+            return CpuFeatures::get().avx512f ? sha1LanesAvx512() : nullptr;
+        case MultiSha1::Implementation::single:
+            break;
+    }
+    return nullptr;
+}
+
+/**
+ * A message being hashed in a lane: its full blocks are read in place,
+ * the last one or two (with the padding) from ```tail```.
+ */
+struct Lane
+{
+    std::size_t                    message    = 0u;
+    std::size_t                    block      = 0u;
+    std::size_t                    fullBlocks = 0u;
+    std::size_t                    blocks     = 0u;
+    const unsigned char*           data       = nullptr;
+    std::array<unsigned char, 128> tail;
+    bool                           active     = false;
+
+    void
+    start(std::size_t index, const MultiSha1::Message& m)
+    {
+        message    = index;
+        block      = 0u;
+        data       = m.data;
+        fullBlocks = m.size / BLOCK_SIZE;
+
+        const auto rest = m.size % BLOCK_SIZE;
+        const auto tailSize = rest + 9u > BLOCK_SIZE ? 2u * BLOCK_SIZE : BLOCK_SIZE;
+        tail.fill(0u);
+        if (rest > 0u)
+        {
+            std::memcpy(tail.data(), m.data + fullBlocks * BLOCK_SIZE, rest);
+        }
+        tail[rest] = 0x80;
+        const uint64_t bits = static_cast<uint64_t>(m.size) * 8u;
+        for (std::size_t i = 0; i < 8u; ++i)
+        {
+            tail[tailSize - 1u - i] = static_cast<unsigned char>(bits >> (8u * i));
+        }
+        blocks = fullBlocks + tailSize / BLOCK_SIZE;
+        active = true;
+    }
+
+    const unsigned char*
+    next() const
+    {
+        return block < fullBlocks ? data + block * BLOCK_SIZE : tail.data() + (block - fullBlocks) * BLOCK_SIZE;
+    }
+};
+
+} /* anonymous namespace */
+
+MultiSha1::Implementation
+MultiSha1::best()
+{
+    // 8 lanes of AVX2 are about as fast as SHA-NI on a single message, 4 lanes of SSE2 slower than OpenSSL
+    static const auto implementation = available(Implementation::avx512) ? Implementation::avx512
+                                     : available(Implementation::avx2) && Sha1Engine::best() != Sha1Engine::Implementation::shaNi ? Implementation::avx2
+                                     : Implementation::single;
+    return implementation;
+}
+
+bool
+MultiSha1::available(Implementation implementation)
+{
+    return implementation == Implementation::single || kernel(implementation) != nullptr;
+}
+
+const char*
+MultiSha1::name(Implementation implementation)
+{
+    switch (implementation)
+    {
+        case Implementation::single:
+            return Sha1Engine::name(Sha1Engine::best());
+        case Implementation::sse2:
+            return "sse2";
+        case Implementation::avx2:
+            return "avx2";
+        case Implementation::avx512:
+            return "avx512";
+    }
+    return "unknown";
+}
+
+std::size_t
+MultiSha1::lanes(Implementation implementation)
+{
+    auto k = kernel(implementation);
+    return k != nullptr ? k->lanes : 1u;
+}
+
+std::vector<Sha1Engine::Digest>
+MultiSha1::hash(const std::vector<Message>& messages, Implementation implementation)
+{
+    std::vector<Sha1Engine::Digest> digests(messages.size());
+    auto k = kernel(implementation);
+    if (k == nullptr)
+    {
+        for (std::size_t i = 0; i < messages.size(); ++i)
+        {
+            Sha1Engine engine;
+            engine.update(messages[i].data, messages[i].size);
+            digests[i] = engine.digest();
+        }
+        return digests;
+    }
+
+    // the idle lanes hash a dummy block: their state is reset when they take a message
+    static const std::array<unsigned char, BLOCK_SIZE> IDLE_BLOCK{};
+    const auto count = k->lanes;
+    std::vector<uint32_t>             state(SHA1_INIT.size() * count, 0u);
+    std::vector<Lane>                 lanes(count);
+    std::vector<const unsigned char*> blocks(count, IDLE_BLOCK.data());
+    std::size_t nextMessage = 0u;
+    std::size_t active      = 0u;
+
+    while (true)
+    {
+        for (std::size_t l = 0; l < count && nextMessage < messages.size(); ++l)
+        {
+            if (!lanes[l].active)
+            {
+                lanes[l].start(nextMessage, messages[nextMessage]);
+                for (std::size_t w = 0; w < SHA1_INIT.size(); ++w)
+                {
+                    state[w * count + l] = SHA1_INIT[w];
+                }
+                ++nextMessage;
+                ++active;
+            }
+        }
+        if (active == 0u)
+        {
+            break;
+        }
+
+        for (std::size_t l = 0; l < count; ++l)
+        {
+            blocks[l] = lanes[l].active ? lanes[l].next() : IDLE_BLOCK.data();
+        }
+        k->compress(state.data(), blocks.data());
+
+        for (std::size_t l = 0; l < count; ++l)
+        {
+            auto& lane = lanes[l];
+            if (!lane.active || ++lane.block < lane.blocks)
+            {
+                continue;
+            }
+            auto& digest = digests[lane.message];
+            for (std::size_t w = 0; w < SHA1_INIT.size(); ++w)
+            {
+                const auto word = state[w * count + l];
+                digest[4 * w]     = static_cast<unsigned char>(word >> 24);
+                digest[4 * w + 1] = static_cast<unsigned char>(word >> 16);
+                digest[4 * w + 2] = static_cast<unsigned char>(word >> 8);
+                digest[4 * w + 3] = static_cast<unsigned char>(word);
+            }
+            lane.active = false;
+            --active;
+        }
+    }
+    return digests;
+}
+
+} /* namespace utils */
+} /* namespace giga */
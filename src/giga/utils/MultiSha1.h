@@ -0,0 +1,81 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GIGA_UTILS_MULTISHA1_H_
+#define GIGA_UTILS_MULTISHA1_H_
+
+#include "Sha1Engine.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace giga
+{
+namespace utils
+{
+
+/**
+ * Computes the SHA1 digests of many small messages at once.
+ *
+ * Every SIMD lane hashes its own message: 4 lanes with SSE2, 8 with AVX2, 16 with AVX-512.
+ * When a message is done, its lane takes the next one. The messages should be of similar
+ * sizes: while the last long message is hashed, the other lanes idle.
+ */
+class MultiSha1 final
+{
+public:
+    enum class Implementation
+    {
+        single, sse2, avx2, avx512
+    };
+
+    struct Message
+    {
+        const unsigned char* data;
+        std::size_t          size;
+    };
+
+public:
+    /**
+     * @return the fastest implementation supported by this CPU.
+     * ```single``` hashes the messages one after the other with ```Sha1Engine```.
+     */
+    static Implementation
+    best();
+
+    static bool
+    available(Implementation implementation);
+
+    static const char*
+    name(Implementation implementation);
+
+    /**
+     * @return the number of messages hashed at the same time.
+     */
+    static std::size_t
+    lanes(Implementation implementation);
+
+    /**
+     * @return the digests of ```messages```, in the same order.
+     */
+    static std::vector<Sha1Engine::Digest>
+    hash(const std::vector<Message>& messages, Implementation implementation = best());
+};
+
+} /* namespace utils */
+} /* namespace giga */
+
+#endif /* GIGA_UTILS_MULTISHA1_H_ */
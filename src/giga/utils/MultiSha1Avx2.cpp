@@ -0,0 +1,111 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MultiSha1Lanes.h"
+
+// compiled with -mavx2 (or /arch:AVX2): only called when CpuFeatures reports AVX2
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace giga
+{
+namespace utils
+{
+
+namespace
+{
+
+struct Avx2
+{
+    typedef __m256i V;
+    static constexpr std::size_t LANES = 8u;
+
+    static V add(V a, V b)          { return _mm256_add_epi32(a, b); }
+    static V xor_(V a, V b)         { return _mm256_xor_si256(a, b); }
+    static V xor3(V a, V b, V c)    { return _mm256_xor_si256(_mm256_xor_si256(a, b), c); }
+    static V choose(V b, V c, V d)  { return _mm256_xor_si256(d, _mm256_and_si256(b, _mm256_xor_si256(c, d))); }
+    static V majority(V b, V c, V d){ return _mm256_or_si256(_mm256_and_si256(b, c), _mm256_and_si256(d, _mm256_or_si256(b, c))); }
+    static V set1(uint32_t x)       { return _mm256_set1_epi32(static_cast<int>(x)); }
+
+    template <int N>
+    static V rotl(V a)              { return _mm256_or_si256(_mm256_slli_epi32(a, N), _mm256_srli_epi32(a, 32 - N)); }
+
+    static V loadState(const uint32_t* p)  { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+    static void storeState(uint32_t* p, V a){ _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), a); }
+
+    static void
+    loadBlock(const unsigned char* const* blocks, V (&w)[16])
+    {
+        const V byteSwap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                            3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+        for (int i = 0; i < 16; i += 8)
+        {
+            V r[LANES];
+            for (std::size_t l = 0; l < LANES; ++l)
+            {
+                r[l] = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks[l] + 4 * i)), byteSwap);
+            }
+            // 8x8 transpose: words 0-3 in the low halves, 4-7 in the high ones
+            V u[LANES];
+            for (std::size_t g = 0; g < LANES; g += 4)
+            {
+                const V t0 = _mm256_unpacklo_epi32(r[g], r[g + 1]);
+                const V t1 = _mm256_unpackhi_epi32(r[g], r[g + 1]);
+                const V t2 = _mm256_unpacklo_epi32(r[g + 2], r[g + 3]);
+                const V t3 = _mm256_unpackhi_epi32(r[g + 2], r[g + 3]);
+                u[g]     = _mm256_unpacklo_epi64(t0, t2);
+                u[g + 1] = _mm256_unpackhi_epi64(t0, t2);
+                u[g + 2] = _mm256_unpacklo_epi64(t1, t3);
+                u[g + 3] = _mm256_unpackhi_epi64(t1, t3);
+            }
+            for (int k = 0; k < 4; ++k)
+            {
+                w[i + k]     = _mm256_permute2x128_si256(u[k], u[k + 4], 0x20);
+                w[i + k + 4] = _mm256_permute2x128_si256(u[k], u[k + 4], 0x31);
+            }
+        }
+    }
+};
+
+} /* anonymous namespace */
+
+const LanesKernel*
+sha1LanesAvx2()
+{
+    static const LanesKernel kernel{Avx2::LANES, compressLanes<Avx2>};
+    return &kernel;
+}
+
+} /* namespace utils */
+} /* namespace giga */
+
+#else
+
+namespace giga
+{
+namespace utils
+{
+
+const LanesKernel*
+sha1LanesAvx2()
+{
+    return nullptr;
+}
+
+} /* namespace utils */
+} /* namespace giga */
+
+#endif
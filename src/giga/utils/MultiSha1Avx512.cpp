@@ -0,0 +1,125 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MultiSha1Lanes.h"
+
+// compiled with -mavx512f (or /arch:AVX512): only called when CpuFeatures reports AVX-512
+#if defined(__AVX512F__)
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC 12 warns about _mm512_undefined_epi32() in its own headers (GCC bug 105593)
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include <immintrin.h>
+
+namespace giga
+{
+namespace utils
+{
+
+namespace
+{
+
+struct Avx512
+{
+    typedef __m512i V;
+    static constexpr std::size_t LANES = 16u;
+
+    static V add(V a, V b)          { return _mm512_add_epi32(a, b); }
+    static V xor_(V a, V b)         { return _mm512_xor_si512(a, b); }
+    static V xor3(V a, V b, V c)    { return _mm512_ternarylogic_epi32(a, b, c, 0x96); }
+    static V choose(V b, V c, V d)  { return _mm512_ternarylogic_epi32(b, c, d, 0xCA); }
+    static V majority(V b, V c, V d){ return _mm512_ternarylogic_epi32(b, c, d, 0xE8); }
+    static V set1(uint32_t x)       { return _mm512_set1_epi32(static_cast<int>(x)); }
+
+    template <int N>
+    static V rotl(V a)              { return _mm512_rol_epi32(a, N); }
+
+    static V loadState(const uint32_t* p)  { return _mm512_loadu_si512(p); }
+    static void storeState(uint32_t* p, V a){ _mm512_storeu_si512(p, a); }
+
+    static V
+    byteSwap(V a)
+    {
+        const V even = _mm512_and_si512(a, _mm512_set1_epi32(0x00FF00FF));
+        const V odd  = _mm512_and_si512(a, _mm512_set1_epi32(static_cast<int>(0xFF00FF00u)));
+        return _mm512_or_si512(rotl<24>(even), rotl<8>(odd));
+    }
+
+    static void
+    loadBlock(const unsigned char* const* blocks, V (&w)[16])
+    {
+        V u[LANES];
+        for (std::size_t g = 0; g < LANES; g += 4)
+        {
+            V r[4];
+            for (std::size_t l = 0; l < 4; ++l)
+            {
+                r[l] = byteSwap(_mm512_loadu_si512(blocks[g + l]));
+            }
+            const V t0 = _mm512_unpacklo_epi32(r[0], r[1]);
+            const V t1 = _mm512_unpackhi_epi32(r[0], r[1]);
+            const V t2 = _mm512_unpacklo_epi32(r[2], r[3]);
+            const V t3 = _mm512_unpackhi_epi32(r[2], r[3]);
+            // in each 128 bits chunk c: the word 4c + k of the lanes g to g + 3
+            u[g]     = _mm512_unpacklo_epi64(t0, t2);
+            u[g + 1] = _mm512_unpackhi_epi64(t0, t2);
+            u[g + 2] = _mm512_unpacklo_epi64(t1, t3);
+            u[g + 3] = _mm512_unpackhi_epi64(t1, t3);
+        }
+        for (int k = 0; k < 4; ++k)
+        {
+            const V lo01 = _mm512_shuffle_i32x4(u[k], u[k + 4], 0x44);
+            const V hi01 = _mm512_shuffle_i32x4(u[k], u[k + 4], 0xEE);
+            const V lo23 = _mm512_shuffle_i32x4(u[k + 8], u[k + 12], 0x44);
+            const V hi23 = _mm512_shuffle_i32x4(u[k + 8], u[k + 12], 0xEE);
+            w[k]      = _mm512_shuffle_i32x4(lo01, lo23, 0x88);
+            w[k + 4]  = _mm512_shuffle_i32x4(lo01, lo23, 0xDD);
+            w[k + 8]  = _mm512_shuffle_i32x4(hi01, hi23, 0x88);
+            w[k + 12] = _mm512_shuffle_i32x4(hi01, hi23, 0xDD);
+        }
+    }
+};
+
+} /* anonymous namespace */
+
+const LanesKernel*
+sha1LanesAvx512()
+{
+    static const LanesKernel kernel{Avx512::LANES, compressLanes<Avx512>};
+    return &kernel;
+}
+
+} /* namespace utils */
+} /* namespace giga */
+
+#else
+
+namespace giga
+{
+namespace utils
+{
+
+const LanesKernel*
+sha1LanesAvx512()
+{
+    return nullptr;
+}
+
+} /* namespace utils */
+} /* namespace giga */
+
+#endif
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GIGA_UTILS_MULTISHA1LANES_H_
+#define GIGA_UTILS_MULTISHA1LANES_H_
+
+// The SHA1 compression, on several independent messages at once (one per SIMD lane).
+//
+// This header is included by the MultiSha1<isa>.cpp files, each one compiled with the
+// flags of its instruction set (see src/giga/CMakeLists.txt). They must not instantiate
+// anything shared with the rest of the library (std containers, ...): the linker could
+// keep their copy, built for an instruction set the CPU may not have.
+
+#include <cstddef>
+#include <cstdint>
+
+namespace giga
+{
+namespace utils
+{
+
+/**
+ * @param state the 5 words of every lane: ```state[word * lanes + lane]```
+ * @param blocks the next 64 bytes block of every lane
+ */
+typedef void (*LanesCompressFct)(uint32_t* state, const unsigned char* const* blocks);
+
+struct LanesKernel
+{
+    std::size_t      lanes;
+    LanesCompressFct compress;
+};
+
+/** @return nullptr if the kernel was not compiled for this platform. */
+const LanesKernel*
+sha1LanesSse2();
+
+const LanesKernel*
+sha1LanesAvx2();
+
+const LanesKernel*
+sha1LanesAvx512();
+
+/**
+ * ```Ops``` provides the vector type ```V```, ```LANES``` and the operations on the vectors.
+ * ```Ops::loadBlock()``` transposes the blocks: ```w[i]``` holds the big endian word ```i``` of every lane.
+ */
+template <typename Ops>
+void
+compressLanes(uint32_t* state, const unsigned char* const* blocks)
+{
+    typedef typename Ops::V V;
+    constexpr std::size_t L = Ops::LANES;
+
+    V w[16];
+    Ops::loadBlock(blocks, w);
+
+    V a = Ops::loadState(state);
+    V b = Ops::loadState(state + L);
+    V c = Ops::loadState(state + 2 * L);
+    V d = Ops::loadState(state + 3 * L);
+    V e = Ops::loadState(state + 4 * L);
+
+    // the message schedule is kept in a ring of 16 words
+    auto schedule = [&w](int t) {
+        if (t >= 16)
+        {
+            w[t & 15] = Ops::template rotl<1>(Ops::xor3(w[(t - 3) & 15], w[(t - 8) & 15], Ops::xor_(w[(t - 14) & 15], w[t & 15])));
+        }
+        return w[t & 15];
+    };
+    auto step = [&](int t, V f, V k) {
+        V tmp = Ops::add(Ops::add(Ops::template rotl<5>(a), f), Ops::add(Ops::add(e, k), schedule(t)));
+        e = d;
+        d = c;
+        c = Ops::template rotl<30>(b);
+        b = a;
+        a = tmp;
+    };
+
+    const V k0 = Ops::set1(0x5A827999u);
+    const V k1 = Ops::set1(0x6ED9EBA1u);
+    const V k2 = Ops::set1(0x8F1BBCDCu);
+    const V k3 = Ops::set1(0xCA62C1D6u);
+    for (int t = 0; t < 20; ++t)
+    {
+        step(t, Ops::choose(b, c, d), k0);
+    }
+    for (int t = 20; t < 40; ++t)
+    {
+        step(t, Ops::xor3(b, c, d), k1);
+    }
+    for (int t = 40; t < 60; ++t)
+    {
+        step(t, Ops::majority(b, c, d), k2);
+    }
+    for (int t = 60; t < 80; ++t)
+    {
+        step(t, Ops::xor3(b, c, d), k3);
+    }
+
+    Ops::storeState(state,         Ops::add(a, Ops::loadState(state)));
+    Ops::storeState(state + L,     Ops::add(b, Ops::loadState(state + L)));
+    Ops::storeState(state + 2 * L, Ops::add(c, Ops::loadState(state + 2 * L)));
+    Ops::storeState(state + 3 * L, Ops::add(d, Ops::loadState(state + 3 * L)));
+    Ops::storeState(state + 4 * L, Ops::add(e, Ops::loadState(state + 4 * L)));
+}
+
+} /* namespace utils */
+} /* namespace giga */
+
+#endif /* GIGA_UTILS_MULTISHA1LANES_H_ */
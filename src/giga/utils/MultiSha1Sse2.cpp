@@ -0,0 +1,105 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MultiSha1Lanes.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+
+namespace giga
+{
+namespace utils
+{
+
+namespace
+{
+
+struct Sse2
+{
+    typedef __m128i V;
+    static constexpr std::size_t LANES = 4u;
+
+    static V add(V a, V b)          { return _mm_add_epi32(a, b); }
+    static V xor_(V a, V b)         { return _mm_xor_si128(a, b); }
+    static V xor3(V a, V b, V c)    { return _mm_xor_si128(_mm_xor_si128(a, b), c); }
+    static V choose(V b, V c, V d)  { return _mm_xor_si128(d, _mm_and_si128(b, _mm_xor_si128(c, d))); }
+    static V majority(V b, V c, V d){ return _mm_or_si128(_mm_and_si128(b, c), _mm_and_si128(d, _mm_or_si128(b, c))); }
+    static V set1(uint32_t x)       { return _mm_set1_epi32(static_cast<int>(x)); }
+
+    template <int N>
+    static V rotl(V a)              { return _mm_or_si128(_mm_slli_epi32(a, N), _mm_srli_epi32(a, 32 - N)); }
+
+    static V loadState(const uint32_t* p)  { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+    static void storeState(uint32_t* p, V a){ _mm_storeu_si128(reinterpret_cast<__m128i*>(p), a); }
+
+    static V
+    byteSwap(V a)
+    {
+        a = _mm_or_si128(_mm_slli_epi16(a, 8), _mm_srli_epi16(a, 8));
+        return _mm_shufflehi_epi16(_mm_shufflelo_epi16(a, 0xB1), 0xB1);
+    }
+
+    static void
+    loadBlock(const unsigned char* const* blocks, V (&w)[16])
+    {
+        for (int i = 0; i < 16; i += 4)
+        {
+            V r[LANES];
+            for (std::size_t l = 0; l < LANES; ++l)
+            {
+                r[l] = byteSwap(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks[l] + 4 * i)));
+            }
+            const V t0 = _mm_unpacklo_epi32(r[0], r[1]);
+            const V t1 = _mm_unpackhi_epi32(r[0], r[1]);
+            const V t2 = _mm_unpacklo_epi32(r[2], r[3]);
+            const V t3 = _mm_unpackhi_epi32(r[2], r[3]);
+            w[i]     = _mm_unpacklo_epi64(t0, t2);
+            w[i + 1] = _mm_unpackhi_epi64(t0, t2);
+            w[i + 2] = _mm_unpacklo_epi64(t1, t3);
+            w[i + 3] = _mm_unpackhi_epi64(t1, t3);
+        }
+    }
+};
+
+} /* anonymous namespace */
+
+const LanesKernel*
+sha1LanesSse2()
+{
+    static const LanesKernel kernel{Sse2::LANES, compressLanes<Sse2>};
+    return &kernel;
+}
+
+} /* namespace utils */
+} /* namespace giga */
+
+#else
+
+namespace giga
+{
+namespace utils
+{
+
+const LanesKernel*
+sha1LanesSse2()
+{
+    return nullptr;
+}
+
+} /* namespace utils */
+} /* namespace giga */
+
+#endif
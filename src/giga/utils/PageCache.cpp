@@ -0,0 +1,126 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PageCache.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace giga
+{
+namespace utils
+{
+
+constexpr std::size_t PageCacheDropper::WINDOW;
+
+PageCacheDropper::PageCacheDropper() :
+        _fd{-1}, _writes{false}, _written{0u}, _from{0u}, _position{0u}
+{
+}
+
+void
+PageCacheDropper::attach(int fd, uint64_t position, bool writes)
+{
+    _fd       = fd;
+    _writes   = writes;
+    _written  = position;
+    _from     = position;
+    _position = position;
+}
+
+void
+PageCacheDropper::advance(uint64_t count)
+{
+    _position += count;
+    if (_fd < 0 || _position - _from < WINDOW)
+    {
+        return;
+    }
+    if (_writes)
+    {
+        // start writing this window back, and drop the previous one (written by now, most of the time)
+        drop(_from, _position, false);
+        drop(_written, _from, true);
+        _written = _from;
+    }
+    else
+    {
+        drop(_from, _position, true);
+    }
+    _from = _position;
+}
+
+void
+PageCacheDropper::seek(uint64_t position)
+{
+    flush();
+    _written  = position;
+    _from     = position;
+    _position = position;
+}
+
+void
+PageCacheDropper::flush()
+{
+    if (_fd < 0)
+    {
+        return;
+    }
+    drop(_written < _from ? _written : _from, _position, true);
+    _written = _position;
+    _from    = _position;
+}
+
+void
+PageCacheDropper::drop(uint64_t from, uint64_t to, bool wait)
+{
+    if (from >= to)
+    {
+        return;
+    }
+#ifndef _WIN32
+    auto offset = static_cast<off_t>(from);
+    auto length = static_cast<off_t>(to - from);
+#if defined(__linux__)
+    if (_writes)
+    {
+        // the dirty pages cannot be dropped: they must be written first
+        unsigned int flags = SYNC_FILE_RANGE_WRITE;
+        if (wait)
+        {
+            flags |= SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WAIT_AFTER;
+        }
+        sync_file_range(_fd, offset, length, flags);
+    }
+#endif
+#if defined(POSIX_FADV_DONTNEED)
+    if (wait || !_writes)
+    {
+        posix_fadvise(_fd, offset, length, POSIX_FADV_DONTNEED);
+    }
+#else
+    (void) offset;
+    (void) length;
+#endif
+#else
+    (void) wait;
+#endif
+}
+
+} /* namespace utils */
+} /* namespace giga */
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GIGA_UTILS_PAGECACHE_H_
+#define GIGA_UTILS_PAGECACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace giga
+{
+namespace utils
+{
+
+/**
+ * How the bulk transfers read and write the files.
+ *  - ```cached```: through the page cache, as usual (the default).
+ *  - ```streaming```: sequential read-ahead, and the pages are given back to the kernel behind the cursor,
+ *    so that hashing or uploading a huge file does not evict the working set of the other processes.
+ *  - ```direct```: bypass the page cache (```O_DIRECT```, ```F_NOCACHE``` on macOS) with aligned buffers.
+ *    It falls back to ```streaming``` when the file system or the buffers do not allow it.
+ */
+enum class IoMode
+{
+    cached, streaming, direct
+};
+
+/**
+ * Gives the pages of a file back to the kernel (```POSIX_FADV_DONTNEED```) once the cursor is past them.
+ *
+ * The pages are dropped by windows of ```WINDOW``` bytes. The written pages must reach the disk first:
+ * on Linux each window is written back asynchronously (```sync_file_range()```), and dropped one window later.
+ * It does nothing until ```attach()``` is called, and nothing at all on Windows.
+ */
+class PageCacheDropper final
+{
+public:
+    static constexpr std::size_t WINDOW = 8u * 1024u * 1024u;
+
+public:
+    PageCacheDropper();
+
+    /**
+     * @brief Drop the pages of ```fd``` from now on, the cursor being at ```position```.
+     * @param writes whether the file is written (the pages are dirty) or read.
+     */
+    void
+    attach(int fd, uint64_t position, bool writes);
+
+    /**
+     * @brief The cursor moved ```count``` bytes forward.
+     */
+    void
+    advance(uint64_t count);
+
+    /**
+     * @brief The cursor jumps to ```position```: what is behind the previous one is dropped.
+     */
+    void
+    seek(uint64_t position);
+
+    /**
+     * @brief Drop everything behind the cursor (waiting for the written pages). Call it before closing the file.
+     */
+    void
+    flush();
+
+private:
+    void
+    drop(uint64_t from, uint64_t to, bool wait);
+
+private:
+    int      _fd;
+    bool     _writes;
+    uint64_t _written;  // the start of the window being written back (writes only)
+    uint64_t _from;     // the start of the pages not dropped yet
+    uint64_t _position;
+};
+
+} /* namespace utils */
+} /* namespace giga */
+
+#endif /* GIGA_UTILS_PAGECACHE_H_ */
@@ -0,0 +1,361 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ReadAheadFile.h"
+#include "Utils.h"
+#include "../rest/HttpErrors.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+namespace giga
+{
+namespace utils
+{
+
+ReadAheadFile::ReadAheadFile(const boost::filesystem::path& filename, std::size_t blockSize, std::size_t depth) :
+        _file{filename, 0u},
+        _blockSize{std::max<std::size_t>(blockSize, 1u)},
+        _depth{std::max<std::size_t>(depth, 2u)},
+        _buffers{},
+        _sizes{},
+        _mut{},
+        _filled{},
+        _released{},
+        _ready{0u},
+        _current{0u},
+        _holding{false},
+        _eof{false},
+        _stopped{false},
+        _error{},
+        _thread{},
+        _io{nullptr},
+        _offsets{},
+        _done{},
+        _pending{0u},
+        _nextOffset{0u},
+        _dropper{}
+{
+}
+
+ReadAheadFile::~ReadAheadFile()
+{
+    close();
+}
+
+void
+ReadAheadFile::setBuffers(std::size_t blockSize, std::size_t depth)
+{
+    std::lock_guard<std::mutex> l{_mut};
+    if (!_buffers.empty())
+    {
+        return;
+    }
+    _blockSize = std::max<std::size_t>(blockSize, 1u);
+    _depth     = std::max<std::size_t>(depth, 2u);
+}
+
+void
+ReadAheadFile::setIoMode(IoMode mode)
+{
+    std::lock_guard<std::mutex> l{_mut};
+    if (!_buffers.empty())
+    {
+        return;
+    }
+    _file.setMode(mode);
+}
+
+void
+ReadAheadFile::setFileIo(std::shared_ptr<FileIo> io)
+{
+    std::lock_guard<std::mutex> l{_mut};
+    if (!_buffers.empty())
+    {
+        return;
+    }
+#ifndef _WIN32
+    _io = std::move(io);
+#else
+    (void) io;
+#endif
+}
+
+std::size_t
+ReadAheadFile::next()
+{
+    std::unique_lock<std::mutex> l{_mut};
+    if (_buffers.empty())
+    {
+        if (_stopped)
+        {
+            return 0u;
+        }
+        for (std::size_t i = 0; i < _depth; ++i)
+        {
+            _buffers.emplace_back(_blockSize);
+        }
+        _sizes.resize(_depth, 0u);
+        if (_io != nullptr)
+        {
+            startReads();
+            l.unlock();
+            _io->submit();
+            l.lock();
+        }
+        else
+        {
+            _thread = std::thread{[this] { run(); }};
+        }
+    }
+
+    if (_io != nullptr)
+    {
+        return nextRead(l);
+    }
+
+    if (_holding)
+    {
+        _holding = false;
+        _current = (_current + 1) % _depth;
+        _released.notify_one();
+    }
+
+    _filled.wait(l, [this] { return _ready > 0 || _eof || _error || _stopped; });
+    if (_ready == 0)
+    {
+        if (_error)
+        {
+            std::rethrow_exception(_error);
+        }
+        return 0u;
+    }
+    --_ready;
+    _holding = true;
+    return _sizes[_current];
+}
+
+const unsigned char*
+ReadAheadFile::data() const
+{
+    return _buffers[_current].data();
+}
+
+void
+ReadAheadFile::close()
+{
+    {
+        std::lock_guard<std::mutex> l{_mut};
+        _stopped = true;
+    }
+    _released.notify_one();
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+    if (_io != nullptr)
+    {
+        // the buffers must outlive the requests
+        std::unique_lock<std::mutex> l{_mut};
+        _filled.wait(l, [this] { return _pending == 0u; });
+        for (auto& buffer : _buffers)
+        {
+            _io->unregisterBuffer(buffer.data());
+        }
+        _io = nullptr;
+        _dropper.flush();
+    }
+    _file.close();
+}
+
+void
+ReadAheadFile::run()
+{
+    std::size_t index = 0u;
+    for (;;)
+    {
+        {
+            // the block being filled is neither ready nor held by the caller
+            std::unique_lock<std::mutex> l{_mut};
+            _released.wait(l, [this] { return _stopped || _ready + (_holding ? 1u : 0u) < _depth; });
+            if (_stopped)
+            {
+                return;
+            }
+        }
+
+        std::size_t read = 0u;
+        std::exception_ptr error;
+        try
+        {
+            read = _file.read(_buffers[index].data(), _blockSize);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> l{_mut};
+            _sizes[index] = read;
+            if (error)
+            {
+                _error = error;
+            }
+            else if (read > 0)
+            {
+                ++_ready;
+                index = (index + 1) % _depth;
+            }
+            if (read < _blockSize || error)
+            {
+                _eof = true;
+            }
+        }
+        _filled.notify_one();
+        if (read < _blockSize || error)
+        {
+            return;
+        }
+    }
+}
+
+void
+ReadAheadFile::startReads()
+{
+    _offsets.resize(_depth, 0u);
+    _done.resize(_depth, 0);
+    for (std::size_t i = 0; i < _depth; ++i)
+    {
+        _io->registerBuffer(_buffers[i].data(), _blockSize);
+    }
+#ifndef _WIN32
+    if (_file.mode() == IoMode::streaming)
+    {
+        _dropper.attach(_file.descriptor(), 0u, false);
+    }
+#endif
+    for (std::size_t i = 0; i < _depth; ++i)
+    {
+        startRead(i);
+    }
+}
+
+void
+ReadAheadFile::startRead(std::size_t index)
+{
+    _sizes[index]   = 0u;
+    _done[index]    = 0;
+    _offsets[index] = _nextOffset;
+    _nextOffset    += _blockSize;
+    continueRead(index);
+}
+
+void
+ReadAheadFile::continueRead(std::size_t index)
+{
+    ++_pending;
+#ifndef _WIN32
+    auto filled = _sizes[index];
+    _io->read(_file.descriptor(), _offsets[index] + filled, _buffers[index].data() + filled, _blockSize - filled,
+              [this, index](std::size_t count, int error) { onRead(index, count, error); });
+#endif
+}
+
+void
+ReadAheadFile::onRead(std::size_t index, std::size_t count, int error)
+{
+    std::shared_ptr<FileIo> io = nullptr;
+    {
+        // nothing of this object is used after the unlock: close() may be done, and the object destroyed
+        std::lock_guard<std::mutex> l{_mut};
+        --_pending;
+        if (error != 0 && !(error == EINVAL && _file.mode() == IoMode::direct && _sizes[index] > 0u))
+        {
+            // (O_DIRECT refuses to read on from the unaligned end of the file)
+            try
+            {
+                BOOST_THROW_EXCEPTION(ErrorException{U("Error reading file: ") + str2wstr(std::strerror(error))});
+            }
+            catch (...)
+            {
+                _error = std::current_exception();
+            }
+        }
+        _sizes[index] += count;
+        // a read may return less than asked: fill the whole block (but at the end of the file)
+        if (error == 0 && count > 0u && _sizes[index] < _blockSize && !_stopped && !_error)
+        {
+            io = _io;
+            continueRead(index);
+        }
+        else
+        {
+            _done[index] = 1;
+            if (_sizes[index] < _blockSize)
+            {
+                _eof = true;
+            }
+        }
+        _filled.notify_all();
+    }
+    if (io != nullptr)
+    {
+        io->submit();
+    }
+}
+
+std::size_t
+ReadAheadFile::nextRead(std::unique_lock<std::mutex>& l)
+{
+    if (_holding)
+    {
+        // the block handed to the caller reads the next part of the file, after the blocks in flight
+        _holding = false;
+        auto released = _current;
+        _current = (_current + 1) % _depth;
+        if (!_eof && !_stopped && !_error)
+        {
+            startRead(released);
+            l.unlock();
+            _io->submit();
+            l.lock();
+        }
+        else
+        {
+            _sizes[released] = 0u;
+            _done[released]  = 1;
+        }
+    }
+
+    _filled.wait(l, [this] { return _done[_current] || _error || _stopped; });
+    if (_error)
+    {
+        std::rethrow_exception(_error);
+    }
+    if (_stopped || _sizes[_current] == 0u)
+    {
+        return 0u;
+    }
+    _holding = true;
+    _dropper.advance(_sizes[_current]);
+    return _sizes[_current];
+}
+
+} /* namespace utils */
+} /* namespace giga */
@@ -0,0 +1,151 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GIGA_UTILS_READAHEADFILE_H_
+#define GIGA_UTILS_READAHEADFILE_H_
+
+#include "FileIo.h"
+#include "SequentialFile.h"
+
+#include <boost/filesystem.hpp>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace giga
+{
+namespace utils
+{
+
+/**
+ * Reads a file sequentially on a background thread, into a ring of buffers.
+ *
+ * The reader fills the next buffers while the caller processes the current one,
+ * so the disk and the CPU work at the same time. With a depth of 2 this is double
+ * buffering, with 3 (the default) triple buffering.
+ *
+ * The buffers and the reader thread are only created by the first call to ```next()```.
+ * With a ```FileIo``` backend there is no reader thread: the blocks are requested from the backend.
+ */
+class ReadAheadFile final
+{
+public:
+    static constexpr std::size_t DEFAULT_DEPTH = 3u;
+
+public:
+    explicit
+    ReadAheadFile(const boost::filesystem::path& filename,
+                  std::size_t blockSize = SequentialFile::DEFAULT_BLOCK_SIZE,
+                  std::size_t depth = DEFAULT_DEPTH);
+    ~ReadAheadFile();
+
+    ReadAheadFile(ReadAheadFile&&)                 = delete;
+    ReadAheadFile(const ReadAheadFile&)            = delete;
+    ReadAheadFile& operator=(const ReadAheadFile&) = delete;
+    ReadAheadFile& operator=(ReadAheadFile&&)      = delete;
+
+    /**
+     * @brief Change the size and the number (at least 2) of the buffers. Only before the first ```next()```.
+     */
+    void
+    setBuffers(std::size_t blockSize, std::size_t depth);
+
+    /**
+     * @brief Change how the file is read (see ```SequentialFile```). Only before the first ```next()```.
+     */
+    void
+    setIoMode(IoMode mode);
+
+    /**
+     * @brief Read through ```io``` instead of a reader thread: all the blocks are requested at once,
+     * and each block given back is requested again. Only before the first ```next()```.
+     */
+    void
+    setFileIo(std::shared_ptr<FileIo> io);
+
+    /**
+     * @brief Give the current block back to the reader, then wait for the next one.
+     * @return the size of the block in ```data()```, 0 at the end of the file.
+     * Rethrows the errors of the reader.
+     */
+    std::size_t
+    next();
+
+    /**
+     * @return the current block. It is valid until the next call to ```next()```.
+     */
+    const unsigned char*
+    data() const;
+
+    /**
+     * @brief Stop the reader and close the file.
+     */
+    void
+    close();
+
+private:
+    void
+    run();
+
+    // with a FileIo (_mut locked, but onRead())
+    void
+    startReads();
+
+    void
+    startRead(std::size_t index);
+
+    void
+    continueRead(std::size_t index);
+
+    void
+    onRead(std::size_t index, std::size_t count, int error);
+
+    std::size_t
+    nextRead(std::unique_lock<std::mutex>& l);
+
+private:
+    SequentialFile             _file;
+    std::size_t                _blockSize;
+    std::size_t                _depth;
+    std::vector<AlignedBuffer> _buffers;
+    std::vector<std::size_t>   _sizes;
+    std::mutex                 _mut;
+    std::condition_variable    _filled;
+    std::condition_variable    _released;
+    std::size_t                _ready;   // blocks read, not handed to the caller yet
+    std::size_t                _current; // the block handed to the caller
+    bool                       _holding; // whether the caller holds _current
+    bool                       _eof;
+    bool                       _stopped;
+    std::exception_ptr         _error;
+    std::thread                _thread;
+
+    std::shared_ptr<FileIo>    _io;
+    std::vector<uint64_t>      _offsets;    // where each block is read from
+    std::vector<char>          _done;       // whether each block is read
+    std::size_t                _pending;    // the requests in flight
+    uint64_t                   _nextOffset; // where the next block is read from
+    PageCacheDropper           _dropper;
+};
+
+} /* namespace utils */
+} /* namespace giga */
+
+#endif /* GIGA_UTILS_READAHEADFILE_H_ */
@@ -0,0 +1,285 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SequentialFile.h"
+#include "../rest/HttpErrors.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace giga
+{
+namespace utils
+{
+
+AlignedBuffer::AlignedBuffer(std::size_t size) :
+        _data{nullptr}, _size{size}
+{
+    if (size == 0u)
+    {
+        return;
+    }
+#ifdef _WIN32
+    _data = static_cast<unsigned char*>(_aligned_malloc(size, ALIGNMENT));
+#else
+    void* data = nullptr;
+    if (posix_memalign(&data, ALIGNMENT, size) == 0)
+    {
+        _data = static_cast<unsigned char*>(data);
+    }
+#endif
+    if (_data == nullptr)
+    {
+        throw std::bad_alloc{};
+    }
+}
+
+AlignedBuffer::~AlignedBuffer()
+{
+#ifdef _WIN32
+    _aligned_free(_data);
+#else
+    std::free(_data);
+#endif
+}
+
+AlignedBuffer::AlignedBuffer(AlignedBuffer&& other) noexcept :
+        _data{other._data}, _size{other._size}
+{
+    other._data = nullptr;
+    other._size = 0u;
+}
+
+AlignedBuffer&
+AlignedBuffer::operator=(AlignedBuffer&& other) noexcept
+{
+    std::swap(_data, other._data);
+    std::swap(_size, other._size);
+    return *this;
+}
+
+unsigned char*
+AlignedBuffer::data() const
+{
+    return _data;
+}
+
+std::size_t
+AlignedBuffer::size() const
+{
+    return _size;
+}
+
+SequentialFile::SequentialFile(const boost::filesystem::path& filename, std::size_t blockSize, IoMode mode) :
+#ifdef _WIN32
+        _buf{blockSize}, _mode{IoMode::cached}, _is{filename.c_str(), std::ifstream::binary}
+{
+    if (!_is)
+    {
+        BOOST_THROW_EXCEPTION(ErrorException{U("Cannot open file")});
+    }
+    setMode(mode);
+}
+#else
+        _buf{blockSize}, _mode{IoMode::cached}, _fd{::open(filename.c_str(), O_RDONLY | O_CLOEXEC)}, _position{0u}, _dropper{}
+{
+    if (_fd < 0)
+    {
+        BOOST_THROW_EXCEPTION(ErrorException{U("Cannot open file")});
+    }
+#if defined(POSIX_FADV_SEQUENTIAL)
+    posix_fadvise(_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#elif defined(F_RDAHEAD)
+    fcntl(_fd, F_RDAHEAD, 1);
+#endif
+    setMode(mode);
+}
+#endif
+
+SequentialFile::~SequentialFile()
+{
+    close();
+}
+
+std::size_t
+SequentialFile::read()
+{
+    return read(_buf.data(), _buf.size());
+}
+
+std::size_t
+SequentialFile::read(unsigned char* buffer, std::size_t size)
+{
+    auto data = reinterpret_cast<char*>(buffer);
+    std::size_t filled = 0u;
+#ifdef _WIN32
+    _is.read(data, static_cast<std::streamsize>(size));
+    if (_is.bad())
+    {
+        BOOST_THROW_EXCEPTION(ErrorException{U("Error reading file")});
+    }
+    filled = static_cast<std::size_t>(_is.gcount());
+#else
+    // a read may return less than asked: fill the whole block (but at the end of the file)
+    while (filled < size)
+    {
+        if (_mode == IoMode::direct
+            && (reinterpret_cast<std::uintptr_t>(data + filled) % AlignedBuffer::ALIGNMENT != 0u
+                || (size - filled) % AlignedBuffer::ALIGNMENT != 0u
+                || _position % AlignedBuffer::ALIGNMENT != 0u))
+        {
+            setMode(IoMode::streaming);
+        }
+        auto count = ::read(_fd, data + filled, size - filled);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EINVAL && _mode == IoMode::direct)
+            {
+                // the file system took O_DIRECT, but not these reads
+                setMode(IoMode::streaming);
+                continue;
+            }
+            BOOST_THROW_EXCEPTION(ErrorException{U("Error reading file")});
+        }
+        if (count == 0)
+        {
+            break;
+        }
+        auto shortRead = static_cast<std::size_t>(count) < size - filled;
+        filled    += static_cast<std::size_t>(count);
+        _position += static_cast<uint64_t>(count);
+        _dropper.advance(static_cast<uint64_t>(count));
+        if (shortRead && _mode == IoMode::direct)
+        {
+            break; // the end of the file: do not fall back to a buffered read of the (unaligned) rest
+        }
+    }
+#endif
+    return filled;
+}
+
+void
+SequentialFile::seek(uint64_t position)
+{
+#ifdef _WIN32
+    _is.clear();
+    _is.seekg(static_cast<std::streamoff>(position));
+    if (!_is)
+    {
+        BOOST_THROW_EXCEPTION(ErrorException{U("Error seeking file")});
+    }
+#else
+    if (::lseek(_fd, static_cast<off_t>(position), SEEK_SET) < 0)
+    {
+        BOOST_THROW_EXCEPTION(ErrorException{U("Error seeking file")});
+    }
+    _position = position;
+    _dropper.seek(position);
+#endif
+}
+
+const unsigned char*
+SequentialFile::data() const
+{
+    return _buf.data();
+}
+
+std::size_t
+SequentialFile::blockSize() const
+{
+    return _buf.size();
+}
+
+#ifndef _WIN32
+int
+SequentialFile::descriptor() const
+{
+    return _fd;
+}
+#endif
+
+IoMode
+SequentialFile::mode() const
+{
+    return _mode;
+}
+
+void
+SequentialFile::setMode(IoMode mode)
+{
+#ifdef _WIN32
+    (void) mode; // the streams always go through the cache
+#else
+    auto direct = mode == IoMode::direct;
+#if defined(O_DIRECT)
+    // not every file system accepts O_DIRECT (tmpfs for example)
+    auto flags = fcntl(_fd, F_GETFL);
+    if (flags < 0 || fcntl(_fd, F_SETFL, direct ? flags | O_DIRECT : flags & ~O_DIRECT) != 0)
+    {
+        direct = false;
+    }
+#elif defined(F_NOCACHE)
+    fcntl(_fd, F_NOCACHE, direct ? 1 : 0);
+#else
+    direct = false;
+#endif
+    _mode = direct ? IoMode::direct : mode == IoMode::cached ? IoMode::cached : IoMode::streaming;
+    if (_mode == IoMode::streaming)
+    {
+        _dropper.attach(_fd, _position, false);
+    }
+    else
+    {
+        _dropper.attach(-1, _position, false);
+    }
+#endif
+}
+
+void
+SequentialFile::close()
+{
+#ifdef _WIN32
+    if (_is.is_open())
+    {
+        _is.close();
+    }
+#else
+    if (_fd >= 0)
+    {
+        _dropper.flush();
+        _dropper.attach(-1, 0u, false);
+        ::close(_fd);
+        _fd = -1;
+    }
+#endif
+}
+
+} /* namespace utils */
+} /* namespace giga */
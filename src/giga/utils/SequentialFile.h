@@ -0,0 +1,153 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GIGA_UTILS_SEQUENTIALFILE_H_
+#define GIGA_UTILS_SEQUENTIALFILE_H_
+
+#include "PageCache.h"
+
+#include <boost/filesystem.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+
+namespace giga
+{
+namespace utils
+{
+
+/**
+ * A page-aligned memory block (no memory is allocated for an empty one).
+ */
+class AlignedBuffer final
+{
+public:
+    static constexpr std::size_t ALIGNMENT = 4096u;
+
+public:
+    explicit
+    AlignedBuffer(std::size_t size);
+    ~AlignedBuffer();
+
+    AlignedBuffer(AlignedBuffer&& other) noexcept;
+    AlignedBuffer& operator=(AlignedBuffer&& other) noexcept;
+    AlignedBuffer(const AlignedBuffer&)            = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+    unsigned char*
+    data() const;
+
+    std::size_t
+    size() const;
+
+private:
+    unsigned char* _data;
+    std::size_t    _size;
+};
+
+/**
+ * Reads a file from the beginning to the end, by large blocks.
+ *
+ * The blocks are read in a page-aligned buffer, and the kernel is told that the access
+ * is sequential (```posix_fadvise()```) so that it reads ahead aggressively.
+ * With a ```blockSize``` of 0, no buffer is allocated: only ```read(data, size)``` can be used.
+ *
+ * With ```IoMode::streaming``` the pages read are given back to the kernel (see ```PageCacheDropper```).
+ * With ```IoMode::direct``` the page cache is bypassed, as long as the buffers, the sizes and the position
+ * stay aligned on ```AlignedBuffer::ALIGNMENT```: the first unaligned read switches to ```IoMode::streaming```.
+ * The last block of the file may be asked with its size rounded up to the alignment.
+ */
+class SequentialFile final
+{
+public:
+    static constexpr std::size_t DEFAULT_BLOCK_SIZE = 1024u * 1024u;
+
+public:
+    explicit
+    SequentialFile(const boost::filesystem::path& filename, std::size_t blockSize = DEFAULT_BLOCK_SIZE,
+                   IoMode mode = IoMode::cached);
+    ~SequentialFile();
+
+    SequentialFile(SequentialFile&&)                 = delete;
+    SequentialFile(const SequentialFile&)            = delete;
+    SequentialFile& operator=(const SequentialFile&) = delete;
+    SequentialFile& operator=(SequentialFile&&)      = delete;
+
+    /**
+     * @brief Read the next block into ```data()```.
+     * @return the number of bytes read: less than ```blockSize()``` only at the end of the file, 0 after it.
+     */
+    std::size_t
+    read();
+
+    /**
+     * @brief Read the next bytes into ```data``` (best aligned on ```AlignedBuffer::ALIGNMENT```).
+     * @return the number of bytes read: less than ```size``` only at the end of the file, 0 after it.
+     */
+    std::size_t
+    read(unsigned char* data, std::size_t size);
+
+    /**
+     * @brief Move to ```position```, from the beginning of the file.
+     */
+    void
+    seek(uint64_t position);
+
+    const unsigned char*
+    data() const;
+
+    std::size_t
+    blockSize() const;
+
+    /**
+     * @brief Change how the next blocks are read. Ignored on Windows (always ```IoMode::cached```).
+     */
+    void
+    setMode(IoMode mode);
+
+#ifndef _WIN32
+    /**
+     * @return the file descriptor, for the positioned reads of a ```FileIo```.
+     */
+    int
+    descriptor() const;
+#endif
+
+    /**
+     * @return the mode really used (```IoMode::direct``` may have fallen back to ```IoMode::streaming```).
+     */
+    IoMode
+    mode() const;
+
+    void
+    close();
+
+private:
+    AlignedBuffer _buf;
+    IoMode        _mode;
+#ifdef _WIN32
+    std::ifstream _is;
+#else
+    int              _fd;
+    uint64_t         _position;
+    PageCacheDropper _dropper;
+#endif
+};
+
+} /* namespace utils */
+} /* namespace giga */
+
+#endif /* GIGA_UTILS_SEQUENTIALFILE_H_ */
@@ -0,0 +1,357 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Sha1Engine.h"
+#include "CpuFeatures.h"
+#include "SequentialFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define GIGA_SHA1_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define GIGA_SHA1_TARGET
+#else
+#define GIGA_SHA1_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+#endif
+#endif
+
+namespace giga
+{
+namespace utils
+{
+
+namespace
+{
+
+inline uint32_t
+rotl(uint32_t x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+inline uint32_t
+loadBigEndian(const unsigned char* p)
+{
+    return (uint32_t{p[0]} << 24) | (uint32_t{p[1]} << 16) | (uint32_t{p[2]} << 8) | uint32_t{p[3]};
+}
+
+void
+compressPortable(uint32_t* state, const unsigned char* blocks, std::size_t count)
+{
+    for (std::size_t b = 0; b < count; ++b, blocks += 64)
+    {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i)
+        {
+            w[i] = loadBigEndian(blocks + 4 * i);
+        }
+        for (int i = 16; i < 80; ++i)
+        {
+            w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        auto a = state[0], b1 = state[1], c = state[2], d = state[3], e = state[4];
+        for (int i = 0; i < 80; ++i)
+        {
+            uint32_t f, k;
+            if (i < 20)
+            {
+                f = (b1 & c) | (~b1 & d);
+                k = 0x5A827999u;
+            }
+            else if (i < 40)
+            {
+                f = b1 ^ c ^ d;
+                k = 0x6ED9EBA1u;
+            }
+            else if (i < 60)
+            {
+                f = (b1 & c) | (b1 & d) | (c & d);
+                k = 0x8F1BBCDCu;
+            }
+            else
+            {
+                f = b1 ^ c ^ d;
+                k = 0xCA62C1D6u;
+            }
+            auto t = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b1, 30);
+            b1 = a;
+            a = t;
+        }
+        state[0] += a;
+        state[1] += b1;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+    }
+}
+
+#ifdef GIGA_SHA1_X86
+
+/**
+ * Four of the 80 rounds: ```G``` in [0, 20). The message schedule is interleaved
+ * with the rounds, as in Intel's reference code.
+ */
+template <int G>
+GIGA_SHA1_TARGET inline void
+shaNiGroup(__m128i& abcd, __m128i& e0, __m128i& e1, __m128i (&msg)[4])
+{
+    auto& cur   = msg[G % 4];
+    auto& eCur  = (G % 2 == 0) ? e0 : e1;
+    auto& eNext = (G % 2 == 0) ? e1 : e0;
+
+    eCur  = (G == 0) ? _mm_add_epi32(eCur, cur) : _mm_sha1nexte_epu32(eCur, cur);
+    eNext = abcd;
+    if (G >= 3 && G <= 18)
+    {
+        msg[(G + 1) % 4] = _mm_sha1msg2_epu32(msg[(G + 1) % 4], cur);
+    }
+    abcd = _mm_sha1rnds4_epu32(abcd, eCur, G / 5);
+    if (G >= 1 && G <= 16)
+    {
+        msg[(G + 3) % 4] = _mm_sha1msg1_epu32(msg[(G + 3) % 4], cur);
+    }
+    if (G >= 2 && G <= 17)
+    {
+        msg[(G + 2) % 4] = _mm_xor_si128(msg[(G + 2) % 4], cur);
+    }
+}
+
+template <int... G>
+GIGA_SHA1_TARGET inline void
+shaNiGroups(__m128i& abcd, __m128i& e0, __m128i& e1, __m128i (&msg)[4], std::integer_sequence<int, G...>)
+{
+    // expands in order: the groups depend on each other
+    int unused[] = {(shaNiGroup<G>(abcd, e0, e1, msg), 0)...};
+    (void) unused;
+}
+
+GIGA_SHA1_TARGET void
+compressShaNi(uint32_t* state, const unsigned char* blocks, std::size_t count)
+{
+    const auto mask = _mm_set_epi64x(0x0001020304050607LL, 0x08090a0b0c0d0e0fLL);
+
+    auto abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0x1B);
+    auto e0   = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+    auto e1   = _mm_setzero_si128();
+
+    for (std::size_t b = 0; b < count; ++b, blocks += 64)
+    {
+        const auto abcdSave = abcd;
+        const auto e0Save   = e0;
+
+        __m128i msg[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 16 * i)), mask);
+        }
+        shaNiGroups(abcd, e0, e1, msg, std::make_integer_sequence<int, 20>{});
+
+        e0   = _mm_sha1nexte_epu32(e0, e0Save);
+        abcd = _mm_add_epi32(abcd, abcdSave);
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_shuffle_epi32(abcd, 0x1B));
+    state[4] = static_cast<uint32_t>(_mm_extract_epi32(e0, 3));
+}
+
+#endif /* GIGA_SHA1_X86 */
+
+} /* anonymous namespace */
+
+Sha1Engine::Implementation
+Sha1Engine::best()
+{
+    static const auto implementation = available(Implementation::shaNi) ? Implementation::shaNi : Implementation::openssl;
+    return implementation;
+}
+
+bool
+Sha1Engine::available(Implementation implementation)
+{
+    switch (implementation)
+    {
+        case Implementation::shaNi:
+#ifdef GIGA_SHA1_X86
+        {
+            const auto& cpu = CpuFeatures::get();
+            return cpu.sha && cpu.ssse3 && cpu.sse41;
+        }
+#else
+            return false;
+#endif
+        case Implementation::openssl:
+        case Implementation::portable:
+            return true;
+    }
+    return false;
+}
+
+const char*
+Sha1Engine::name(Implementation implementation)
+{
+    switch (implementation)
+    {
+        case Implementation::shaNi:
+            return "sha-ni";
+        case Implementation::openssl:
+            return "openssl";
+        case Implementation::portable:
+            return "portable";
+    }
+    return "unknown";
+}
+
+std::string
+Sha1Engine::file(const boost::filesystem::path& filename)
+{
+    SequentialFile file{filename};
+    Sha1Engine engine;
+    while (auto read = file.read())
+    {
+        engine.update(file.data(), read);
+    }
+    return engine.hexDigest();
+}
+
+std::string
+Sha1Engine::toHex(const Digest& digest)
+{
+    static constexpr char HEX[] = "0123456789abcdef";
+    std::string hex(digest.size() * 2, '0');
+    for (std::size_t i = 0; i < digest.size(); ++i)
+    {
+        hex[2 * i]     = HEX[digest[i] >> 4];
+        hex[2 * i + 1] = HEX[digest[i] & 0x0F];
+    }
+    return hex;
+}
+
+Sha1Engine::Sha1Engine(Implementation implementation) :
+        _implementation{available(implementation) ? implementation : Implementation::openssl},
+        _compress{compressPortable},
+        _ctx{},
+        _state{{0x67452301u, 0xEFCDAB89u, 0x98BADCFEu, 0x10325476u, 0xC3D2E1F0u}},
+        _block{},
+        _blockSize{0u},
+        _length{0u}
+{
+#ifdef GIGA_SHA1_X86
+    if (_implementation == Implementation::shaNi)
+    {
+        _compress = compressShaNi;
+    }
+#endif
+    if (_implementation == Implementation::openssl)
+    {
+        SHA1_Init(&_ctx);
+    }
+}
+
+void
+Sha1Engine::update(const void* data, std::size_t size)
+{
+    if (_implementation == Implementation::openssl)
+    {
+        SHA1_Update(&_ctx, data, size);
+        return;
+    }
+
+    auto bytes = static_cast<const unsigned char*>(data);
+    _length += size;
+    if (_blockSize > 0)
+    {
+        auto count = std::min(size, _block.size() - _blockSize);
+        std::memcpy(_block.data() + _blockSize, bytes, count);
+        _blockSize += count;
+        bytes += count;
+        size -= count;
+        if (_blockSize < _block.size())
+        {
+            return;
+        }
+        _compress(_state.data(), _block.data(), 1u);
+        _blockSize = 0u;
+    }
+
+    auto blocks = size / _block.size();
+    if (blocks > 0)
+    {
+        _compress(_state.data(), bytes, blocks);
+        bytes += blocks * _block.size();
+        size -= blocks * _block.size();
+    }
+    std::memcpy(_block.data(), bytes, size);
+    _blockSize = size;
+}
+
+Sha1Engine::Digest
+Sha1Engine::digest()
+{
+    Digest digest;
+    if (_implementation == Implementation::openssl)
+    {
+        SHA1_Final(digest.data(), &_ctx);
+        return digest;
+    }
+
+    const auto bitLength = _length * 8u;
+    _block[_blockSize++] = 0x80;
+    if (_blockSize > _block.size() - 8u)
+    {
+        std::fill(_block.begin() + static_cast<std::ptrdiff_t>(_blockSize), _block.end(), 0);
+        _compress(_state.data(), _block.data(), 1u);
+        _blockSize = 0u;
+    }
+    std::fill(_block.begin() + static_cast<std::ptrdiff_t>(_blockSize), _block.end() - 8, 0);
+    for (int i = 0; i < 8; ++i)
+    {
+        _block[_block.size() - 1u - static_cast<std::size_t>(i)] = static_cast<unsigned char>(bitLength >> (8 * i));
+    }
+    _compress(_state.data(), _block.data(), 1u);
+    _blockSize = 0u;
+
+    for (std::size_t i = 0; i < _state.size(); ++i)
+    {
+        digest[4 * i]     = static_cast<unsigned char>(_state[i] >> 24);
+        digest[4 * i + 1] = static_cast<unsigned char>(_state[i] >> 16);
+        digest[4 * i + 2] = static_cast<unsigned char>(_state[i] >> 8);
+        digest[4 * i + 3] = static_cast<unsigned char>(_state[i]);
+    }
+    return digest;
+}
+
+std::string
+Sha1Engine::hexDigest()
+{
+    return toHex(digest());
+}
+
+Sha1Engine::Implementation
+Sha1Engine::implementation() const
+{
+    return _implementation;
+}
+
+} /* namespace utils */
+} /* namespace giga */
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GIGA_UTILS_SHA1ENGINE_H_
+#define GIGA_UTILS_SHA1ENGINE_H_
+
+#include <boost/filesystem.hpp>
+#include <openssl/sha.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace giga
+{
+namespace utils
+{
+
+/**
+ * Computes SHA1 digests with the fastest implementation available on the running CPU.
+ *
+ * The implementation is picked at runtime:
+ *  - ```shaNi```: the x86 SHA extensions (SHA1RNDS4, SHA1MSG1, ...),
+ *  - ```openssl```: OpenSSL's assembly, which dispatches itself between AVX2, AVX and SSSE3,
+ *  - ```portable```: plain C++, for testing and for the exotic platforms.
+ */
+class Sha1Engine final
+{
+public:
+    enum class Implementation
+    {
+        shaNi, openssl, portable
+    };
+
+    typedef std::array<unsigned char, SHA_DIGEST_LENGTH> Digest;
+
+public:
+    /**
+     * @return the fastest implementation supported by this CPU.
+     */
+    static Implementation
+    best();
+
+    static bool
+    available(Implementation implementation);
+
+    static const char*
+    name(Implementation implementation);
+
+    /**
+     * @brief Hash a whole file (read with ```SequentialFile```).
+     * @return the lower case hexadecimal digest.
+     */
+    static std::string
+    file(const boost::filesystem::path& filename);
+
+    static std::string
+    toHex(const Digest& digest);
+
+public:
+    explicit
+    Sha1Engine(Implementation implementation = best());
+    ~Sha1Engine() = default;
+
+    Sha1Engine(Sha1Engine&&)                 = default;
+    Sha1Engine(const Sha1Engine&)            = default;
+    Sha1Engine& operator=(const Sha1Engine&) = default;
+    Sha1Engine& operator=(Sha1Engine&&)      = default;
+
+    void
+    update(const void* data, std::size_t size);
+
+    /**
+     * @brief Finish the computation. The engine must not be updated afterwards.
+     */
+    Digest
+    digest();
+
+    /**
+     * @brief Finish the computation, then return the lower case hexadecimal digest.
+     */
+    std::string
+    hexDigest();
+
+    Implementation
+    implementation() const;
+
+private:
+    typedef void (*CompressFct)(uint32_t* state, const unsigned char* blocks, std::size_t count);
+
+private:
+    Implementation                _implementation;
+    CompressFct                   _compress;
+    SHA_CTX                       _ctx;
+    std::array<uint32_t, 5>       _state;
+    std::array<unsigned char, 64> _block;
+    std::size_t                   _blockSize; // bytes buffered in _block
+    uint64_t                      _length;
+};
+
+} /* namespace utils */
+} /* namespace giga */
+
+#endif /* GIGA_UTILS_SHA1ENGINE_H_ */
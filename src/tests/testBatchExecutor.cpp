@@ -0,0 +1,109 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MODULE batch_executor
+#include <boost/test/included/unit_test.hpp>
+#include <giga/rest/BatchExecutor.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace boost::unit_test;
+using giga::BatchExecutor;
+
+BOOST_AUTO_TEST_CASE(test_results_are_in_input_order)
+{
+    auto executor = BatchExecutor{4u};
+    auto results  = executor.run<int>(20u, [](std::size_t i) {
+        return pplx::create_task([i]() {
+            // the first ones are the slowest
+            std::this_thread::sleep_for(std::chrono::milliseconds{static_cast<int>(20u - i)});
+            return std::make_shared<int>(static_cast<int>(i));
+        });
+    }).get();
+
+    BOOST_REQUIRE_EQUAL(results.size(), 20u);
+    for (auto i = 0u; i < results.size(); ++i)
+    {
+        BOOST_REQUIRE(results[i].ok());
+        BOOST_CHECK_EQUAL(*results[i].get(), static_cast<int>(i));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_concurrency_is_bounded)
+{
+    auto inFlight = std::make_shared<std::atomic<int>>(0);
+    auto maxSeen  = std::make_shared<std::atomic<int>>(0);
+    auto executor = BatchExecutor{3u};
+    auto results  = executor.run<int>(12u, [inFlight, maxSeen](std::size_t i) {
+        auto now  = ++*inFlight;
+        auto seen = maxSeen->load();
+        while (now > seen && !maxSeen->compare_exchange_weak(seen, now))
+        {
+        }
+        return pplx::create_task([i, inFlight]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds{20});
+            --*inFlight;
+            return std::make_shared<int>(static_cast<int>(i));
+        });
+    }).get();
+
+    BOOST_CHECK_EQUAL(results.size(), 12u);
+    BOOST_CHECK_LE(maxSeen->load(), 3);
+    BOOST_CHECK_EQUAL(executor.maxConcurrency(), 3u);
+    BOOST_CHECK_EQUAL(BatchExecutor{0u}.maxConcurrency(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(test_errors_are_per_item)
+{
+    auto executor = BatchExecutor{2u};
+    auto results  = executor.run<int>(5u, [](std::size_t i) -> pplx::task<std::shared_ptr<int>> {
+        if (i == 1u)
+        {
+            throw std::runtime_error{"not sent"};
+        }
+        return pplx::create_task([i]() {
+            if (i == 3u)
+            {
+                throw std::runtime_error{"failed"};
+            }
+            return std::make_shared<int>(static_cast<int>(i));
+        });
+    }).get();
+
+    BOOST_REQUIRE_EQUAL(results.size(), 5u);
+    BOOST_CHECK(results[0].ok());
+    BOOST_CHECK(!results[1].ok());
+    BOOST_CHECK_THROW(results[1].get(), std::runtime_error);
+    BOOST_CHECK(results[2].ok());
+    BOOST_CHECK(!results[3].ok());
+    BOOST_CHECK_THROW(results[3].get(), std::runtime_error);
+    BOOST_CHECK_EQUAL(*results[4].get(), 4);
+}
+
+BOOST_AUTO_TEST_CASE(test_empty_batch)
+{
+    auto executor = BatchExecutor{};
+    auto results  = executor.run<int>(0u, [](std::size_t) {
+        return pplx::task_from_result(std::make_shared<int>(0));
+    }).get();
+    BOOST_CHECK(results.empty());
+    BOOST_CHECK_EQUAL(executor.maxConcurrency(), BatchExecutor::DEFAULT_CONCURRENCY);
+}
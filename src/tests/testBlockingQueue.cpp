@@ -0,0 +1,116 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MODULE blocking_queue
+#include <boost/test/included/unit_test.hpp>
+#include <giga/utils/BlockingQueue.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+using namespace boost::unit_test;
+using giga::utils::BlockingQueue;
+
+namespace
+{
+std::size_t
+weight (const std::string& s)
+{
+    return s.size();
+}
+}
+
+BOOST_AUTO_TEST_CASE(test_fifo)
+{
+    BlockingQueue<int> q;
+    q.enqueue(1);
+    q.enqueue(2);
+    q.enqueue(3);
+    BOOST_CHECK_EQUAL(q.size_approx(), 3u);
+
+    int e = 0;
+    q.wait_dequeue(e);
+    BOOST_CHECK_EQUAL(e, 1);
+    BOOST_CHECK(q.try_dequeue(e));
+    BOOST_CHECK_EQUAL(e, 2);
+    BOOST_CHECK(q.try_dequeue(e));
+    BOOST_CHECK_EQUAL(e, 3);
+    BOOST_CHECK(!q.try_dequeue(e));
+}
+
+BOOST_AUTO_TEST_CASE(test_full_queue_blocks_the_producer_until_a_dequeue)
+{
+    BlockingQueue<int> q;
+    q.setLimits(1u, 0u, nullptr);
+    q.wait_enqueue(1);
+
+    std::atomic<bool> enqueued{false};
+    std::thread producer{[&q, &enqueued]() {
+        q.wait_enqueue(2);
+        enqueued = true;
+    }};
+    std::this_thread::sleep_for(std::chrono::milliseconds{100});
+    BOOST_CHECK(!enqueued);
+    BOOST_CHECK_EQUAL(q.size_approx(), 1u);
+
+    int e = 0;
+    q.wait_dequeue(e);
+    producer.join();
+    BOOST_CHECK(enqueued);
+    BOOST_CHECK_EQUAL(e, 1);
+    BOOST_CHECK(q.try_dequeue(e));
+    BOOST_CHECK_EQUAL(e, 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_heavy_element_accepted_by_an_empty_queue)
+{
+    BlockingQueue<std::string> q;
+    q.setLimits(0u, 10u, &weight);
+
+    q.wait_enqueue(std::string(100u, 'a')); // does not block
+    BOOST_CHECK_EQUAL(q.size_bytes(), 100u);
+
+    std::atomic<bool> enqueued{false};
+    std::thread producer{[&q, &enqueued]() {
+        q.wait_enqueue(std::string{"b"});
+        enqueued = true;
+    }};
+    std::this_thread::sleep_for(std::chrono::milliseconds{100});
+    BOOST_CHECK(!enqueued);
+
+    std::string e;
+    BOOST_CHECK(q.try_dequeue(e));
+    producer.join();
+    BOOST_CHECK(enqueued);
+    BOOST_CHECK_EQUAL(e.size(), 100u);
+    BOOST_CHECK_EQUAL(q.size_bytes(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(test_removing_the_limits_releases_the_producer)
+{
+    BlockingQueue<int> q;
+    q.setLimits(1u, 0u, nullptr);
+    q.enqueue(1);
+
+    std::thread producer{[&q]() {
+        q.wait_enqueue(2);
+    }};
+    std::this_thread::sleep_for(std::chrono::milliseconds{50});
+    q.setLimits(0u, 0u, nullptr);
+    producer.join();
+    BOOST_CHECK_EQUAL(q.size_approx(), 2u);
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MODULE callback_dispatcher
+#include <boost/test/included/unit_test.hpp>
+#include <giga/core/details/CallbackDispatcher.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace boost::unit_test;
+using giga::details::CallbackBatch;
+using giga::details::CallbackDispatcher;
+using std::chrono::milliseconds;
+
+BOOST_AUTO_TEST_CASE(test_events_are_delivered_in_order)
+{
+    std::vector<int> delivered;
+    CallbackDispatcher dispatcher;
+    for (auto i = 0; i < 100; ++i)
+    {
+        dispatcher.post([&delivered, i] { delivered.push_back(i); });
+    }
+    dispatcher.flush();
+    BOOST_REQUIRE_EQUAL(delivered.size(), 100u);
+    for (auto i = 0; i < 100; ++i)
+    {
+        BOOST_CHECK_EQUAL(delivered[static_cast<std::size_t>(i)], i);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_flush_waits_for_the_event_being_delivered)
+{
+    std::atomic<bool> started{false};
+    std::atomic<bool> done{false};
+    CallbackDispatcher dispatcher;
+    dispatcher.post([&started, &done] {
+        started = true;
+        std::this_thread::sleep_for(milliseconds{200});
+        done = true;
+    });
+    while (!started)
+    {
+        std::this_thread::sleep_for(milliseconds{1});
+    }
+    dispatcher.flush(); // the queue is empty, but the event is not delivered yet
+    BOOST_CHECK(done);
+}
+
+BOOST_AUTO_TEST_CASE(test_throwing_event_is_only_logged)
+{
+    auto delivered = false;
+    CallbackDispatcher dispatcher;
+    dispatcher.post([] { throw std::runtime_error{"callback error"}; });
+    dispatcher.post([&delivered] { delivered = true; });
+    dispatcher.flush();
+    BOOST_CHECK(delivered);
+}
+
+BOOST_AUTO_TEST_CASE(test_flush_from_a_callback)
+{
+    auto flushed = false;
+    CallbackDispatcher dispatcher;
+    dispatcher.post([&dispatcher, &flushed] {
+        dispatcher.flush(); // does not wait for itself
+        flushed = true;
+    });
+    dispatcher.flush();
+    BOOST_CHECK(flushed);
+}
+
+BOOST_AUTO_TEST_CASE(test_batches)
+{
+    std::vector<std::vector<int>> batches;
+    CallbackDispatcher dispatcher;
+    {
+        CallbackBatch<int> batch{dispatcher, [&batches](std::vector<int>&& items) { batches.push_back(std::move(items)); }, 3u};
+        dispatcher.post([] { std::this_thread::sleep_for(milliseconds{50}); }); // the items pile up meanwhile
+        for (auto i = 0; i < 10; ++i)
+        {
+            batch.push(int{i});
+        }
+        dispatcher.flush();
+    }
+
+    std::vector<int> all;
+    for (const auto& items : batches)
+    {
+        BOOST_CHECK(!items.empty() && items.size() <= 3u);
+        all.insert(all.end(), items.begin(), items.end());
+    }
+    BOOST_CHECK_EQUAL(batches.size(), 4u);
+    BOOST_REQUIRE_EQUAL(all.size(), 10u);
+    for (auto i = 0; i < 10; ++i)
+    {
+        BOOST_CHECK_EQUAL(all[static_cast<std::size_t>(i)], i);
+    }
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MODULE chunk_ranges
+#include <boost/test/included/unit_test.hpp>
+#include <giga/core/details/ChunkRanges.h>
+
+using namespace boost::unit_test;
+using giga::details::ChunkRanges;
+
+BOOST_AUTO_TEST_CASE(test_merge_out_of_order)
+{
+    ChunkRanges r;
+    r.add(2048, 4096);
+    BOOST_CHECK(r.contiguousEnd() == 0);
+    r.add(0, 1024);
+    BOOST_CHECK(r.contiguousEnd() == 1024);
+    r.add(1024, 2048);
+    BOOST_CHECK(r.contiguousEnd() == 4096);
+    BOOST_CHECK(r.ranges().size() == 1);
+    BOOST_CHECK(r.acknowledged() == 4096);
+}
+
+BOOST_AUTO_TEST_CASE(test_overlapping_ranges)
+{
+    ChunkRanges r;
+    r.add(0, 100);
+    r.add(50, 150);
+    r.add(300, 400);
+    r.add(120, 310);
+    BOOST_CHECK(r.ranges().size() == 1);
+    BOOST_CHECK(r.acknowledged() == 400);
+    BOOST_CHECK(r.contains(10, 390));
+    BOOST_CHECK(!r.contains(10, 401));
+}
+
+BOOST_AUTO_TEST_CASE(test_next_missing)
+{
+    ChunkRanges r;
+    r.add(0, 10);
+    r.add(20, 30);
+    BOOST_CHECK(r.nextMissing(0) == 10);
+    BOOST_CHECK(r.nextMissing(15) == 15);
+    BOOST_CHECK(r.nextMissing(25) == 30);
+    BOOST_CHECK(!r.contains(5, 25));
+    r.clear();
+    BOOST_CHECK(r.acknowledged() == 0);
+    BOOST_CHECK(r.contiguousEnd() == 0);
+}
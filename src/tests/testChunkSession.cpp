@@ -0,0 +1,107 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MODULE chunk_session
+#include <boost/test/included/unit_test.hpp>
+#include <giga/core/details/ChunkSession.h>
+
+using namespace boost::unit_test;
+using giga::details::ChunkSession;
+
+BOOST_AUTO_TEST_CASE(test_out_of_order_replies_do_not_restart)
+{
+    ChunkSession s;
+    BOOST_CHECK(s.onSerialReply(0, 1024) == 1024);
+
+    s.startParallel(1024);
+    // [3072, 4096) is acknowledged before [1024, 3072)
+    BOOST_CHECK(s.onParallelReply(3072, 4096, 3072, 4096));
+    BOOST_CHECK(s.acked().contiguousEnd() == 1024);
+    BOOST_CHECK(s.onParallelReply(1024, 2048, 0, 2048));
+    BOOST_CHECK(s.onParallelReply(2048, 3072, 0, 3072));
+    BOOST_CHECK(s.acked().contiguousEnd() == 4096);
+    BOOST_CHECK(!s.serialOnly());
+}
+
+BOOST_AUTO_TEST_CASE(test_dropped_prefix_restarts_serial)
+{
+    ChunkSession s;
+    BOOST_CHECK(s.onSerialReply(0, 1024) == 1024);
+    s.startParallel(1024);
+    BOOST_CHECK(s.onParallelReply(1024, 2048, 0, 2048));
+
+    // the server only has [0, 1024) left
+    BOOST_CHECK(!s.onParallelReply(2048, 3072, 0, 1024));
+    BOOST_CHECK(s.serialOnly());
+    BOOST_CHECK(s.acked().contiguousEnd() == 0);
+
+    // a chunk sent before the restart
+    BOOST_CHECK(!s.onParallelReply(3072, 4096, 0, 4096));
+    BOOST_CHECK(s.acked().acknowledged() == 0);
+    BOOST_CHECK(!s.tooManyRestarts());
+
+    BOOST_CHECK(s.onSerialReply(0, 1024) == 1024);
+    BOOST_CHECK(s.serialOnly());
+}
+
+BOOST_AUTO_TEST_CASE(test_restarts_are_limited)
+{
+    ChunkSession s;
+    for (auto i = 0u; i < ChunkSession::MAX_RESTARTS; ++i)
+    {
+        BOOST_CHECK(s.onSerialReply(1024, 2048) == 0);
+        BOOST_CHECK(!s.tooManyRestarts());
+    }
+    BOOST_CHECK(s.onSerialReply(1024, 2048) == 0);
+    BOOST_CHECK(s.tooManyRestarts());
+}
+
+BOOST_AUTO_TEST_CASE(test_next_gap_skips_the_chunks_in_flight)
+{
+    ChunkSession s;
+    s.startParallel(1024);
+    BOOST_CHECK(s.nextGap(8192) == std::make_pair(1024ul, 8192ul));
+
+    s.sending(1024, 2048);
+    s.sending(2048, 3072);
+    BOOST_CHECK(s.nextGap(8192) == std::make_pair(3072ul, 8192ul));
+    s.sending(4096, 5120);
+    BOOST_CHECK(s.nextGap(8192) == std::make_pair(3072ul, 4096ul));
+    s.sending(3072, 4096);
+    s.sending(5120, 8192);
+    BOOST_CHECK(s.nextGap(8192).first == 8192);
+}
+
+BOOST_AUTO_TEST_CASE(test_chunks_not_kept_are_sent_again)
+{
+    ChunkSession s;
+    s.startParallel(1024);
+    s.sending(1024, 2048);
+    s.sending(2048, 3072);
+
+    // the server did not keep [2048, 3072), received before [1024, 2048)
+    BOOST_CHECK(s.onParallelReply(2048, 3072, 0, 1024));
+    BOOST_CHECK(s.acked().acknowledged() == 1024);
+    BOOST_CHECK(s.nextGap(3072) == std::make_pair(2048ul, 3072ul));
+
+    BOOST_CHECK(s.onParallelReply(1024, 2048, 0, 2048));
+    BOOST_CHECK(s.acked().contiguousEnd() == 2048);
+    BOOST_CHECK(s.nextGap(3072) == std::make_pair(2048ul, 3072ul));
+
+    s.sending(2048, 3072);
+    BOOST_CHECK(s.onParallelReply(2048, 3072, 0, 3072));
+    BOOST_CHECK(s.nextGap(3072).first == 3072);
+    BOOST_CHECK(!s.serialOnly());
+}
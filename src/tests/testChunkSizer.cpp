@@ -0,0 +1,101 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MODULE chunk_sizer
+#include <boost/test/included/unit_test.hpp>
+#include <giga/core/details/ChunkSizer.h>
+
+#include <chrono>
+
+using namespace boost::unit_test;
+using giga::details::ChunkSizer;
+using giga::details::ChunkSizing;
+using std::chrono::milliseconds;
+
+namespace
+{
+constexpr uint64_t MiB = 1024ul * 1024ul;
+}
+
+BOOST_AUTO_TEST_CASE(test_fixed_size)
+{
+    ChunkSizer sizer{ChunkSizing::fixed(2 * MiB)};
+    BOOST_CHECK_EQUAL(sizer.size(), 2 * MiB);
+    sizer.onChunkSent(2 * MiB, milliseconds{1000});
+    sizer.onChunkSent(2 * MiB, milliseconds{100});
+    sizer.onChunkRetry();
+    BOOST_CHECK_EQUAL(sizer.size(), 2 * MiB);
+}
+
+BOOST_AUTO_TEST_CASE(test_grows_up_to_max)
+{
+    ChunkSizer sizer{ChunkSizing::adaptive(4 * MiB, 1 * MiB)};
+    BOOST_CHECK_EQUAL(sizer.size(), 1 * MiB);
+
+    sizer.onChunkSent(1 * MiB, milliseconds{1000});
+    BOOST_CHECK_EQUAL(sizer.size(), 2 * MiB);
+    sizer.onChunkSent(2 * MiB, milliseconds{1000}); // faster
+    BOOST_CHECK_EQUAL(sizer.size(), 4 * MiB);
+    sizer.onChunkSent(4 * MiB, milliseconds{1000}); // faster, but at max
+    BOOST_CHECK_EQUAL(sizer.size(), 4 * MiB);
+    sizer.onChunkSent(4 * MiB, milliseconds{1000}); // not faster
+    BOOST_CHECK_EQUAL(sizer.size(), 4 * MiB);
+    BOOST_CHECK_EQUAL(sizer.lastThroughput(), 4 * MiB);
+}
+
+BOOST_AUTO_TEST_CASE(test_shrinks_on_retry_down_to_min)
+{
+    ChunkSizer sizer{ChunkSizing::adaptive(8 * MiB, 2 * MiB)};
+    sizer.onChunkSent(2 * MiB, milliseconds{1000});
+    sizer.onChunkSent(4 * MiB, milliseconds{1000});
+    BOOST_CHECK_EQUAL(sizer.size(), 8 * MiB);
+
+    sizer.onChunkRetry();
+    BOOST_CHECK_EQUAL(sizer.size(), 4 * MiB);
+    sizer.onChunkRetry();
+    sizer.onChunkRetry();
+    BOOST_CHECK_EQUAL(sizer.size(), 2 * MiB);
+}
+
+BOOST_AUTO_TEST_CASE(test_no_growth_right_after_a_retry)
+{
+    ChunkSizer sizer{ChunkSizing::adaptive(8 * MiB, 1 * MiB)};
+    sizer.onChunkSent(1 * MiB, milliseconds{1000});
+    sizer.onChunkSent(2 * MiB, milliseconds{1000});
+    BOOST_CHECK_EQUAL(sizer.size(), 4 * MiB);
+
+    sizer.onChunkRetry();
+    BOOST_CHECK_EQUAL(sizer.size(), 2 * MiB);
+    for (auto i = 0u; i < ChunkSizer::HOLD_DOWN_CHUNKS; ++i)
+    {
+        // each one faster than the previous
+        sizer.onChunkSent(2 * MiB, milliseconds{500 - 100 * i});
+        BOOST_CHECK_EQUAL(sizer.size(), 2 * MiB);
+    }
+    sizer.onChunkSent(2 * MiB, milliseconds{50});
+    BOOST_CHECK_EQUAL(sizer.size(), 4 * MiB);
+}
+
+BOOST_AUTO_TEST_CASE(test_throughput_of_parallel_chunks)
+{
+    ChunkSizer sizer{ChunkSizing::fixed(1 * MiB)};
+    BOOST_CHECK_EQUAL(sizer.throughput(), 0ul);
+
+    // two chunks sent at the same time: 2 MiB in 1 s
+    auto end = ChunkSizer::TimePoint{} + std::chrono::seconds{10};
+    sizer.onChunkSent(1 * MiB, milliseconds{1000}, end);
+    sizer.onChunkSent(1 * MiB, milliseconds{900}, end - milliseconds{50});
+    BOOST_CHECK_EQUAL(sizer.throughput(), 2 * MiB);
+}
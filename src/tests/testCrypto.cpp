@@ -17,6 +17,8 @@
 #include <boost/test/included/unit_test.hpp>
 #include <cpprest/details/basic_types.h>
 #include <giga/utils/Crypto.h>
+#include <giga/utils/MultiSha1.h>
+#include <giga/utils/Sha1Engine.h>
 #include <giga/utils/Utils.h>
 
 using namespace boost::unit_test;
@@ -35,6 +37,78 @@ BOOST_AUTO_TEST_CASE(test_calculate_fkey)
     BOOST_CHECK("V9leIEW8PYNMhlDuMNvkpWei" == fkey);
 }
 
+BOOST_AUTO_TEST_CASE(test_sha1_implementations)
+{
+    using giga::utils::Sha1Engine;
+    std::string data;
+    for (auto i = 0u; i < 100000u; ++i)
+    {
+        data.push_back(static_cast<char>(i * 7919u >> 3));
+    }
+
+    for (auto implementation : {Sha1Engine::Implementation::shaNi, Sha1Engine::Implementation::openssl, Sha1Engine::Implementation::portable})
+    {
+        if (!Sha1Engine::available(implementation))
+        {
+            continue;
+        }
+        auto abc = Sha1Engine{implementation};
+        abc.update("abc", 3);
+        BOOST_CHECK("a9993e364706816aba3e25717850c26c9cd0d89d" == abc.hexDigest());
+
+        auto empty = Sha1Engine{implementation};
+        BOOST_CHECK("da39a3ee5e6b4b0d3255bfef95601890afd80709" == empty.hexDigest());
+
+        // odd sized updates, to cross the block boundaries
+        auto chunked = Sha1Engine{implementation};
+        for (std::size_t pos = 0, step = 1; pos < data.size(); pos += step, step = step * 3 + 1)
+        {
+            chunked.update(data.data() + pos, std::min(step, data.size() - pos));
+        }
+        auto reference = Sha1Engine{Sha1Engine::Implementation::openssl};
+        reference.update(data.data(), data.size());
+        BOOST_CHECK(reference.hexDigest() == chunked.hexDigest());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_multi_sha1)
+{
+    using giga::utils::MultiSha1;
+    using giga::utils::Sha1Engine;
+    std::string data;
+    for (auto i = 0u; i < 300000u; ++i)
+    {
+        data.push_back(static_cast<char>(i * 7919u >> 5));
+    }
+    // every padding case (0 to 129 bytes), then larger messages of different sizes
+    std::vector<MultiSha1::Message> messages;
+    auto bytes = reinterpret_cast<const unsigned char*>(data.data());
+    for (std::size_t size = 0; size < 130u; ++size)
+    {
+        messages.push_back(MultiSha1::Message{bytes + size, size});
+    }
+    for (std::size_t size = 1000u; size < 100000u; size += 9973u)
+    {
+        messages.push_back(MultiSha1::Message{bytes + size, size * 2u});
+    }
+
+    for (auto implementation : {MultiSha1::Implementation::single, MultiSha1::Implementation::sse2, MultiSha1::Implementation::avx2, MultiSha1::Implementation::avx512})
+    {
+        if (!MultiSha1::available(implementation))
+        {
+            continue;
+        }
+        auto digests = MultiSha1::hash(messages, implementation);
+        BOOST_REQUIRE(digests.size() == messages.size());
+        for (std::size_t i = 0; i < messages.size(); ++i)
+        {
+            auto reference = Sha1Engine{Sha1Engine::Implementation::openssl};
+            reference.update(messages[i].data, messages[i].size);
+            BOOST_CHECK(reference.digest() == digests[i]);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(test_aes)
 {
     auto result    = Crypto::aesEncrypt(U("password"), "data");
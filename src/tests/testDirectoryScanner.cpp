@@ -0,0 +1,187 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MODULE directory_scanner
+#include <boost/test/included/unit_test.hpp>
+#include <giga/core/details/DirectoryScanner.h>
+#include <giga/rest/HttpErrors.h>
+
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <tuple>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace boost::unit_test;
+using boost::filesystem::path;
+using giga::details::DirectoryScanner;
+
+namespace
+{
+typedef std::set<std::tuple<path, path, uint64_t>> Files;
+
+void
+writeFile(const path& p, const std::string& content)
+{
+    std::ofstream os{p.c_str(), std::ios::binary | std::ios::trunc};
+    os << content;
+}
+
+struct TempDir
+{
+    TempDir() : dir{boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()} {
+        boost::filesystem::create_directories(dir);
+    }
+    ~TempDir() {
+        boost::system::error_code ec;
+        boost::filesystem::remove_all(dir, ec);
+    }
+    path dir;
+};
+
+/** The node names given by the Uploader: trimmed, without the dot-files. */
+utility::string_t
+nodeName(const path& p)
+{
+    auto name = p.filename().native();
+    boost::algorithm::trim(name);
+    return name.empty() || name[0] == U('.') ? utility::string_t{} : name;
+}
+
+Files
+scan(const path& root, unsigned workerCount)
+{
+    std::mutex mut;
+    Files files;
+    auto onFile = [&mut, &files](DirectoryScanner::File&& file) {
+        std::lock_guard<std::mutex> l{mut};
+        BOOST_CHECK(files.emplace(file.path, file.nodePath, file.size).second);
+    };
+    DirectoryScanner scanner{workerCount, nodeName, onFile, []{ return false; }};
+    scanner.scan(root);
+    return files;
+}
+}
+
+BOOST_AUTO_TEST_CASE(test_workers_find_the_same_files)
+{
+    TempDir tmp;
+    auto root = tmp.dir / "root";
+    Files expected;
+    for (auto i = 0; i < 20; ++i)
+    {
+        auto dir = root / ("dir" + std::to_string(i)) / "sub";
+        boost::filesystem::create_directories(dir);
+        for (auto j = 0; j < 5; ++j)
+        {
+            auto name = "file" + std::to_string(j);
+            writeFile(dir / name, std::string(static_cast<std::size_t>(i + j), 'x'));
+            expected.emplace(dir / name, path{"root"} / ("dir" + std::to_string(i)) / "sub" / name, i + j);
+        }
+    }
+    writeFile(root / "top", "top");
+    expected.emplace(root / "top", path{"root"} / "top", 3);
+
+    BOOST_CHECK(scan(root, 1) == expected);
+    BOOST_CHECK(scan(root, 4) == expected);
+
+    // a file is scanned alone
+    BOOST_CHECK(scan(root / "top", 4) == Files{std::make_tuple(root / "top", path{"top"}, 3ul)});
+}
+
+BOOST_AUTO_TEST_CASE(test_hidden_and_blank_names_are_skipped)
+{
+    TempDir tmp;
+    auto root = tmp.dir / "root";
+    boost::filesystem::create_directories(root / ".git");
+    boost::filesystem::create_directories(root / "   ");
+    writeFile(root / ".git" / "config", "config");
+    writeFile(root / "   " / "file", "file");
+    writeFile(root / ".hidden", "hidden");
+    writeFile(root / "  spaced  ", "spaced");
+
+    // the node names are trimmed
+    BOOST_CHECK(scan(root, 4) == Files{std::make_tuple(root / "  spaced  ", path{"root"} / "spaced", 6ul)});
+    BOOST_CHECK(scan(root / ".git", 4).empty());
+}
+
+#ifndef _WIN32
+BOOST_AUTO_TEST_CASE(test_directory_links_are_followed)
+{
+    TempDir tmp;
+    auto root = tmp.dir / "root";
+    auto target = tmp.dir / "target";
+    boost::filesystem::create_directories(root);
+    boost::filesystem::create_directories(target / "sub");
+    writeFile(target / "sub" / "file", "file");
+    boost::filesystem::create_directory_symlink(target, root / "link");
+    boost::filesystem::create_symlink(tmp.dir / "missing", root / "broken");
+
+    auto expected = Files{std::make_tuple(root / "link" / "sub" / "file", path{"root"} / "link" / "sub" / "file", 4ul)};
+    BOOST_CHECK(scan(root, 1) == expected);
+    BOOST_CHECK(scan(root, 4) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(test_unreadable_directory_does_not_stop_the_scan)
+{
+    TempDir tmp;
+    auto root = tmp.dir / "root";
+    boost::filesystem::create_directories(root / "other");
+    writeFile(root / "top", "top");
+    writeFile(root / "other" / "file", "file");
+
+    // a directory whose path is too long to be opened (even by root)
+    auto fd = open((root).c_str(), O_RDONLY | O_DIRECTORY);
+    BOOST_REQUIRE(fd >= 0);
+    auto name = std::string(200, 'd');
+    for (auto i = 0; i < 25; ++i)
+    {
+        BOOST_REQUIRE(mkdirat(fd, name.c_str(), 0700) == 0);
+        auto child = openat(fd, name.c_str(), O_RDONLY | O_DIRECTORY);
+        close(fd);
+        fd = child;
+        BOOST_REQUIRE(fd >= 0);
+    }
+    close(fd);
+
+    Files files;
+    auto onFile = [&files](DirectoryScanner::File&& file) {
+        files.emplace(file.path, file.nodePath, file.size);
+    };
+    DirectoryScanner scanner{4, nodeName, onFile, []{ return false; }};
+    BOOST_CHECK_THROW(scanner.scan(root), giga::ErrorException);
+    BOOST_CHECK(files == (Files{std::make_tuple(root / "top", path{"root"} / "top", 3ul),
+                                std::make_tuple(root / "other" / "file", path{"root"} / "other" / "file", 4ul)}));
+
+    // shorten the path, for its removal
+    fd = open((root).c_str(), O_RDONLY | O_DIRECTORY);
+    for (auto i = 0; fd >= 0 && i < 25; ++i)
+    {
+        renameat(fd, name.c_str(), fd, "d");
+        auto child = openat(fd, "d", O_RDONLY | O_DIRECTORY);
+        close(fd);
+        fd = child;
+    }
+    close(fd);
+}
+#endif
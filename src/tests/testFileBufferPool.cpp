@@ -0,0 +1,81 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MODULE file_buffer_pool
+#include <boost/test/included/unit_test.hpp>
+#include <giga/core/details/FileBufferPool.h>
+
+using namespace boost::unit_test;
+using giga::details::FileBufferPool;
+
+BOOST_AUTO_TEST_CASE(test_acquire_within_capacity)
+{
+    FileBufferPool pool;
+    pool.setCapacity(1000u);
+
+    auto a = pool.acquire(600u);
+    BOOST_REQUIRE(a != nullptr);
+    BOOST_CHECK_EQUAL(a->size(), 600u);
+    BOOST_CHECK(pool.heldBytes() >= 600u);
+
+    // over the capacity: refused, without blocking
+    BOOST_CHECK(pool.acquire(600u) == nullptr);
+
+    a = nullptr;
+    BOOST_CHECK_EQUAL(pool.idleCount(), 1u);
+    auto b = pool.acquire(600u);
+    BOOST_REQUIRE(b != nullptr);
+    BOOST_CHECK_EQUAL(pool.idleCount(), 0u); // recycled
+}
+
+BOOST_AUTO_TEST_CASE(test_idle_buffers_make_room)
+{
+    FileBufferPool pool;
+    pool.setCapacity(1000u);
+
+    pool.acquire(800u); // given back at once, kept idle
+    BOOST_CHECK_EQUAL(pool.idleCount(), 1u);
+
+    // too small to reuse the idle buffer: it is freed to make room
+    auto small = pool.acquire(300u);
+    BOOST_REQUIRE(small != nullptr);
+    BOOST_CHECK_EQUAL(pool.idleCount(), 0u);
+    BOOST_CHECK(pool.heldBytes() <= pool.capacity());
+}
+
+BOOST_AUTO_TEST_CASE(test_capacity_lowered)
+{
+    FileBufferPool pool;
+    pool.setCapacity(1000u);
+    auto a = pool.acquire(500u);
+    BOOST_REQUIRE(a != nullptr);
+
+    pool.setCapacity(0u);
+    BOOST_CHECK(pool.acquire(1u) == nullptr);
+    a = nullptr;
+    BOOST_CHECK_EQUAL(pool.heldBytes(), 0u);
+    BOOST_CHECK_EQUAL(pool.idleCount(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_buffer_outlives_pool)
+{
+    std::shared_ptr<std::vector<unsigned char>> buffer = nullptr;
+    {
+        FileBufferPool pool;
+        buffer = pool.acquire(10u);
+    }
+    BOOST_REQUIRE(buffer != nullptr);
+    buffer = nullptr;
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MODULE file_io
+#include <boost/test/included/unit_test.hpp>
+#include <giga/utils/FileIo.h>
+#include <giga/utils/SequentialFile.h>
+
+#include <boost/filesystem.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace boost::unit_test;
+using boost::filesystem::path;
+using giga::utils::AlignedBuffer;
+using giga::utils::FileIo;
+
+namespace
+{
+std::vector<std::shared_ptr<FileIo>>
+backends()
+{
+    std::vector<std::shared_ptr<FileIo>> all;
+    for (auto backend : {FileIo::Backend::ioUring, FileIo::Backend::blocking})
+    {
+        auto io = FileIo::create(backend, 16u);
+        BOOST_CHECK_EQUAL(io != nullptr, FileIo::available(backend));
+        if (io != nullptr)
+        {
+            BOOST_CHECK(io->backend() == backend);
+            all.push_back(io);
+        }
+    }
+    return all;
+}
+}
+
+#ifndef _WIN32
+BOOST_AUTO_TEST_CASE(test_write_then_read)
+{
+    BOOST_CHECK(FileIo::available(FileIo::Backend::blocking));
+    for (const auto& io : backends())
+    {
+        BOOST_TEST_MESSAGE(FileIo::name(io->backend()));
+        auto p  = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+        auto fd = ::open(p.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        BOOST_REQUIRE(fd >= 0);
+
+        AlignedBuffer out{100000u};
+        for (std::size_t i = 0; i < out.size(); ++i)
+        {
+            out.data()[i] = static_cast<unsigned char>(i * 7u);
+        }
+        auto registered = io->registerBuffer(out.data(), out.size());
+        io->writeAll(fd, 0u, out.data(), out.size());
+        if (registered)
+        {
+            io->unregisterBuffer(out.data());
+        }
+
+        AlignedBuffer in{200000u};
+        BOOST_CHECK_EQUAL(io->readAll(fd, 0u, in.data(), in.size()), out.size()); // short at the end of the file
+        BOOST_CHECK(std::equal(out.data(), out.data() + out.size(), in.data()));
+        BOOST_CHECK_EQUAL(io->readAll(fd, out.size(), in.data(), 10u), 0u);
+
+        ::close(fd);
+        boost::filesystem::remove(p);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_many_requests_in_flight)
+{
+    for (const auto& io : backends())
+    {
+        // more requests than the ring holds
+        const std::size_t blocks = 100u;
+        auto p  = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+        auto fd = ::open(p.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        BOOST_REQUIRE(fd >= 0);
+        std::vector<unsigned char> content(blocks * 512u);
+        for (std::size_t i = 0; i < content.size(); ++i)
+        {
+            content[i] = static_cast<unsigned char>(i / 512u);
+        }
+        io->writeAll(fd, 0u, content.data(), content.size());
+
+        std::vector<unsigned char> read(content.size());
+        std::mutex mut;
+        std::condition_variable cond;
+        std::size_t done = 0u;
+        std::atomic<int> errors{0};
+        for (std::size_t i = 0; i < blocks; ++i)
+        {
+            io->read(fd, i * 512u, read.data() + i * 512u, 512u, [&](std::size_t count, int error) {
+                if (error != 0 || count != 512u)
+                {
+                    ++errors;
+                }
+                std::lock_guard<std::mutex> l{mut};
+                ++done;
+                cond.notify_one();
+            });
+        }
+        io->submit();
+        std::unique_lock<std::mutex> l{mut};
+        cond.wait(l, [&] { return done == blocks; });
+        BOOST_CHECK_EQUAL(errors.load(), 0);
+        BOOST_CHECK(read == content);
+
+        ::close(fd);
+        boost::filesystem::remove(p);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_errors)
+{
+    for (const auto& io : backends())
+    {
+        unsigned char buffer[16];
+        BOOST_CHECK_THROW(io->readAll(-1, 0u, buffer, sizeof(buffer)), std::exception);
+    }
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(test_shared)
+{
+#ifdef _WIN32
+    BOOST_CHECK(FileIo::shared() == nullptr);
+#else
+    BOOST_REQUIRE(FileIo::shared() != nullptr);
+    BOOST_CHECK(FileIo::shared() == FileIo::shared());
+#endif
+}
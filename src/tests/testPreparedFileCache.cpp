@@ -0,0 +1,70 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MODULE prepared_file_cache
+#include <boost/test/included/unit_test.hpp>
+#include <giga/core/details/PreparedFileCache.h>
+
+#include <boost/filesystem.hpp>
+#include <fstream>
+
+using namespace boost::unit_test;
+using boost::filesystem::path;
+using giga::details::PreparedFileCache;
+
+namespace
+{
+void
+writeFile(const path& p, const std::string& content)
+{
+    std::ofstream os{p.c_str(), std::ios::binary | std::ios::trunc};
+    os << content;
+}
+}
+
+BOOST_AUTO_TEST_CASE(test_cache_survives_reload)
+{
+    auto dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(dir);
+    auto cacheFile = dir / "prepared.cache";
+    auto file      = dir / "file.txt";
+    writeFile(file, "content");
+
+    {
+        PreparedFileCache cache{cacheFile};
+        auto key = PreparedFileCache::key(file);
+        BOOST_REQUIRE(key);
+        BOOST_CHECK(!cache.find(*key));
+        cache.insert(*key, PreparedFileCache::Entry{"sha1", "fid", "fkey"});
+        cache.insert(*key, PreparedFileCache::Entry{"sha1b", "fidb", "fkeyb"});
+    }
+    {
+        PreparedFileCache cache{cacheFile};
+        BOOST_CHECK(cache.size() == 1);
+        auto entry = cache.find(*PreparedFileCache::key(file));
+        BOOST_REQUIRE(entry);
+        BOOST_CHECK(entry->sha1 == "sha1b");
+        BOOST_CHECK(entry->fid  == "fidb");
+        BOOST_CHECK(entry->fkey == "fkeyb");
+    }
+
+    // a modified file is hashed again
+    writeFile(file, "another content");
+    {
+        PreparedFileCache cache{cacheFile};
+        BOOST_CHECK(!cache.find(*PreparedFileCache::key(file)));
+    }
+    boost::filesystem::remove_all(dir);
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MODULE progress_notifier
+#include <boost/test/included/unit_test.hpp>
+#include <giga/core/details/ProgressNotifier.h>
+
+#include <chrono>
+#include <thread>
+
+using namespace boost::unit_test;
+using giga::details::ProgressNotifier;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+BOOST_AUTO_TEST_CASE(test_changes_are_coalesced_within_the_interval)
+{
+    ProgressNotifier n{milliseconds{200}};
+    n.notify();
+    BOOST_CHECK(n.wait()); // the first change is reported at once
+
+    auto start = steady_clock::now();
+    for (auto i = 0; i < 10; ++i)
+    {
+        n.notify();
+    }
+    BOOST_CHECK(n.wait()); // once for the 10 changes, at the end of the interval
+    BOOST_CHECK(steady_clock::now() - start >= milliseconds{150});
+
+    n.stop();
+    BOOST_CHECK(!n.wait()); // nothing left
+}
+
+BOOST_AUTO_TEST_CASE(test_stop_reports_the_last_change)
+{
+    ProgressNotifier n{milliseconds{10000}};
+    n.notify();
+    BOOST_CHECK(n.wait());
+
+    n.notify();
+    auto reported = false;
+    std::thread reporter{[&n, &reported]() {
+        reported = n.wait();
+    }};
+    std::this_thread::sleep_for(milliseconds{50});
+    auto start = steady_clock::now();
+    n.stop();
+    reporter.join();
+    BOOST_CHECK(reported);
+    BOOST_CHECK(steady_clock::now() - start < milliseconds{5000});
+    BOOST_CHECK(!n.wait());
+
+    n.reset();
+    n.setMinInterval(milliseconds{0});
+    n.notify();
+    BOOST_CHECK(n.wait());
+}
+
+BOOST_AUTO_TEST_CASE(test_wait_sleeps_until_a_change)
+{
+    ProgressNotifier n{milliseconds{0}};
+    auto wakes = 0;
+    std::thread reporter{[&n, &wakes]() {
+        while (n.wait())
+        {
+            ++wakes;
+        }
+    }};
+    std::this_thread::sleep_for(milliseconds{50});
+    n.notify();
+    std::this_thread::sleep_for(milliseconds{50});
+    n.stop();
+    reporter.join();
+    BOOST_CHECK_EQUAL(wakes, 1);
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MODULE read_ahead_file
+#include <boost/test/included/unit_test.hpp>
+#include <giga/utils/ReadAheadFile.h>
+
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <string>
+
+using namespace boost::unit_test;
+using boost::filesystem::path;
+using giga::utils::ReadAheadFile;
+
+namespace
+{
+path
+writeFile(std::size_t size)
+{
+    auto p = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    std::ofstream os{p.c_str(), std::ios::binary | std::ios::trunc};
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        os.put(static_cast<char>(i * 31u + i / 251u));
+    }
+    return p;
+}
+
+std::string
+readAll(ReadAheadFile& file)
+{
+    std::string content;
+    while (auto read = file.next())
+    {
+        content.append(reinterpret_cast<const char*>(file.data()), read);
+    }
+    return content;
+}
+
+std::string
+expected(const path& p)
+{
+    std::ifstream is{p.c_str(), std::ios::binary};
+    return std::string{std::istreambuf_iterator<char>{is}, std::istreambuf_iterator<char>{}};
+}
+}
+
+BOOST_AUTO_TEST_CASE(test_read_whole_file)
+{
+    for (auto size : {0u, 1u, 4096u, 10000u, 65536u})
+    {
+        auto p = writeFile(size);
+        for (auto depth : {2u, 3u, 5u})
+        {
+            ReadAheadFile file{p, 4096u, depth};
+            BOOST_CHECK(expected(p) == readAll(file));
+            BOOST_CHECK(file.next() == 0u);
+        }
+        boost::filesystem::remove(p);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_set_buffers)
+{
+    auto p = writeFile(100000u);
+    ReadAheadFile file{p};
+    file.setBuffers(1000u, 2u);
+    BOOST_CHECK(file.next() == 1000u);
+    file.setBuffers(5000u, 4u); // ignored: the reader is running
+    BOOST_CHECK(file.next() == 1000u);
+    boost::filesystem::remove(p);
+}
+
+BOOST_AUTO_TEST_CASE(test_close_while_reading)
+{
+    auto p = writeFile(100000u);
+    {
+        ReadAheadFile file{p, 1000u, 2u};
+        BOOST_CHECK(file.next() == 1000u);
+        // the reader is blocked on the full ring: the destructor must stop it
+    }
+    ReadAheadFile file{p, 1000u, 2u};
+    file.close();
+    BOOST_CHECK(file.next() == 0u);
+    boost::filesystem::remove(p);
+}
+
+BOOST_AUTO_TEST_CASE(test_missing_file)
+{
+    BOOST_CHECK_THROW(ReadAheadFile{"/this/file/does/not/exist"}, std::exception);
+}
+
+BOOST_AUTO_TEST_CASE(test_io_modes)
+{
+    // 10000 is not a multiple of the alignment: IoMode::direct falls back for the end of the file
+    for (auto size : {0u, 10000u, 3u * 1024u * 1024u + 1u})
+    {
+        auto p = writeFile(size);
+        for (auto mode : {giga::utils::IoMode::cached, giga::utils::IoMode::streaming, giga::utils::IoMode::direct})
+        {
+            for (auto blockSize : {4096u, 10000u})
+            {
+                ReadAheadFile file{p, blockSize, 2u};
+                file.setIoMode(mode);
+                BOOST_CHECK(expected(p) == readAll(file));
+            }
+        }
+        boost::filesystem::remove(p);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_file_io_backends)
+{
+    for (auto backend : {giga::utils::FileIo::Backend::ioUring, giga::utils::FileIo::Backend::blocking})
+    {
+        auto io = giga::utils::FileIo::create(backend, 16u);
+        if (io == nullptr)
+        {
+            continue;
+        }
+        for (auto size : {0u, 4096u, 10000u, 3u * 1024u * 1024u + 1u})
+        {
+            auto p = writeFile(size);
+            for (auto mode : {giga::utils::IoMode::cached, giga::utils::IoMode::streaming, giga::utils::IoMode::direct})
+            {
+                for (auto depth : {2u, 5u})
+                {
+                    ReadAheadFile file{p, 4096u, depth};
+                    file.setIoMode(mode);
+                    file.setFileIo(io);
+                    BOOST_CHECK(expected(p) == readAll(file));
+                    BOOST_CHECK(file.next() == 0u);
+                }
+            }
+            // given back before the end
+            {
+                ReadAheadFile file{p, 4096u, 3u};
+                file.setFileIo(io);
+                file.next();
+            }
+            boost::filesystem::remove(p);
+        }
+    }
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MODULE request_coalescer
+#include <boost/test/included/unit_test.hpp>
+#include <giga/rest/RequestCoalescer.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace boost::unit_test;
+using giga::RequestCoalescer;
+
+namespace
+{
+/**
+ * A fetch of ```value``` taking 100 ms, counted in ```calls```.
+ */
+template<typename T>
+std::function<pplx::task<std::shared_ptr<T>>()>
+slowFetch(T value, std::shared_ptr<std::atomic<int>> calls)
+{
+    return [value, calls]() {
+        ++*calls;
+        return pplx::create_task([value]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds{100});
+            return std::make_shared<T>(value);
+        });
+    };
+}
+}
+
+BOOST_AUTO_TEST_CASE(test_in_flight_requests_are_shared)
+{
+    auto calls     = std::make_shared<std::atomic<int>>(0);
+    auto coalescer = std::make_shared<RequestCoalescer>();
+
+    std::vector<pplx::task<std::shared_ptr<std::string>>> tasks;
+    for (auto i = 0; i < 10; ++i)
+    {
+        tasks.push_back(coalescer->join<std::string>(U("nodes/1"), slowFetch(std::string{"node"}, calls)));
+    }
+    std::vector<std::shared_ptr<std::string>> results;
+    for (auto& t : tasks)
+    {
+        results.push_back(t.get());
+        BOOST_CHECK_EQUAL(*results.back(), "node");
+    }
+    BOOST_CHECK_EQUAL(calls->load(), 1);
+    BOOST_CHECK_EQUAL(coalescer->stats().misses, 1u);
+    BOOST_CHECK_EQUAL(coalescer->stats().hits, 9u);
+
+    // each caller has its own copy
+    *results[0] = "changed";
+    BOOST_CHECK_EQUAL(*results[1], "node");
+}
+
+BOOST_AUTO_TEST_CASE(test_keys_and_types_are_distinct)
+{
+    auto calls     = std::make_shared<std::atomic<int>>(0);
+    auto coalescer = std::make_shared<RequestCoalescer>();
+
+    auto a = coalescer->join<std::string>(U("nodes/1"), slowFetch(std::string{"1"}, calls));
+    auto b = coalescer->join<std::string>(U("nodes/2"), slowFetch(std::string{"2"}, calls));
+    auto c = coalescer->join<int>(U("nodes/1"), slowFetch(1, calls));
+    BOOST_CHECK_EQUAL(*a.get(), "1");
+    BOOST_CHECK_EQUAL(*b.get(), "2");
+    BOOST_CHECK_EQUAL(*c.get(), 1);
+    BOOST_CHECK_EQUAL(calls->load(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_completed_requests_are_not_cached)
+{
+    auto calls     = std::make_shared<std::atomic<int>>(0);
+    auto coalescer = std::make_shared<RequestCoalescer>();
+
+    coalescer->join<int>(U("me"), slowFetch(1, calls)).get();
+    coalescer->join<int>(U("me"), slowFetch(2, calls)).get();
+    BOOST_CHECK_EQUAL(calls->load(), 2);
+    BOOST_CHECK_EQUAL(coalescer->stats().hits, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_errors_are_shared)
+{
+    auto coalescer = std::make_shared<RequestCoalescer>();
+    auto failing   = []() {
+        return pplx::create_task([]() -> std::shared_ptr<int> {
+            std::this_thread::sleep_for(std::chrono::milliseconds{100});
+            throw std::runtime_error("404");
+        });
+    };
+
+    auto a = coalescer->join<int>(U("nodes/404"), failing);
+    auto b = coalescer->join<int>(U("nodes/404"), failing);
+    BOOST_CHECK_THROW(a.get(), std::runtime_error);
+    BOOST_CHECK_THROW(b.get(), std::runtime_error);
+
+    // a fetch throwing at once
+    auto c = coalescer->join<int>(U("nodes/404"), []() -> pplx::task<std::shared_ptr<int>> {
+        throw std::runtime_error("no token");
+    });
+    BOOST_CHECK_THROW(c.get(), std::runtime_error);
+    BOOST_CHECK_EQUAL(coalescer->stats().misses, 2u);
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MODULE response_cache
+#include <boost/test/included/unit_test.hpp>
+#include <giga/rest/ResponseCache.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+using namespace boost::unit_test;
+using giga::ResponseCache;
+
+namespace
+{
+void
+store(ResponseCache& cache, const utility::string_t& key, const std::string& value, std::size_t bytes = 100u)
+{
+    cache.store<std::string>(key, std::make_shared<const std::string>(value), ResponseCache::Validators{U("\"etag\""), U("")}, bytes);
+}
+}
+
+BOOST_AUTO_TEST_CASE(test_find)
+{
+    ResponseCache cache;
+    BOOST_CHECK(cache.find<std::string>(U("/api/1.0/me")).value == nullptr);
+
+    store(cache, U("/api/1.0/me"), "me");
+    auto found = cache.find<std::string>(U("/api/1.0/me"));
+    BOOST_REQUIRE(found.value != nullptr);
+    BOOST_CHECK_EQUAL(*found.value, "me");
+    BOOST_CHECK(found.validators.etag == U("\"etag\""));
+    BOOST_CHECK(!found.fresh); // revalidated by default
+
+    // another type under the same key
+    BOOST_CHECK(cache.find<int>(U("/api/1.0/me")).value == nullptr);
+
+    cache.revalidated(U("/api/1.0/me"));
+    auto stats = cache.stats();
+    BOOST_CHECK_EQUAL(stats.misses, 1u);
+    BOOST_CHECK_EQUAL(stats.revalidated, 1u);
+    BOOST_CHECK_EQUAL(stats.entries, 1u);
+    BOOST_CHECK_EQUAL(stats.bytes, 100u);
+}
+
+BOOST_AUTO_TEST_CASE(test_fresh_and_ttl)
+{
+    ResponseCache cache;
+    auto limits     = cache.limits();
+    limits.freshFor = std::chrono::seconds{60};
+    cache.setLimits(limits);
+    store(cache, U("/api/1.0/me"), "me");
+    BOOST_CHECK(cache.find<std::string>(U("/api/1.0/me")).fresh);
+    BOOST_CHECK_EQUAL(cache.stats().fresh, 1u);
+
+    limits.freshFor = std::chrono::seconds{0};
+    limits.ttl      = std::chrono::seconds{0};
+    cache.setLimits(limits);
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    BOOST_CHECK(cache.find<std::string>(U("/api/1.0/me")).value == nullptr);
+    BOOST_CHECK_EQUAL(cache.stats().entries, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_least_recently_used_are_evicted)
+{
+    ResponseCache cache;
+    auto limits     = cache.limits();
+    limits.maxBytes = 300u;
+    cache.setLimits(limits);
+
+    store(cache, U("/api/1.0/nodes/a"), "a");
+    store(cache, U("/api/1.0/nodes/b"), "b");
+    store(cache, U("/api/1.0/nodes/c"), "c");
+    cache.find<std::string>(U("/api/1.0/nodes/a")); // b is now the least recently used
+    store(cache, U("/api/1.0/nodes/d"), "d");
+
+    BOOST_CHECK(cache.find<std::string>(U("/api/1.0/nodes/a")).value != nullptr);
+    BOOST_CHECK(cache.find<std::string>(U("/api/1.0/nodes/b")).value == nullptr);
+    BOOST_CHECK(cache.find<std::string>(U("/api/1.0/nodes/c")).value != nullptr);
+    BOOST_CHECK(cache.find<std::string>(U("/api/1.0/nodes/d")).value != nullptr);
+    BOOST_CHECK_EQUAL(cache.stats().bytes, 300u);
+
+    // larger than the whole cache: not kept
+    store(cache, U("/api/1.0/nodes/e"), "e", 1000u);
+    BOOST_CHECK(cache.find<std::string>(U("/api/1.0/nodes/e")).value == nullptr);
+
+    // unknown size, counted as ResponseCache::UNKNOWN_SIZE
+    store(cache, U("/api/1.0/nodes/f"), "f", 0u);
+    BOOST_CHECK(cache.find<std::string>(U("/api/1.0/nodes/f")).value == nullptr);
+    BOOST_CHECK_EQUAL(cache.stats().entries, 3u);
+}
+
+BOOST_AUTO_TEST_CASE(test_invalidate)
+{
+    ResponseCache cache;
+    store(cache, U("/api/1.0/nodes/a"), "a");
+    store(cache, U("/api/1.0/nodes/a/nodes"), "children of a");
+    store(cache, U("/api/1.0/nodes/a/nodes?name=x"), "x in a");
+    store(cache, U("/api/1.0/nodes/ab"), "ab");
+
+    cache.invalidate(U("/api/1.0/nodes/a"));
+    BOOST_CHECK(cache.find<std::string>(U("/api/1.0/nodes/a")).value == nullptr);
+    BOOST_CHECK(cache.find<std::string>(U("/api/1.0/nodes/a/nodes")).value == nullptr);
+    BOOST_CHECK(cache.find<std::string>(U("/api/1.0/nodes/a/nodes?name=x")).value == nullptr);
+    BOOST_CHECK(cache.find<std::string>(U("/api/1.0/nodes/ab")).value != nullptr);
+
+    cache.clear();
+    BOOST_CHECK_EQUAL(cache.stats().entries, 0u);
+    BOOST_CHECK_EQUAL(cache.stats().bytes, 0u);
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MODULE token_manager
+#include <boost/test/included/unit_test.hpp>
+#include <giga/rest/TokenManager.h>
+#include <giga/utils/Utils.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace boost::unit_test;
+using giga::TokenManager;
+using std::chrono::steady_clock;
+
+namespace
+{
+TokenManager::Token
+token(const utility::string_t& value, std::chrono::seconds lifetime)
+{
+    return TokenManager::Token{value, steady_clock::now() + lifetime};
+}
+
+/**
+ * Gives "t1", "t2", ... slowly, valid for an hour.
+ */
+TokenManager::RefreshFct
+slowRefresh(std::shared_ptr<std::atomic<int>> calls)
+{
+    return [calls]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds{50});
+        auto n = ++*calls;
+        return token(U("t") + giga::utils::str2wstr(std::to_string(n)), std::chrono::seconds{3600});
+    };
+}
+}
+
+BOOST_AUTO_TEST_CASE(test_not_authenticated)
+{
+    auto tokens = std::make_shared<TokenManager>();
+    BOOST_CHECK(tokens->current() == nullptr);
+    BOOST_CHECK(tokens->valid().get() == nullptr);
+    BOOST_CHECK(tokens->rejected(U("t0")).get() == nullptr);
+    BOOST_CHECK_EQUAL(tokens->refreshCount(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_valid_token_is_not_refreshed)
+{
+    auto calls  = std::make_shared<std::atomic<int>>(0);
+    auto tokens = std::make_shared<TokenManager>();
+    tokens->reset(token(U("t0"), std::chrono::seconds{3600}), slowRefresh(calls));
+    for (auto i = 0; i < 100; ++i)
+    {
+        BOOST_CHECK(tokens->valid().get()->accessToken == U("t0"));
+    }
+    BOOST_CHECK_EQUAL(calls->load(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_refreshed_ahead_in_the_background)
+{
+    auto calls  = std::make_shared<std::atomic<int>>(0);
+    auto tokens = std::make_shared<TokenManager>();
+    tokens->reset(token(U("t0"), TokenManager::REFRESH_AHEAD - std::chrono::seconds{10}), slowRefresh(calls));
+
+    // still valid: the callers do not wait for the refresh
+    for (auto i = 0; i < 10; ++i)
+    {
+        BOOST_CHECK(tokens->valid().get()->accessToken == U("t0"));
+    }
+    for (auto i = 0; i < 100 && tokens->current()->accessToken == U("t0"); ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    }
+    BOOST_CHECK(tokens->current()->accessToken == U("t1"));
+    BOOST_CHECK_EQUAL(calls->load(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_single_flight_when_expiring)
+{
+    auto calls  = std::make_shared<std::atomic<int>>(0);
+    auto tokens = std::make_shared<TokenManager>();
+    tokens->reset(token(U("t0"), std::chrono::seconds{1}), slowRefresh(calls));
+
+    std::vector<std::thread> threads;
+    std::atomic<int> renewed{0};
+    for (auto i = 0; i < 16; ++i)
+    {
+        threads.emplace_back([&]() {
+            if (tokens->valid().get()->accessToken == U("t1"))
+            {
+                ++renewed;
+            }
+        });
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    BOOST_CHECK_EQUAL(renewed.load(), 16);
+    BOOST_CHECK_EQUAL(calls->load(), 1);
+    BOOST_CHECK_EQUAL(tokens->refreshCount(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(test_rejected)
+{
+    auto calls  = std::make_shared<std::atomic<int>>(0);
+    auto tokens = std::make_shared<TokenManager>();
+    tokens->reset(token(U("t0"), std::chrono::seconds{3600}), slowRefresh(calls));
+
+    BOOST_CHECK(tokens->rejected(U("t0")).get()->accessToken == U("t1"));
+    // a request sent with the old token: already renewed
+    BOOST_CHECK(tokens->rejected(U("t0")).get()->accessToken == U("t1"));
+    BOOST_CHECK_EQUAL(calls->load(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_failed_refresh_keeps_the_token)
+{
+    auto calls  = std::make_shared<std::atomic<int>>(0);
+    auto tokens = std::make_shared<TokenManager>();
+    tokens->reset(token(U("t0"), std::chrono::seconds{1}), [calls]() -> TokenManager::Token {
+        ++*calls;
+        throw std::runtime_error("unreachable");
+    });
+
+    BOOST_CHECK(tokens->valid().get()->accessToken == U("t0"));
+    // not retried at once
+    BOOST_CHECK(tokens->valid().get()->accessToken == U("t0"));
+    BOOST_CHECK(tokens->rejected(U("t0")).get()->accessToken == U("t0"));
+    BOOST_CHECK_EQUAL(calls->load(), 1);
+}
@@ -0,0 +1,317 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MODULE upload_journal
+#include <boost/test/included/unit_test.hpp>
+#include <giga/core/details/UploadJournal.h>
+
+#include <boost/filesystem.hpp>
+#include <fstream>
+
+using namespace boost::unit_test;
+using boost::filesystem::path;
+using giga::details::PreparedFileCache;
+using giga::details::UploadJournal;
+
+namespace
+{
+void
+writeFile(const path& p, const std::string& content)
+{
+    std::ofstream os{p.c_str(), std::ios::binary | std::ios::trunc};
+    os << content;
+}
+
+std::size_t
+lineCount(const path& p)
+{
+    std::ifstream is{p.c_str(), std::ios::binary};
+    std::string line;
+    std::size_t count = 0;
+    while (std::getline(is, line))
+    {
+        count += 1;
+    }
+    return count;
+}
+
+struct TempDir
+{
+    TempDir() : dir{boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()} {
+        boost::filesystem::create_directories(dir);
+    }
+    ~TempDir() {
+        boost::filesystem::remove_all(dir);
+    }
+    path dir;
+};
+}
+
+BOOST_AUTO_TEST_CASE(test_journal_survives_reload)
+{
+    TempDir tmp;
+    auto journalFile = tmp.dir / "upload.journal";
+    auto file        = tmp.dir / "file.txt";
+    writeFile(file, "content");
+    auto identity = PreparedFileCache::key(file);
+    BOOST_REQUIRE(identity);
+
+    {
+        UploadJournal journal{journalFile, UploadJournal::OpenMode::truncate};
+        journal.requested("parent", tmp.dir);
+        BOOST_CHECK(journal.scanned("parent", file, "dir/file.txt", 7));
+        journal.prepared("parent", file, *identity, "sha1", "fid", "fkey");
+        journal.acknowledged("parent", file, "1-sha1", 1024);
+    }
+    UploadJournal journal{journalFile, UploadJournal::OpenMode::resume};
+    auto requests = journal.pendingRequests();
+    BOOST_REQUIRE(requests.size() == 1);
+    BOOST_CHECK(requests[0].parentId == "parent");
+    BOOST_CHECK(requests[0].path == tmp.dir);
+
+    auto found = journal.find("parent", file);
+    BOOST_REQUIRE(found);
+    BOOST_CHECK(found->nodePath == "dir/file.txt");
+    BOOST_CHECK(found->size == 7);
+    BOOST_CHECK(found->isPrepared);
+    BOOST_CHECK(found->identity == *identity);
+    BOOST_CHECK(found->sha1 == "sha1");
+    BOOST_CHECK(found->fid  == "fid");
+    BOOST_CHECK(found->fkey == "fkey");
+    BOOST_CHECK(found->sessionId == "1-sha1");
+    BOOST_CHECK(found->acknowledged == 1024);
+    BOOST_CHECK(!journal.find("parent", tmp.dir / "other.txt"));
+    BOOST_CHECK(!journal.find("other", file));
+}
+
+BOOST_AUTO_TEST_CASE(test_journal_is_compacted)
+{
+    TempDir tmp;
+    auto journalFile = tmp.dir / "upload.journal";
+    {
+        UploadJournal journal{journalFile, UploadJournal::OpenMode::truncate};
+        journal.requested("parent", tmp.dir);
+        for (auto i = 0; i < 10; ++i)
+        {
+            auto file = tmp.dir / std::to_string(i);
+            journal.scanned("parent", file, std::to_string(i), 1);
+            journal.acknowledged("parent", file, "1-sha1", 512);
+            journal.acknowledged("parent", file, "1-sha1", 512); // not written again
+            journal.acknowledged("parent", file, "1-sha1", 1024);
+            if (i > 0)
+            {
+                journal.done("parent", file);
+            }
+        }
+        journal.requestScanned("parent", tmp.dir);
+    }
+    BOOST_CHECK(lineCount(journalFile) == 1 + 2 + 10 * 3 + 9);
+
+    {
+        UploadJournal journal{journalFile, UploadJournal::OpenMode::resume};
+        BOOST_CHECK(journal.pendingRequests().empty());
+        BOOST_REQUIRE(journal.pendingFiles().size() == 1);
+        BOOST_CHECK(journal.pendingFiles()[0].acknowledged == 1024);
+    }
+    // the header, S and A of the pending file: the done files of a completed request are forgotten
+    BOOST_CHECK(lineCount(journalFile) == 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_paths_are_escaped)
+{
+    TempDir tmp;
+    auto journalFile = tmp.dir / "upload.journal";
+    auto file        = tmp.dir / "a\tb\nc\\d\\t";
+    {
+        UploadJournal journal{journalFile, UploadJournal::OpenMode::truncate};
+        BOOST_CHECK(journal.scanned("parent", file, "x\\n\ty", 3));
+        journal.acknowledged("parent", file, "1-\t", 2);
+    }
+    UploadJournal journal{journalFile, UploadJournal::OpenMode::resume};
+    auto files = journal.pendingFiles();
+    BOOST_REQUIRE(files.size() == 1);
+    BOOST_CHECK(files[0].path == file);
+    BOOST_CHECK(files[0].nodePath == "x\\n\ty");
+    BOOST_CHECK(files[0].sessionId == "1-\t");
+    BOOST_CHECK(files[0].acknowledged == 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_acknowledged_per_session)
+{
+    TempDir tmp;
+    auto journalFile = tmp.dir / "upload.journal";
+    auto file        = tmp.dir / "file.txt";
+    {
+        UploadJournal journal{journalFile, UploadJournal::OpenMode::truncate};
+        journal.scanned("parent", file, "file.txt", 4096);
+        journal.acknowledged("parent", file, "1-sha1", 2048);
+
+        // the file changed: the acknowledged offset belongs to the new session
+        journal.acknowledged("parent", file, "1-sha1b", 1024);
+        BOOST_CHECK(journal.find("parent", file)->sessionId == "1-sha1b");
+        BOOST_CHECK(journal.find("parent", file)->acknowledged == 1024);
+    }
+    UploadJournal journal{journalFile, UploadJournal::OpenMode::resume};
+    BOOST_CHECK(journal.find("parent", file)->sessionId == "1-sha1b");
+    BOOST_CHECK(journal.find("parent", file)->acknowledged == 1024);
+
+    // a file scanned again starts a new session
+    journal.scanned("parent", file, "file.txt", 4096);
+    BOOST_CHECK(journal.find("parent", file)->sessionId.empty());
+    BOOST_CHECK(journal.find("parent", file)->acknowledged == 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_invalid_lines_are_ignored)
+{
+    TempDir tmp;
+    auto journalFile = tmp.dir / "upload.journal";
+    auto file        = tmp.dir / "file.txt";
+    {
+        UploadJournal journal{journalFile, UploadJournal::OpenMode::truncate};
+        journal.scanned("parent", file, "file.txt", 10);
+        journal.scanned("parent", tmp.dir / "other.txt", "other.txt", 10);
+    }
+    {
+        std::ofstream os{journalFile.c_str(), std::ios::binary | std::ios::app};
+        os << "X\tparent\tunknown\n";
+        os << "S\tparent\n";
+        os << "S\tparent\tbad.txt\tbad.txt\tnot a size\n";
+        os << "A\tparent\t" << file.string() << "\t1-sha1\t-\n";
+        os << "P\tparent\t" << file.string() << "\tsha1\tfid\tfkey\n"; // a version 1 record
+        os << "A\tparent\t" << file.string() << "\t1-sha1\t512\n";
+        os << "A\tparent\t" << file.string() << "\t1-sh"; // truncated by a crash
+    }
+    {
+        UploadJournal journal{journalFile, UploadJournal::OpenMode::resume};
+        BOOST_CHECK(journal.pendingFiles().size() == 2);
+        auto found = journal.find("parent", file);
+        BOOST_REQUIRE(found);
+        BOOST_CHECK(!found->isPrepared);
+        BOOST_CHECK(found->sessionId == "1-sha1");
+        BOOST_CHECK(found->acknowledged == 512);
+    }
+
+    // a journal of another format is ignored
+    writeFile(journalFile, "giga-upload-journal 0\nS\tparent\tfile.txt\tfile.txt\t10\n");
+    UploadJournal journal{journalFile, UploadJournal::OpenMode::resume};
+    BOOST_CHECK(journal.pendingFiles().empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_resumed_files_are_skipped_once)
+{
+    TempDir tmp;
+    auto journalFile = tmp.dir / "upload.journal";
+    auto dir         = tmp.dir / "dir";
+    auto done        = dir / "done.txt";
+    auto pending     = dir / "pending.txt";
+    auto failed      = dir / "failed.txt";
+    auto other       = tmp.dir / "dir.txt"; // not in dir
+    {
+        UploadJournal journal{journalFile, UploadJournal::OpenMode::truncate};
+        journal.requested("parent", dir);
+        journal.requested("parent", other);
+        journal.requestScanned("parent", other);
+        for (const auto& file : {done, pending, failed, other})
+        {
+            BOOST_CHECK(journal.scanned("parent", file, file.filename(), 1));
+        }
+        journal.done("parent", done);
+        journal.failed("parent", failed);
+    }
+
+    UploadJournal journal{journalFile, UploadJournal::OpenMode::resume};
+    BOOST_CHECK(journal.pendingFiles().size() == 2);
+    BOOST_CHECK(!journal.find("parent", failed));
+
+    // other was queued again by the resume, but its request completed
+    BOOST_CHECK(journal.scanned("parent", other, "dir.txt", 1));
+
+    // the interrupted request is scanned again: only the failed file is queued
+    BOOST_CHECK(!journal.scanned("parent", done, "done.txt", 1));
+    BOOST_CHECK(!journal.scanned("parent", pending, "pending.txt", 1));
+    BOOST_CHECK(journal.scanned("parent", failed, "failed.txt", 1));
+    journal.requestScanned("parent", dir);
+
+    // then added again by the user
+    BOOST_CHECK(journal.scanned("parent", done, "done.txt", 1));
+    BOOST_CHECK(journal.scanned("parent", pending, "pending.txt", 1));
+}
+
+BOOST_AUTO_TEST_CASE(test_skipped_files_are_forgotten_when_the_request_is_scanned)
+{
+    TempDir tmp;
+    auto journalFile = tmp.dir / "upload.journal";
+    auto removed     = tmp.dir / "sub" / "removed.txt";
+    {
+        UploadJournal journal{journalFile, UploadJournal::OpenMode::truncate};
+        journal.requested("parent", tmp.dir);
+        journal.scanned("parent", removed, "sub/removed.txt", 1);
+        journal.done("parent", removed);
+    }
+    UploadJournal journal{journalFile, UploadJournal::OpenMode::resume};
+    journal.requestScanned("parent", tmp.dir); // removed.txt was not found again
+    BOOST_CHECK(journal.scanned("parent", removed, "sub/removed.txt", 1));
+}
+
+BOOST_AUTO_TEST_CASE(test_clear_forgets_everything)
+{
+    TempDir tmp;
+    auto journalFile = tmp.dir / "upload.journal";
+    auto file        = tmp.dir / "file.txt";
+    {
+        UploadJournal journal{journalFile, UploadJournal::OpenMode::truncate};
+        journal.requested("parent", tmp.dir);
+        journal.scanned("parent", file, "file.txt", 1);
+        journal.clear();
+        BOOST_CHECK(journal.pendingFiles().empty());
+        journal.scanned("parent", tmp.dir / "new.txt", "new.txt", 1);
+    }
+    UploadJournal journal{journalFile, UploadJournal::OpenMode::resume};
+    BOOST_CHECK(journal.pendingRequests().empty());
+    BOOST_REQUIRE(journal.pendingFiles().size() == 1);
+    BOOST_CHECK(journal.pendingFiles()[0].path == tmp.dir / "new.txt");
+}
+
+BOOST_AUTO_TEST_CASE(test_modified_file_has_another_identity)
+{
+    TempDir tmp;
+    auto journalFile = tmp.dir / "upload.journal";
+    auto file        = tmp.dir / "file.txt";
+    writeFile(file, "content");
+    {
+        UploadJournal journal{journalFile, UploadJournal::OpenMode::truncate};
+        journal.scanned("parent", file, "file.txt", 7);
+        journal.prepared("parent", file, *PreparedFileCache::key(file), "sha1", "fid", "fkey");
+    }
+    UploadJournal journal{journalFile, UploadJournal::OpenMode::resume};
+    BOOST_CHECK(journal.find("parent", file)->identity == *PreparedFileCache::key(file));
+
+    // modified in place, same size
+    auto mtime = boost::filesystem::last_write_time(file);
+    writeFile(file, "CONTENT");
+    boost::filesystem::last_write_time(file, mtime + 1);
+    BOOST_CHECK(journal.find("parent", file)->identity != *PreparedFileCache::key(file));
+
+    // replaced by another file of the same size and modification time
+    auto replacement = tmp.dir / "replacement.txt";
+    writeFile(replacement, "content");
+    boost::filesystem::last_write_time(replacement, mtime);
+    boost::filesystem::rename(replacement, file);
+    auto identity = journal.find("parent", file)->identity;
+    auto current  = *PreparedFileCache::key(file);
+    BOOST_CHECK(current.size == identity.size);
+    BOOST_CHECK(current.inode != identity.inode);
+    BOOST_CHECK(current != identity);
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2016 Gigatribe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MODULE upload_scheduler
+#include <boost/test/included/unit_test.hpp>
+#include <giga/core/details/UploadScheduler.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace boost::unit_test;
+using giga::details::SchedulingPolicy;
+using giga::details::SchedulingTicket;
+using giga::details::UploadScheduler;
+
+namespace
+{
+typedef UploadScheduler<std::unique_ptr<int>> Scheduler;
+
+void
+push(Scheduler& s, int value, uint64_t size, uint64_t requestId = 0, int priority = 0)
+{
+    s.enqueue(std::unique_ptr<int>{new int{value}}, SchedulingTicket{size, requestId, priority});
+}
+
+std::vector<int>
+drain(Scheduler& s, std::size_t count)
+{
+    std::vector<int> values;
+    std::unique_ptr<int> element;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        s.wait_dequeue(element);
+        values.push_back(element ? *element : -1);
+    }
+    return values;
+}
+}
+
+BOOST_AUTO_TEST_CASE(test_fifo)
+{
+    Scheduler s;
+    push(s, 1, 300);
+    push(s, 2, 100);
+    push(s, 3, 200);
+    BOOST_CHECK((drain(s, 3) == std::vector<int>{1, 2, 3}));
+    BOOST_CHECK(s.size_approx() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_smallest_first)
+{
+    Scheduler s;
+    s.setPolicy(SchedulingPolicy::smallestFirst);
+    push(s, 1, 1000000);
+    push(s, 2, 10);
+    push(s, 3, 30);
+    push(s, 4, 20);
+    push(s, 5, 40);
+    // the 4th dequeue takes the oldest file
+    BOOST_CHECK((drain(s, 5) == std::vector<int>{2, 4, 3, 1, 5}));
+}
+
+BOOST_AUTO_TEST_CASE(test_priority)
+{
+    Scheduler s;
+    push(s, 1, 10, 1, 0);
+    push(s, 2, 10, 2, 5);
+    push(s, 3, 10, 1, 0);
+    push(s, 4, 10, 2, 5);
+    s.setPolicy(SchedulingPolicy::priority);
+    BOOST_CHECK((drain(s, 4) == std::vector<int>{2, 4, 1, 3}));
+}
+
+BOOST_AUTO_TEST_CASE(test_fair)
+{
+    Scheduler s;
+    s.setPolicy(SchedulingPolicy::fair);
+    for (int i = 0; i < 6; ++i)
+    {
+        push(s, 10 + i, 100, 1, 0); // weight 1
+    }
+    for (int i = 0; i < 6; ++i)
+    {
+        push(s, 20 + i, 100, 2, 1); // weight 2
+    }
+    auto values = drain(s, 9);
+    auto fromSecond = std::count_if(values.begin(), values.end(), [](int v) { return v >= 20; });
+    BOOST_CHECK(fromSecond == 6);
+    BOOST_CHECK(values.front() == 10 || values.front() == 20);
+}
+
+BOOST_AUTO_TEST_CASE(test_barriers_are_not_reordered)
+{
+    Scheduler s;
+    s.setPolicy(SchedulingPolicy::smallestFirst);
+    push(s, 1, 300);
+    push(s, 2, 200);
+    s.enqueue_barrier(nullptr);
+    push(s, 3, 1);
+    s.enqueue_barrier(nullptr);
+    BOOST_CHECK((drain(s, 5) == std::vector<int>{2, 1, -1, 3, -1}));
+}
+
+BOOST_AUTO_TEST_CASE(test_limits)
+{
+    Scheduler s;
+    s.setLimits(2, 0, nullptr);
+    push(s, 1, 10);
+    push(s, 2, 10);
+    std::atomic<bool> waited{false};
+    std::thread producer{[&] {
+        s.wait_not_full();
+        waited = true;
+    }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    BOOST_CHECK(!waited);
+    drain(s, 1);
+    producer.join();
+    BOOST_CHECK(waited);
+}